@@ -37,6 +37,7 @@
 struct state {
         char need_op_write:1;
         char need_op_read:1;
+        char need_op_randwrite:1;
 
         char need_iface_fileio:1;
         char need_iface_xattr:1;
@@ -48,6 +49,7 @@ struct state {
         long int count;
 
         size_t block_size;
+        size_t spread;
 
         char *specfile;
         void *libglusterfsclient_context;
@@ -106,12 +108,19 @@ parse_opts (int key, char *arg,
                 if (strcasecmp (arg, "read") == 0) {
                         state->need_op_write = 0;
                         state->need_op_read = 1;
+                        state->need_op_randwrite = 0;
                 } else if (strcasecmp (arg, "write") == 0) {
                         state->need_op_write = 1;
                         state->need_op_read = 0;
+                        state->need_op_randwrite = 0;
                 } else if (strcasecmp (arg, "both") == 0) {
                         state->need_op_write = 1;
                         state->need_op_read = 1;
+                        state->need_op_randwrite = 0;
+                } else if (strcasecmp (arg, "randwrite") == 0) {
+                        state->need_op_write = 0;
+                        state->need_op_read = 0;
+                        state->need_op_randwrite = 1;
                 } else {
                         fprintf (stderr, "unknown op: %s\n", arg);
                         return -1;
@@ -157,6 +166,16 @@ parse_opts (int key, char *arg,
                 state->block_size = block_size;
         }
         break;
+        case 'r':
+        {
+                size_t spread = atol (arg);
+                if (!spread) {
+                        fprintf (stderr, "incorrect spread: %s\n", arg);
+                        return -1;
+                }
+                state->spread = spread;
+        }
+        break;
         case 's':
                 state->specfile = strdup (arg);
                 break;
@@ -248,12 +267,90 @@ do_mode_posix_iface_fileio_read (struct state *state)
 }
 
 
+long int
+gcd (long int a, long int b)
+{
+        while (b) {
+                long int t = a % b;
+                a = b;
+                b = t;
+        }
+
+        return a;
+}
+
+
+/*
+ * offset of the i'th block of a random-ish writer: the file is written
+ * in chunks of 'spread' bytes, and within a chunk the blocks go in a
+ * shuffled order. every block is written exactly once.
+ */
+off_t
+randwrite_offset (struct state *state, long int i)
+{
+        long int per_chunk = state->spread / state->block_size;
+        long int stride = 0;
+        long int chunk = 0;
+        long int slot = 0;
+
+        if (per_chunk < 2)
+                return (off_t)i * state->block_size;
+
+        /* a stride coprime to per_chunk visits every slot once */
+        stride = per_chunk / 2 + 1;
+        while (gcd (stride, per_chunk) != 1)
+                stride++;
+
+        chunk = i / per_chunk;
+        slot = ((i % per_chunk) * stride + chunk) % per_chunk;
+
+        return ((off_t)chunk * per_chunk + slot) * state->block_size;
+}
+
+
+int
+do_mode_posix_iface_fileio_randwrite (struct state *state)
+{
+        long int i;
+        int ret = -1;
+        int fd = -1;
+        char block[state->block_size];
+        char filename[512];
+
+        sprintf (filename, "%s.random", state->prefix);
+
+        fd = open (filename, O_CREAT|O_WRONLY, 00600);
+        if (fd == -1) {
+                fprintf (stderr, "open(%s) => %s\n", filename, strerror (errno));
+                return 0;
+        }
+
+        for (i=0; i<state->count; i++) {
+                ret = pwrite (fd, block, state->block_size,
+                              randwrite_offset (state, i));
+                if (ret != state->block_size) {
+                        fprintf (stderr, "pwrite (%s) => %d/%s\n", filename,
+                                 ret, strerror (errno));
+                        break;
+                }
+                state->io_size += ret;
+        }
+
+        close (fd);
+
+        return i;
+}
+
+
 int
 do_mode_posix_iface_fileio (struct state *state)
 {
         if (state->need_op_write)
                 MEASURE (do_mode_posix_iface_fileio_write, state);
 
+        if (state->need_op_randwrite)
+                MEASURE (do_mode_posix_iface_fileio_randwrite, state);
+
         if (state->need_op_read)
                 MEASURE (do_mode_posix_iface_fileio_read, state);
 
@@ -413,12 +510,51 @@ do_mode_libglusterfsclient_iface_fileio_read (struct state *state)
 }
 
 
+int
+do_mode_libglusterfsclient_iface_fileio_randwrite (struct state *state)
+{
+        long int i;
+        int ret = -1;
+        glusterfs_file_t fd = 0;
+        char block[state->block_size];
+        char filename[512];
+
+        sprintf (filename, "/%s.random", state->prefix);
+
+        fd = glusterfs_glh_open (state->libglusterfsclient_context,
+                                 filename, O_CREAT|O_WRONLY, 0);
+        if (fd == 0) {
+                fprintf (stderr, "open(%s) => %s\n", filename, strerror (errno));
+                return 0;
+        }
+
+        for (i=0; i<state->count; i++) {
+                ret = glusterfs_pwrite (fd, block, state->block_size,
+                                        randwrite_offset (state, i));
+                if (ret == -1) {
+                        fprintf (stderr, "glusterfs_pwrite(%s) => %s\n",
+                                 filename, strerror (errno));
+                        break;
+                }
+                state->io_size += ret;
+        }
+
+        glusterfs_close (fd);
+
+        return i;
+}
+
+
 int
 do_mode_libglusterfsclient_iface_fileio (struct state *state)
 {
         if (state->need_op_write)
                 MEASURE (do_mode_libglusterfsclient_iface_fileio_write, state);
 
+        if (state->need_op_randwrite)
+                MEASURE (do_mode_libglusterfsclient_iface_fileio_randwrite,
+                         state);
+
         if (state->need_op_read)
                 MEASURE (do_mode_libglusterfsclient_iface_fileio_read, state);
 
@@ -574,13 +710,16 @@ do_actions (struct state *state)
 
 static struct argp_option options[] = {
         {"op", 'o', "OPERATIONS", 0,
-         "WRITE|READ|BOTH - defaults to BOTH"},
+         "WRITE|READ|BOTH|RANDWRITE - defaults to BOTH"},
         {"iface", 'i', "INTERFACE", 0,
          "FILEIO|XATTR|BOTH - defaults to FILEIO"},
         {"mode", 'm', "MODE", 0,
          "POSIX|LIBGLUSTERFSCLIENT|BOTH - defaults to POSIX"},
         {"block", 'b', "BLOCKSIZE", 0,
          "<NUM> - defaults to 4096"},
+        {"spread", 'r', "SPREAD", 0,
+         "<NUM> - RANDWRITE shuffles blocks within chunks of this many "
+         "bytes, defaults to 1048576"},
         {"specfile", 's', "SPECFILE", 0,
          "absolute path to specfile"},
         {"prefix", 'p', "PREFIX", 0,
@@ -612,6 +751,7 @@ main (int argc, char *argv[])
         state.need_mode_libglusterfsclient = 0;
 
         state.block_size = 4096;
+        state.spread = 1048576;
 
         strcpy (state.prefix, "tmpfile");
         state.count = 1048576;
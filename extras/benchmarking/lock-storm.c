@@ -0,0 +1,286 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * lock-storm - a number of processes take byte-range write locks on one
+ * file, interleaved like MPI-IO ranks writing a strided file (process i
+ * locks blocks i, i + procs, i + 2 * procs ...), hold them all and then
+ * unlock them. prints the lock and unlock rates, which with the locks
+ * translator go down with the number of locks held on the file.
+ *
+ * processes rather than threads, since fcntl locks belong to a process.
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <argp.h>
+
+struct ls_config {
+        char          path[512];
+        long          block_size;
+        long          count;
+        int           procs;
+};
+static struct ls_config ls_config;
+
+
+static error_t
+ls_parse_opts (int key, char *arg,
+               struct argp_state *_state)
+{
+        char *tmp = NULL;
+        long  val = 0;
+
+        switch (key) {
+        case 'f':
+                strncpy (ls_config.path, arg, 511);
+                return 0;
+        case ARGP_KEY_NO_ARGS:
+        case ARGP_KEY_ARG:
+        case ARGP_KEY_END:
+                return 0;
+        case 'b':
+        case 'c':
+        case 'p':
+                break;
+        default:
+                return ARGP_ERR_UNKNOWN;
+        }
+
+        val = strtol (arg, &tmp, 10);
+        if ((val <= 0) || (val == LONG_MAX) || (tmp && *tmp)) {
+                fprintf (stderr, "invalid argument (%s)\n", arg);
+                return -1;
+        }
+
+        switch (key) {
+        case 'b':
+                ls_config.block_size = val;
+                break;
+        case 'c':
+                ls_config.count = val;
+                break;
+        case 'p':
+                ls_config.procs = val;
+                break;
+        }
+
+        return 0;
+}
+
+static struct argp_option ls_options[] = {
+        {"file", 'f', "FILE", 0,
+         "file to lock, created if needed (defaults to tmpfile)"},
+        {"block", 'b', "BLOCKSIZE", 0,
+         "length of each locked range (defaults to 4096)"},
+        {"count", 'c', "COUNT", 0,
+         "locks taken by each process (defaults to 10000)"},
+        {"procs", 'p', "COUNT", 0,
+         "number of locking processes (defaults to 4)"},
+        {0, 0, 0, 0, 0}
+};
+
+static struct argp argp = {
+        ls_options,
+        ls_parse_opts,
+        "",
+        "lock-storm - many interleaved byte-range locks on one file"
+};
+
+
+static int
+ls_setlk (int fd, short type, off_t start, off_t len)
+{
+        struct flock flock = {0, };
+
+        flock.l_type   = type;
+        flock.l_whence = SEEK_SET;
+        flock.l_start  = start;
+        flock.l_len    = len;
+
+        return fcntl (fd, F_SETLKW, &flock);
+}
+
+
+/*
+ * lock everything, say so on @ready, wait for @go to be closed, unlock
+ * everything.
+ */
+static int
+ls_locker (int rank, int ready, int go)
+{
+        off_t offset = 0;
+        long  i = 0;
+        char  c = 0;
+        int   fd = -1;
+
+        fd = open (ls_config.path, O_RDWR);
+        if (fd == -1) {
+                fprintf (stderr, "open(%s) => %s\n", ls_config.path,
+                         strerror (errno));
+                return 1;
+        }
+
+        for (i = 0; i < ls_config.count; i++) {
+                offset = ((off_t)i * ls_config.procs + rank)
+                        * ls_config.block_size;
+                if (ls_setlk (fd, F_WRLCK, offset,
+                              ls_config.block_size) == -1) {
+                        fprintf (stderr, "lock => %s\n", strerror (errno));
+                        return 1;
+                }
+        }
+
+        if (write (ready, &c, 1) != 1)
+                return 1;
+
+        if (read (go, &c, 1) != 0)
+                return 1;
+
+        for (i = 0; i < ls_config.count; i++) {
+                offset = ((off_t)i * ls_config.procs + rank)
+                        * ls_config.block_size;
+                if (ls_setlk (fd, F_UNLCK, offset,
+                              ls_config.block_size) == -1) {
+                        fprintf (stderr, "unlock => %s\n", strerror (errno));
+                        return 1;
+                }
+        }
+
+        close (fd);
+
+        return 0;
+}
+
+
+static double
+ls_elapsed (struct timeval *start)
+{
+        struct timeval now;
+
+        gettimeofday (&now, NULL);
+
+        return (now.tv_sec - start->tv_sec)
+                + (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        struct timeval  start;
+        double          lock_time = 0;
+        double          unlock_time = 0;
+        long            total = 0;
+        pid_t           pid = 0;
+        char            c = 0;
+        int             ready[2];
+        int             go[2];
+        int             status = 0;
+        int             failed = 0;
+        int             fd = -1;
+        int             i = 0;
+
+        strcpy (ls_config.path, "tmpfile");
+        ls_config.block_size = 4096;
+        ls_config.count = 10000;
+        ls_config.procs = 4;
+
+        if (argp_parse (&argp, argc, argv, 0, 0, NULL) != 0) {
+                fprintf (stderr, "argp_parse() failed\n");
+                return 1;
+        }
+
+        fd = open (ls_config.path, O_RDWR | O_CREAT, 0644);
+        if (fd == -1) {
+                fprintf (stderr, "open(%s) => %s\n", ls_config.path,
+                         strerror (errno));
+                return 1;
+        }
+        close (fd);
+
+        if ((pipe (ready) == -1) || (pipe (go) == -1)) {
+                fprintf (stderr, "pipe => %s\n", strerror (errno));
+                return 1;
+        }
+
+        gettimeofday (&start, NULL);
+
+        for (i = 0; i < ls_config.procs; i++) {
+                pid = fork ();
+                if (pid == -1) {
+                        fprintf (stderr, "fork => %s\n", strerror (errno));
+                        return 1;
+                }
+
+                if (pid == 0) {
+                        close (ready[0]);
+                        close (go[1]);
+                        exit (ls_locker (i, ready[1], go[0]));
+                }
+        }
+
+        close (ready[1]);
+        close (go[0]);
+
+        for (i = 0; i < ls_config.procs; i++) {
+                if (read (ready[0], &c, 1) != 1) {
+                        failed = 1;
+                        break;
+                }
+        }
+
+        lock_time = ls_elapsed (&start);
+
+        gettimeofday (&start, NULL);
+        close (go[1]);
+
+        for (i = 0; i < ls_config.procs; i++) {
+                if (wait (&status) == -1)
+                        break;
+                if (!WIFEXITED (status) || WEXITSTATUS (status))
+                        failed = 1;
+        }
+
+        unlock_time = ls_elapsed (&start);
+
+        if (failed) {
+                fprintf (stderr, "some lockers failed\n");
+                return 1;
+        }
+
+        total = ls_config.count * ls_config.procs;
+
+        fprintf (stdout, "procs=%d, locks=%ld, lock/s=%.0f, unlock/s=%.0f\n",
+                 ls_config.procs, total, total / lock_time,
+                 total / unlock_time);
+
+        return 0;
+}
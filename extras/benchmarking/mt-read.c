@@ -0,0 +1,287 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * mt-read - re-read a set of files from 1, 2, 4 ... threads and print
+ * the read rate for each thread count. run it on a glusterfs mount with
+ * a read cache (io-cache) to see how the cache scales with readers.
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <argp.h>
+
+struct mtr_file {
+        int   fd;
+        off_t blocks;
+};
+
+struct mtr_config {
+        char             prefix[512];
+        long             file_count;
+        size_t           block_size;
+        int              max_threads;
+        int              seconds;
+        struct mtr_file *files;
+        volatile int     stop;
+};
+static struct mtr_config mtr_config;
+
+struct mtr_thread {
+        pthread_t     thread;
+        unsigned int  seed;
+        long          ops;
+        int           failed;
+};
+
+
+static error_t
+mtr_parse_opts (int key, char *arg,
+                struct argp_state *_state)
+{
+        char *tmp = NULL;
+        long  val = 0;
+
+        switch (key) {
+        case 'p':
+                strncpy (mtr_config.prefix, arg, 511);
+                return 0;
+        case ARGP_KEY_NO_ARGS:
+        case ARGP_KEY_ARG:
+        case ARGP_KEY_END:
+                return 0;
+        case 'c':
+        case 'b':
+        case 't':
+        case 's':
+                break;
+        default:
+                return ARGP_ERR_UNKNOWN;
+        }
+
+        val = strtol (arg, &tmp, 10);
+        if ((val <= 0) || (val == LONG_MAX) || (tmp && *tmp)) {
+                fprintf (stderr, "invalid argument (%s)\n", arg);
+                return -1;
+        }
+
+        switch (key) {
+        case 'c':
+                mtr_config.file_count = val;
+                break;
+        case 'b':
+                mtr_config.block_size = val;
+                break;
+        case 't':
+                mtr_config.max_threads = val;
+                break;
+        case 's':
+                mtr_config.seconds = val;
+                break;
+        }
+
+        return 0;
+}
+
+static struct argp_option mtr_options[] = {
+        {"prefix", 'p', "PREFIX", 0,
+         "files are PREFIX.000000, PREFIX.000001 ... (defaults to tmpfile)"},
+        {"count", 'c', "COUNT", 0, "number of files (defaults to 16)"},
+        {"block", 'b', "BLOCKSIZE", 0,
+         "size of each read in bytes (defaults to 4096)"},
+        {"threads", 't', "COUNT", 0,
+         "largest number of reader threads (defaults to 16)"},
+        {"seconds", 's', "SECONDS", 0,
+         "run time per thread count (defaults to 10)"},
+        {0, 0, 0, 0, 0}
+};
+
+static struct argp argp = {
+        mtr_options,
+        mtr_parse_opts,
+        "",
+        "mt-read - re-read a set of files from a growing number of threads"
+};
+
+
+static int
+mtr_open_files (void)
+{
+        struct stat st;
+        char        path[540];
+        long        i = 0;
+
+        mtr_config.files = calloc (mtr_config.file_count,
+                                   sizeof (struct mtr_file));
+        if (!mtr_config.files)
+                return -1;
+
+        for (i = 0; i < mtr_config.file_count; i++) {
+                sprintf (path, "%s.%06ld", mtr_config.prefix, i);
+
+                mtr_config.files[i].fd = open (path, O_RDONLY);
+                if (mtr_config.files[i].fd == -1) {
+                        fprintf (stderr, "open(%s) => %s\n", path,
+                                 strerror (errno));
+                        return -1;
+                }
+
+                if (fstat (mtr_config.files[i].fd, &st) == -1) {
+                        fprintf (stderr, "fstat(%s) => %s\n", path,
+                                 strerror (errno));
+                        return -1;
+                }
+
+                mtr_config.files[i].blocks = st.st_size
+                        / mtr_config.block_size;
+                if (!mtr_config.files[i].blocks) {
+                        fprintf (stderr, "%s is smaller than one block\n",
+                                 path);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+
+static void *
+mtr_read (void *arg)
+{
+        struct mtr_thread *thread = arg;
+        struct mtr_file   *file = NULL;
+        char               block[mtr_config.block_size];
+        off_t              offset = 0;
+        ssize_t            ret = 0;
+
+        while (!mtr_config.stop) {
+                file = &mtr_config.files[rand_r (&thread->seed)
+                                         % mtr_config.file_count];
+                offset = (off_t)(rand_r (&thread->seed) % file->blocks)
+                        * mtr_config.block_size;
+
+                ret = pread (file->fd, block, mtr_config.block_size, offset);
+                if (ret == -1) {
+                        fprintf (stderr, "pread => %s\n", strerror (errno));
+                        thread->failed = 1;
+                        break;
+                }
+
+                thread->ops++;
+        }
+
+        return NULL;
+}
+
+
+static int
+mtr_run (int thread_count)
+{
+        struct mtr_thread *threads = NULL;
+        struct timeval     start, stop;
+        double             elapsed = 0;
+        long               ops = 0;
+        int                failed = 0;
+        int                i = 0;
+
+        threads = calloc (thread_count, sizeof (*threads));
+        if (!threads)
+                return -1;
+
+        mtr_config.stop = 0;
+        gettimeofday (&start, NULL);
+
+        for (i = 0; i < thread_count; i++) {
+                threads[i].seed = i + 1;
+                if (pthread_create (&threads[i].thread, NULL, mtr_read,
+                                    &threads[i]) != 0) {
+                        fprintf (stderr, "pthread_create => %s\n",
+                                 strerror (errno));
+                        thread_count = i;
+                        mtr_config.stop = 1;
+                        failed = 1;
+                        break;
+                }
+        }
+
+        if (!failed)
+                sleep (mtr_config.seconds);
+        mtr_config.stop = 1;
+
+        for (i = 0; i < thread_count; i++) {
+                pthread_join (threads[i].thread, NULL);
+                ops += threads[i].ops;
+                failed |= threads[i].failed;
+        }
+
+        gettimeofday (&stop, NULL);
+        elapsed = (stop.tv_sec - start.tv_sec)
+                + (stop.tv_usec - start.tv_usec) / 1000000.0;
+
+        fprintf (stdout, "threads=%d, reads=%ld, reads/s=%.0f, MB/s=%.1f\n",
+                 thread_count, ops, ops / elapsed,
+                 ops * mtr_config.block_size / elapsed / (1024 * 1024));
+
+        free (threads);
+
+        return failed ? -1 : 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        int threads = 0;
+
+        strcpy (mtr_config.prefix, "tmpfile");
+        mtr_config.file_count = 16;
+        mtr_config.block_size = 4096;
+        mtr_config.max_threads = 16;
+        mtr_config.seconds = 10;
+
+        if (argp_parse (&argp, argc, argv, 0, 0, NULL) != 0) {
+                fprintf (stderr, "argp_parse() failed\n");
+                return 1;
+        }
+
+        if (mtr_open_files () != 0)
+                return 1;
+
+        /* the first pass only warms up the cache */
+        mtr_run (1);
+
+        for (threads = 1; threads <= mtr_config.max_threads; threads *= 2) {
+                if (mtr_run (threads) != 0)
+                        return 1;
+        }
+
+        return 0;
+}
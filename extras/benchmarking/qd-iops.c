@@ -0,0 +1,277 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * qd-iops - random O_DIRECT reads (or writes) on one file, with 1, 2, 4 ...
+ * requests outstanding, printing the IOPS for each queue depth. each
+ * outstanding request is a thread blocked in pread/pwrite, so run it on a
+ * glusterfs mount to compare bricks with and without linux-aio.
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <argp.h>
+
+struct qdi_config {
+        char          path[512];
+        size_t        block_size;
+        int           max_depth;
+        int           seconds;
+        int           write;
+        int           fd;
+        off_t         blocks;
+        volatile int  stop;
+};
+static struct qdi_config qdi_config;
+
+struct qdi_thread {
+        pthread_t     thread;
+        unsigned int  seed;
+        long          ops;
+        int           failed;
+};
+
+
+static error_t
+qdi_parse_opts (int key, char *arg,
+                struct argp_state *_state)
+{
+        char *tmp = NULL;
+        long  val = 0;
+
+        switch (key) {
+        case 'f':
+                strncpy (qdi_config.path, arg, 511);
+                return 0;
+        case 'w':
+                qdi_config.write = 1;
+                return 0;
+        case ARGP_KEY_NO_ARGS:
+        case ARGP_KEY_ARG:
+        case ARGP_KEY_END:
+                return 0;
+        case 'b':
+        case 'q':
+        case 's':
+                break;
+        default:
+                return ARGP_ERR_UNKNOWN;
+        }
+
+        val = strtol (arg, &tmp, 10);
+        if ((val <= 0) || (val == LONG_MAX) || (tmp && *tmp)) {
+                fprintf (stderr, "invalid argument (%s)\n", arg);
+                return -1;
+        }
+
+        switch (key) {
+        case 'b':
+                qdi_config.block_size = val;
+                break;
+        case 'q':
+                qdi_config.max_depth = val;
+                break;
+        case 's':
+                qdi_config.seconds = val;
+                break;
+        }
+
+        return 0;
+}
+
+static struct argp_option qdi_options[] = {
+        {"file", 'f', "FILE", 0,
+         "file to do the I/O on, at least a few blocks big "
+         "(defaults to tmpfile)"},
+        {"block", 'b', "BLOCKSIZE", 0,
+         "size of each request in bytes, a multiple of 4096 "
+         "(defaults to 4096)"},
+        {"depth", 'q', "COUNT", 0,
+         "largest number of outstanding requests (defaults to 64)"},
+        {"seconds", 's', "SECONDS", 0,
+         "run time per queue depth (defaults to 10)"},
+        {"write", 'w', 0, 0, "write instead of reading"},
+        {0, 0, 0, 0, 0}
+};
+
+static struct argp argp = {
+        qdi_options,
+        qdi_parse_opts,
+        "",
+        "qd-iops - random direct I/O on a file at growing queue depths"
+};
+
+
+static void *
+qdi_io (void *arg)
+{
+        struct qdi_thread *thread = arg;
+        char              *block = NULL;
+        off_t              offset = 0;
+        ssize_t            ret = 0;
+
+        if (posix_memalign ((void **) &block, 4096,
+                            qdi_config.block_size) != 0) {
+                thread->failed = 1;
+                return NULL;
+        }
+
+        memset (block, 0x5a, qdi_config.block_size);
+
+        while (!qdi_config.stop) {
+                offset = (off_t)(rand_r (&thread->seed) % qdi_config.blocks)
+                        * qdi_config.block_size;
+
+                if (qdi_config.write)
+                        ret = pwrite (qdi_config.fd, block,
+                                      qdi_config.block_size, offset);
+                else
+                        ret = pread (qdi_config.fd, block,
+                                     qdi_config.block_size, offset);
+                if (ret == -1) {
+                        fprintf (stderr, "%s => %s\n",
+                                 qdi_config.write ? "pwrite" : "pread",
+                                 strerror (errno));
+                        thread->failed = 1;
+                        break;
+                }
+
+                thread->ops++;
+        }
+
+        free (block);
+
+        return NULL;
+}
+
+
+static int
+qdi_run (int depth)
+{
+        struct qdi_thread *threads = NULL;
+        struct timeval     start, stop;
+        double             elapsed = 0;
+        long               ops = 0;
+        int                failed = 0;
+        int                i = 0;
+
+        threads = calloc (depth, sizeof (*threads));
+        if (!threads)
+                return -1;
+
+        qdi_config.stop = 0;
+        gettimeofday (&start, NULL);
+
+        for (i = 0; i < depth; i++) {
+                threads[i].seed = i + 1;
+                if (pthread_create (&threads[i].thread, NULL, qdi_io,
+                                    &threads[i]) != 0) {
+                        fprintf (stderr, "pthread_create => %s\n",
+                                 strerror (errno));
+                        depth = i;
+                        qdi_config.stop = 1;
+                        failed = 1;
+                        break;
+                }
+        }
+
+        if (!failed)
+                sleep (qdi_config.seconds);
+        qdi_config.stop = 1;
+
+        for (i = 0; i < depth; i++) {
+                pthread_join (threads[i].thread, NULL);
+                ops += threads[i].ops;
+                failed |= threads[i].failed;
+        }
+
+        gettimeofday (&stop, NULL);
+        elapsed = (stop.tv_sec - start.tv_sec)
+                + (stop.tv_usec - start.tv_usec) / 1000000.0;
+
+        fprintf (stdout, "depth=%d, %s=%ld, IOPS=%.0f, MB/s=%.1f\n",
+                 depth, qdi_config.write ? "writes" : "reads", ops,
+                 ops / elapsed,
+                 ops * qdi_config.block_size / elapsed / (1024 * 1024));
+
+        free (threads);
+
+        return failed ? -1 : 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        struct stat st;
+        int         depth = 0;
+
+        strcpy (qdi_config.path, "tmpfile");
+        qdi_config.block_size = 4096;
+        qdi_config.max_depth = 64;
+        qdi_config.seconds = 10;
+
+        if (argp_parse (&argp, argc, argv, 0, 0, NULL) != 0) {
+                fprintf (stderr, "argp_parse() failed\n");
+                return 1;
+        }
+
+        qdi_config.fd = open (qdi_config.path,
+                              (qdi_config.write ? O_RDWR : O_RDONLY)
+                              | O_DIRECT);
+        if (qdi_config.fd == -1) {
+                fprintf (stderr, "open(%s) => %s\n", qdi_config.path,
+                         strerror (errno));
+                return 1;
+        }
+
+        if (fstat (qdi_config.fd, &st) == -1) {
+                fprintf (stderr, "fstat(%s) => %s\n", qdi_config.path,
+                         strerror (errno));
+                return 1;
+        }
+
+        qdi_config.blocks = st.st_size / qdi_config.block_size;
+        if (!qdi_config.blocks) {
+                fprintf (stderr, "%s is smaller than one block\n",
+                         qdi_config.path);
+                return 1;
+        }
+
+        for (depth = 1; depth <= qdi_config.max_depth; depth *= 2) {
+                if (qdi_run (depth) != 0)
+                        return 1;
+        }
+
+        close (qdi_config.fd);
+
+        return 0;
+}
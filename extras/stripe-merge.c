@@ -1,44 +1,37 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
-int
-main (int argc, char *argv[])
+/*
+ * The stripe children of a file in the sparse layout hold each piece at
+ * its offset in the file and holes elsewhere, so the file is the OR of
+ * them all.
+ */
+static int
+merge_sparse (int *fds, int nfds)
 {
-	int fds[argc-1];
-	char buf[argc-1][4096];
+	char buf[nfds][4096];
 	int i;
 	int max_ret, ret;
 
-	if (argc < 2) {
-		printf ("Usage: %s file1 file2 ... >file\n", argv[0]);
-		return 1;
-	}
-
-	for (i=0; i<argc-1; i++) {
-		fds[i] = open (argv[i+1], O_RDONLY);
-		if (fds[i] == -1) {
-			perror (argv[i+1]);
-			return 1;
-		}
-	}
-
 	max_ret = 0;
 	do {
 		char newbuf[4096] = {0, };
 		int j;
 
 		max_ret = 0;
-		for (i=0; i<argc-1; i++) {
+		for (i=0; i<nfds; i++) {
 			memset (buf[i], 0, 4096);
 			ret = read (fds[i], buf[i], 4096); 
 			if (ret > max_ret)
 				max_ret = ret;
 		}
 		for (i=0; i<max_ret;i++)
-			for (j=0; j<argc-1; j++)
+			for (j=0; j<nfds; j++)
 				newbuf[i] |= buf[j][i];
 		write (1, newbuf, max_ret);
 	} while (max_ret);
@@ -46,3 +39,87 @@ main (int argc, char *argv[])
 	return 0;
 }
 
+/*
+ * In the dense layout they hold their pieces back to back, so the file
+ * is a piece of each in turn, up to the first short one.
+ */
+static int
+merge_dense (int *fds, int nfds, size_t block_size)
+{
+	char *buf;
+	int i;
+	ssize_t ret, done;
+
+	buf = malloc (block_size);
+	if (!buf) {
+		perror ("malloc");
+		return 1;
+	}
+
+	for (;;) {
+		for (i=0; i<nfds; i++) {
+			done = 0;
+			while (done < block_size) {
+				ret = read (fds[i], buf + done,
+					    block_size - done);
+				if (ret == -1) {
+					perror ("read");
+					free (buf);
+					return 1;
+				}
+				if (ret == 0)
+					break;
+				done += ret;
+			}
+
+			write (1, buf, done);
+
+			if (done < block_size) {
+				free (buf);
+				return 0;
+			}
+		}
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	size_t block_size = 0;
+	char *end = NULL;
+	int first = 1;
+	int i;
+
+	if ((argc > 2) && !strcmp (argv[1], "-d")) {
+		block_size = strtoul (argv[2], &end, 0);
+		if (!block_size || *end) {
+			fprintf (stderr, "invalid block size %s\n", argv[2]);
+			return 1;
+		}
+		first = 3;
+	}
+
+	if (argc - first < 1) {
+		printf ("Usage: %s [-d block-size] file1 file2 ... >file\n"
+			"  -d  the files are in the dense layout, striped "
+			"with block-size\n"
+			"      (the stripe-size xattr); give them in "
+			"stripe-index order\n", argv[0]);
+		return 1;
+	}
+
+	int fds[argc-first];
+
+	for (i=0; i<argc-first; i++) {
+		fds[i] = open (argv[i+first], O_RDONLY);
+		if (fds[i] == -1) {
+			perror (argv[i+first]);
+			return 1;
+		}
+	}
+
+	if (block_size)
+		return merge_dense (fds, argc - first, block_size);
+
+	return merge_sparse (fds, argc - first);
+}
@@ -1236,6 +1236,19 @@ default_notify (xlator_t *this, int32_t event, void *data, ...)
 		}
 	}
 	break;
+	case GF_EVENT_UPCALL:
+	{
+		/* unlike the other events, @data is not the child, so
+		   hand it up untouched */
+		xlator_list_t *parent = this->parents;
+		while (parent) {
+                        if (parent->xlator->init_succeeded)
+                                xlator_notify (parent->xlator, event,
+                                               data, NULL);
+			parent = parent->next;
+		}
+	}
+	break;
 	case GF_EVENT_CHILD_DOWN:
 	case GF_EVENT_CHILD_UP:
 	default:
@@ -75,6 +75,10 @@
 #define GLUSTERFS_ENTRYLK_COUNT "glusterfs.entrylk-count"
 #define GLUSTERFS_POSIXLK_COUNT "glusterfs.posixlk-count"
 
+/* files needing self-heal, as recorded by features/index */
+#define GF_XATTR_INDEX_PENDING_KEY "glusterfs.index.pending"
+#define GF_XATTR_INDEX_FORGET_KEY  "glusterfs.index.forget"
+
 #define ZR_FILE_CONTENT_REQUEST(key) (!strncmp(key, ZR_FILE_CONTENT_STR, \
 					       ZR_FILE_CONTENT_STRLEN))
 
@@ -195,6 +199,11 @@ typedef enum {
 
 #define GF_REPLICATE_TRASH_DIR          ".landfill"
 
+/* Directory in which storage/posix keeps the handles of the files of a
+   brick by generation number, see posix-handle.c */
+
+#define GF_HANDLE_DIR                   ".glusterfs"
+
 struct _xlator_cmdline_option {
 	struct list_head    cmd_args;
 	char               *volume;
@@ -293,6 +302,10 @@ typedef enum {
         GF_EVENT_TRANSPORT_CONNECTED,
         GF_EVENT_VOLFILE_MODIFIED,
         GF_EVENT_GRAPH_NEW,
+        GF_EVENT_UPCALL,                /* data is the inode changed by
+                                           another client */
+        GF_EVENT_UPCALL_UNAVAILABLE,    /* a brick below connected without
+                                           sending invalidations */
 } glusterfs_event_t;
 
 
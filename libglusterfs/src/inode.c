@@ -485,6 +485,72 @@ inode_ref (inode_t *inode)
 }
 
 
+/*
+ * inode_ref, unless @inode has already been retired (unreferenced and
+ * forgotten) and only waits to be destroyed. this is for xlators which keep
+ * pointers to inodes without holding a reference, dropping them in their
+ * forget callback: as long as the forget has not run, the memory is still
+ * there, but the inode may not be brought back to life.
+ */
+inode_t *
+inode_ref_unless_retired (inode_t *inode)
+{
+        inode_table_t *table = NULL;
+
+        if (!inode)
+                return NULL;
+
+        table = inode->table;
+
+        pthread_mutex_lock (&table->lock);
+        {
+                if (inode->ref || inode->nlookup || (inode->ino == 1))
+                        inode = __inode_ref (inode);
+                else
+                        inode = NULL;
+        }
+        pthread_mutex_unlock (&table->lock);
+
+        return inode;
+}
+
+
+/*
+ * the number of times @inode was changed by another client, as told by a
+ * brick. a cache notes it when it sends a request and does not keep the
+ * reply if it changed meanwhile: the invalidation may have overtaken a
+ * reply with the old data.
+ */
+uint64_t
+inode_invalidation_seq (inode_t *inode)
+{
+        uint64_t seq = 0;
+
+        if (!inode)
+                return 0;
+
+        LOCK (&inode->lock);
+        {
+                seq = inode->invalidations;
+        }
+        UNLOCK (&inode->lock);
+
+        return seq;
+}
+
+
+/* to be called before GF_EVENT_UPCALL is raised for @inode */
+void
+inode_invalidation_bump (inode_t *inode)
+{
+        LOCK (&inode->lock);
+        {
+                inode->invalidations++;
+        }
+        UNLOCK (&inode->lock);
+}
+
+
 static dentry_t *
 __dentry_create (inode_t *inode, inode_t *parent, const char *name)
 {
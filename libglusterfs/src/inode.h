@@ -105,6 +105,8 @@ struct _inode {
         struct list_head     dentry_list;   /* list of directory entries for this inode */
         struct list_head     hash;          /* hash table pointers */
         struct list_head     list;          /* active/lru/purge */
+        uint64_t             invalidations; /* GF_EVENT_UPCALLs raised for
+                                               this inode so far */
 
 	struct _inode_ctx   *_ctx;    /* replacement for dict_t *(inode->ctx) */
 };
@@ -132,6 +134,15 @@ inode_parent (inode_t *inode, ino_t par, const char *name);
 inode_t *
 inode_ref (inode_t *inode);
 
+inode_t *
+inode_ref_unless_retired (inode_t *inode);
+
+uint64_t
+inode_invalidation_seq (inode_t *inode);
+
+void
+inode_invalidation_bump (inode_t *inode);
+
 inode_t *
 inode_unref (inode_t *inode);
 
@@ -87,6 +87,7 @@ enum gf_common_mem_types_ {
         gf_common_mt_rpc_trans_reqinfo_t,
         gf_common_mt_rpc_trans_rsp_t,
         gf_common_mt_glusterfs_graph_t,
+        gf_common_mt_rpcclnt_cb_program_t,
         gf_common_mt_end
 };
 #endif
@@ -458,6 +458,45 @@ syncop_setxattr (xlator_t *subvol, loc_t *loc, dict_t *dict, int32_t flags)
         return args.op_ret;
 }
 
+int
+syncop_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int op_ret, int op_errno, dict_t *dict)
+{
+        struct syncargs *args = NULL;
+
+        args = cookie;
+
+        args->op_ret   = op_ret;
+        args->op_errno = op_errno;
+
+        if ((op_ret == 0) && dict)
+                args->xattr = dict_ref (dict);
+
+        __wake (args);
+
+        return 0;
+}
+
+
+/* the caller owns a ref on the returned @dict */
+int
+syncop_getxattr (xlator_t *subvol, loc_t *loc, const char *name,
+                 dict_t **dict)
+{
+        struct syncargs args = {0, };
+
+        SYNCOP (subvol, (&args), syncop_getxattr_cbk, subvol->fops->getxattr,
+                loc, name);
+
+        if (dict)
+                *dict = args.xattr;
+        else if (args.xattr)
+                dict_unref (args.xattr);
+
+        errno = args.op_errno;
+        return args.op_ret;
+}
+
 int
 syncop_statfs_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		    int32_t op_ret, int32_t op_errno,
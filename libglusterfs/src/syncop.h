@@ -178,4 +178,9 @@ syncop_statfs (xlator_t *subvol, loc_t *loc, struct statvfs *buf);
 int
 syncop_setxattr (xlator_t *subvol, loc_t *loc, dict_t *dict, int32_t flags);
 
+int
+syncop_getxattr (xlator_t *subvol, loc_t *loc, const char *name,
+                 /* out */
+                 dict_t **dict);
+
 #endif /* _SYNCOP_H */
@@ -134,6 +134,13 @@ enum gf_pmap_procnum {
         GF_PMAP_MAXVALUE,
 };
 
+/* calls made by a brick to its clients, on the client's connection */
+enum gf_cbk_procnum {
+        GF_CBK_NULL = 0,
+        GF_CBK_INVALIDATE,
+        GF_CBK_MAXVALUE,
+};
+
 
 #define GLUSTER3_1_FOP_PROGRAM   1298437 /* Completely random */
 #define GLUSTER3_1_FOP_VERSION   310 /* 3.1.0 */
@@ -153,4 +160,7 @@ enum gf_pmap_procnum {
 #define GLUSTER_PMAP_PROGRAM    34123456
 #define GLUSTER_PMAP_VERSION    1
 
+#define GLUSTER_CBK_PROGRAM     52743234 /* Completely random */
+#define GLUSTER_CBK_VERSION     1   /* 0.0.1 */
+
 #endif /* !_PROTOCOL_COMMON_H */
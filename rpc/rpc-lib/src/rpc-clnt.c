@@ -27,6 +27,7 @@
 
 #include "rpc-clnt.h"
 #include "xdr-rpcclnt.h"
+#include "xdr-rpc.h"
 #include "rpc-transport.h"
 #include "protocol-common.h"
 #include "mem-pool.h"
@@ -704,6 +705,68 @@ out:
 }
 
 
+/* The server does not expect a reply to a callback, so there is no xid to
+ * remember: decode the call, find the actor and hand it the program header.
+ */
+int
+rpc_clnt_handle_cbk (struct rpc_clnt *clnt, rpc_transport_pollin_t *msg)
+{
+        char                 *msgbuf  = NULL;
+        rpcclnt_cb_program_t *program = NULL;
+        struct rpc_msg        rpcmsg;
+        struct iovec          progmsg; /* RPC Program payload */
+        size_t                msglen  = 0;
+        int                   found   = 0;
+        int                   ret     = -1;
+        int                   procnum = 0;
+
+        msgbuf = msg->vector[0].iov_base;
+        msglen = msg->vector[0].iov_len;
+
+        ret = xdr_to_rpc_call (msgbuf, msglen, &rpcmsg, &progmsg, NULL, NULL);
+        if (ret == -1) {
+                gf_log ("rpc-clnt", GF_LOG_DEBUG, "RPC call decoding failed");
+                goto out;
+        }
+
+        gf_log ("rpc-clnt", GF_LOG_TRACE, "received rpc message (XID: 0x%x, "
+                "Ver: %u, Program: %u, ProgVers: %u, Proc: %u) "
+                "from rpc-transport (%s)", rpc_call_xid (&rpcmsg),
+                rpc_call_rpcvers (&rpcmsg), rpc_call_program (&rpcmsg),
+                rpc_call_progver (&rpcmsg), rpc_call_progproc (&rpcmsg),
+                clnt->conn.trans->name);
+
+        procnum = rpc_call_progproc (&rpcmsg);
+
+        pthread_mutex_lock (&clnt->lock);
+        {
+                list_for_each_entry (program, &clnt->programs, program) {
+                        if ((program->prognum == rpc_call_program (&rpcmsg))
+                            && (program->progver == rpc_call_progver (&rpcmsg))) {
+                                found = 1;
+                                break;
+                        }
+                }
+        }
+        pthread_mutex_unlock (&clnt->lock);
+
+        if (found && (procnum < program->numactors) &&
+            (program->actors[procnum].actor)) {
+                ret = program->actors[procnum].actor (clnt, program->mydata,
+                                                      &progmsg);
+        } else {
+                gf_log ("rpc-clnt", GF_LOG_DEBUG, "no actor for the callback "
+                        "(program: %u, version: %u, procnum: %d)",
+                        rpc_call_program (&rpcmsg),
+                        rpc_call_progver (&rpcmsg), procnum);
+                ret = -1;
+        }
+
+out:
+        return ret;
+}
+
+
 inline void
 rpc_clnt_set_connected (rpc_clnt_connection_t *conn)
 {
@@ -798,7 +861,11 @@ rpc_clnt_notify (rpc_transport_t *trans, void *mydata,
         case RPC_TRANSPORT_MSG_RECEIVED:
         {
                 pollin = data;
-                ret = rpc_clnt_handle_reply (clnt, pollin);
+                if (pollin->private)
+                        ret = rpc_clnt_handle_reply (clnt, pollin);
+                else
+                        /* only replies carry a request_info */
+                        ret = rpc_clnt_handle_cbk (clnt, pollin);
                 /* ret = clnt->notifyfn (clnt, clnt->mydata, RPC_CLNT_MSG,
                  * data);
                  */
@@ -916,6 +983,7 @@ rpc_clnt_init (struct rpc_clnt_config *config, dict_t *options,
         }
 
         pthread_mutex_init (&rpc->lock, NULL);
+        INIT_LIST_HEAD (&rpc->programs);
         rpc->ctx = ctx;
 
         rpc->reqpool = mem_pool_new (struct rpc_req,
@@ -960,6 +1028,40 @@ rpc_clnt_register_notify (struct rpc_clnt *rpc, rpc_clnt_notify_t fn,
         return 0;
 }
 
+int
+rpcclnt_cbk_program_register (struct rpc_clnt *clnt,
+                              rpcclnt_cb_program_t *program)
+{
+        rpcclnt_cb_program_t *tmp = NULL;
+        int                   ret = -1;
+
+        if (!clnt || !program)
+                goto out;
+
+        tmp = GF_CALLOC (1, sizeof (*tmp), gf_common_mt_rpcclnt_cb_program_t);
+        if (tmp == NULL) {
+                gf_log ("rpc-clnt", GF_LOG_ERROR, "out of memory");
+                goto out;
+        }
+
+        memcpy (tmp, program, sizeof (*tmp));
+        INIT_LIST_HEAD (&tmp->program);
+
+        pthread_mutex_lock (&clnt->lock);
+        {
+                list_add_tail (&tmp->program, &clnt->programs);
+        }
+        pthread_mutex_unlock (&clnt->lock);
+
+        ret = 0;
+        gf_log ("rpc-clnt", GF_LOG_DEBUG, "New program registered: %s, Num: "
+                "%d, Ver: %d", program->progname, program->prognum,
+                program->progver);
+out:
+        return ret;
+}
+
+
 ssize_t
 xdr_serialize_glusterfs_auth (char *dest, struct auth_glusterfs_parms *au)
 {
@@ -1342,6 +1444,14 @@ out:
 void
 rpc_clnt_destroy (struct rpc_clnt *rpc)
 {
+        rpcclnt_cb_program_t *program = NULL;
+        rpcclnt_cb_program_t *tmp     = NULL;
+
+        list_for_each_entry_safe (program, tmp, &rpc->programs, program) {
+                list_del_init (&program->program);
+                GF_FREE (program);
+        }
+
         rpc_clnt_connection_cleanup (&rpc->conn);
         rpc_clnt_reconnect_cleanup (&rpc->conn);
         pthread_mutex_destroy (&rpc->lock);
@@ -83,6 +83,29 @@ typedef struct rpc_clnt_program {
         int                   numproc;
 } rpc_clnt_prog_t;
 
+/* A program whose procedures the server calls on this connection (eg., to
+ * tell about changes it made to files the client has cached). The actors get
+ * the program header of the call and do not reply.
+ */
+typedef int (*rpcclnt_cb_fn) (struct rpc_clnt *rpc, void *mydata,
+                              struct iovec *iov);
+
+typedef struct rpcclnt_actor_desc {
+        char          *procname;
+        int            procnum;
+        rpcclnt_cb_fn  actor;
+} rpcclnt_cb_actor_t;
+
+typedef struct rpcclnt_cb_program {
+        char                *progname;
+        int                  prognum;
+        int                  progver;
+        rpcclnt_cb_actor_t  *actors;
+        int                  numactors;
+        void                *mydata;
+        struct list_head     program;
+} rpcclnt_cb_program_t;
+
 #define RPC_MAX_AUTH_BYTES   400
 typedef struct rpc_auth_data {
         int             flavour;
@@ -146,6 +169,9 @@ struct rpc_clnt {
 
         struct mem_pool       *saved_frames_pool;
 
+        /* callback programs, see rpcclnt_cbk_program_register () */
+        struct list_head       programs;
+
         glusterfs_ctx_t       *ctx;
 };
 
@@ -182,6 +208,9 @@ int rpc_clnt_submit (struct rpc_clnt *rpc, rpc_clnt_prog_t *prog,
 
 void rpc_clnt_destroy (struct rpc_clnt *rpc);
 
+int rpcclnt_cbk_program_register (struct rpc_clnt *rpc,
+                                  rpcclnt_cb_program_t *program);
+
 void rpc_clnt_set_connected (rpc_clnt_connection_t *conn);
 
 void rpc_clnt_unset_connected (rpc_clnt_connection_t *conn);
@@ -77,6 +77,9 @@ typedef struct rpcsvc_state {
         void                    *mydata; /* This is xlator */
         rpcsvc_notify_t          notifyfn;
 
+        /* xid of the last callback sent to a client */
+        uint32_t                 cbk_xid;
+
 } rpcsvc_t;
 
 
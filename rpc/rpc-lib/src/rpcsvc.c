@@ -31,6 +31,7 @@
 #include "compat-errno.h"
 #include "list.h"
 #include "xdr-rpc.h"
+#include "xdr-rpcclnt.h"
 #include "iobuf.h"
 #include "globals.h"
 #include "xdr-common.h"
@@ -1534,6 +1535,128 @@ disconnect_exit:
 }
 
 
+/* Builds the record header of a call made by the server to the client at the
+ * other end of a connection (a callback). Callbacks carry no credentials and
+ * are never replied to.
+ */
+static struct iobuf *
+rpcsvc_callback_build_record (rpcsvc_t *rpc, int prognum, int progver,
+                              int procnum, size_t payload,
+                              struct iovec *recbuf)
+{
+        struct rpc_msg  request     = {0, };
+        struct iobuf   *request_iob = NULL;
+        char           *record      = NULL;
+        struct iovec    recordhdr   = {0, };
+        size_t          pagesize    = 0;
+        size_t          fraglen     = 0;
+        int             ret         = -1;
+
+        request_iob = iobuf_get (rpc->ctx->iobuf_pool);
+        if (!request_iob) {
+                gf_log (GF_RPCSVC, GF_LOG_ERROR, "Failed to get iobuf");
+                goto out;
+        }
+
+        pagesize = iobpool_pagesize ((struct iobuf_pool *)rpc->ctx->iobuf_pool);
+        record = iobuf_ptr (request_iob);
+
+        pthread_mutex_lock (&rpc->rpclock);
+        {
+                request.rm_xid = ++rpc->cbk_xid;
+        }
+        pthread_mutex_unlock (&rpc->rpclock);
+
+        request.rm_direction = CALL;
+        request.rm_call.cb_rpcvers = 2;
+        request.rm_call.cb_prog = prognum;
+        request.rm_call.cb_vers = progver;
+        request.rm_call.cb_proc = procnum;
+        request.rm_call.cb_cred.oa_flavor = AUTH_NONE;
+        request.rm_call.cb_verf.oa_flavor = AUTH_NONE;
+
+        ret = rpc_request_to_xdr (&request, (record + RPCSVC_FRAGHDR_SIZE),
+                                  pagesize - RPCSVC_FRAGHDR_SIZE, &recordhdr);
+        if (ret == -1) {
+                gf_log (GF_RPCSVC, GF_LOG_ERROR, "Failed to create RPC call");
+                iobuf_unref (request_iob);
+                request_iob = NULL;
+                goto out;
+        }
+
+        fraglen = payload + recordhdr.iov_len;
+        rpcsvc_set_last_frag_header_size (fraglen, record);
+
+        recbuf->iov_base = record;
+        recbuf->iov_len = RPCSVC_FRAGHDR_SIZE + recordhdr.iov_len;
+out:
+        return request_iob;
+}
+
+
+/* Sends a call of @procnum in the program @prognum/@progver to the client
+ * connected over @trans. @proghdr holds the already encoded arguments, in
+ * buffers referenced by @iobref (if any), the same way as for
+ * rpcsvc_submit_generic ().
+ */
+int
+rpcsvc_callback_submit (rpcsvc_t *rpc, rpc_transport_t *trans, int prognum,
+                        int progver, int procnum, struct iovec *proghdr,
+                        int proghdrcount, struct iobref *iobref)
+{
+        struct iobuf        *request_iob = NULL;
+        struct iovec         rpchdr      = {0, };
+        rpc_transport_req_t  req;
+        size_t               msglen      = 0;
+        char                 new_iobref  = 0;
+        int                  ret         = -1;
+        int                  i           = 0;
+
+        if ((!rpc) || (!trans))
+                goto out;
+
+        for (i = 0; i < proghdrcount; i++)
+                msglen += proghdr[i].iov_len;
+
+        request_iob = rpcsvc_callback_build_record (rpc, prognum, progver,
+                                                    procnum, msglen, &rpchdr);
+        if (!request_iob)
+                goto out;
+
+        if (!iobref) {
+                iobref = iobref_new ();
+                if (!iobref) {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "out of memory");
+                        goto out;
+                }
+
+                new_iobref = 1;
+        }
+
+        iobref_add (iobref, request_iob);
+
+        memset (&req, 0, sizeof (req));
+        req.msg.rpchdr = &rpchdr;
+        req.msg.rpchdrcount = 1;
+        req.msg.proghdr = proghdr;
+        req.msg.proghdrcount = proghdrcount;
+        req.msg.iobref = iobref;
+
+        ret = rpc_transport_submit_request (trans, &req);
+        if (ret == -1)
+                gf_log (GF_RPCSVC, GF_LOG_DEBUG, "Failed to submit callback "
+                        "(program: %d, procnum: %d)", prognum, procnum);
+out:
+        if (new_iobref)
+                iobref_unref (iobref);
+
+        if (request_iob)
+                iobuf_unref (request_iob);
+
+        return ret;
+}
+
+
 int
 rpcsvc_error_reply (rpcsvc_request_t *req)
 {
@@ -474,6 +474,11 @@ rpcsvc_submit_generic (rpcsvc_request_t *req, struct iovec *proghdr,
 extern int
 rpcsvc_error_reply (rpcsvc_request_t *req);
 
+extern int
+rpcsvc_callback_submit (rpcsvc_t *rpc, rpc_transport_t *trans, int prognum,
+                        int progver, int procnum, struct iovec *proghdr,
+                        int proghdrcount, struct iobref *iobref);
+
 #define RPCSVC_PEER_STRLEN      1024
 #define RPCSVC_AUTH_ACCEPT      1
 #define RPCSVC_AUTH_REJECT      2
@@ -700,6 +700,10 @@ __socket_read_vectored_request (rpc_transport_t *this)
                 /* fall through */
 
         case SP_STATE_READ_VERFBYTES:
+                /* the payload gets an iobuf of its own, so that it starts
+                 * page aligned and storage/posix can write it with
+                 * O_DIRECT without copying it first.
+                 */
                 if (priv->incoming.payload_vector.iov_base == NULL) {
                         iobuf = iobuf_get (this->ctx->iobuf_pool);
                         if (!iobuf) {
@@ -1665,6 +1665,19 @@ xdr_gf_common_rsp (XDR *xdrs, gf_common_rsp *objp)
 	return TRUE;
 }
 
+bool_t
+xdr_gf_cbk_invalidate_req (XDR *xdrs, gf_cbk_invalidate_req *objp)
+{
+
+	 if (!xdr_u_quad_t (xdrs, &objp->gfs_id))
+		 return FALSE;
+	 if (!xdr_u_quad_t (xdrs, &objp->ino))
+		 return FALSE;
+	 if (!xdr_u_quad_t (xdrs, &objp->gen))
+		 return FALSE;
+	return TRUE;
+}
+
 
 bool_t
 xdr_gfs3_dirlist (XDR *xdrs, gfs3_dirlist *objp)
@@ -1063,6 +1063,13 @@ struct gf_common_rsp {
 };
 typedef struct gf_common_rsp gf_common_rsp;
 
+struct gf_cbk_invalidate_req {
+	u_quad_t gfs_id;
+	u_quad_t ino;
+	u_quad_t gen;
+};
+typedef struct gf_cbk_invalidate_req gf_cbk_invalidate_req;
+
 struct gfs3_dirlist {
 	u_quad_t d_ino;
 	u_quad_t d_off;
@@ -1189,6 +1196,7 @@ extern  bool_t xdr_gf_notify_rsp (XDR *, gf_notify_rsp*);
 extern  bool_t xdr_gfs3_releasedir_req (XDR *, gfs3_releasedir_req*);
 extern  bool_t xdr_gfs3_release_req (XDR *, gfs3_release_req*);
 extern  bool_t xdr_gf_common_rsp (XDR *, gf_common_rsp*);
+extern  bool_t xdr_gf_cbk_invalidate_req (XDR *, gf_cbk_invalidate_req*);
 
 #else /* K&R C */
 extern bool_t xdr_gf_statfs ();
@@ -1276,6 +1284,7 @@ extern bool_t xdr_gf_log_req ();
 extern bool_t xdr_gf_notify_req ();
 extern bool_t xdr_gf_notify_rsp ();
 extern bool_t xdr_gf_common_rsp ();
+extern bool_t xdr_gf_cbk_invalidate_req ();
 
 #endif /* K&R C */
 
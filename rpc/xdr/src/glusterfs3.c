@@ -48,6 +48,21 @@ xdr_serialize_common_rsp (struct iovec outmsg, void *rsp)
 
 }
 
+ssize_t
+xdr_from_cbk_invalidate_req (struct iovec outmsg, void *req)
+{
+        return xdr_serialize_generic (outmsg, (void *)req,
+                                      (xdrproc_t)xdr_gf_cbk_invalidate_req);
+
+}
+ssize_t
+xdr_to_cbk_invalidate_req (struct iovec inmsg, void *args)
+{
+        return xdr_to_generic (inmsg, (void *)args,
+                               (xdrproc_t)xdr_gf_cbk_invalidate_req);
+
+}
+
 ssize_t
 xdr_serialize_setvolume_rsp (struct iovec outmsg, void *rsp)
 {
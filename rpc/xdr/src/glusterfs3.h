@@ -513,4 +513,9 @@ xdr_to_readv_rsp (struct iovec inmsg, void *args);
 ssize_t
 xdr_to_getspec_rsp (struct iovec inmsg, void *args);
 
+ssize_t
+xdr_from_cbk_invalidate_req (struct iovec outmsg, void *req);
+ssize_t
+xdr_to_cbk_invalidate_req (struct iovec inmsg, void *args);
+
 #endif /* !_GLUSTERFS3_H */
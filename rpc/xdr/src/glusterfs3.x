@@ -732,6 +732,13 @@ struct gf_common_rsp {
 } ;
 
 
+struct gf_cbk_invalidate_req {
+       unsigned hyper gfs_id;
+       unsigned hyper ino;
+       unsigned hyper gen;
+} ;
+
+
 struct gf_dump_req {
        unsigned hyper gfs_id;
 };
@@ -56,9 +56,14 @@
 #include "afr-self-heal-common.h"
 #include "pump.h"
 
+#define AFR_ICTX_READABLE_MASK         0xFFFFFF0000000000ULL
 #define AFR_ICTX_OPENDIR_DONE_MASK     0x0000000200000000ULL
 #define AFR_ICTX_SPLIT_BRAIN_MASK      0x0000000100000000ULL
-#define AFR_ICTX_READ_CHILD_MASK       0x00000000FFFFFFFFULL
+#define AFR_ICTX_UP_EPOCH_MASK         0x00000000FFFF0000ULL
+#define AFR_ICTX_READ_CHILD_MASK       0x000000000000FFFFULL
+
+#define AFR_ICTX_READABLE_SHIFT        40
+#define AFR_ICTX_UP_EPOCH_SHIFT        16
 
 void
 afr_set_lk_owner (call_frame_t *frame, xlator_t *this)
@@ -237,6 +242,243 @@ out:
 }
 
 
+/*
+ * readable children - the children known to be in sync for an inode,
+ * as seen by the last lookup. They are only trusted as long as no
+ * child has come up since (a child coming back may hold stale data).
+ */
+
+uint64_t
+afr_readable_children (xlator_t *this, inode_t *inode)
+{
+        afr_private_t *priv = NULL;
+
+        int ret = 0;
+
+        uint64_t ctx      = 0;
+        uint64_t epoch    = 0;
+        uint64_t readable = 0;
+
+        VALIDATE_OR_GOTO (inode, out);
+
+        priv = this->private;
+
+        LOCK (&inode->lock);
+        {
+                ret = __inode_ctx_get (inode, this, &ctx);
+
+                if (ret < 0)
+                        goto unlock;
+
+                epoch = (ctx & AFR_ICTX_UP_EPOCH_MASK)
+                        >> AFR_ICTX_UP_EPOCH_SHIFT;
+
+                if (epoch == (priv->up_count & 0xFFFF))
+                        readable = (ctx & AFR_ICTX_READABLE_MASK)
+                                >> AFR_ICTX_READABLE_SHIFT;
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+out:
+        return readable;
+}
+
+
+void
+afr_set_readable_children (xlator_t *this, inode_t *inode, uint64_t readable)
+{
+        afr_private_t *priv = NULL;
+
+        uint64_t ctx   = 0;
+        uint64_t epoch = 0;
+        int      ret   = 0;
+
+        VALIDATE_OR_GOTO (inode, out);
+
+        priv = this->private;
+
+        epoch = priv->up_count & 0xFFFF;
+
+        LOCK (&inode->lock);
+        {
+                ret = __inode_ctx_get (inode, this, &ctx);
+
+                if (ret < 0) {
+                        ctx = 0;
+                }
+
+                ctx = (~(AFR_ICTX_READABLE_MASK | AFR_ICTX_UP_EPOCH_MASK) & ctx)
+                        | (AFR_ICTX_READABLE_MASK
+                           & (readable << AFR_ICTX_READABLE_SHIFT))
+                        | (AFR_ICTX_UP_EPOCH_MASK
+                           & (epoch << AFR_ICTX_UP_EPOCH_SHIFT));
+
+                __inode_ctx_put (inode, this, ctx);
+        }
+        UNLOCK (&inode->lock);
+
+out:
+        return;
+}
+
+
+void
+afr_unset_readable_child (xlator_t *this, inode_t *inode, int child_index)
+{
+        uint64_t ctx = 0;
+        int      ret = 0;
+
+        VALIDATE_OR_GOTO (inode, out);
+
+        if (child_index >= AFR_MAX_READABLE_CHILDREN)
+                goto out;
+
+        LOCK (&inode->lock);
+        {
+                ret = __inode_ctx_get (inode, this, &ctx);
+
+                if (ret < 0)
+                        goto unlock;
+
+                ctx &= ~(1ULL << (child_index + AFR_ICTX_READABLE_SHIFT));
+
+                __inode_ctx_put (inode, this, ctx);
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+out:
+        return;
+}
+
+
+/**
+ * afr_read_child_select - pick the child to send a read fop to
+ *
+ * With adaptive-read-child, pick the readable child that is up and
+ * has the least (average latency * (requests in flight + 1)). A
+ * child we have no latency sample for yet wins, so that every
+ * replica gets measured. Otherwise, use the inode's read child.
+ */
+
+int
+afr_read_child_select (xlator_t *this, inode_t *inode)
+{
+        afr_private_t *priv = NULL;
+
+        uint64_t readable   = 0;
+        uint64_t score      = 0;
+        uint64_t best_score = 0;
+
+        int read_child = -1;
+        int best       = -1;
+        int i          = 0;
+
+        priv = this->private;
+
+        read_child = afr_read_child (this, inode);
+
+        if (!priv->adaptive_read_child || (priv->read_child >= 0))
+                goto out;
+
+        readable = afr_readable_children (this, inode);
+        if (!readable)
+                goto out;
+
+        LOCK (&priv->read_child_lock);
+        {
+                for (i = 0; i < priv->child_count; i++) {
+                        if (i >= AFR_MAX_READABLE_CHILDREN)
+                                break;
+
+                        if (!(readable & (1ULL << i)) || !priv->child_up[i])
+                                continue;
+
+                        score = priv->child_latency[i]
+                                * (priv->child_inflight[i] + 1);
+
+                        if ((best == -1) || (score < best_score)) {
+                                best       = i;
+                                best_score = score;
+                        }
+                }
+        }
+        UNLOCK (&priv->read_child_lock);
+
+        if (best != -1)
+                read_child = best;
+out:
+        return read_child;
+}
+
+
+void
+afr_read_latency_begin (xlator_t *this, afr_local_t *local, int child_index)
+{
+        afr_private_t *priv = NULL;
+
+        priv = this->private;
+
+        if (!priv->adaptive_read_child)
+                return;
+
+        local->read_latency.child = child_index;
+        local->read_latency.timed = _gf_true;
+        gettimeofday (&local->read_latency.start, NULL);
+
+        LOCK (&priv->read_child_lock);
+        {
+                priv->child_inflight[child_index]++;
+        }
+        UNLOCK (&priv->read_child_lock);
+}
+
+
+void
+afr_read_latency_end (xlator_t *this, afr_local_t *local, int32_t op_ret)
+{
+        afr_private_t *priv = NULL;
+
+        struct timeval now = {0, };
+
+        uint64_t sample = 0;
+        int      child  = 0;
+
+        priv = this->private;
+
+        if (!local->read_latency.timed)
+                return;
+
+        local->read_latency.timed = _gf_false;
+        child = local->read_latency.child;
+
+        gettimeofday (&now, NULL);
+
+        sample = ((now.tv_sec - local->read_latency.start.tv_sec) * 1000000)
+                + (now.tv_usec - local->read_latency.start.tv_usec);
+
+        LOCK (&priv->read_child_lock);
+        {
+                priv->child_inflight[child]--;
+
+                /* a failed call says nothing about the child's speed */
+                if (op_ret == -1)
+                        goto unlock;
+
+                /* exponentially weighted: new = 7/8 old + 1/8 sample */
+                if (priv->child_latency[child] == 0)
+                        priv->child_latency[child] = sample ? sample : 1;
+                else
+                        priv->child_latency[child] =
+                                ((priv->child_latency[child] * 7) + sample)
+                                / 8;
+        }
+unlock:
+        UNLOCK (&priv->read_child_lock);
+}
+
+
 /**
  * afr_local_cleanup - cleanup everything in frame->local
  */
@@ -396,6 +638,17 @@ afr_local_cleanup (afr_local_t *local, xlator_t *this)
 		GF_FREE (local->cont.writev.vector);
 	}
 
+        { /* readv */
+                for (i = 0; i < local->cont.readv.stripe_count; i++) {
+                        GF_FREE (local->cont.readv.stripes[i].vector);
+
+                        if (local->cont.readv.stripes[i].iobref)
+                                iobref_unref (local->cont.readv.stripes[i].iobref);
+                }
+
+                GF_FREE (local->cont.readv.stripes);
+        }
+
 	{ /* setxattr */
 		if (local->cont.setxattr.dict)
 			dict_unref (local->cont.setxattr.dict);
@@ -654,6 +907,23 @@ afr_lookup_done (call_frame_t *frame, xlator_t *this, struct iatt *lookup_buf)
                 }
         }
 
+        if (local->op_ret == 0) {
+                /* all replicas that answered agree; reads may go
+                   to any of them */
+
+                if (local->enoent_count
+                    || local->self_heal.need_metadata_self_heal
+                    || local->self_heal.need_data_self_heal
+                    || local->self_heal.need_entry_self_heal)
+                        afr_set_readable_children (this,
+                                                   local->cont.lookup.inode,
+                                                   0);
+                else
+                        afr_set_readable_children (this,
+                                                   local->cont.lookup.inode,
+                                                   local->cont.lookup.success_children);
+        }
+
         if ((local->self_heal.need_metadata_self_heal
              || local->self_heal.need_data_self_heal
              || local->self_heal.need_entry_self_heal)
@@ -778,6 +1048,10 @@ afr_fresh_lookup_cbk (call_frame_t *frame, void *cookie,
 
                 afr_lookup_collect_xattr (local, this, child_index, xattr);
 
+                if (child_index < AFR_MAX_READABLE_CHILDREN)
+                        local->cont.lookup.success_children
+                                |= (1ULL << child_index);
+
                 first_up_child = afr_first_up_child (priv);
 
                 if (child_index == first_up_child) {
@@ -802,6 +1076,8 @@ afr_fresh_lookup_cbk (call_frame_t *frame, void *cookie,
                                         "added root inode");
                                 priv->root_inode = inode_ref (inode);
                                 priv->first_lookup = 0;
+
+                                afr_index_heal_start (this);
                         }
 
                         *lookup_buf = *buf;
@@ -903,6 +1179,10 @@ afr_revalidate_lookup_cbk (call_frame_t *frame, void *cookie,
 
                 afr_lookup_collect_xattr (local, this, child_index, xattr);
 
+                if (child_index < AFR_MAX_READABLE_CHILDREN)
+                        local->cont.lookup.success_children
+                                |= (1ULL << child_index);
+
                 first_up_child = afr_first_up_child (priv);
 
                 if (child_index == first_up_child) {
@@ -1172,6 +1452,21 @@ afr_fd_ctx_set (xlator_t *this, fd_t *fd)
                         goto unlock;
                 }
 
+                fd_ctx->eager_locked_on = GF_CALLOC (
+                                         sizeof (*fd_ctx->eager_locked_on),
+                                         priv->child_count,
+                                         gf_afr_mt_char);
+
+                if (!fd_ctx->eager_locked_on) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "Out of memory");
+
+                        op_ret = -ENOMEM;
+                        goto unlock;
+                }
+
+                INIT_LIST_HEAD (&fd_ctx->eager_lock_waiters);
+
                 fd_ctx->up_count   = priv->up_count;
                 fd_ctx->down_count = priv->down_count;
 
@@ -1495,6 +1790,9 @@ afr_cleanup_fd_ctx (xlator_t *this, fd_t *fd)
                 if (fd_ctx->opened_on)
                         GF_FREE (fd_ctx->opened_on);
 
+                if (fd_ctx->eager_locked_on)
+                        GF_FREE (fd_ctx->eager_locked_on);
+
                 GF_FREE (fd_ctx);
         }
 
@@ -2519,6 +2817,32 @@ afr_priv_dump (xlator_t *this)
         gf_proc_dump_write(key, "%u", priv->entry_lock_server_count);
         gf_proc_dump_build_key(key, key_prefix, "wait_count");
         gf_proc_dump_write(key, "%u", priv->wait_count);
+        gf_proc_dump_build_key(key, key_prefix, "adaptive_read_child");
+        gf_proc_dump_write(key, "%d", priv->adaptive_read_child);
+        gf_proc_dump_build_key(key, key_prefix, "index_self_heal");
+        gf_proc_dump_write(key, "%d", priv->index_self_heal);
+        gf_proc_dump_build_key(key, key_prefix, "index_heal_running");
+        gf_proc_dump_write(key, "%d", priv->index_heal_running);
+        gf_proc_dump_build_key(key, key_prefix, "striped_read");
+        gf_proc_dump_write(key, "%d", priv->striped_read);
+        gf_proc_dump_build_key(key, key_prefix, "striped_read_min_size");
+        gf_proc_dump_write(key, "%"PRIu64, priv->striped_read_min_size);
+        gf_proc_dump_build_key(key, key_prefix, "data_self_heal_window_bytes");
+        gf_proc_dump_write(key, "%"PRIu64, priv->data_self_heal_window_bytes);
+        gf_proc_dump_build_key(key, key_prefix, "data_self_heal_bandwidth");
+        gf_proc_dump_write(key, "%"PRIu64, priv->data_self_heal_bandwidth);
+        for (i = 0; priv->child_latency && (i < priv->child_count); i++) {
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "child_latency_usec[%d]", i);
+                gf_proc_dump_write(key, "%"PRIu64, priv->child_latency[i]);
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "child_reads_in_flight[%d]", i);
+                gf_proc_dump_write(key, "%d", priv->child_inflight[i]);
+        }
+        gf_proc_dump_build_key(key, key_prefix, "eager_lock");
+        gf_proc_dump_write(key, "%d", priv->eager_lock);
+        gf_proc_dump_build_key(key, key_prefix, "eager_lock_timeout");
+        gf_proc_dump_write(key, "%u", priv->eager_lock_timeout);
 
         return 0;
 }
@@ -2593,6 +2917,8 @@ afr_notify (xlator_t *this, int32_t event,
 			default_notify (this, event, data);
                 }
 
+                afr_index_heal_start (this);
+
 		break;
 
 	case GF_EVENT_CHILD_DOWN:
@@ -197,6 +197,8 @@ afr_stat_cbk (call_frame_t *frame, void *cookie,
 
 	local = frame->local;
 
+        afr_read_latency_end (this, local, op_ret);
+
 	if (op_ret == -1) {
 	retry:
 		last_tried = local->cont.stat.last_tried;
@@ -212,6 +214,8 @@ afr_stat_cbk (call_frame_t *frame, void *cookie,
 
 		unwind = 0;
 
+                afr_read_latency_begin (this, local, this_try);
+
 		STACK_WIND_COOKIE (frame, afr_stat_cbk,
 				   (void *) (long) read_child,
 				   children[this_try],
@@ -258,7 +262,7 @@ afr_stat (call_frame_t *frame, xlator_t *this,
 
 	frame->local = local;
 
-        read_child = afr_read_child (this, loc->inode);
+        read_child = afr_read_child_select (this, loc->inode);
 
         if (read_child >= 0) {
                 call_child = read_child;
@@ -281,6 +285,8 @@ afr_stat (call_frame_t *frame, xlator_t *this,
 
 	local->cont.stat.ino = loc->inode->ino;
 
+        afr_read_latency_begin (this, local, call_child);
+
 	STACK_WIND_COOKIE (frame, afr_stat_cbk, (void *) (long) call_child,
 			   children[call_child],
 			   children[call_child]->fops->stat,
@@ -319,6 +325,8 @@ afr_fstat_cbk (call_frame_t *frame, void *cookie,
 
 	local = frame->local;
 
+        afr_read_latency_end (this, local, op_ret);
+
 	read_child = (long) cookie;
 
 	if (op_ret == -1) {
@@ -336,6 +344,8 @@ afr_fstat_cbk (call_frame_t *frame, void *cookie,
 
 		unwind = 0;
 
+                afr_read_latency_begin (this, local, this_try);
+
 		STACK_WIND_COOKIE (frame, afr_fstat_cbk,
 				   (void *) (long) read_child,
 				   children[this_try],
@@ -385,7 +395,7 @@ afr_fstat (call_frame_t *frame, xlator_t *this,
 
 	VALIDATE_OR_GOTO (fd->inode, out);
 
-        read_child = afr_read_child (this, fd->inode);
+        read_child = afr_read_child_select (this, fd->inode);
 
         if (read_child >= 0) {
                 call_child = read_child;
@@ -407,6 +417,8 @@ afr_fstat (call_frame_t *frame, xlator_t *this,
 	local->cont.fstat.ino = fd->inode->ino;
 	local->fd = fd_ref (fd);
 
+        afr_read_latency_begin (this, local, call_child);
+
 	STACK_WIND_COOKIE (frame, afr_fstat_cbk, (void *) (long) call_child,
 			   children[call_child],
 			   children[call_child]->fops->fstat,
@@ -744,6 +756,11 @@ out:
  *
  * if any of the above read's fail, try the children in sequence
  * beginning at the beginning
+ *
+ * with striped-read, a large read is instead split into one chunk
+ * per in-sync replica, the chunks are read in parallel and put back
+ * together. if any chunk fails, the whole read is redone the usual
+ * way.
  */
 
 int32_t
@@ -772,6 +789,8 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
 	local = frame->local;
 
+        afr_read_latency_end (this, local, op_ret);
+
         read_child = (long) cookie;
 
 	if (op_ret == -1) {
@@ -793,6 +812,8 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
 		unwind = 0;
 
+                afr_read_latency_begin (this, local, this_try);
+
 		STACK_WIND_COOKIE (frame, afr_readv_cbk,
 				   (void *) (long) read_child,
 				   children[this_try],
@@ -814,9 +835,8 @@ out:
 }
 
 
-int32_t
-afr_readv (call_frame_t *frame, xlator_t *this,
-	   fd_t *fd, size_t size, off_t offset)
+static int
+afr_readv_single (call_frame_t *frame, xlator_t *this)
 {
 	afr_private_t * priv       = NULL;
 	afr_local_t   * local      = NULL;
@@ -825,22 +845,12 @@ afr_readv (call_frame_t *frame, xlator_t *this,
         int32_t         read_child = -1;
 	int             call_child = 0;
 
-	int32_t         op_ret     = -1;
-	int32_t         op_errno   = 0;
-
-	VALIDATE_OR_GOTO (frame, out);
-	VALIDATE_OR_GOTO (this, out);
-	VALIDATE_OR_GOTO (this->private, out);
-	VALIDATE_OR_GOTO (fd, out);
-
 	priv     = this->private;
 	children = priv->children;
 
-	ALLOC_OR_GOTO (local, afr_local_t, out);
-
-	frame->local = local;
+	local = frame->local;
 
-        read_child = afr_read_child (this, fd->inode);
+        read_child = afr_read_child_select (this, local->fd->inode);
 
         if (read_child >= 0) {
                 call_child = read_child;
@@ -854,26 +864,321 @@ afr_readv (call_frame_t *frame, xlator_t *this,
         } else {
 		call_child = afr_first_up_child (priv);
 		if (call_child == -1) {
-			op_errno = ENOTCONN;
 			gf_log (this->name, GF_LOG_DEBUG,
 				"no child is up");
-			goto out;
+			return ENOTCONN;
 		}
 
 		local->cont.readv.last_tried = call_child;
 	}
 
+        afr_read_latency_begin (this, local, call_child);
+
+	STACK_WIND_COOKIE (frame, afr_readv_cbk,
+			   (void *) (long) call_child,
+			   children[call_child],
+			   children[call_child]->fops->readv,
+			   local->fd, local->cont.readv.size,
+			   local->cont.readv.offset);
+
+	return 0;
+}
+
+
+/*
+ * pick the children a read can be striped over - those that are up,
+ * have the fd open and were found in sync by the last lookup.
+ * returns the number of children picked.
+ */
+
+static int
+afr_striped_readv_children (xlator_t *this, fd_t *fd, size_t size,
+                            unsigned char *children)
+{
+	afr_private_t * priv     = NULL;
+	afr_fd_ctx_t  * fd_ctx   = NULL;
+
+        uint64_t        ctx      = 0;
+        uint64_t        readable = 0;
+
+        int             count    = 0;
+        int             ret      = 0;
+        int             i        = 0;
+
+	priv = this->private;
+
+        if (!priv->striped_read || (priv->read_child >= 0)
+            || (size < priv->striped_read_min_size))
+                goto out;
+
+        ret = fd_ctx_get (fd, this, &ctx);
+        if (ret < 0)
+                goto out;
+
+        fd_ctx = (afr_fd_ctx_t *)(long) ctx;
+
+        readable = afr_readable_children (this, fd->inode);
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (i >= AFR_MAX_READABLE_CHILDREN)
+                        break;
+
+                if (!(readable & (1ULL << i)) || !priv->child_up[i]
+                    || !fd_ctx->opened_on[i])
+                        continue;
+
+                children[i] = 1;
+                count++;
+        }
+
+out:
+        return count;
+}
+
+
+static int
+afr_striped_readv_done (call_frame_t *frame, xlator_t *this)
+{
+	afr_private_t     * priv    = NULL;
+	afr_local_t       * local   = NULL;
+        afr_read_stripe_t * stripes = NULL;
+
+        struct iovec  * vector   = NULL;
+        struct iobref * iobref   = NULL;
+        struct iatt   * buf      = NULL;
+
+        int32_t         op_ret   = 0;
+        int32_t         op_errno = 0;
+        int32_t         count    = 0;
+        int             i        = 0;
+        int             j        = 0;
+
+	priv    = this->private;
+	local   = frame->local;
+        stripes = local->cont.readv.stripes;
+
+        for (i = 0; i < local->cont.readv.stripe_count; i++) {
+                if (stripes[i].op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "chunk %d of striped read failed on %s (%s),"
+                                " reading from a single subvolume",
+                                i, priv->children[stripes[i].child]->name,
+                                strerror (stripes[i].op_errno));
+
+                        op_errno = afr_readv_single (frame, this);
+                        if (op_errno)
+                                goto err;
+
+                        return 0;
+                }
+
+                count += stripes[i].count;
+        }
+
+        vector = GF_CALLOC (count, sizeof (*vector), gf_afr_mt_iovec);
+        iobref = iobref_new ();
+
+        if (!vector || !iobref) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "out of memory :(");
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        count = 0;
+
+        for (i = 0; i < local->cont.readv.stripe_count; i++) {
+                for (j = 0; j < stripes[i].count; j++)
+                        vector[count++] = stripes[i].vector[j];
+
+                if (stripes[i].iobref)
+                        iobref_merge (iobref, stripes[i].iobref);
+
+                op_ret += stripes[i].op_ret;
+                buf     = &stripes[i].buf;
+
+                /* short read, we hit the end of the file */
+                if (stripes[i].op_ret < stripes[i].size)
+                        break;
+        }
+
+        buf->ia_ino = local->cont.readv.ino;
+
+        AFR_STACK_UNWIND (readv, frame, op_ret, op_errno,
+                          vector, count, buf, iobref);
+
+        GF_FREE (vector);
+        iobref_unref (iobref);
+
+        return 0;
+
+err:
+        GF_FREE (vector);
+        if (iobref)
+                iobref_unref (iobref);
+
+        AFR_STACK_UNWIND (readv, frame, -1, op_errno, NULL, 0, NULL, NULL);
+
+        return 0;
+}
+
+
+int32_t
+afr_striped_readv_cbk (call_frame_t *frame, void *cookie,
+                       xlator_t *this, int32_t op_ret, int32_t op_errno,
+                       struct iovec *vector, int32_t count, struct iatt *buf,
+                       struct iobref *iobref)
+{
+	afr_local_t       * local  = NULL;
+        afr_read_stripe_t * stripe = NULL;
+
+        int call_count = -1;
+
+	local  = frame->local;
+        stripe = &local->cont.readv.stripes[(long) cookie];
+
+        LOCK (&frame->lock);
+        {
+                stripe->op_ret   = op_ret;
+                stripe->op_errno = op_errno;
+
+                if ((op_ret >= 0) && count) {
+                        stripe->buf = *buf;
+
+                        stripe->vector = iov_dup (vector, count);
+                        if (!stripe->vector) {
+                                stripe->op_ret   = -1;
+                                stripe->op_errno = ENOMEM;
+                        } else {
+                                stripe->count  = count;
+                                stripe->iobref = iobref_ref (iobref);
+                        }
+                } else if (op_ret >= 0) {
+                        stripe->buf = *buf;
+                }
+        }
+        UNLOCK (&frame->lock);
+
+        call_count = afr_frame_return (frame);
+
+        if (call_count == 0)
+                afr_striped_readv_done (frame, this);
+
+        return 0;
+}
+
+
+static int
+afr_striped_readv (call_frame_t *frame, xlator_t *this,
+                   unsigned char *children, int child_count)
+{
+	afr_private_t     * priv    = NULL;
+	afr_local_t       * local   = NULL;
+        afr_read_stripe_t * stripes = NULL;
+
+        size_t chunk        = 0;
+        int    stripe_count = 0;
+        int    i            = 0;
+        int    stripe       = 0;
+
+	priv  = this->private;
+	local = frame->local;
+
+        /* split evenly, page aligned, so each brick reads whole pages */
+        chunk = (local->cont.readv.size + child_count - 1) / child_count;
+        chunk = (chunk + AFR_STRIPED_READ_ALIGN - 1)
+                & ~(AFR_STRIPED_READ_ALIGN - 1);
+
+        stripe_count = (local->cont.readv.size + chunk - 1) / chunk;
+
+        stripes = GF_CALLOC (stripe_count, sizeof (*stripes),
+                             gf_afr_mt_afr_read_stripe_t);
+        if (!stripes) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "out of memory :(");
+                return ENOMEM;
+        }
+
+        local->cont.readv.stripes      = stripes;
+        local->cont.readv.stripe_count = stripe_count;
+        local->call_count              = stripe_count;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (!children[i])
+                        continue;
+
+                if (stripe == stripe_count)
+                        break;
+
+                stripes[stripe].child  = i;
+                stripes[stripe].offset = local->cont.readv.offset
+                        + (stripe * chunk);
+                stripes[stripe].size   = min (chunk, local->cont.readv.size
+                                              - (stripe * chunk));
+                stripe++;
+        }
+
+        for (stripe = 0; stripe < stripe_count; stripe++) {
+                i = stripes[stripe].child;
+
+                STACK_WIND_COOKIE (frame, afr_striped_readv_cbk,
+                                   (void *) (long) stripe,
+                                   priv->children[i],
+                                   priv->children[i]->fops->readv,
+                                   local->fd, stripes[stripe].size,
+                                   stripes[stripe].offset);
+        }
+
+        return 0;
+}
+
+
+int32_t
+afr_readv (call_frame_t *frame, xlator_t *this,
+	   fd_t *fd, size_t size, off_t offset)
+{
+	afr_private_t * priv       = NULL;
+	afr_local_t   * local      = NULL;
+
+        unsigned char * children    = NULL;
+        int             child_count = 0;
+
+	int32_t         op_ret     = -1;
+	int32_t         op_errno   = 0;
+
+	VALIDATE_OR_GOTO (frame, out);
+	VALIDATE_OR_GOTO (this, out);
+	VALIDATE_OR_GOTO (this->private, out);
+	VALIDATE_OR_GOTO (fd, out);
+
+	priv     = this->private;
+
+	ALLOC_OR_GOTO (local, afr_local_t, out);
+
+	frame->local = local;
+
 	local->fd                    = fd_ref (fd);
 
         local->cont.readv.ino        = fd->inode->ino;
 	local->cont.readv.size       = size;
 	local->cont.readv.offset     = offset;
 
-	STACK_WIND_COOKIE (frame, afr_readv_cbk,
-			   (void *) (long) call_child,
-			   children[call_child],
-			   children[call_child]->fops->readv,
-			   fd, size, offset);
+        if (priv->striped_read) {
+                children = alloca (priv->child_count);
+                memset (children, 0, priv->child_count);
+
+                child_count = afr_striped_readv_children (this, fd, size,
+                                                          children);
+        }
+
+        if (child_count > 1)
+                op_errno = afr_striped_readv (frame, this, children,
+                                              child_count);
+        else
+                op_errno = afr_readv_single (frame, this);
+
+        if (op_errno)
+                goto out;
 
 	op_ret = 0;
 out:
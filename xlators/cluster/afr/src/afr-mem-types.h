@@ -38,9 +38,12 @@ enum gf_afr_mem_types_ {
         gf_afr_mt_afr_node_character,
         gf_afr_mt_sh_diff_loop_state,
         gf_afr_mt_uint8_t,
+        gf_afr_mt_uint64_t,
         gf_afr_mt_loc_t,
         gf_afr_mt_entry_name,
         gf_afr_mt_pump_priv,
+        gf_afr_mt_afr_eager_lock_waiter_t,
+        gf_afr_mt_afr_read_stripe_t,
         gf_afr_mt_end
 };
 #endif
@@ -34,6 +34,7 @@
 #include "compat.h"
 #include "byte-order.h"
 #include "md5.h"
+#include "timer.h"
 
 #include "afr-transaction.h"
 #include "afr-self-heal.h"
@@ -45,6 +46,86 @@
 */
 
 
+/*
+  Pipelining and throttling, common to all algorithms.
+
+  Each algorithm keeps up to 'window' blocks of a file in flight. The
+  window is data-self-heal-window-bytes worth of blocks if that is set,
+  or data-self-heal-window-size blocks otherwise.
+
+  data-self-heal-bandwidth caps the bytes per second that all data
+  self-heals of this volume together may scan. A loop is admitted only
+  while the current second has budget left; a heal that runs out with
+  nothing in flight sleeps until the next second.
+*/
+
+static unsigned int
+sh_loop_window (afr_private_t *priv, size_t block_size)
+{
+        uint64_t window = 0;
+
+        if (!priv->data_self_heal_window_bytes)
+                return priv->data_self_heal_window_size;
+
+        window = priv->data_self_heal_window_bytes / block_size;
+
+        if (window < 1)
+                window = 1;
+
+        if (window > AFR_SH_MAX_WINDOW)
+                window = AFR_SH_MAX_WINDOW;
+
+        return window;
+}
+
+
+static gf_boolean_t
+sh_throttle_admit (afr_private_t *priv, size_t bytes)
+{
+        gf_boolean_t admit = _gf_true;
+        time_t       now   = 0;
+
+        if (!priv->data_self_heal_bandwidth)
+                goto out;
+
+        now = time (NULL);
+
+        LOCK (&priv->sh_throttle_lock);
+        {
+                if (now != priv->sh_throttle_second) {
+                        priv->sh_throttle_second = now;
+                        priv->sh_throttle_bytes  = 0;
+                }
+
+                if (priv->sh_throttle_bytes < priv->data_self_heal_bandwidth)
+                        priv->sh_throttle_bytes += bytes;
+                else
+                        admit = _gf_false;
+        }
+        UNLOCK (&priv->sh_throttle_lock);
+
+out:
+        return admit;
+}
+
+
+static void
+sh_throttle_sleep (call_frame_t *frame, xlator_t *this,
+                   gf_timer_cbk_t resume)
+{
+        struct timeval delta = {1, 0};
+
+        gf_log (this->name, GF_LOG_TRACE,
+                "self-heal bandwidth used up, pausing");
+
+        if (!gf_timer_call_after (this->ctx, delta, resume, frame)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not pause self-heal, resuming right away");
+                resume (frame);
+        }
+}
+
+
 /*
   The "full" algorithm. Copies the entire file from
   source to sinks.
@@ -290,6 +371,26 @@ out:
 }
 
 
+static void
+sh_full_throttle_resume (void *data)
+{
+        call_frame_t *frame = data;
+	afr_local_t * local = NULL;
+        afr_sh_algo_full_private_t *sh_priv = NULL;
+
+        local   = frame->local;
+        sh_priv = local->self_heal.private;
+
+        LOCK (&sh_priv->lock);
+        {
+                sh_priv->throttle_wait = _gf_false;
+        }
+        UNLOCK (&sh_priv->lock);
+
+        sh_full_loop_driver (frame, THIS);
+}
+
+
 static int
 sh_full_loop_driver (call_frame_t *frame, xlator_t *this)
 {
@@ -300,6 +401,7 @@ sh_full_loop_driver (call_frame_t *frame, xlator_t *this)
 
         int   loop    = 0;
         int   recurse = 0;
+        int   throttled = 0;
 
         off_t offset  = 0;
 
@@ -341,7 +443,18 @@ spawn:
 
         LOCK (&sh_priv->lock);
         {
-                if ((sh_priv->loops_running < priv->data_self_heal_window_size)
+                if (sh_priv->throttle_wait) {
+                        /* the timer will call us */
+                } else if ((sh_priv->loops_running < sh_priv->window)
+                    && (sh_priv->offset < sh->file_size)
+                    && !sh_throttle_admit (priv, sh->block_size)) {
+
+                        if (sh_priv->loops_running == 0) {
+                                sh_priv->throttle_wait = _gf_true;
+                                throttled = 1;
+                        }
+
+                } else if ((sh_priv->loops_running < sh_priv->window)
                     && (sh_priv->offset < sh->file_size)) {
 
                         gf_log (this->name, GF_LOG_TRACE,
@@ -361,6 +474,9 @@ spawn:
         }
         UNLOCK (&sh_priv->lock);
 
+        if (throttled)
+                sh_throttle_sleep (frame, this, sh_full_throttle_resume);
+
         if (loop) {
                 sh_full_read_write (frame, this, offset);
                 if (recurse)
@@ -389,6 +505,8 @@ afr_sh_algo_full (call_frame_t *frame, xlator_t *this)
 
         LOCK_INIT (&sh_priv->lock);
 
+        sh_priv->window = sh_loop_window (priv, sh->block_size);
+
         sh->private = sh_priv;
 
         local->call_count = 0;
@@ -420,7 +538,7 @@ sh_diff_private_cleanup (call_frame_t *frame, xlator_t *this)
 
         sh_priv = sh->private;
 
-        for (i = 0; i < priv->data_self_heal_window_size; i++) {
+        for (i = 0; i < sh_priv->window; i++) {
                 if (sh_priv->loops[i]) {
                         if (sh_priv->loops[i]->write_needed)
                                 GF_FREE (sh_priv->loops[i]->write_needed);
@@ -890,7 +1008,7 @@ sh_diff_checksum (call_frame_t *frame, xlator_t *this, off_t offset)
 
         rw_local->call_count = call_count;
 
-        loop_index = sh_diff_find_unused_loop (sh_priv, priv->data_self_heal_window_size);
+        loop_index = sh_diff_find_unused_loop (sh_priv, sh_priv->window);
 
         loop_state = sh_priv->loops[loop_index];
         loop_state->offset       = offset;
@@ -935,6 +1053,26 @@ out:
 }
 
 
+static void
+sh_diff_throttle_resume (void *data)
+{
+        call_frame_t *frame = data;
+	afr_local_t * local = NULL;
+        afr_sh_algo_diff_private_t *sh_priv = NULL;
+
+        local   = frame->local;
+        sh_priv = local->self_heal.private;
+
+        LOCK (&sh_priv->lock);
+        {
+                sh_priv->throttle_wait = _gf_false;
+        }
+        UNLOCK (&sh_priv->lock);
+
+        sh_diff_loop_driver (frame, THIS);
+}
+
+
 static int
 sh_diff_loop_driver (call_frame_t *frame, xlator_t *this)
 {
@@ -945,6 +1083,7 @@ sh_diff_loop_driver (call_frame_t *frame, xlator_t *this)
 
         int   loop    = 0;
         int   recurse = 0;
+        int   throttled = 0;
 
         off_t offset = 0;
         char  sh_type_str[256] = {0,};
@@ -995,7 +1134,18 @@ spawn:
 
         LOCK (&sh_priv->lock);
         {
-                if ((sh_priv->loops_running < priv->data_self_heal_window_size)
+                if (sh_priv->throttle_wait) {
+                        /* the timer will call us */
+                } else if ((sh_priv->loops_running < sh_priv->window)
+                    && (sh_priv->offset < sh->file_size)
+                    && !sh_throttle_admit (priv, sh_priv->block_size)) {
+
+                        if (sh_priv->loops_running == 0) {
+                                sh_priv->throttle_wait = _gf_true;
+                                throttled = 1;
+                        }
+
+                } else if ((sh_priv->loops_running < sh_priv->window)
                     && (sh_priv->offset < sh->file_size)) {
 
                         gf_log (this->name, GF_LOG_TRACE,
@@ -1015,6 +1165,9 @@ spawn:
         }
         UNLOCK (&sh_priv->lock);
 
+        if (throttled)
+                sh_throttle_sleep (frame, this, sh_diff_throttle_resume);
+
         if (loop) {
                 sh_diff_checksum (frame, this, offset);
                 if (recurse)
@@ -1044,6 +1197,7 @@ afr_sh_algo_diff (call_frame_t *frame, xlator_t *this)
                              gf_afr_mt_afr_private_t);
 
         sh_priv->block_size = this->ctx->page_size;
+        sh_priv->window     = sh_loop_window (priv, sh_priv->block_size);
 
         sh->private = sh_priv;
 
@@ -1051,11 +1205,11 @@ afr_sh_algo_diff (call_frame_t *frame, xlator_t *this)
 
         local->call_count = 0;
 
-        sh_priv->loops = GF_CALLOC (priv->data_self_heal_window_size,
+        sh_priv->loops = GF_CALLOC (sh_priv->window,
                                     sizeof (*sh_priv->loops),
                                     gf_afr_mt_sh_diff_loop_state);
 
-        for (i = 0; i < priv->data_self_heal_window_size; i++) {
+        for (i = 0; i < sh_priv->window; i++) {
                 sh_priv->loops[i]               = GF_CALLOC (1, sizeof (*sh_priv->loops[i]),
                                                              gf_afr_mt_sh_diff_loop_state);
 
@@ -34,6 +34,8 @@ extern struct afr_sh_algorithm afr_self_heal_algorithms[3];
 typedef struct {
         gf_lock_t lock;
         unsigned int loops_running;
+        unsigned int window;           /* max loops_running */
+        gf_boolean_t throttle_wait;    /* waiting for bandwidth */
         off_t offset;
 } afr_sh_algo_full_private_t;
 
@@ -49,6 +51,8 @@ typedef struct {
 
         gf_lock_t lock;
         unsigned int loops_running;
+        unsigned int window;           /* max loops_running */
+        gf_boolean_t throttle_wait;    /* waiting for bandwidth */
         off_t offset;
 
         int32_t total_blocks;
@@ -0,0 +1,355 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * index self-heal
+ *
+ * bricks running features/index keep a list of the files whose
+ * changelog on that brick is not clean. whenever a subvolume comes
+ * up, we read that list back from every subvolume and look up each
+ * file in it. the lookup does the actual healing, exactly as if an
+ * application had touched the file, so heal time depends on how much
+ * changed rather than on how big the volume is.
+ *
+ * each subvolume's list is walked by its own synctask. lookups that
+ * need healing go to background self-heal, so up to
+ * background-self-heal-count files are healed at once.
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "glusterfs.h"
+#include "afr.h"
+#include "dict.h"
+#include "xlator.h"
+#include "logging.h"
+#include "common-utils.h"
+#include "syncop.h"
+
+#include "afr-self-heal.h"
+
+
+static void
+afr_index_root_loc (afr_private_t *priv, loc_t *loc)
+{
+        loc->path  = "/";
+        loc->name  = "";
+        loc->inode = priv->root_inode;
+        loc->ino   = 1;
+}
+
+
+/*
+ * look up every component of @path, starting at the root, so that
+ * the parent directories get healed (and the file re-created on the
+ * subvolumes that missed it) before the file itself.
+ */
+
+static int
+afr_index_heal_path (xlator_t *this, const char *path)
+{
+        afr_private_t *priv = NULL;
+
+        loc_t        root;
+        loc_t        parent;
+        loc_t        loc;
+        struct iatt  iatt;
+        struct iatt  postparent;
+        const char  *end = NULL;
+        int          ret = 0;
+
+        priv = this->private;
+
+        memset (&root, 0, sizeof (root));
+        memset (&parent, 0, sizeof (parent));
+
+        afr_index_root_loc (priv, &root);
+
+        end = path;
+
+        while (*end) {
+                end = strchr (end + 1, '/');
+                if (!end)
+                        end = path + strlen (path);
+
+                memset (&loc, 0, sizeof (loc));
+
+                loc.path = GF_CALLOC (1, (end - path) + 1, gf_afr_mt_char);
+                if (!loc.path) {
+                        ret = -ENOMEM;
+                        break;
+                }
+
+                memcpy ((char *) loc.path, path, end - path);
+
+                loc.name   = strrchr (loc.path, '/') + 1;
+                loc.parent = inode_ref (parent.inode ? parent.inode
+                                        : root.inode);
+                loc.inode  = inode_new (root.inode->table);
+
+                ret = syncop_lookup (this, &loc, NULL, &iatt, NULL,
+                                     &postparent);
+                if (ret < 0) {
+                        ret = -errno;
+                        loc_wipe (&loc);
+                        break;
+                }
+
+                loc.ino        = iatt.ia_ino;
+                loc.inode->ino = iatt.ia_ino;
+
+                loc_wipe (&parent);
+                parent = loc;
+        }
+
+        loc_wipe (&parent);
+
+        return ret;
+}
+
+
+static int
+afr_index_forget_path (xlator_t *this, int child, const char *path)
+{
+        afr_private_t *priv = NULL;
+        dict_t        *dict = NULL;
+
+        loc_t root;
+        int   ret = -1;
+
+        priv = this->private;
+
+        memset (&root, 0, sizeof (root));
+        afr_index_root_loc (priv, &root);
+
+        dict = dict_new ();
+        if (!dict)
+                goto out;
+
+        ret = dict_set_str (dict, GF_XATTR_INDEX_FORGET_KEY, (char *) path);
+        if (ret < 0)
+                goto out;
+
+        ret = syncop_setxattr (priv->children[child], &root, dict, 0);
+out:
+        if (dict)
+                dict_unref (dict);
+
+        return ret;
+}
+
+
+static int
+afr_index_heal_task (void *data)
+{
+        xlator_t      *this = NULL;
+        afr_private_t *priv = NULL;
+        dict_t        *dict = NULL;
+
+        loc_t    root;
+        char     key[256];
+        char    *path   = NULL;
+        int64_t  offset = 0;
+        int32_t  count  = 0;
+        int      child  = 0;
+        int      healed = 0;
+        int      i      = 0;
+        int      ret    = 0;
+
+        this  = THIS;
+        priv  = this->private;
+        child = (long) data;
+
+        memset (&root, 0, sizeof (root));
+        afr_index_root_loc (priv, &root);
+
+        for (;;) {
+                if (offset)
+                        snprintf (key, 256, "%s.%"PRId64,
+                                  GF_XATTR_INDEX_PENDING_KEY, offset);
+                else
+                        snprintf (key, 256, "%s", GF_XATTR_INDEX_PENDING_KEY);
+
+                ret = syncop_getxattr (priv->children[child], &root, key,
+                                       &dict);
+                if (ret < 0) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "could not read the index of %s (%s)",
+                                priv->children[child]->name,
+                                strerror (errno));
+                        break;
+                }
+
+                ret = dict_get_int32 (dict, GF_XATTR_INDEX_PENDING_KEY ".count",
+                                      &count);
+                if (ret < 0)
+                        count = 0;
+
+                for (i = 0; i < count; i++) {
+                        snprintf (key, 256, "%s.path.%d",
+                                  GF_XATTR_INDEX_PENDING_KEY, i);
+
+                        if (dict_get_str (dict, key, &path) < 0)
+                                continue;
+
+                        if (!priv->child_up[child])
+                                goto out;
+
+                        ret = afr_index_heal_path (this, path);
+                        if (ret == -ENOENT) {
+                                /* gone everywhere; nothing left to heal */
+                                afr_index_forget_path (this, child, path);
+                                continue;
+                        }
+
+                        if (ret < 0) {
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "lookup of %s failed (%s)",
+                                        path, strerror (-ret));
+                                continue;
+                        }
+
+                        healed++;
+                }
+
+                ret = dict_get_int64 (dict, GF_XATTR_INDEX_PENDING_KEY ".next",
+                                      &offset);
+                dict_unref (dict);
+                dict = NULL;
+
+                if (ret < 0)
+                        break;
+        }
+
+out:
+        if (dict)
+                dict_unref (dict);
+
+        gf_log (this->name, GF_LOG_NORMAL,
+                "index self-heal of %s done, %d files looked up",
+                priv->children[child]->name, healed);
+
+        return 0;
+}
+
+
+static int
+afr_index_heal_task_done (int ret, void *data)
+{
+        xlator_t      *this = NULL;
+        afr_private_t *priv = NULL;
+
+        gf_boolean_t again = _gf_false;
+
+        this = THIS;
+        priv = this->private;
+
+        LOCK (&priv->lock);
+        {
+                priv->index_heal_running--;
+
+                if (!priv->index_heal_running && priv->index_heal_again) {
+                        priv->index_heal_again = _gf_false;
+                        again = _gf_true;
+                }
+        }
+        UNLOCK (&priv->lock);
+
+        if (again)
+                afr_index_heal_start (this);
+
+        return 0;
+}
+
+
+/*
+ * start walking the indices of all subvolumes that are up. if a walk
+ * is already on, another one is done right after it, since whatever
+ * came up now may have added to the indices.
+ */
+
+void
+afr_index_heal_start (xlator_t *this)
+{
+        afr_private_t *priv = NULL;
+        xlator_t      *old_THIS = NULL;
+
+        int up_children = 0;
+        int i           = 0;
+        int ret         = 0;
+
+        priv = this->private;
+
+        if (!priv->index_self_heal || !priv->index_heal_env
+            || !priv->root_inode)
+                return;
+
+        for (i = 0; i < priv->child_count; i++)
+                if (priv->child_up[i])
+                        up_children++;
+
+        /* nothing to heal onto */
+        if (up_children < 2)
+                return;
+
+        LOCK (&priv->lock);
+        {
+                if (priv->index_heal_running) {
+                        priv->index_heal_again = _gf_true;
+                        up_children = 0;
+                } else {
+                        priv->index_heal_running = up_children;
+                }
+        }
+        UNLOCK (&priv->lock);
+
+        if (!up_children)
+                return;
+
+        /* the tasks run as us */
+        old_THIS = THIS;
+        THIS = this;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (!priv->child_up[i] || !up_children)
+                        continue;
+
+                up_children--;
+
+                ret = synctask_new (priv->index_heal_env, afr_index_heal_task,
+                                    afr_index_heal_task_done,
+                                    (void *) (long) i);
+                if (ret < 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not start index self-heal of %s",
+                                priv->children[i]->name);
+
+                        afr_index_heal_task_done (ret, NULL);
+                }
+        }
+
+        /* children that went down meanwhile have no task to finish */
+        while (up_children--)
+                afr_index_heal_task_done (0, NULL);
+
+        THIS = old_THIS;
+}
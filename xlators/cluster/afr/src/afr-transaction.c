@@ -23,6 +23,7 @@
 
 #include "afr.h"
 #include "afr-transaction.h"
+#include "timer.h"
 
 #include <signal.h>
 
@@ -456,6 +457,495 @@ afr_lock_server_count (afr_private_t *priv, afr_transaction_type type)
 }
 
 
+/* {{{ eager lock */
+
+/*
+  With eager locking, the first write on an fd takes a full-file
+  inodelk with the fd as lk-owner and leaves it held when the write
+  is done. Writes that follow on the same fd find the lock held and
+  go straight to the fop, so together with the delayed post-op a
+  sole writer pays neither the lock nor the unlock round-trips.
+
+  The lock is dropped once the fd has been idle for
+  eager-lock-timeout seconds, or handed over to a flush (or
+  ftruncate) on the fd, which does its post-op and unlocks as usual.
+*/
+
+static
+int afr_lock_rec (call_frame_t *frame, xlator_t *this, int child_index);
+
+static int
+afr_lock_done (call_frame_t *frame, xlator_t *this);
+
+int32_t
+afr_lock (call_frame_t *frame, xlator_t *this);
+
+static int
+afr_eager_lock (call_frame_t *frame, xlator_t *this);
+
+
+static int
+afr_eager_lock_enabled (afr_private_t *priv, afr_local_t *local)
+{
+        if (!priv->eager_lock || !local->fd)
+                return 0;
+
+        switch (local->transaction.type) {
+        case AFR_DATA_TRANSACTION:
+        case AFR_FLUSH_TRANSACTION:
+                return 1;
+        default:
+                return 0;
+        }
+}
+
+
+static void
+afr_eager_lock_wake (struct list_head *waiters)
+{
+        afr_eager_lock_waiter_t *waiter = NULL;
+        afr_eager_lock_waiter_t *tmp    = NULL;
+        call_frame_t            *frame  = NULL;
+
+        list_for_each_entry_safe (waiter, tmp, waiters, list) {
+                list_del_init (&waiter->list);
+
+                frame = waiter->frame;
+                GF_FREE (waiter);
+
+                afr_eager_lock (frame, frame->this);
+        }
+}
+
+
+int32_t
+afr_eager_unlock_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno)
+{
+        int call_count = 0;
+
+        call_count = afr_frame_return (frame);
+
+        if (call_count == 0)
+                AFR_STACK_DESTROY (frame);
+
+        return 0;
+}
+
+
+/*
+  drop the lock held on @locked_on on behalf of @fd. The ref the
+  eager lock held on @fd is handed over to the unlock frame.
+*/
+
+static void
+afr_eager_unlock (xlator_t *this, fd_t *fd, unsigned char *locked_on)
+{
+        afr_private_t *priv  = NULL;
+        afr_local_t   *local = NULL;
+        call_frame_t  *frame = NULL;
+
+        struct flock flock;
+
+        int i          = 0;
+        int call_count = 0;
+
+        priv = this->private;
+
+        call_count = afr_locked_nodes_count (locked_on, priv->child_count);
+        if (call_count == 0)
+                goto out;
+
+        frame = create_frame (this, this->ctx->pool);
+        if (!frame)
+                goto out;
+
+        local = GF_CALLOC (1, sizeof (*local), gf_afr_mt_afr_local_t);
+        if (!local) {
+                STACK_DESTROY (frame->root);
+                goto out;
+        }
+
+        frame->local = local;
+        frame->root->lk_owner = (uint64_t)(long) fd;
+
+        local->fd         = fd;
+        local->call_count = call_count;
+
+        memset (&flock, 0, sizeof (flock));
+        flock.l_type = F_UNLCK;
+
+        gf_log (this->name, GF_LOG_TRACE,
+                "releasing eager lock on fd=%p", fd);
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (!locked_on[i])
+                        continue;
+
+                STACK_WIND (frame, afr_eager_unlock_cbk,
+                            priv->children[i],
+                            priv->children[i]->fops->finodelk,
+                            this->name, fd, F_SETLK, &flock);
+
+                if (!--call_count)
+                        break;
+        }
+
+        return;
+out:
+        if (call_count)
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not release eager lock on fd=%p", fd);
+        fd_unref (fd);
+}
+
+
+static void
+afr_eager_lock_timer_expired (void *data);
+
+
+static void
+afr_eager_lock_arm_timer (xlator_t *this, fd_t *fd)
+{
+        afr_private_t *priv  = NULL;
+        gf_timer_t    *timer = NULL;
+
+        struct timeval delta = {0, };
+
+        priv = this->private;
+
+        delta.tv_sec = priv->eager_lock_timeout;
+
+        /* the timer is never cancelled. It holds its own ref on the
+           fd until it fires and checks whether the fd is still idle */
+
+        fd_ref (fd);
+
+        timer = gf_timer_call_after (this->ctx, delta,
+                                     afr_eager_lock_timer_expired, fd);
+        if (!timer) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not arm eager lock timer for fd=%p", fd);
+                fd_unref (fd);
+        }
+}
+
+
+static void
+afr_eager_lock_timer_expired (void *data)
+{
+        xlator_t      *this      = NULL;
+        afr_private_t *priv      = NULL;
+        fd_t          *fd        = NULL;
+        afr_fd_ctx_t  *fd_ctx    = NULL;
+        unsigned char *locked_on = NULL;
+
+        struct timeval now = {0, };
+        uint64_t       ctx = 0;
+
+        int ret     = -1;
+        int release = 0;
+        int rearm   = 0;
+
+        fd   = data;
+        this = THIS;
+        priv = this->private;
+
+        locked_on = alloca (priv->child_count);
+
+        gettimeofday (&now, NULL);
+
+        LOCK (&fd->lock);
+        {
+                ret = __fd_ctx_get (fd, this, &ctx);
+                if (ret < 0)
+                        goto unlock;
+
+                fd_ctx = (afr_fd_ctx_t *)(long) ctx;
+
+                fd_ctx->eager_lock_timer_armed = _gf_false;
+
+                if (!fd_ctx->eager_lock_held)
+                        goto unlock;
+
+                if ((fd_ctx->eager_lock_users == 0)
+                    && ((now.tv_sec - fd_ctx->eager_lock_last_used.tv_sec)
+                        >= priv->eager_lock_timeout)) {
+                        memcpy (locked_on, fd_ctx->eager_locked_on,
+                                priv->child_count);
+                        memset (fd_ctx->eager_locked_on, 0,
+                                priv->child_count);
+
+                        fd_ctx->eager_lock_held = _gf_false;
+                        release = 1;
+                } else {
+                        fd_ctx->eager_lock_timer_armed = _gf_true;
+                        rearm = 1;
+                }
+        }
+unlock:
+        UNLOCK (&fd->lock);
+
+        if (rearm)
+                afr_eager_lock_arm_timer (this, fd);
+
+        if (release)
+                afr_eager_unlock (this, fd, locked_on);
+
+        fd_unref (fd);
+}
+
+
+/*
+  called by an AFR_EAGER_LOCK_ACQUIRING write once its lock is in
+  place and its pre-op is done, to let other writes use the lock
+*/
+
+static void
+afr_eager_lock_publish (call_frame_t *frame, xlator_t *this)
+{
+        afr_private_t *priv   = NULL;
+        afr_local_t   *local  = NULL;
+        afr_fd_ctx_t  *fd_ctx = NULL;
+
+        struct list_head waiters;
+
+        uint64_t ctx = 0;
+        int      ret = -1;
+
+        priv  = this->private;
+        local = frame->local;
+
+        INIT_LIST_HEAD (&waiters);
+
+        /* the held lock keeps a ref on the fd of its own */
+        fd_ref (local->fd);
+
+        LOCK (&local->fd->lock);
+        {
+                ret = __fd_ctx_get (local->fd, this, &ctx);
+                if (ret < 0)
+                        goto unlock;
+
+                fd_ctx = (afr_fd_ctx_t *)(long) ctx;
+
+                memcpy (fd_ctx->eager_locked_on,
+                        local->transaction.locked_nodes,
+                        priv->child_count);
+
+                fd_ctx->eager_lock_busy = _gf_false;
+                fd_ctx->eager_lock_held = _gf_true;
+
+                list_splice_init (&fd_ctx->eager_lock_waiters, &waiters);
+        }
+unlock:
+        UNLOCK (&local->fd->lock);
+
+        if (ret < 0) {
+                fd_unref (local->fd);
+                return;
+        }
+
+        local->transaction.eager_lock = AFR_EAGER_LOCK_SHARED;
+
+        afr_eager_lock_wake (&waiters);
+}
+
+
+/*
+  called when a transaction is done with the fd's lock. Wakes up the
+  waiters once nobody is using the lock, and arms the idle timer if
+  the lock stays held.
+*/
+
+static void
+afr_eager_lock_put (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t   *local  = NULL;
+        afr_fd_ctx_t  *fd_ctx = NULL;
+
+        struct list_head waiters;
+
+        uint64_t ctx = 0;
+        int      ret = -1;
+        int      arm = 0;
+
+        local = frame->local;
+
+        INIT_LIST_HEAD (&waiters);
+
+        LOCK (&local->fd->lock);
+        {
+                ret = __fd_ctx_get (local->fd, this, &ctx);
+                if (ret < 0)
+                        goto unlock;
+
+                fd_ctx = (afr_fd_ctx_t *)(long) ctx;
+
+                switch (local->transaction.eager_lock) {
+                case AFR_EAGER_LOCK_ACQUIRING:
+                        fd_ctx->eager_lock_busy = _gf_false;
+                        fd_ctx->eager_lock_users--;
+                        break;
+
+                case AFR_EAGER_LOCK_SHARED:
+                        fd_ctx->eager_lock_users--;
+                        break;
+
+                case AFR_EAGER_LOCK_EXCLUSIVE:
+                        fd_ctx->eager_lock_exclusive = _gf_false;
+                        break;
+
+                default:
+                        break;
+                }
+
+                if (fd_ctx->eager_lock_users || fd_ctx->eager_lock_busy)
+                        goto unlock;
+
+                list_splice_init (&fd_ctx->eager_lock_waiters, &waiters);
+
+                if (list_empty (&waiters) && fd_ctx->eager_lock_held) {
+                        gettimeofday (&fd_ctx->eager_lock_last_used, NULL);
+
+                        if (!fd_ctx->eager_lock_timer_armed) {
+                                fd_ctx->eager_lock_timer_armed = _gf_true;
+                                arm = 1;
+                        }
+                }
+        }
+unlock:
+        UNLOCK (&local->fd->lock);
+
+        local->transaction.eager_lock = AFR_EAGER_LOCK_NONE;
+
+        if (arm)
+                afr_eager_lock_arm_timer (this, local->fd);
+
+        afr_eager_lock_wake (&waiters);
+}
+
+
+static int
+afr_eager_lock (call_frame_t *frame, xlator_t *this)
+{
+        afr_private_t *priv   = NULL;
+        afr_local_t   *local  = NULL;
+        afr_fd_ctx_t  *fd_ctx = NULL;
+
+        afr_eager_lock_waiter_t *waiter = NULL;
+        afr_eager_lock_role_t    role   = AFR_EAGER_LOCK_NONE;
+
+        uint64_t ctx       = 0;
+        int      ret       = -1;
+        int      wait      = 0;
+        int      inherited = 0;
+
+        priv  = this->private;
+        local = frame->local;
+
+        LOCK (&local->fd->lock);
+        {
+                ret = __fd_ctx_get (local->fd, this, &ctx);
+                if (ret < 0)
+                        goto unlock;
+
+                fd_ctx = (afr_fd_ctx_t *)(long) ctx;
+
+                if (local->op == GF_FOP_WRITE) {
+                        /* writes queue up behind a waiting flush */
+                        if (fd_ctx->eager_lock_busy
+                            || fd_ctx->eager_lock_exclusive
+                            || !list_empty (&fd_ctx->eager_lock_waiters)) {
+                                wait = 1;
+                        } else if (fd_ctx->eager_lock_held) {
+                                memcpy (local->transaction.locked_nodes,
+                                        fd_ctx->eager_locked_on,
+                                        priv->child_count);
+
+                                fd_ctx->eager_lock_users++;
+                                role = AFR_EAGER_LOCK_SHARED;
+                        } else {
+                                fd_ctx->eager_lock_busy = _gf_true;
+                                fd_ctx->eager_lock_users++;
+                                role = AFR_EAGER_LOCK_ACQUIRING;
+                        }
+                } else {
+                        /* the post-op of a flush must not race with
+                           writes still using the lock */
+                        if (fd_ctx->eager_lock_busy
+                            || fd_ctx->eager_lock_exclusive
+                            || fd_ctx->eager_lock_users) {
+                                wait = 1;
+                        } else {
+                                fd_ctx->eager_lock_exclusive = _gf_true;
+                                role = AFR_EAGER_LOCK_EXCLUSIVE;
+
+                                if (fd_ctx->eager_lock_held) {
+                                        memcpy (local->transaction.locked_nodes,
+                                                fd_ctx->eager_locked_on,
+                                                priv->child_count);
+                                        memset (fd_ctx->eager_locked_on, 0,
+                                                priv->child_count);
+
+                                        fd_ctx->eager_lock_held = _gf_false;
+                                        inherited = 1;
+                                }
+                        }
+                }
+
+                if (wait) {
+                        waiter = GF_CALLOC (1, sizeof (*waiter),
+                                            gf_afr_mt_afr_eager_lock_waiter_t);
+                        if (!waiter) {
+                                wait = 0;
+                                goto unlock;
+                        }
+
+                        waiter->frame = frame;
+                        list_add_tail (&waiter->list,
+                                       &fd_ctx->eager_lock_waiters);
+                }
+        }
+unlock:
+        UNLOCK (&local->fd->lock);
+
+        if (wait)
+                return 0;
+
+        if (role == AFR_EAGER_LOCK_NONE) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "not using eager lock on fd=%p", local->fd);
+                return afr_lock (frame, this);
+        }
+
+        local->transaction.eager_lock = role;
+        local->transaction.start      = 0;
+        local->transaction.len        = 0;
+
+        afr_pid_save (frame);
+
+        frame->root->pid      = (long) frame->root;
+        frame->root->lk_owner = (uint64_t)(long) local->fd;
+
+        if ((role == AFR_EAGER_LOCK_SHARED) || inherited) {
+                /* an inheriting transaction unlocks with its own ref */
+                if (inherited)
+                        fd_unref (local->fd);
+
+                local->transaction.lock_count =
+                        afr_locked_nodes_count (local->transaction.locked_nodes,
+                                                priv->child_count);
+
+                return afr_lock_done (frame, this);
+        }
+
+        return afr_lock_rec (frame, this, 0);
+}
+
+/* }}} */
+
+
 /* {{{ unlock */
 
 static int
@@ -511,6 +1001,9 @@ afr_unlock_common_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	UNLOCK (&frame->lock);
 
 	if (call_count == 0) {
+                if (local->transaction.eager_lock)
+                        afr_eager_lock_put (frame, this);
+
 		local->transaction.done (frame, this);
 	}
 	
@@ -537,6 +1030,14 @@ afr_unlock (call_frame_t *frame, xlator_t *this)
 
 	local = frame->local;
 
+        if (local->transaction.eager_lock == AFR_EAGER_LOCK_SHARED) {
+                /* leave the lock held for the writes to come */
+                afr_eager_lock_put (frame, this);
+
+                local->transaction.done (frame, this);
+                return 0;
+        }
+
         /*
           pid has been restored to saved_pid in the fop,
           so set it back to frame->root 
@@ -548,6 +1049,9 @@ afr_unlock (call_frame_t *frame, xlator_t *this)
                                                          priv->child_count);
 
 	if (call_count == 0) {
+                if (local->transaction.eager_lock)
+                        afr_eager_lock_put (frame, this);
+
 		local->transaction.done (frame, this);
 		return 0;
 	}
@@ -912,6 +1416,10 @@ afr_changelog_pre_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		    (local->op_errno == ENOTSUP)) {
 			local->transaction.resume (frame, this);
 		} else {
+                        if (local->transaction.eager_lock
+                            == AFR_EAGER_LOCK_ACQUIRING)
+                                afr_eager_lock_publish (frame, this);
+
                         __mark_all_success (local->pending, priv->child_count,
                                             local->transaction.type);
 
@@ -1197,6 +1705,33 @@ out:
 }
 
 
+static int
+afr_lock_done (call_frame_t *frame, xlator_t *this)
+{
+	afr_local_t *   local = NULL;
+	afr_private_t * priv  = NULL;
+
+	local = frame->local;
+	priv  = this->private;
+
+        if (__changelog_needed_pre_op (frame, this)) {
+                afr_changelog_pre_op (frame, this);
+        } else {
+                if (local->transaction.eager_lock == AFR_EAGER_LOCK_ACQUIRING)
+                        afr_eager_lock_publish (frame, this);
+
+                __mark_all_success (local->pending, priv->child_count,
+                                    local->transaction.type);
+
+                afr_pid_restore (frame);
+
+                local->transaction.fop (frame, this);
+        }
+
+        return 0;
+}
+
+
 static
 int afr_lock_rec (call_frame_t *frame, xlator_t *this, int child_index)
 {
@@ -1277,16 +1812,7 @@ int afr_lock_rec (call_frame_t *frame, xlator_t *this, int child_index)
 
 		/* we're done locking */
 
-		if (__changelog_needed_pre_op (frame, this)) {
-			afr_changelog_pre_op (frame, this);
-		} else {
-                        __mark_all_success (local->pending, priv->child_count,
-                                            local->transaction.type);
-
-                        afr_pid_restore (frame);
-
-			local->transaction.fop (frame, this);
-		}
+                afr_lock_done (frame, this);
 
 		return 0;
 	}
@@ -1428,6 +1954,11 @@ afr_transaction_fop_failed (call_frame_t *frame, xlator_t *this, int child_index
                                    child_index, local->transaction.type);
                 break;
         }
+
+        /* the child may now lag behind the others; stop reading from it
+           until a lookup finds the replicas in sync again */
+        afr_unset_readable_child (this, local->fd ? local->fd->inode
+                                  : local->loc.inode, child_index);
 }
 
 
@@ -1456,7 +1987,9 @@ afr_transaction (call_frame_t *frame, xlator_t *this, afr_transaction_type type)
 
 			local->transaction.fop (frame, this);
 		}
-	} else {
+	} else if (afr_eager_lock_enabled (priv, local)) {
+                afr_eager_lock (frame, this);
+        } else {
 		afr_lock (frame, this);
 	}
 
@@ -93,10 +93,18 @@ init (xlator_t *this)
         char * algo            = NULL;
 	char * change_log      = NULL;
 	char * strict_readdir  = NULL;
+	char * eager_lock      = NULL;
+        char * adaptive_read   = NULL;
+        char * striped_read    = NULL;
+        char * striped_min     = NULL;
+        char * index_heal      = NULL;
+        char * window_bytes    = NULL;
+        char * heal_bandwidth  = NULL;
 
         int32_t background_count  = 0;
 	int32_t lock_server_count = 1;
         int32_t window_size       = 0;
+        int32_t eager_lock_timeout = 0;
 
 	int    fav_ret       = -1;
 	int    read_ret      = -1;
@@ -177,6 +185,36 @@ init (xlator_t *this)
 		priv->data_self_heal_window_size = window_size;
 	}
 
+	dict_ret = dict_get_str (this->options, "data-self-heal-window-bytes",
+				 &window_bytes);
+	if (dict_ret == 0) {
+		ret = gf_string2bytesize (window_bytes,
+					  &priv->data_self_heal_window_bytes);
+		if (ret != 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option data-self-heal-window-bytes %s'. "
+				"Using data-self-heal-window-size instead.",
+				window_bytes);
+			priv->data_self_heal_window_bytes = 0;
+		}
+	}
+
+	dict_ret = dict_get_str (this->options, "data-self-heal-bandwidth",
+				 &heal_bandwidth);
+	if (dict_ret == 0) {
+		ret = gf_string2bytesize (heal_bandwidth,
+					  &priv->data_self_heal_bandwidth);
+		if (ret != 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option data-self-heal-bandwidth %s'. "
+				"Defaulting to unlimited.",
+				heal_bandwidth);
+			priv->data_self_heal_bandwidth = 0;
+		}
+	}
+
+	LOCK_INIT (&priv->sh_throttle_lock);
+
 	dict_ret = dict_get_str (this->options, "metadata-self-heal",
 				 &self_heal);
 	if (dict_ret == 0) {
@@ -304,6 +342,105 @@ init (xlator_t *this)
 		}
 	}
 
+	priv->eager_lock = _gf_false;
+
+	dict_ret = dict_get_str (this->options, "eager-lock", &eager_lock);
+	if (dict_ret == 0) {
+		ret = gf_string2boolean (eager_lock, &priv->eager_lock);
+		if (ret < 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option eager-lock %s'. "
+				"Defaulting to eager-lock as 'off'.",
+				eager_lock);
+			priv->eager_lock = _gf_false;
+		}
+	}
+
+        priv->eager_lock_timeout = 1;
+
+	dict_ret = dict_get_int32 (this->options, "eager-lock-timeout",
+				   &eager_lock_timeout);
+	if (dict_ret == 0) {
+		gf_log (this->name, GF_LOG_DEBUG,
+			"Setting eager lock timeout to %d",
+			eager_lock_timeout);
+
+		priv->eager_lock_timeout = eager_lock_timeout;
+	}
+
+	priv->adaptive_read_child = _gf_false;
+
+	dict_ret = dict_get_str (this->options, "adaptive-read-child",
+				 &adaptive_read);
+	if (dict_ret == 0) {
+		ret = gf_string2boolean (adaptive_read,
+					 &priv->adaptive_read_child);
+		if (ret < 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option adaptive-read-child %s'. "
+				"Defaulting to adaptive-read-child as 'off'.",
+				adaptive_read);
+			priv->adaptive_read_child = _gf_false;
+		}
+	}
+
+	priv->striped_read = _gf_false;
+
+	dict_ret = dict_get_str (this->options, "striped-read",
+				 &striped_read);
+	if (dict_ret == 0) {
+		ret = gf_string2boolean (striped_read, &priv->striped_read);
+		if (ret < 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option striped-read %s'. "
+				"Defaulting to striped-read as 'off'.",
+				striped_read);
+			priv->striped_read = _gf_false;
+		}
+	}
+
+        priv->striped_read_min_size = AFR_STRIPED_READ_MIN_SIZE;
+
+	dict_ret = dict_get_str (this->options, "striped-read-min-size",
+				 &striped_min);
+	if (dict_ret == 0) {
+		ret = gf_string2bytesize (striped_min,
+					  &priv->striped_read_min_size);
+		if (ret != 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option striped-read-min-size %s'. "
+				"Defaulting to %d.",
+				striped_min, AFR_STRIPED_READ_MIN_SIZE);
+			priv->striped_read_min_size = AFR_STRIPED_READ_MIN_SIZE;
+		}
+	}
+
+	priv->index_self_heal = _gf_false;
+
+	dict_ret = dict_get_str (this->options, "index-self-heal",
+				 &index_heal);
+	if (dict_ret == 0) {
+		ret = gf_string2boolean (index_heal, &priv->index_self_heal);
+		if (ret < 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option index-self-heal %s'. "
+				"Defaulting to index-self-heal as 'off'.",
+				index_heal);
+			priv->index_self_heal = _gf_false;
+		}
+	}
+
+        if (priv->index_self_heal) {
+                priv->index_heal_env = syncenv_new (0);
+                if (!priv->index_heal_env) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not create the index self-heal "
+                                "environment");
+                        op_errno = ENOMEM;
+                        goto out;
+                }
+        }
+
 	trav = this->children;
 	while (trav) {
 		if (!read_ret && !strcmp (read_subvol, trav->xlator->name)) {
@@ -350,6 +487,26 @@ init (xlator_t *this)
 		goto out;
 	}
 
+        priv->child_latency = GF_CALLOC (sizeof (*priv->child_latency),
+                                         child_count,
+                                         gf_afr_mt_uint64_t);
+        if (!priv->child_latency) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Out of memory.");
+                op_errno = ENOMEM;
+                goto out;
+        }
+
+        priv->child_inflight = GF_CALLOC (sizeof (*priv->child_inflight),
+                                          child_count,
+                                          gf_afr_mt_int32_t);
+        if (!priv->child_inflight) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Out of memory.");
+                op_errno = ENOMEM;
+                goto out;
+        }
+
         priv->pending_key = GF_CALLOC (sizeof (*priv->pending_key), 
                                         child_count,
                                         gf_afr_mt_char);
@@ -476,7 +633,13 @@ struct volume_options options[] = {
         { .key  = {"data-self-heal-window-size"},
           .type = GF_OPTION_TYPE_INT,
           .min  = 1,
-          .max  = 1024
+          .max  = AFR_SH_MAX_WINDOW
+        },
+        { .key  = {"data-self-heal-window-bytes"},
+          .type = GF_OPTION_TYPE_SIZET,
+        },
+        { .key  = {"data-self-heal-bandwidth"},
+          .type = GF_OPTION_TYPE_SIZET,
         },
 	{ .key  = {"metadata-self-heal"},  
 	  .type = GF_OPTION_TYPE_BOOL
@@ -508,5 +671,26 @@ struct volume_options options[] = {
 	{ .key  = {"strict-readdir"},
 	  .type = GF_OPTION_TYPE_BOOL,
 	},
+	{ .key  = {"eager-lock"},
+	  .type = GF_OPTION_TYPE_BOOL,
+	},
+        { .key  = {"eager-lock-timeout"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 60
+        },
+	{ .key  = {"adaptive-read-child"},
+	  .type = GF_OPTION_TYPE_BOOL,
+	},
+	{ .key  = {"index-self-heal"},
+	  .type = GF_OPTION_TYPE_BOOL,
+	},
+	{ .key  = {"striped-read"},
+	  .type = GF_OPTION_TYPE_BOOL,
+	},
+	{ .key  = {"striped-read-min-size"},
+	  .type = GF_OPTION_TYPE_SIZET,
+	  .min  = AFR_STRIPED_READ_ALIGN,
+	},
 	{ .key  = {NULL} },
 };
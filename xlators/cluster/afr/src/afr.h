@@ -32,6 +32,18 @@
 
 #define AFR_XATTR_PREFIX "trusted.afr"
 
+/* children beyond this are never picked by adaptive-read-child */
+#define AFR_MAX_READABLE_CHILDREN 24
+
+/* chunks of a striped read are multiples of this */
+#define AFR_STRIPED_READ_ALIGN 4096
+
+/* most read/writes a data self-heal keeps in flight on one file */
+#define AFR_SH_MAX_WINDOW 1024
+
+/* default for striped-read-min-size */
+#define AFR_STRIPED_READ_MIN_SIZE (128 * 1024)
+
 struct _pump_private;
 
 typedef struct _afr_private {
@@ -39,7 +51,20 @@ typedef struct _afr_private {
 	unsigned int child_count;     /* total number of children   */
 
         unsigned int read_child_rr;   /* round-robin index of the read_child */
-        gf_lock_t read_child_lock;    /* lock to protect above */
+        gf_lock_t read_child_lock;    /* lock to protect above, and the
+                                         read latency stats below */
+
+        gf_boolean_t adaptive_read_child; /* route reads by latency */
+        uint64_t *child_latency;      /* avg read latency in usecs */
+        int32_t  *child_inflight;     /* reads in flight on each child */
+
+        gf_boolean_t striped_read;    /* split large reads over replicas */
+        uint64_t striped_read_min_size; /* smallest read to split */
+
+        gf_boolean_t index_self_heal;  /* heal from the bricks' indices */
+        struct syncenv *index_heal_env;
+        int index_heal_running;        /* index walks in progress */
+        gf_boolean_t index_heal_again; /* walk again when they finish */
         
 	xlator_t **children;
 
@@ -55,6 +80,13 @@ typedef struct _afr_private {
         char *       data_self_heal_algorithm;    /* name of algorithm */
         unsigned int data_self_heal_window_size;  /* max number of pipelined
                                                      read/writes */
+        uint64_t     data_self_heal_window_bytes; /* same, in bytes; overrides
+                                                     the above if set */
+        uint64_t     data_self_heal_bandwidth;    /* bytes/sec all data
+                                                     self-heals may scan */
+        gf_lock_t    sh_throttle_lock;
+        time_t       sh_throttle_second;  /* second being accounted */
+        uint64_t     sh_throttle_bytes;   /* bytes admitted in it */
 
         unsigned int background_self_heal_count;
         unsigned int background_self_heals_started;
@@ -77,6 +109,10 @@ typedef struct _afr_private {
 
 	unsigned int wait_count;      /* # of servers to wait for success */
 
+        gf_boolean_t eager_lock;         /* keep the data lock held across
+                                            writes on an fd */
+        unsigned int eager_lock_timeout; /* secs an idle fd keeps its lock */
+
         uint64_t up_count;      /* number of CHILD_UPs we have seen */
         uint64_t down_count;    /* number of CHILD_DOWNs we have seen */
 
@@ -203,6 +239,14 @@ afr_index_for_transaction_type (afr_transaction_type type)
 }
 
 
+typedef enum {
+        AFR_EAGER_LOCK_NONE,
+        AFR_EAGER_LOCK_ACQUIRING,     /* write taking the fd's lock */
+        AFR_EAGER_LOCK_SHARED,        /* write using the fd's held lock */
+        AFR_EAGER_LOCK_EXCLUSIVE,     /* flush, ftruncate: unlocks when done */
+} afr_eager_lock_role_t;
+
+
 typedef enum {
         AFR_CHILD_UP_FLUSH,
         AFR_CHILD_DOWN_FLUSH,
@@ -249,6 +293,12 @@ typedef struct _afr_local {
 
         int (*up_down_flush_cbk) (call_frame_t *, xlator_t *);
 
+        struct {
+                gf_boolean_t   timed;
+                int            child;
+                struct timeval start;
+        } read_latency;
+
 	/* 
 	   This struct contains the arguments for the "continuation"
 	   (scheme-like) of fops
@@ -272,6 +322,7 @@ typedef struct _afr_local {
 			dict_t *xattr;
 			dict_t **xattrs;
                         gf_boolean_t is_revalidate;
+                        uint64_t success_children;
 		} lookup;
 
 		struct {
@@ -318,6 +369,9 @@ typedef struct _afr_local {
 			size_t size;
 			off_t offset;
 			int last_tried;
+
+                        struct afr_read_stripe *stripes;
+                        int stripe_count;
 		} readv;
 
 		/* dir read */
@@ -524,6 +578,8 @@ typedef struct _afr_local {
 
 		afr_transaction_type type;
 
+                afr_eager_lock_role_t eager_lock;
+
 		int success_count;
 		int erase_pending;
 		int failure_count;
@@ -549,6 +605,21 @@ typedef struct _afr_local {
 } afr_local_t;
 
 
+/* one chunk of a striped read */
+typedef struct afr_read_stripe {
+        int            child;
+        off_t          offset;
+        size_t         size;
+
+        int32_t        op_ret;
+        int32_t        op_errno;
+        struct iovec  *vector;
+        int32_t        count;
+        struct iobref *iobref;
+        struct iatt    buf;
+} afr_read_stripe_t;
+
+
 typedef struct {
         unsigned char *pre_op_done;
         unsigned char *opened_on;     /* which subvolumes the fd is open on */
@@ -561,9 +632,25 @@ typedef struct {
         int32_t last_tried;
         gf_boolean_t failed_over;
         struct list_head entries; /* needed for readdir failover */
+
+        /* eager locking of data transactions */
+        unsigned char *eager_locked_on; /* children the lock is held on */
+        gf_boolean_t eager_lock_held;
+        gf_boolean_t eager_lock_busy;      /* being acquired by a write */
+        gf_boolean_t eager_lock_exclusive; /* owned by a flush or ftruncate */
+        int eager_lock_users;              /* writes using the lock */
+        gf_boolean_t eager_lock_timer_armed;
+        struct timeval eager_lock_last_used;
+        struct list_head eager_lock_waiters;
 } afr_fd_ctx_t;
 
 
+typedef struct {
+        struct list_head list;
+        call_frame_t *frame;
+} afr_eager_lock_waiter_t;
+
+
 /* try alloc and if it fails, goto label */
 #define ALLOC_OR_GOTO(var, type, label) do {                     \
 		var = GF_CALLOC (sizeof (type), 1,               \
@@ -629,6 +716,24 @@ afr_local_cleanup (afr_local_t *local, xlator_t *this);
 int
 afr_frame_return (call_frame_t *frame);
 
+uint64_t
+afr_readable_children (xlator_t *this, inode_t *inode);
+
+void
+afr_set_readable_children (xlator_t *this, inode_t *inode, uint64_t readable);
+
+void
+afr_unset_readable_child (xlator_t *this, inode_t *inode, int child_index);
+
+int
+afr_read_child_select (xlator_t *this, inode_t *inode);
+
+void
+afr_read_latency_begin (xlator_t *this, afr_local_t *local, int child_index);
+
+void
+afr_read_latency_end (xlator_t *this, afr_local_t *local, int32_t op_ret);
+
 uint64_t
 afr_is_split_brain (xlator_t *this, inode_t *inode);
 
@@ -34,6 +34,9 @@ enum gf_stripe_mem_types_ {
         gf_stripe_mt_xlator_t,
         gf_stripe_mt_stripe_private_t,
         gf_stripe_mt_stripe_options,
+        gf_stripe_mt_stripe_extent,
+        gf_stripe_mt_stripe_run,
+        gf_stripe_mt_int32_t,
         gf_stripe_mt_end
 };
 #endif
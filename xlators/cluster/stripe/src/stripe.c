@@ -49,6 +49,100 @@ out:
         return;
 }
 
+/**
+ * stripe_child_index - index of @child in the stripe, -1 if it is none
+ *        of ours.
+ */
+static int32_t
+stripe_child_index (xlator_t *this, xlator_t *child)
+{
+        stripe_private_t *priv = NULL;
+        int32_t           i = 0;
+
+        priv = this->private;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (priv->xl_array[i] == child)
+                        return i;
+        }
+
+        return -1;
+}
+
+
+/**
+ * stripe_inode_dense_size - the stripe size of @inode if its children hold
+ *        it in the dense layout, 0 if they hold it sparse.
+ */
+static uint64_t
+stripe_inode_dense_size (xlator_t *this, inode_t *inode)
+{
+        uint64_t dense_size = 0;
+
+        if (inode)
+                inode_ctx_get (inode, this, &dense_size);
+
+        return dense_size;
+}
+
+
+/**
+ * stripe_logical_size - how far into the file the @child_size bytes that
+ *        @child holds of it go. In the dense layout a child keeps its
+ *        pieces back to back, in the sparse one at their offsets in the
+ *        file.
+ */
+static off_t
+stripe_logical_size (xlator_t *this, xlator_t *child, uint64_t dense_size,
+                     off_t child_size)
+{
+        stripe_private_t *priv = NULL;
+        int32_t           index = 0;
+        off_t             stripe_size = dense_size;
+        off_t             last = 0;
+
+        priv = this->private;
+
+        if (!stripe_size || !child_size)
+                return child_size;
+
+        index = stripe_child_index (this, child);
+        if (index < 0)
+                return child_size;
+
+        last = child_size - 1;
+
+        return (((last / stripe_size) * priv->child_count + index) *
+                stripe_size) + (last % stripe_size) + 1;
+}
+
+
+/**
+ * stripe_child_size - how many bytes of a dense file @size bytes long the
+ *        child at @index holds.
+ */
+static off_t
+stripe_child_size (xlator_t *this, int32_t index, uint64_t dense_size,
+                   off_t size)
+{
+        stripe_private_t *priv = NULL;
+        off_t             stripe_size = dense_size;
+        off_t             round = 0;
+        off_t             tail = 0;
+
+        priv = this->private;
+
+        if (!stripe_size)
+                return size;
+
+        round = stripe_size * priv->child_count;
+        tail  = (size % round) - (index * stripe_size);
+
+        return ((size / round) * stripe_size) +
+                max (min (tail, stripe_size), 0);
+}
+
+
 /**
  * stripe_get_matching_bs - Get the matching block size for the given path.
  */
@@ -206,6 +300,8 @@ stripe_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         inode_t        *tmp_inode = NULL;
         stripe_local_t *local = NULL;
         call_frame_t   *prev = NULL;
+        uint64_t        dense_size = 0;
+        char            key[256] = {0,};
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
@@ -237,6 +333,19 @@ stripe_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 if (op_ret >= 0) {
                         local->op_ret = 0;
 
+                        sprintf (key, "trusted.%s.stripe-layout", this->name);
+                        if (dict && dict_get (dict, key)
+                            && (data_to_int32 (dict_get (dict, key))
+                                == STRIPE_LAYOUT_DENSE)) {
+                                sprintf (key, "trusted.%s.stripe-size",
+                                         this->name);
+                                if (dict_get (dict, key))
+                                        dense_size =
+                                                data_to_int64 (dict_get (dict,
+                                                                         key));
+                                local->dense_stripe_size = dense_size;
+                        }
+
                         if (FIRST_CHILD(this) == prev->this) {
                                 local->stbuf      = *buf;
                                 local->postparent = *postparent;
@@ -246,8 +355,13 @@ stripe_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         local->stbuf_blocks      += buf->ia_blocks;
                         local->postparent_blocks += postparent->ia_blocks;
 
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
+                        if (local->stbuf_size <
+                            stripe_logical_size (this, prev->this, dense_size,
+                                                 buf->ia_size))
+                                local->stbuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             dense_size,
+                                                             buf->ia_size);
                         if (local->postparent_size < postparent->ia_size)
                                 local->postparent_size = postparent->ia_size;
                 }
@@ -264,6 +378,10 @@ stripe_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 tmp_dict  = local->dict;
                 tmp_inode = local->inode;
 
+                if ((local->op_ret != -1) && local->dense_stripe_size)
+                        inode_ctx_put (local->inode, this,
+                                       local->dense_stripe_size);
+
                 if (local->op_ret != -1) {
                         local->stbuf.ia_blocks      = local->stbuf_blocks;
                         local->stbuf.ia_size        = local->stbuf_size;
@@ -294,6 +412,7 @@ stripe_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
         xlator_list_t    *trav = NULL;
         stripe_private_t *priv = NULL;
         int32_t           op_errno = EINVAL;
+        char              key[256] = {0,};
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
@@ -318,6 +437,28 @@ stripe_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
         /* Everytime in stripe lookup, all child nodes
            should be looked up */
         local->call_count = priv->child_count;
+
+        /* find out how the file is laid out on the children */
+        if (priv->xattr_supported) {
+                if (xattr_req)
+                        xattr_req = dict_ref (xattr_req);
+                else
+                        xattr_req = dict_new ();
+
+                if (xattr_req) {
+                        sprintf (key, "trusted.%s.stripe-size", this->name);
+                        if (dict_set_int64 (xattr_req, key, 0))
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "%s: could not ask for the layout",
+                                        loc->path);
+                        sprintf (key, "trusted.%s.stripe-layout", this->name);
+                        if (dict_set_int32 (xattr_req, key, 0))
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "%s: could not ask for the layout",
+                                        loc->path);
+                }
+        }
+
         while (trav) {
                 STACK_WIND (frame, stripe_lookup_cbk, trav->xlator,
                             trav->xlator->fops->lookup,
@@ -325,6 +466,9 @@ stripe_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 trav = trav->next;
         }
 
+        if (priv->xattr_supported && xattr_req)
+                dict_unref (xattr_req);
+
         return 0;
 err:
         STACK_UNWIND_STRICT (lookup, frame, -1, op_errno, NULL, NULL, NULL, NULL);
@@ -369,8 +513,14 @@ stripe_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         }
 
                         local->stbuf_blocks += buf->ia_blocks;
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
+                        if (local->stbuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 buf->ia_size))
+                                local->stbuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             buf->ia_size);
                 }
         }
         UNLOCK (&frame->lock);
@@ -424,6 +574,8 @@ stripe_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
         local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
+        local->dense_stripe_size =
+                stripe_inode_dense_size (this, loc->inode);
 
         while (trav) {
                 STACK_WIND (frame, stripe_stat_cbk, trav->xlator,
@@ -567,11 +719,23 @@ stripe_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         local->prebuf_blocks  += prebuf->ia_blocks;
                         local->postbuf_blocks += postbuf->ia_blocks;
 
-                        if (local->prebuf_size < prebuf->ia_size)
-                                local->prebuf_size = prebuf->ia_size;
-
-                        if (local->postbuf_size < postbuf->ia_size)
-                                local->postbuf_size = postbuf->ia_size;
+                        if (local->prebuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 prebuf->ia_size))
+                                local->prebuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             prebuf->ia_size);
+
+                        if (local->postbuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 postbuf->ia_size))
+                                local->postbuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             postbuf->ia_size);
                 }
         }
         UNLOCK (&frame->lock);
@@ -600,6 +764,7 @@ int32_t
 stripe_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
 {
         xlator_list_t    *trav = NULL;
+        int32_t           index = 0;
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
         int32_t           op_errno = EINVAL;
@@ -628,10 +793,17 @@ stripe_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
         local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
+        local->dense_stripe_size =
+                stripe_inode_dense_size (this, loc->inode);
 
+        /* a dense file is shorter on each child than it is */
         while (trav) {
                 STACK_WIND (frame, stripe_truncate_cbk, trav->xlator,
-                            trav->xlator->fops->truncate, loc, offset);
+                            trav->xlator->fops->truncate, loc,
+                            stripe_child_size (this, index,
+                                               local->dense_stripe_size,
+                                               offset));
+                index++;
                 trav = trav->next;
         }
 
@@ -684,10 +856,22 @@ stripe_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         local->prebuf_blocks  += preop->ia_blocks;
                         local->postbuf_blocks += postop->ia_blocks;
 
-                        if (local->prebuf_size < preop->ia_size)
-                                local->prebuf_size = preop->ia_size;
-                        if (local->postbuf_size < postop->ia_size)
-                                local->postbuf_size = postop->ia_size;
+                        if (local->prebuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 preop->ia_size))
+                                local->prebuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             preop->ia_size);
+                        if (local->postbuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 postop->ia_size))
+                                local->postbuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             postop->ia_size);
                 }
         }
         UNLOCK (&frame->lock);
@@ -746,6 +930,8 @@ stripe_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
         local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
+        local->dense_stripe_size =
+                stripe_inode_dense_size (this, loc->inode);
 
         while (trav) {
                 STACK_WIND (frame, stripe_setattr_cbk,
@@ -788,6 +974,8 @@ stripe_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
         local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
+        local->dense_stripe_size =
+                stripe_inode_dense_size (this, fd->inode);
 
         while (trav) {
                 STACK_WIND (frame, stripe_setattr_cbk, trav->xlator,
@@ -1353,6 +1541,7 @@ stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         char     size_key[256]  = {0,};
                         char     index_key[256] = {0,};
                         char     count_key[256] = {0,};
+                        char     layout_key[256] = {0,};
                         dict_t  *dict           = NULL;
 
                         sprintf (size_key,
@@ -1361,6 +1550,12 @@ stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                  "trusted.%s.stripe-count", this->name);
                         sprintf (index_key,
                                  "trusted.%s.stripe-index", this->name);
+                        sprintf (layout_key,
+                                 "trusted.%s.stripe-layout", this->name);
+
+                        if (priv->dense_layout && local->stripe_size)
+                                inode_ctx_put (local->inode, this,
+                                               local->stripe_size);
 
                         local->call_count = priv->child_count;
 
@@ -1390,6 +1585,14 @@ stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                         gf_log (this->name, GF_LOG_ERROR,
                                                 "%s: set stripe-index failed",
                                                 local->loc.path);
+                                ret = dict_set_int32 (dict, layout_key,
+                                                      (priv->dense_layout ?
+                                                       STRIPE_LAYOUT_DENSE :
+                                                       STRIPE_LAYOUT_SPARSE));
+                                if (ret)
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "%s: set stripe-layout failed",
+                                                local->loc.path);
 
                                 STACK_WIND (frame,
                                             stripe_mknod_ifreg_setxattr_cbk,
@@ -1961,6 +2164,9 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         fctx->stripe_size  = local->stripe_size;
                         fctx->stripe_count = priv->child_count;
                         fctx->static_array = 1;
+                        fctx->dense = (priv->dense_layout &&
+                                       local->stripe_size &&
+                                       priv->xattr_supported);
                         fctx->xl_array = priv->xl_array;
                         fd_ctx_set (local->fd, this,
                                     (uint64_t)(long)fctx);
@@ -1974,6 +2180,7 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         char           size_key[256] = {0,};
                         char           index_key[256] = {0,};
                         char           count_key[256] = {0,};
+                        char           layout_key[256] = {0,};
                         dict_t        *dict = NULL;
 
                         sprintf (size_key,
@@ -1982,6 +2189,12 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                  "trusted.%s.stripe-count", this->name);
                         sprintf (index_key,
                                  "trusted.%s.stripe-index", this->name);
+                        sprintf (layout_key,
+                                 "trusted.%s.stripe-layout", this->name);
+
+                        if (priv->dense_layout && local->stripe_size)
+                                inode_ctx_put (local->inode, this,
+                                               local->stripe_size);
 
                         local->call_count = priv->child_count;
 
@@ -2014,6 +2227,15 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                                 "%s: set stripe-size failed",
                                                 local->loc.path);
 
+                                ret = dict_set_int32 (dict, layout_key,
+                                                      (priv->dense_layout ?
+                                                       STRIPE_LAYOUT_DENSE :
+                                                       STRIPE_LAYOUT_SPARSE));
+                                if (ret)
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "%s: set stripe-layout failed",
+                                                local->loc.path);
+
                                 STACK_WIND (frame, stripe_create_setxattr_cbk,
                                             priv->xl_array[i],
                                             priv->xl_array[i]->fops->setxattr,
@@ -2250,6 +2472,12 @@ stripe_open_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                 local->xattr_self_heal_needed = 1;
                         }
                 }
+                /* Layout; files from before there was one are sparse */
+                sprintf (key, "trusted.%s.stripe-layout", this->name);
+                data = dict_get (dict, key);
+                if (data && (data_to_int32 (data) == STRIPE_LAYOUT_DENSE))
+                        local->fctx->dense = 1;
+
                 /* Stripe count */
                 sprintf (key, "trusted.%s.stripe-count", this->name);
                 data = dict_get (dict, key);
@@ -2346,6 +2574,10 @@ unlock:
                         goto err;
                 }
 
+                if (local->fctx->dense)
+                        inode_ctx_put (local->fd->inode, this,
+                                       local->fctx->stripe_size);
+
                 local->call_count = local->fctx->stripe_count;
 
                 trav = this->children;
@@ -2763,11 +2995,23 @@ stripe_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         local->prebuf_blocks  += prebuf->ia_blocks;
                         local->postbuf_blocks += postbuf->ia_blocks;
 
-                        if (local->prebuf_size < prebuf->ia_size)
-                                local->prebuf_size = prebuf->ia_size;
-
-                        if (local->postbuf_size < postbuf->ia_size)
-                                local->postbuf_size = postbuf->ia_size;
+                        if (local->prebuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 prebuf->ia_size))
+                                local->prebuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             prebuf->ia_size);
+
+                        if (local->postbuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 postbuf->ia_size))
+                                local->postbuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             postbuf->ia_size);
                 }
         }
         UNLOCK (&frame->lock);
@@ -2818,6 +3062,8 @@ stripe_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t flags)
         local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
+        local->dense_stripe_size =
+                stripe_inode_dense_size (this, fd->inode);
 
         while (trav) {
                 STACK_WIND (frame, stripe_fsync_cbk, trav->xlator,
@@ -2868,8 +3114,14 @@ stripe_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                 local->stbuf = *buf;
 
                         local->stbuf_blocks += buf->ia_blocks;
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
+                        if (local->stbuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 buf->ia_size))
+                                local->stbuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             buf->ia_size);
                 }
         }
         UNLOCK (&frame->lock);
@@ -2920,6 +3172,8 @@ stripe_fstat (call_frame_t *frame,
         local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
+        local->dense_stripe_size =
+                stripe_inode_dense_size (this, fd->inode);
 
         while (trav) {
                 STACK_WIND (frame, stripe_fstat_cbk, trav->xlator,
@@ -2940,6 +3194,7 @@ stripe_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
         xlator_list_t    *trav = NULL;
+        int32_t           index = 0;
         int32_t           op_errno = 1;
 
         VALIDATE_OR_GOTO (frame, err);
@@ -2960,10 +3215,17 @@ stripe_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
         local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
+        local->dense_stripe_size =
+                stripe_inode_dense_size (this, fd->inode);
 
+        /* a dense file is shorter on each child than it is */
         while (trav) {
                 STACK_WIND (frame, stripe_truncate_cbk, trav->xlator,
-                            trav->xlator->fops->ftruncate, fd, offset);
+                            trav->xlator->fops->ftruncate, fd,
+                            stripe_child_size (this, index,
+                                               local->dense_stripe_size,
+                                               offset));
+                index++;
                 trav = trav->next;
         }
 
@@ -3060,96 +3322,277 @@ err:
 }
 
 
-int32_t
-stripe_readv_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                        int32_t op_ret, int32_t op_errno, struct iatt *buf)
+/**
+ * stripe_child_offset - where the byte at @offset of the file is kept in
+ *        the file on its child. In the sparse layout each child keeps its
+ *        pieces at their offsets in the file, with holes where the other
+ *        children's are; in the dense one it keeps them back to back.
+ */
+static off_t
+stripe_child_offset (stripe_fd_ctx_t *fctx, off_t offset)
 {
-        int32_t         i = 0;
-        int32_t         callcnt = 0;
-        int32_t         count = 0;
-        stripe_local_t *local = NULL;
-        struct iovec   *vec = NULL;
-        struct iatt     tmp_stbuf = {0,};
-        struct iobref  *tmp_iobref = NULL;
-        struct iobuf   *iobuf = NULL;
+        off_t round = 0;
 
-        if (!this || !frame || !frame->local) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
+        if (!fctx->dense)
+                return offset;
 
-        local = frame->local;
+        round = fctx->stripe_size * fctx->stripe_count;
 
-        LOCK (&frame->lock);
-        {
-                callcnt = --local->call_count;
-                if (op_ret != -1)
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
+        return ((offset / round) * fctx->stripe_size) +
+                (offset % fctx->stripe_size);
+}
+
+
+/**
+ * stripe_map_extents - split the @size bytes at @offset into pieces that
+ *        lie on a single child, and gather the pieces that are adjacent
+ *        in the file on their child into runs. Each run is sent to its
+ *        child as a single readv/writev. Returns the number of runs, or
+ *        -1 if out of memory.
+ */
+static int32_t
+stripe_map_extents (stripe_fd_ctx_t *fctx, off_t offset, size_t size,
+                    struct stripe_extent **extents_p, int32_t *extent_count_p,
+                    struct stripe_run **runs_p)
+{
+        struct stripe_extent *extents = NULL;
+        struct stripe_run    *runs = NULL;
+        struct stripe_run    *run = NULL;
+        int32_t              *last_run = NULL;
+        int32_t               extent_count = 0;
+        int32_t               run_count = 0;
+        int32_t               child = 0;
+        int32_t               i = 0;
+        off_t                 stripe_size = 0;
+        off_t                 child_offset = 0;
+        off_t                 end = 0;
+        size_t                piece = 0;
+
+        stripe_size  = fctx->stripe_size;
+        end          = offset + size;
+        extent_count = (roof (end, stripe_size) -
+                        floor (offset, stripe_size)) / stripe_size;
+        if (!extent_count)
+                extent_count = 1;
+
+        extents = GF_CALLOC (extent_count, sizeof (*extents),
+                             gf_stripe_mt_stripe_extent);
+        runs = GF_CALLOC (extent_count, sizeof (*runs),
+                          gf_stripe_mt_stripe_run);
+        if (!extents || !runs) {
+                if (extents)
+                        GF_FREE (extents);
+                if (runs)
+                        GF_FREE (runs);
+                return -1;
+        }
+
+        /* the run each child's last piece went into */
+        last_run = alloca (fctx->stripe_count * sizeof (*last_run));
+        for (i = 0; i < fctx->stripe_count; i++)
+                last_run[i] = -1;
+
+        for (i = 0; i < extent_count; i++) {
+                piece = min (roof (offset + 1, stripe_size), end) - offset;
+                child = (offset / stripe_size) % fctx->stripe_count;
+                child_offset = stripe_child_offset (fctx, offset);
+
+                run = NULL;
+                if (last_run[child] != -1) {
+                        run = &runs[last_run[child]];
+                        if ((run->offset + run->size) != child_offset)
+                                run = NULL;
+                }
+
+                if (!run) {
+                        last_run[child] = run_count;
+                        run = &runs[run_count++];
+                        run->child  = child;
+                        run->offset = child_offset;
+                }
+
+                extents[i].offset     = offset;
+                extents[i].size       = piece;
+                extents[i].run        = last_run[child];
+                extents[i].run_offset = run->size;
+
+                run->size += piece;
+                offset    += piece;
         }
-        UNLOCK (&frame->lock);
 
-        if (!callcnt) {
-                op_ret = 0;
+        *extents_p      = extents;
+        *extent_count_p = extent_count;
+        *runs_p         = runs;
+
+        return run_count;
+}
 
-                /* Keep extra space for filling in '\0's */
-                vec = GF_CALLOC ((local->count * 2), sizeof (struct iovec),
-                                 gf_stripe_mt_iovec);
-                if (!vec) {
-                        op_ret = -1;
+
+/**
+ * stripe_readv_unwind - put the pieces read back in file order, and send
+ *        them up in a single vector. A piece that came back short is a
+ *        hole if the file goes on beyond it (local->stbuf_size has been
+ *        fetched by then), and the end of the file otherwise.
+ */
+static int32_t
+stripe_readv_unwind (call_frame_t *frame, xlator_t *this)
+{
+        int32_t               i = 0;
+        int32_t               count = 0;
+        int32_t               max_count = 0;
+        int32_t               op_ret = 0;
+        int32_t               op_errno = 0;
+        size_t                page_size = 0;
+        off_t                 avail = 0;
+        off_t                 want = 0;
+        off_t                 fill = 0;
+        stripe_local_t       *local = NULL;
+        struct stripe_extent *extent = NULL;
+        struct readv_replies *reply = NULL;
+        struct iovec         *vec = NULL;
+        struct iobuf         *zero_iobuf = NULL;
+        struct iatt           tmp_stbuf = {0,};
+        struct iobref        *tmp_iobref = NULL;
+
+        local     = frame->local;
+        page_size = this->ctx->page_size;
+
+        for (i = 0; i < local->wind_count; i++) {
+                if (local->replies[i].op_ret == -1) {
+                        op_ret   = -1;
+                        op_errno = local->replies[i].op_errno;
                         goto done;
                 }
+                max_count += local->replies[i].count;
+        }
 
-                for (i = 0; i < local->wind_count; i++) {
-                        if (local->replies[i].op_ret) {
-                                memcpy ((vec + count), local->replies[i].vector,
-                                        (local->replies[i].count * sizeof (struct iovec)));
-                                count +=  local->replies[i].count;
-                                op_ret += local->replies[i].op_ret;
-                        }
-                        if ((local->replies[i].op_ret <
-                             local->replies[i].requested_size) &&
-                            (local->stbuf_size > (local->offset + op_ret))) {
-                                /* Fill in 0s here */
-                                vec[count].iov_len  =
-                                        (local->replies[i].requested_size -
-                                         local->replies[i].op_ret);
-                                iobuf = iobuf_get (this->ctx->iobuf_pool);
-                                if (!iobuf) {
+        /* room for the zeroes of the holes too */
+        for (i = 0; i < local->extent_count; i++)
+                max_count += (local->extents[i].size / page_size) + 1;
+
+        vec = GF_CALLOC (max_count, sizeof (struct iovec), gf_stripe_mt_iovec);
+        if (!vec) {
+                op_ret   = -1;
+                op_errno = ENOMEM;
+                goto done;
+        }
+
+        for (i = 0; i < local->extent_count; i++) {
+                extent = &local->extents[i];
+                reply  = &local->replies[extent->run];
+
+                avail = reply->op_ret - (off_t) extent->run_offset;
+                if (avail < 0)
+                        avail = 0;
+                if (avail > extent->size)
+                        avail = extent->size;
+
+                if (avail) {
+                        count += iov_subset (reply->vector, reply->count,
+                                             extent->run_offset,
+                                             extent->run_offset + avail,
+                                             vec + count);
+                        op_ret += avail;
+                }
+
+                if (avail == extent->size)
+                        continue;
+
+                want = extent->size;
+                if (local->stbuf_size < (extent->offset + want))
+                        want = max (local->stbuf_size - extent->offset, 0);
+
+                for (fill = want - avail; fill > 0; fill -= page_size) {
+                        if (!zero_iobuf) {
+                                zero_iobuf = iobuf_get (this->ctx->iobuf_pool);
+                                if (!zero_iobuf) {
                                         gf_log (this->name, GF_LOG_ERROR,
                                                 "Out of memory.");
-                                        op_ret = -1;
+                                        op_ret   = -1;
                                         op_errno = ENOMEM;
                                         goto done;
                                 }
-                                memset (iobuf->ptr, 0, vec[count].iov_len);
-                                iobref_add (local->iobref, iobuf);
-                                vec[count].iov_base = iobuf->ptr;
-
-                                op_ret += vec[count].iov_len;
-                                count++;
+                                memset (zero_iobuf->ptr, 0, page_size);
+                                iobref_add (local->iobref, zero_iobuf);
                         }
-                        GF_FREE (local->replies[i].vector);
+
+                        vec[count].iov_base = zero_iobuf->ptr;
+                        vec[count].iov_len  = min (fill, (off_t) page_size);
+                        op_ret += vec[count].iov_len;
+                        count++;
                 }
 
-                /* FIXME: notice that st_ino, and st_dev (gen) will be
-                 * different than what inode will have. Make sure this doesn't
-                 * cause any bugs at higher levels */
-                memcpy (&tmp_stbuf, &local->replies[0].stbuf,
-                        sizeof (struct iatt));
+                if (want < extent->size)
+                        break;
+        }
+
+        /* FIXME: notice that st_ino, and st_dev (gen) will be
+         * different than what inode will have. Make sure this doesn't
+         * cause any bugs at higher levels */
+        memcpy (&tmp_stbuf, &local->replies[0].stbuf, sizeof (struct iatt));
+        if (local->stbuf_size)
                 tmp_stbuf.ia_size = local->stbuf_size;
 
-        done:
-                GF_FREE (local->replies);
-                tmp_iobref = local->iobref;
-                fd_unref (local->fd);
-                STACK_UNWIND_STRICT (readv, frame, op_ret, op_errno, vec,
-                                     count, &tmp_stbuf, tmp_iobref);
+done:
+        for (i = 0; i < local->wind_count; i++) {
+                if (local->replies[i].vector)
+                        GF_FREE (local->replies[i].vector);
+        }
+        GF_FREE (local->replies);
+        GF_FREE (local->extents);
+
+        if (zero_iobuf)
+                iobuf_unref (zero_iobuf);
+
+        if (op_ret == -1)
+                count = 0;
 
+        tmp_iobref = local->iobref;
+        fd_unref (local->fd);
+        STACK_UNWIND_STRICT (readv, frame, op_ret, op_errno, vec, count,
+                             &tmp_stbuf, tmp_iobref);
+
+        if (tmp_iobref)
                 iobref_unref (tmp_iobref);
-                if (vec)
-                        GF_FREE (vec);
+        if (vec)
+                GF_FREE (vec);
+
+        return 0;
+}
+
+
+int32_t
+stripe_readv_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, struct iatt *buf)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t *local = NULL;
+        call_frame_t   *prev = NULL;
+        off_t           size = 0;
+
+        if (!this || !frame || !frame->local) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+                if (op_ret != -1) {
+                        size = stripe_logical_size (this, prev->this,
+                                                    local->dense_stripe_size,
+                                                    buf->ia_size);
+                        if (local->stbuf_size < size)
+                                local->stbuf_size = size;
+                }
         }
+        UNLOCK (&frame->lock);
+
+        if (!callcnt)
+                stripe_readv_unwind (frame, this);
 out:
         return 0;
 }
@@ -3163,130 +3606,71 @@ stripe_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                   int32_t op_ret, int32_t op_errno, struct iovec *vector,
                   int32_t count, struct iatt *stbuf, struct iobref *iobref)
 {
-        int32_t         index = 0;
-        int32_t         callcnt = 0;
-        int32_t         final_count = 0;
-        int32_t         need_to_check_proper_size = 0;
-        call_frame_t   *mframe = NULL;
-        stripe_local_t *mlocal = NULL;
-        stripe_local_t *local = NULL;
-        struct iovec   *final_vec = NULL;
-        struct iatt     tmp_stbuf = {0,};
-        struct iobref  *tmp_iobref = NULL;
-        stripe_fd_ctx_t  *fctx = NULL;
+        int32_t               i = 0;
+        int32_t               run = 0;
+        int32_t               callcnt = 0;
+        int32_t               need_to_check_proper_size = 0;
+        stripe_local_t       *local = NULL;
+        struct stripe_extent *extent = NULL;
+        stripe_fd_ctx_t      *fctx = NULL;
 
-        if (!this || !frame || !frame->local || !cookie) {
+        if (!this || !frame || !frame->local) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto end;
-        }
-
-        local  = frame->local;
-        index  = local->node_index;
-        mframe = local->orig_frame;
-        if (!mframe)
-                goto out;
-
-        mlocal = mframe->local;
-        if (!mlocal)
                 goto out;
+        }
 
-        fctx = mlocal->fctx;
+        local = frame->local;
+        run   = (long) cookie;
+        fctx  = local->fctx;
 
-        LOCK (&mframe->lock);
+        LOCK (&frame->lock);
         {
-                mlocal->replies[index].op_ret = op_ret;
-                mlocal->replies[index].op_errno = op_errno;
-                mlocal->replies[index].requested_size = local->readv_size;
+                local->replies[run].op_ret = op_ret;
+                local->replies[run].op_errno = op_errno;
                 if (op_ret >= 0) {
-                        mlocal->replies[index].stbuf  = *stbuf;
-                        mlocal->replies[index].count  = count;
-                        mlocal->replies[index].vector = iov_dup (vector, count);
+                        local->replies[run].stbuf  = *stbuf;
+                        local->replies[run].count  = count;
+                        local->replies[run].vector = iov_dup (vector, count);
 
-                        if (!mlocal->iobref)
-                                mlocal->iobref = iobref_new ();
-                        iobref_merge (mlocal->iobref, iobref);
+                        if (!local->iobref)
+                                local->iobref = iobref_new ();
+                        iobref_merge (local->iobref, iobref);
                 }
-                callcnt = ++mlocal->call_count;
+                callcnt = ++local->call_count;
         }
-        UNLOCK(&mframe->lock);
-
-        if (callcnt == mlocal->wind_count) {
-                op_ret = 0;
-
-                for (index=0; index < mlocal->wind_count; index++) {
-                        /* check whether each stripe returned
-                         * 'expected' number of bytes */
-                        if (mlocal->replies[index].op_ret == -1) {
-                                op_ret = -1;
-                                op_errno = mlocal->replies[index].op_errno;
-                                break;
-                        }
-                        /* TODO: handle the 'holes' within the read range
-                           properly */
-                        if (mlocal->replies[index].op_ret <
-                            mlocal->replies[index].requested_size) {
-                                need_to_check_proper_size = 1;
-                        }
-
-                        op_ret       += mlocal->replies[index].op_ret;
-                        mlocal->count += mlocal->replies[index].count;
-                }
-                if (op_ret == -1)
-                        goto done;
-                if (need_to_check_proper_size)
-                        goto check_size;
+        UNLOCK (&frame->lock);
 
-                final_vec = GF_CALLOC (mlocal->count, sizeof (struct iovec),
-                                       gf_stripe_mt_iovec);
+        if (callcnt != local->wind_count)
+                goto out;
 
-                if (!final_vec) {
-                        op_ret = -1;
-                        goto done;
-                }
+        for (i = 0; i < local->extent_count; i++) {
+                extent = &local->extents[i];
+                if (local->replies[extent->run].op_ret == -1)
+                        break;
 
-                for (index = 0; index < mlocal->wind_count; index++) {
-                        memcpy ((final_vec + final_count),
-                                mlocal->replies[index].vector,
-                                (mlocal->replies[index].count *
-                                 sizeof (struct iovec)));
-                        final_count +=  mlocal->replies[index].count;
-                        GF_FREE (mlocal->replies[index].vector);
+                /* a hole, or the end of the file? */
+                if (local->replies[extent->run].op_ret <
+                    (extent->run_offset + extent->size)) {
+                        need_to_check_proper_size = 1;
+                        break;
                 }
-
-                /* FIXME: notice that st_ino, and st_dev (gen) will be
-                 * different than what inode will have. Make sure this doesn't
-                 * cause any bugs at higher levels */
-                memcpy (&tmp_stbuf, &mlocal->replies[0].stbuf,
-                        sizeof (struct iatt));
-
-        done:
-                /* */
-                GF_FREE (mlocal->replies);
-                tmp_iobref = mlocal->iobref;
-                fd_unref (mlocal->fd);
-                STACK_UNWIND_STRICT (readv, mframe, op_ret, op_errno, final_vec,
-                                     final_count, &tmp_stbuf, tmp_iobref);
-
-                iobref_unref (tmp_iobref);
-                if (final_vec)
-                        GF_FREE (final_vec);
         }
 
-        goto out;
+        if (!need_to_check_proper_size) {
+                stripe_readv_unwind (frame, this);
+                goto out;
+        }
 
-check_size:
-        mlocal->call_count = fctx->stripe_count;
+        local->call_count = fctx->stripe_count;
 
-        for (index = 0; index < fctx->stripe_count; index++) {
-                STACK_WIND (mframe, stripe_readv_fstat_cbk,
-                            (fctx->xl_array[index]),
-                            (fctx->xl_array[index])->fops->fstat,
-                            mlocal->fd);
+        for (i = 0; i < fctx->stripe_count; i++) {
+                STACK_WIND (frame, stripe_readv_fstat_cbk,
+                            (fctx->xl_array[i]),
+                            (fctx->xl_array[i])->fops->fstat,
+                            local->fd);
         }
 
 out:
-        STACK_DESTROY (frame->root);
-end:
         return 0;
 }
 
@@ -3297,19 +3681,12 @@ stripe_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
 {
         int32_t           op_errno = EINVAL;
         int32_t           idx = 0;
-        int32_t           index = 0;
-        int32_t           num_stripe = 0;
-        int32_t           off_index = 0;
-        size_t            frame_size = 0;
-        off_t             rounded_end = 0;
+        int32_t           run_count = 0;
         uint64_t          tmp_fctx = 0;
         uint64_t          stripe_size = 0;
-        off_t             rounded_start = 0;
-        off_t             frame_offset = offset;
         stripe_local_t   *local = NULL;
-        call_frame_t     *rframe = NULL;
-        stripe_local_t   *rlocal = NULL;
         stripe_fd_ctx_t  *fctx = NULL;
+        struct stripe_run *runs = NULL;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
@@ -3329,14 +3706,6 @@ stripe_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
                         "Wrong stripe size for the file");
                 goto err;
         }
-        /* The file is stripe across the child nodes. Send the read request
-         * to the child nodes appropriately after checking which region of
-         * the file is in which child node. Always '0-<stripe_size>' part of
-         * the file resides in the first child.
-         */
-        rounded_start = floor (offset, stripe_size);
-        rounded_end = roof (offset+size, stripe_size);
-        num_stripe = (rounded_end- rounded_start)/stripe_size;
 
         local = GF_CALLOC (1, sizeof (stripe_local_t),
                            gf_stripe_mt_stripe_local_t);
@@ -3346,50 +3715,52 @@ stripe_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
         }
         frame->local = local;
 
+        /* The file is stripe across the child nodes. Send the read request
+         * to the child nodes appropriately after checking which region of
+         * the file is in which child node. Always '0-<stripe_size>' part of
+         * the file resides in the first child. All the pieces a child
+         * holds back to back are read in one go.
+         */
+        run_count = stripe_map_extents (fctx, offset, size, &local->extents,
+                                        &local->extent_count, &runs);
+        if (run_count == -1) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
         /* This is where all the vectors should be copied. */
-        local->replies = GF_CALLOC (num_stripe, sizeof (struct readv_replies),
+        local->replies = GF_CALLOC (run_count, sizeof (struct readv_replies),
                                     gf_stripe_mt_readv_replies);
         if (!local->replies) {
+                GF_FREE (local->extents);
+                GF_FREE (runs);
                 op_errno = ENOMEM;
                 goto err;
         }
 
-        off_index = (offset / stripe_size) % fctx->stripe_count;
-        local->wind_count = num_stripe;
+        local->wind_count = run_count;
         local->readv_size = size;
         local->offset     = offset;
         local->fd         = fd_ref (fd);
         local->fctx       = fctx;
+        if (fctx->dense)
+                local->dense_stripe_size = fctx->stripe_size;
 
-        for (index = off_index; index < (num_stripe + off_index); index++) {
-                rframe = copy_frame (frame);
-                rlocal = GF_CALLOC (1, sizeof (stripe_local_t),
-                                    gf_stripe_mt_stripe_local_t);
-                if (!rlocal) {
-                        op_errno = ENOMEM;
-                        goto err;
-                }
-
-                frame_size = min (roof (frame_offset+1, stripe_size),
-                                  (offset + size)) - frame_offset;
-
-                rlocal->node_index = index - off_index;
-                rlocal->orig_frame = frame;
-                rlocal->readv_size = frame_size;
-                rframe->local = rlocal;
-                idx = (index % fctx->stripe_count);
-                STACK_WIND (rframe, stripe_readv_cbk, fctx->xl_array[idx],
-                            fctx->xl_array[idx]->fops->readv,
-                            fd, frame_size, frame_offset);
+        for (idx = 0; idx < run_count; idx++) {
+                local->replies[idx].requested_size = runs[idx].size;
+        }
 
-                frame_offset += frame_size;
+        for (idx = 0; idx < run_count; idx++) {
+                STACK_WIND_COOKIE (frame, stripe_readv_cbk, (void *)(long) idx,
+                                   fctx->xl_array[runs[idx].child],
+                                   fctx->xl_array[runs[idx].child]->fops->readv,
+                                   fd, runs[idx].size, runs[idx].offset);
         }
 
+        GF_FREE (runs);
+
         return 0;
 err:
-        if (local && local->fd)
-                fd_unref (local->fd);
-
         STACK_UNWIND_STRICT (readv, frame, -1, op_errno, NULL, 0, NULL, NULL);
         return 0;
 }
@@ -3427,11 +3798,22 @@ stripe_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         local->op_ret += op_ret;
                         local->post_buf = *postbuf;
                         local->pre_buf = *prebuf;
+
+                        if (local->postbuf_size <
+                            stripe_logical_size (this, prev->this,
+                                                 local->dense_stripe_size,
+                                                 postbuf->ia_size))
+                                local->postbuf_size =
+                                        stripe_logical_size (this, prev->this,
+                                                             local->dense_stripe_size,
+                                                             postbuf->ia_size);
                 }
         }
         UNLOCK (&frame->lock);
 
         if ((callcnt == local->wind_count) && local->unwind) {
+                if (local->post_buf.ia_size < local->postbuf_size)
+                        local->post_buf.ia_size = local->postbuf_size;
                 STACK_UNWIND_STRICT (writev, frame, local->op_ret,
                                      local->op_errno, &local->pre_buf,
                                      &local->post_buf);
@@ -3445,18 +3827,22 @@ stripe_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
                struct iovec *vector, int32_t count, off_t offset,
                struct iobref *iobref)
 {
-        struct iovec     *tmp_vec = NULL;
-        stripe_local_t   *local = NULL;
-        stripe_fd_ctx_t  *fctx = NULL;
-        int32_t           op_errno = 1;
-        int32_t           idx = 0;
-        int32_t           total_size = 0;
-        int32_t           offset_offset = 0;
-        int32_t           remaining_size = 0;
-        int32_t           tmp_count = count;
-        off_t             fill_size = 0;
-        uint64_t          stripe_size = 0;
-        uint64_t          tmp_fctx = 0;
+        struct iovec         *tmp_vec = NULL;
+        stripe_local_t       *local = NULL;
+        stripe_fd_ctx_t      *fctx = NULL;
+        struct stripe_extent *extents = NULL;
+        struct stripe_run    *runs = NULL;
+        int32_t              *vec_index = NULL;
+        int32_t               op_errno = 1;
+        int32_t               idx = 0;
+        int32_t               run = 0;
+        int32_t               total_size = 0;
+        int32_t               extent_count = 0;
+        int32_t               run_count = 0;
+        int32_t               tmp_count = 0;
+        off_t                 start = 0;
+        uint64_t              stripe_size = 0;
+        uint64_t              tmp_fctx = 0;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
@@ -3475,7 +3861,6 @@ stripe_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
         for (idx = 0; idx< count; idx ++) {
                 total_size += vector[idx].iov_len;
         }
-        remaining_size = total_size;
 
         local = GF_CALLOC (1, sizeof (stripe_local_t),
                            gf_stripe_mt_stripe_local_t);
@@ -3485,46 +3870,82 @@ stripe_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
         }
         frame->local = local;
         local->stripe_size = stripe_size;
+        if (fctx->dense)
+                local->dense_stripe_size = stripe_size;
+
+        /* Send striped chunks of the vector to child nodes appropriately,
+           all the chunks a child holds back to back in a single writev. */
+        run_count = stripe_map_extents (fctx, offset, total_size, &extents,
+                                        &extent_count, &runs);
+        if (run_count == -1) {
+                op_errno = ENOMEM;
+                goto err;
+        }
 
-        while (1) {
-                /* Send striped chunk of the vector to child
-                   nodes appropriately. */
-                idx = (((offset + offset_offset) /
-                        local->stripe_size) % fctx->stripe_count);
+        /* vec_index[run] .. vec_index[run + 1] is the vector of the run */
+        vec_index = GF_CALLOC (run_count + 1, sizeof (*vec_index),
+                               gf_stripe_mt_int32_t);
+        if (!vec_index) {
+                op_errno = ENOMEM;
+                goto err;
+        }
 
-                fill_size = (local->stripe_size -
-                             ((offset + offset_offset) % local->stripe_size));
-                if (fill_size > remaining_size)
-                        fill_size = remaining_size;
+        for (idx = 0; idx < extent_count; idx++) {
+                start = extents[idx].offset - offset;
+                vec_index[extents[idx].run + 1] +=
+                        iov_subset (vector, count, start,
+                                    start + extents[idx].size, NULL);
+        }
 
-                remaining_size -= fill_size;
+        for (run = 0; run < run_count; run++)
+                vec_index[run + 1] += vec_index[run];
 
-                tmp_count = iov_subset (vector, count, offset_offset,
-                                        offset_offset + fill_size, NULL);
-                tmp_vec = GF_CALLOC (tmp_count, sizeof (struct iovec),
-                                     gf_stripe_mt_iovec);
-                if (!tmp_vec) {
-                        op_errno = ENOMEM;
-                        goto err;
+        tmp_vec = GF_CALLOC (vec_index[run_count], sizeof (struct iovec),
+                             gf_stripe_mt_iovec);
+        if (!tmp_vec) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        /* the pieces of a run are in file order, and so are the extents */
+        for (run = 0; run < run_count; run++) {
+                tmp_count = vec_index[run];
+                for (idx = 0; idx < extent_count; idx++) {
+                        if (extents[idx].run != run)
+                                continue;
+                        start = extents[idx].offset - offset;
+                        tmp_count += iov_subset (vector, count, start,
+                                                 start + extents[idx].size,
+                                                 tmp_vec + tmp_count);
                 }
-                tmp_count = iov_subset (vector, count, offset_offset,
-                                        offset_offset + fill_size, tmp_vec);
+        }
 
-                local->wind_count++;
-                if (remaining_size == 0)
-                        local->unwind = 1;
+        local->wind_count = run_count;
+        local->unwind     = 1;
 
-                STACK_WIND (frame, stripe_writev_cbk, fctx->xl_array[idx],
-                            fctx->xl_array[idx]->fops->writev, fd, tmp_vec,
-                            tmp_count, offset + offset_offset, iobref);
-                GF_FREE (tmp_vec);
-                offset_offset += fill_size;
-                if (remaining_size == 0)
-                        break;
+        for (run = 0; run < run_count; run++) {
+                STACK_WIND (frame, stripe_writev_cbk,
+                            fctx->xl_array[runs[run].child],
+                            fctx->xl_array[runs[run].child]->fops->writev,
+                            fd, tmp_vec + vec_index[run],
+                            vec_index[run + 1] - vec_index[run],
+                            runs[run].offset, iobref);
         }
 
+        GF_FREE (tmp_vec);
+        GF_FREE (vec_index);
+        GF_FREE (extents);
+        GF_FREE (runs);
+
         return 0;
 err:
+        if (vec_index)
+                GF_FREE (vec_index);
+        if (extents)
+                GF_FREE (extents);
+        if (runs)
+                GF_FREE (runs);
+
         STACK_UNWIND_STRICT (writev, frame, -1, op_errno, NULL, NULL);
         return 0;
 }
@@ -3814,6 +4235,27 @@ init (xlator_t *this)
                 }
         }
 
+        priv->dense_layout = _gf_false;
+        data = dict_get (this->options, "layout");
+        if (data) {
+                if (!strcmp (data->data, "dense")) {
+                        priv->dense_layout = _gf_true;
+                } else if (strcmp (data->data, "sparse")) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "Invalid 'option layout %s'. "
+                                "Defaulting to layout as 'sparse'.",
+                                data->data);
+                }
+        }
+
+        /* the layout of a file is recorded in its xattrs */
+        if (priv->dense_layout && !priv->xattr_supported) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "dense layout needs 'option use-xattr on', "
+                        "using the sparse layout");
+                priv->dense_layout = _gf_false;
+        }
+
         /* notify related */
         priv->nodes_down = priv->child_count;
         this->private = priv;
@@ -3902,5 +4344,9 @@ struct volume_options options[] = {
         { .key  = {"use-xattr"},
           .type = GF_OPTION_TYPE_BOOL
         },
+        { .key  = {"layout"},
+          .type = GF_OPTION_TYPE_STR,
+          .value = {"sparse", "dense"}
+        },
         { .key  = {NULL} },
 };
@@ -37,6 +37,14 @@
 #include <signal.h>
 
 
+/**
+ * How a file's pieces are kept on the children, recorded in its
+ * 'trusted.<stripe>.stripe-layout' xattr: at their offsets in the file,
+ * or back to back.
+ */
+#define STRIPE_LAYOUT_SPARSE 0
+#define STRIPE_LAYOUT_DENSE  1
+
 /**
  * struct stripe_options : This keeps the pattern and the block-size
  *     information, which is used for striping on a file.
@@ -60,6 +68,7 @@ struct stripe_private {
         int8_t                  child_count;
         int8_t                 *state; /* Current state of child node */
         gf_boolean_t            xattr_supported;  /* default yes */
+        gf_boolean_t            dense_layout;     /* lay out new files dense */
 };
 
 /**
@@ -74,10 +83,28 @@ struct readv_replies {
         struct iatt   stbuf;    /* 'stbuf' is also a part of reply */
 };
 
+/**
+ * A piece of a read or write that lies on a single child, and the run it
+ * was sent in: the pieces a child holds back to back go in one call.
+ */
+struct stripe_extent {
+        off_t         offset;     /* in the file */
+        size_t        size;
+        int32_t       run;
+        size_t        run_offset; /* where in the run it lies */
+};
+
+struct stripe_run {
+        int32_t       child;
+        off_t         offset;     /* in the file on the child */
+        size_t        size;
+};
+
 typedef struct _stripe_fd_ctx {
         off_t      stripe_size;
         int        stripe_count;
         int        static_array;
+        int        dense;         /* pieces kept back to back */
         xlator_t **xl_array;
 } stripe_fd_ctx_t;
 
@@ -113,6 +140,8 @@ struct stripe_local {
         blkcnt_t             postparent_blocks;
 
         struct readv_replies *replies;
+        struct stripe_extent *extents;
+        int32_t              extent_count;
         struct statvfs       statvfs_buf;
         dir_entry_t         *entry;
 
@@ -142,6 +171,7 @@ struct stripe_local {
         /* General usage */
         off_t                offset;
         off_t                stripe_size;
+        uint64_t             dense_stripe_size; /* 0 if the file is sparse */
 
         int xattr_self_heal_needed;
         int entry_self_heal_needed;
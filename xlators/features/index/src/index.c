@@ -0,0 +1,888 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * features/index - keep an on-disk list of the files on this brick
+ * whose replicate changelog is not clean.
+ *
+ * It sits on the brick, above storage/posix. Every xattrop that leaves
+ * a non-zero 'trusted.afr.*' value on a file adds the file's path to
+ * the index, and every xattrop that leaves all of them zero drops it.
+ * The self-heal driver in cluster/replicate reads the list back with
+ * a getxattr of GF_XATTR_INDEX_PENDING_KEY on the root, so after an
+ * outage it only has to look at what changed instead of crawling the
+ * whole volume.
+ *
+ * The index is a flat directory (option index-base). Each entry is
+ * named after the MD5 of the path and holds the path itself.
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "index.h"
+#include "index-mem-types.h"
+#include "checksum.h"
+#include "common-utils.h"
+#include "md5.h"
+
+
+void
+index_local_wipe (index_local_t *local)
+{
+        if (!local)
+                return;
+
+        loc_wipe (&local->loc);
+        loc_wipe (&local->newloc);
+
+        if (local->fd)
+                fd_unref (local->fd);
+
+        GF_FREE (local);
+}
+
+
+static index_local_t *
+index_local_new (xlator_t *this)
+{
+        index_local_t *local = NULL;
+
+        local = GF_CALLOC (1, sizeof (*local), gf_index_mt_index_local_t);
+        if (!local)
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+
+        return local;
+}
+
+
+/* {{{ index entries */
+
+static void
+index_entry_path (xlator_t *this, const char *path, char *entry)
+{
+        index_private_t *priv = NULL;
+
+        uint8_t sum[MD5_DIGEST_LEN];
+        char    name[(MD5_DIGEST_LEN * 2) + 1];
+        int     i = 0;
+
+        priv = this->private;
+
+        gf_rsync_strong_checksum ((char *) path, strlen (path), sum);
+
+        for (i = 0; i < MD5_DIGEST_LEN; i++)
+                sprintf (name + (i * 2), "%02x", sum[i]);
+
+        snprintf (entry, PATH_MAX, "%s/%s", priv->index_base, name);
+}
+
+
+static int
+index_entry_add (xlator_t *this, const char *path)
+{
+        char entry[PATH_MAX];
+        int  fd  = -1;
+        int  ret = -1;
+        int  len = 0;
+
+        index_entry_path (this, path, entry);
+
+        fd = open (entry, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+        if (fd == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not add %s to the index (%s)",
+                        path, strerror (errno));
+                goto out;
+        }
+
+        len = strlen (path);
+
+        ret = write (fd, path, len);
+        if (ret != len) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not add %s to the index (%s)",
+                        path, strerror (errno));
+                unlink (entry);
+                ret = -1;
+                goto out;
+        }
+
+        ret = 0;
+out:
+        if (fd != -1)
+                close (fd);
+
+        return ret;
+}
+
+
+/* returns 1 if there was an entry for @path */
+static int
+index_entry_del (xlator_t *this, const char *path)
+{
+        char entry[PATH_MAX];
+        int  ret = 0;
+
+        index_entry_path (this, path, entry);
+
+        ret = unlink (entry);
+        if ((ret == -1) && (errno != ENOENT)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not drop %s from the index (%s)",
+                        path, strerror (errno));
+        }
+
+        return (ret == 0);
+}
+
+
+static void
+index_changelog_check (dict_t *xattr, char *key, data_t *value, void *data)
+{
+        int *dirty = data;
+
+        int32_t *array = NULL;
+        int      i     = 0;
+
+        if (strncmp (key, INDEX_CHANGELOG_PREFIX,
+                     strlen (INDEX_CHANGELOG_PREFIX)))
+                return;
+
+        if (*dirty == -1)
+                *dirty = 0;
+
+        array = (int32_t *) value->data;
+
+        for (i = 0; i < (value->len / sizeof (int32_t)); i++) {
+                if (array[i]) {
+                        *dirty = 1;
+                        break;
+                }
+        }
+}
+
+
+static pthread_mutex_t *
+index_update_lock (xlator_t *this, inode_t *inode)
+{
+        index_private_t *priv = NULL;
+
+        priv = this->private;
+
+        return &priv->update_locks[((unsigned long) inode >> 6)
+                                   % INDEX_UPDATE_LOCKS];
+}
+
+
+static uint64_t
+index_state_get (xlator_t *this, inode_t *inode)
+{
+        uint64_t state = INDEX_STATE_UNKNOWN;
+
+        inode_ctx_get (inode, this, &state);
+
+        return state;
+}
+
+
+static void
+index_state_set (xlator_t *this, inode_t *inode, uint64_t state)
+{
+        inode_ctx_put (inode, this, state);
+}
+
+
+/*
+ * bring the index in line with the changelog an xattrop left behind.
+ * the inode ctx remembers the last thing we did, so that the pre-op
+ * and post-op of every transaction don't both cost a disk update. the
+ * update itself is done under the update lock of the inode only, so that
+ * updates of one file reach the disk in order.
+ */
+
+static void
+index_changelog_update (xlator_t *this, inode_t *inode, const char *path,
+                        dict_t *xattr)
+{
+        pthread_mutex_t *lock  = NULL;
+        uint64_t         state = INDEX_STATE_UNKNOWN;
+        int              dirty = -1;
+
+        dict_foreach (xattr, index_changelog_check, &dirty);
+
+        if (dirty == -1)
+                /* not a changelog update */
+                return;
+
+        state = index_state_get (this, inode);
+        if ((dirty && (state == INDEX_STATE_PRESENT))
+            || (!dirty && (state == INDEX_STATE_ABSENT)))
+                return;
+
+        lock = index_update_lock (this, inode);
+
+        pthread_mutex_lock (lock);
+        {
+                state = index_state_get (this, inode);
+
+                if (dirty && (state != INDEX_STATE_PRESENT)) {
+                        if (index_entry_add (this, path) == 0)
+                                index_state_set (this, inode,
+                                                 INDEX_STATE_PRESENT);
+                } else if (!dirty && (state != INDEX_STATE_ABSENT)) {
+                        index_entry_del (this, path);
+                        index_state_set (this, inode, INDEX_STATE_ABSENT);
+                }
+        }
+        pthread_mutex_unlock (lock);
+}
+
+
+static void
+index_forget_path (xlator_t *this, inode_t *inode, const char *path)
+{
+        pthread_mutex_t *lock = NULL;
+
+        lock = index_update_lock (this, inode);
+
+        pthread_mutex_lock (lock);
+        {
+                if (index_state_get (this, inode) != INDEX_STATE_ABSENT)
+                        index_entry_del (this, path);
+
+                index_state_set (this, inode, INDEX_STATE_ABSENT);
+        }
+        pthread_mutex_unlock (lock);
+}
+
+/* }}} */
+
+
+/* {{{ xattrop */
+
+int32_t
+index_xattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, dict_t *xattr)
+{
+        index_local_t *local = NULL;
+
+        local = frame->local;
+
+        if ((op_ret == 0) && xattr && local->loc.path)
+                index_changelog_update (this, local->loc.inode,
+                                        local->loc.path, xattr);
+
+        INDEX_STACK_UNWIND (xattrop, frame, op_ret, op_errno, xattr);
+        return 0;
+}
+
+
+int32_t
+index_xattrop (call_frame_t *frame, xlator_t *this, loc_t *loc,
+               gf_xattrop_flags_t optype, dict_t *xattr)
+{
+        index_local_t *local = NULL;
+
+        local = index_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (xattrop, frame, -1, ENOMEM, NULL);
+                return 0;
+        }
+
+        frame->local = local;
+
+        loc_copy (&local->loc, loc);
+
+        STACK_WIND (frame, index_xattrop_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->xattrop,
+                    loc, optype, xattr);
+        return 0;
+}
+
+
+int32_t
+index_fxattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, dict_t *xattr)
+{
+        index_local_t *local = NULL;
+        char          *path  = NULL;
+
+        local = frame->local;
+
+        if ((op_ret == 0) && xattr
+            && (inode_path (local->fd->inode, NULL, &path) >= 0)) {
+                index_changelog_update (this, local->fd->inode, path,
+                                        xattr);
+        }
+
+        if (path)
+                GF_FREE (path);
+
+        INDEX_STACK_UNWIND (fxattrop, frame, op_ret, op_errno, xattr);
+        return 0;
+}
+
+
+int32_t
+index_fxattrop (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                gf_xattrop_flags_t optype, dict_t *xattr)
+{
+        index_local_t *local = NULL;
+
+        local = index_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (fxattrop, frame, -1, ENOMEM, NULL);
+                return 0;
+        }
+
+        frame->local = local;
+
+        local->fd = fd_ref (fd);
+
+        STACK_WIND (frame, index_fxattrop_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->fxattrop,
+                    fd, optype, xattr);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ namespace changes */
+
+int32_t
+index_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno,
+                  struct iatt *preparent, struct iatt *postparent)
+{
+        index_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (op_ret == 0)
+                index_forget_path (this, local->loc.inode, local->loc.path);
+
+        INDEX_STACK_UNWIND (unlink, frame, op_ret, op_errno,
+                            preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+index_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        index_local_t *local = NULL;
+
+        local = index_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (unlink, frame, -1, ENOMEM, NULL, NULL);
+                return 0;
+        }
+
+        frame->local = local;
+
+        loc_copy (&local->loc, loc);
+
+        STACK_WIND (frame, index_unlink_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->unlink,
+                    loc);
+        return 0;
+}
+
+
+int32_t
+index_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno,
+                 struct iatt *preparent, struct iatt *postparent)
+{
+        index_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (op_ret == 0)
+                index_forget_path (this, local->loc.inode, local->loc.path);
+
+        INDEX_STACK_UNWIND (rmdir, frame, op_ret, op_errno,
+                            preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+index_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        index_local_t *local = NULL;
+
+        local = index_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (rmdir, frame, -1, ENOMEM, NULL, NULL);
+                return 0;
+        }
+
+        frame->local = local;
+
+        loc_copy (&local->loc, loc);
+
+        STACK_WIND (frame, index_rmdir_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->rmdir,
+                    loc);
+        return 0;
+}
+
+
+/*
+ * a renamed file keeps its changelog, so its entry moves along. the
+ * entries of files below a renamed directory go stale; the self-heal
+ * driver drops those when it fails to find them (see
+ * GF_XATTR_INDEX_FORGET_KEY).
+ */
+
+int32_t
+index_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                  struct iatt *preoldparent, struct iatt *postoldparent,
+                  struct iatt *prenewparent, struct iatt *postnewparent)
+{
+        index_local_t   *local = NULL;
+        inode_t         *inode = NULL;
+        pthread_mutex_t *lock  = NULL;
+
+        uint64_t state = INDEX_STATE_UNKNOWN;
+
+        local = frame->local;
+        inode = local->loc.inode;
+
+        if ((op_ret == -1) || !inode)
+                goto out;
+
+        lock = index_update_lock (this, inode);
+
+        pthread_mutex_lock (lock);
+        {
+                state = index_state_get (this, inode);
+
+                if (state != INDEX_STATE_ABSENT) {
+                        if (!index_entry_del (this, local->loc.path))
+                                state = INDEX_STATE_ABSENT;
+                        else if (index_entry_add (this,
+                                                  local->newloc.path) == 0)
+                                state = INDEX_STATE_PRESENT;
+                        else
+                                state = INDEX_STATE_UNKNOWN;
+                }
+
+                index_state_set (this, inode, state);
+        }
+        pthread_mutex_unlock (lock);
+
+out:
+        INDEX_STACK_UNWIND (rename, frame, op_ret, op_errno, buf,
+                            preoldparent, postoldparent,
+                            prenewparent, postnewparent);
+        return 0;
+}
+
+
+int32_t
+index_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+              loc_t *newloc)
+{
+        index_local_t *local = NULL;
+
+        local = index_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (rename, frame, -1, ENOMEM,
+                                     NULL, NULL, NULL, NULL, NULL);
+                return 0;
+        }
+
+        frame->local = local;
+
+        loc_copy (&local->loc, oldloc);
+        loc_copy (&local->newloc, newloc);
+
+        STACK_WIND (frame, index_rename_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->rename,
+                    oldloc, newloc);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ pending list */
+
+/*
+ * reply to a getxattr of GF_XATTR_INDEX_PENDING_KEY[.<offset>] with up
+ * to 'batch' paths from the index, starting at <offset>:
+ *
+ *   GF_XATTR_INDEX_PENDING_KEY ".count"      number of paths
+ *   GF_XATTR_INDEX_PENDING_KEY ".path.<n>"   the paths
+ *   GF_XATTR_INDEX_PENDING_KEY ".next"       offset to ask for next,
+ *                                            absent at the end
+ */
+
+static int
+index_pending_list (xlator_t *this, const char *name, dict_t *dict)
+{
+        index_private_t *priv  = NULL;
+        DIR             *dir   = NULL;
+        struct dirent   *entry = NULL;
+
+        char     key[256];
+        char     entry_path[PATH_MAX];
+        char     path[PATH_MAX];
+        int64_t  offset = 0;
+        int32_t  count  = 0;
+        int      fd     = -1;
+        int      len    = 0;
+        int      ret    = -1;
+
+        priv = this->private;
+
+        name += strlen (GF_XATTR_INDEX_PENDING_KEY);
+        if ((name[0] == '.') && (gf_string2int64 (name + 1, &offset) != 0))
+                return -EINVAL;
+
+        dir = opendir (priv->index_base);
+        if (!dir) {
+                ret = -errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not open index %s (%s)",
+                        priv->index_base, strerror (errno));
+                return ret;
+        }
+
+        if (offset)
+                seekdir (dir, offset);
+
+        while (count < priv->batch) {
+                errno = 0;
+                entry = readdir (dir);
+                if (!entry)
+                        break;
+
+                if (!strcmp (entry->d_name, ".")
+                    || !strcmp (entry->d_name, ".."))
+                        continue;
+
+                snprintf (entry_path, PATH_MAX, "%s/%s",
+                          priv->index_base, entry->d_name);
+
+                fd = open (entry_path, O_RDONLY);
+                if (fd == -1)
+                        /* healed while we were reading */
+                        continue;
+
+                len = read (fd, path, PATH_MAX - 1);
+                close (fd);
+
+                if (len <= 0)
+                        continue;
+
+                path[len] = '\0';
+
+                snprintf (key, 256, "%s.path.%d",
+                          GF_XATTR_INDEX_PENDING_KEY, count);
+
+                ret = dict_set_dynstr (dict, key, gf_strdup (path));
+                if (ret < 0)
+                        goto out;
+
+                count++;
+        }
+
+        if (entry) {
+                ret = dict_set_int64 (dict, GF_XATTR_INDEX_PENDING_KEY ".next",
+                                      telldir (dir));
+                if (ret < 0)
+                        goto out;
+        }
+
+        ret = dict_set_int32 (dict, GF_XATTR_INDEX_PENDING_KEY ".count",
+                              count);
+out:
+        closedir (dir);
+
+        return ret;
+}
+
+
+int32_t
+index_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, dict_t *dict)
+{
+        STACK_UNWIND_STRICT (getxattr, frame, op_ret, op_errno, dict);
+        return 0;
+}
+
+
+int32_t
+index_getxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                const char *name)
+{
+        dict_t *dict = NULL;
+
+        int32_t op_ret   = -1;
+        int32_t op_errno = 0;
+        int     ret      = 0;
+
+        if (!name || strncmp (name, GF_XATTR_INDEX_PENDING_KEY,
+                              strlen (GF_XATTR_INDEX_PENDING_KEY))) {
+                STACK_WIND (frame, index_getxattr_cbk,
+                            FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->getxattr,
+                            loc, name);
+                return 0;
+        }
+
+        dict = dict_new ();
+        if (!dict) {
+                op_errno = ENOMEM;
+                goto out;
+        }
+
+        ret = index_pending_list (this, name, dict);
+        if (ret < 0) {
+                op_errno = -ret;
+                goto out;
+        }
+
+        op_ret = 0;
+out:
+        STACK_UNWIND_STRICT (getxattr, frame, op_ret, op_errno, dict);
+
+        if (dict)
+                dict_unref (dict);
+
+        return 0;
+}
+
+
+int32_t
+index_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno)
+{
+        STACK_UNWIND_STRICT (setxattr, frame, op_ret, op_errno);
+        return 0;
+}
+
+
+int32_t
+index_setxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                dict_t *dict, int32_t flags)
+{
+        pthread_mutex_t *lock  = NULL;
+        inode_t         *inode = NULL;
+        char            *path  = NULL;
+        int              ret   = 0;
+
+        ret = dict_get_str (dict, GF_XATTR_INDEX_FORGET_KEY, &path);
+        if (ret < 0) {
+                STACK_WIND (frame, index_setxattr_cbk,
+                            FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->setxattr,
+                            loc, dict, flags);
+                return 0;
+        }
+
+        /* a file still known as PRESENT would not be added again the next
+           time it becomes dirty */
+        if (loc->inode)
+                inode = inode_from_path (loc->inode->table, path);
+
+        if (inode) {
+                lock = index_update_lock (this, inode);
+
+                pthread_mutex_lock (lock);
+                {
+                        index_entry_del (this, path);
+                        index_state_set (this, inode, INDEX_STATE_UNKNOWN);
+                }
+                pthread_mutex_unlock (lock);
+
+                inode_unref (inode);
+        } else {
+                index_entry_del (this, path);
+        }
+
+        STACK_UNWIND_STRICT (setxattr, frame, 0, 0);
+        return 0;
+}
+
+/* }}} */
+
+
+int
+index_forget (xlator_t *this, inode_t *inode)
+{
+        uint64_t state = 0;
+
+        inode_ctx_del (inode, this, &state);
+
+        return 0;
+}
+
+
+int32_t
+mem_acct_init (xlator_t *this)
+{
+        int     ret = -1;
+
+        if (!this)
+                return ret;
+
+        ret = xlator_mem_acct_init (this, gf_index_mt_end + 1);
+
+        if (ret != 0) {
+                gf_log (this->name, GF_LOG_ERROR, "Memory accounting init"
+                        "failed");
+                return ret;
+        }
+
+        return ret;
+}
+
+
+int32_t
+init (xlator_t *this)
+{
+        index_private_t *priv = NULL;
+        struct stat      buf;
+
+        char *index_base = NULL;
+        int   ret        = -1;
+        int   i          = 0;
+
+        if (!this->children || this->children->next) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "'index' not configured with exactly one child");
+                goto out;
+        }
+
+        if (!this->parents) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "dangling volume. check volfile ");
+        }
+
+        ret = dict_get_str (this->options, "index-base", &index_base);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "'option index-base' is required");
+                goto out;
+        }
+
+        ret = mkdir (index_base, 0700);
+        if ((ret == -1) && (errno != EEXIST)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not create index directory %s (%s)",
+                        index_base, strerror (errno));
+                goto out;
+        }
+
+        ret = stat (index_base, &buf);
+        if ((ret == -1) || !S_ISDIR (buf.st_mode)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "index-base %s is not a directory", index_base);
+                ret = -1;
+                goto out;
+        }
+
+        priv = GF_CALLOC (1, sizeof (*priv), gf_index_mt_index_private_t);
+        if (!priv) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                ret = -1;
+                goto out;
+        }
+
+        priv->index_base = gf_strdup (index_base);
+        priv->batch      = INDEX_DEFAULT_BATCH;
+
+        for (i = 0; i < INDEX_UPDATE_LOCKS; i++)
+                pthread_mutex_init (&priv->update_locks[i], NULL);
+
+        ret = dict_get_int32 (this->options, "batch-size", &priv->batch);
+        if (ret == 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "returning %d paths per pending list",
+                        priv->batch);
+        }
+
+        this->private = priv;
+        ret = 0;
+out:
+        return ret;
+}
+
+
+void
+fini (xlator_t *this)
+{
+        index_private_t *priv = NULL;
+        int              i    = 0;
+
+        priv = this->private;
+        if (!priv)
+                return;
+
+        this->private = NULL;
+
+        for (i = 0; i < INDEX_UPDATE_LOCKS; i++)
+                pthread_mutex_destroy (&priv->update_locks[i]);
+
+        GF_FREE (priv->index_base);
+        GF_FREE (priv);
+
+        return;
+}
+
+
+struct xlator_fops fops = {
+        .xattrop     = index_xattrop,
+        .fxattrop    = index_fxattrop,
+        .unlink      = index_unlink,
+        .rmdir       = index_rmdir,
+        .rename      = index_rename,
+        .getxattr    = index_getxattr,
+        .setxattr    = index_setxattr,
+};
+
+struct xlator_cbks cbks = {
+        .forget      = index_forget,
+};
+
+struct volume_options options[] = {
+        { .key  = {"index-base"},
+          .type = GF_OPTION_TYPE_PATH
+        },
+        { .key  = {"batch-size"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 65536
+        },
+        { .key  = {NULL} },
+};
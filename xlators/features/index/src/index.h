@@ -0,0 +1,75 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __INDEX_H__
+#define __INDEX_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+
+#include "glusterfs.h"
+#include "logging.h"
+#include "dict.h"
+#include "xlator.h"
+#include "defaults.h"
+
+/* prefix of the changelog keys that mark a file as needing heal */
+#define INDEX_CHANGELOG_PREFIX   "trusted.afr."
+
+/* default number of paths returned by one pending-list getxattr */
+#define INDEX_DEFAULT_BATCH      1024
+
+/* locks ordering the index updates of a file, hashed by inode */
+#define INDEX_UPDATE_LOCKS       64
+
+/* what we know about a file's entry in the index (its inode ctx) */
+typedef enum {
+        INDEX_STATE_UNKNOWN = 0,
+        INDEX_STATE_PRESENT,
+        INDEX_STATE_ABSENT,
+} index_state_t;
+
+typedef struct {
+        char         *index_base;   /* directory holding the index */
+        int32_t       batch;        /* paths per pending-list reply */
+
+        /* held across the disk update of an entry, while inode->lock only
+           guards the state in the inode ctx */
+        pthread_mutex_t update_locks[INDEX_UPDATE_LOCKS];
+} index_private_t;
+
+typedef struct {
+        loc_t         loc;
+        loc_t         newloc;
+        fd_t         *fd;
+} index_local_t;
+
+#define INDEX_STACK_UNWIND(fop, frame, params ...) do {         \
+                index_local_t *__local = NULL;                  \
+                __local = frame->local;                         \
+                frame->local = NULL;                            \
+                STACK_UNWIND_STRICT (fop, frame, params);       \
+                index_local_wipe (__local);                     \
+        } while (0)
+
+#endif /* __INDEX_H__ */
@@ -33,6 +33,7 @@
 #include "inode.h"
 #include "logging.h"
 #include "common-utils.h"
+#include "hashfn.h"
 
 #include "locks.h"
 #include "common.h"
@@ -43,8 +44,96 @@ __is_lock_grantable (pl_inode_t *pl_inode, posix_lock_t *lock);
 static void
 __insert_and_merge (pl_inode_t *pl_inode, posix_lock_t *lock);
 
+/* Returns the interned domain of this name, adding it if it is new */
+static pl_domain_t *
+pl_domain_get (xlator_t *this, const char *name)
+{
+        posix_locks_private_t *priv    = NULL;
+        pl_domain_t           *pdomain = NULL;
+        struct list_head      *bucket  = NULL;
+
+        priv = this->private;
+
+        bucket = &priv->domains[gf_dm_hashfn (name, strlen (name))
+                                % PL_DOMAIN_HASH_SIZE];
+
+        LOCK (&priv->lock);
+        {
+                list_for_each_entry (pdomain, bucket, hash) {
+                        if (strcmp (pdomain->name, name) == 0)
+                                goto unlock;
+                }
+
+                pdomain = GF_CALLOC (1, sizeof (*pdomain),
+                                     gf_locks_mt_pl_domain_t);
+                if (!pdomain)
+                        goto unlock;
+
+                pdomain->name = gf_strdup (name);
+                if (!pdomain->name) {
+                        GF_FREE (pdomain);
+                        pdomain = NULL;
+                        goto unlock;
+                }
+
+                LOCK_INIT (&pdomain->lock);
+                list_add_tail (&pdomain->hash, bucket);
+        }
+unlock:
+        UNLOCK (&priv->lock);
+
+        return pdomain;
+}
+
+
+void
+pl_domain_granted (pl_domain_t *pdomain, struct timeval *granted)
+{
+        gettimeofday (granted, NULL);
+
+        LOCK (&pdomain->lock);
+        {
+                pdomain->grants++;
+        }
+        UNLOCK (&pdomain->lock);
+}
+
+
+void
+pl_domain_blocked (pl_domain_t *pdomain)
+{
+        LOCK (&pdomain->lock);
+        {
+                pdomain->blocks++;
+        }
+        UNLOCK (&pdomain->lock);
+}
+
+
+void
+pl_domain_released (pl_domain_t *pdomain, struct timeval *granted)
+{
+        struct timeval now  = {0, };
+        int64_t        usec = 0;
+
+        gettimeofday (&now, NULL);
+
+        usec = (now.tv_sec - granted->tv_sec) * 1000000
+                + (now.tv_usec - granted->tv_usec);
+        if (usec < 0)
+                usec = 0;
+
+        LOCK (&pdomain->lock);
+        {
+                pdomain->releases++;
+                pdomain->hold_usec += usec;
+        }
+        UNLOCK (&pdomain->lock);
+}
+
+
 static pl_dom_list_t *
-allocate_domain (const char *volume)
+allocate_domain (pl_domain_t *pdomain)
 {
         pl_dom_list_t *dom = NULL;
 
@@ -53,13 +142,8 @@ allocate_domain (const char *volume)
         if (!dom)
                 return NULL;
 
-
-        dom->domain = gf_strdup(volume);
-	if (!dom->domain) {
-		gf_log ("posix-locks", GF_LOG_TRACE,
-			"Out of Memory");
-		return NULL;
-	}
+        dom->pdomain = pdomain;
+        dom->domain  = pdomain->name;
 
         gf_log ("posix-locks", GF_LOG_TRACE,
                 "New domain allocated: %s", dom->domain);
@@ -69,6 +153,8 @@ allocate_domain (const char *volume)
         INIT_LIST_HEAD (&dom->blocked_entrylks);
         INIT_LIST_HEAD (&dom->inodelk_list);
         INIT_LIST_HEAD (&dom->blocked_inodelks);
+        pl_itree_init (&dom->inodelk_tree);
+        pl_itree_init (&dom->blocked_inodelk_tree);
 
         return dom;
 }
@@ -77,22 +163,29 @@ allocate_domain (const char *volume)
  * allocates a domain and returns it
  */
 pl_dom_list_t *
-get_domain (pl_inode_t *pl_inode, const char *volume)
+get_domain (xlator_t *this, pl_inode_t *pl_inode, const char *volume)
 {
+        pl_domain_t   *pdomain = NULL;
         pl_dom_list_t *dom = NULL;
 
-        list_for_each_entry (dom, &pl_inode->dom_list, inode_list) {
-                if (strcmp (dom->domain, volume) == 0)
-                        goto found;
-
+        pdomain = pl_domain_get (this, volume);
+        if (!pdomain)
+                return NULL;
 
-        }
+        pthread_mutex_lock (&pl_inode->mutex);
+        {
+                list_for_each_entry (dom, &pl_inode->dom_list, inode_list) {
+                        if (dom->pdomain == pdomain)
+                                goto found;
+                }
 
-        dom = allocate_domain(volume);
+                dom = allocate_domain (pdomain);
 
-        if (dom)
-                list_add (&dom->inode_list, &pl_inode->dom_list);
+                if (dom)
+                        list_add (&dom->inode_list, &pl_inode->dom_list);
+        }
 found:
+        pthread_mutex_unlock (&pl_inode->mutex);
 
         return dom;
 }
@@ -377,32 +470,45 @@ pl_trace_release (xlator_t *this, fd_t *fd)
 }
 
 
+/* Called with pl_inode->mutex held. Returns the inode if the ref on it
+   is to be dropped, which the caller does after unlocking */
+inode_t *
+__pl_update_refkeeper (pl_inode_t *pl_inode, inode_t *inode)
+{
+        inode_t *unref    = NULL;
+        int      is_empty = 0;
+
+        is_empty = __pl_inode_is_empty (pl_inode);
+
+        if (is_empty && pl_inode->refkeeper) {
+                unref = pl_inode->refkeeper;
+                pl_inode->refkeeper = NULL;
+        }
+
+        if (!is_empty && !pl_inode->refkeeper) {
+                pl_inode->refkeeper = inode_ref (inode);
+        }
+
+        return unref;
+}
+
+
 void
 pl_update_refkeeper (xlator_t *this, inode_t *inode)
 {
         pl_inode_t *pl_inode  = NULL;
-        int         is_empty  = 0;
-        int         need_unref = 0;
+        inode_t    *unref     = NULL;
 
         pl_inode = pl_inode_get (this, inode);
 
         pthread_mutex_lock (&pl_inode->mutex);
         {
-                is_empty = __pl_inode_is_empty (pl_inode);
-
-                if (is_empty && pl_inode->refkeeper) {
-                        need_unref = 1;
-                        pl_inode->refkeeper = NULL;
-                }
-
-                if (!is_empty && !pl_inode->refkeeper) {
-                        pl_inode->refkeeper = inode_ref (inode);
-                }
+                unref = __pl_update_refkeeper (pl_inode, inode);
         }
         pthread_mutex_unlock (&pl_inode->mutex);
 
-        if (need_unref)
-                inode_unref (inode);
+        if (unref)
+                inode_unref (unref);
 }
 
 
@@ -440,7 +546,9 @@ pl_inode_get (xlator_t *this, inode_t *inode)
 
 	INIT_LIST_HEAD (&pl_inode->dom_list);
 	INIT_LIST_HEAD (&pl_inode->ext_list);
+	INIT_LIST_HEAD (&pl_inode->blocked_ext_list);
 	INIT_LIST_HEAD (&pl_inode->rw_list);
+        pl_itree_init (&pl_inode->ext_tree);
 
 	inode_ctx_put (inode, this, (uint64_t)(long)(pl_inode));
 
@@ -476,6 +584,7 @@ new_posix_lock (struct flock *flock, void *transport, pid_t client_pid,
         lock->owner      = owner;
 
 	INIT_LIST_HEAD (&lock->list);
+	INIT_LIST_HEAD (&lock->blocked_locks);
 
 	return lock;
 }
@@ -485,6 +594,14 @@ new_posix_lock (struct flock *flock, void *transport, pid_t client_pid,
 void
 __delete_lock (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
+        if (list_empty (&lock->list))
+                return;
+
+        if (lock->blocked)
+                list_del_init (&lock->blocked_locks);
+        else
+                pl_itree_remove (&pl_inode->ext_tree, &lock->node);
+
 	list_del_init (&lock->list);
 }
 
@@ -512,12 +629,20 @@ posix_lock_to_flock (posix_lock_t *lock, struct flock *flock)
 }
 
 
-/* Insert the lock into the inode's lock list */
+/* Insert the lock into the inode's lock list, and into the range
+   index or the wait queue */
 static void
 __insert_lock (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
 	list_add_tail (&lock->list, &pl_inode->ext_list);
 
+        if (lock->blocked)
+                list_add_tail (&lock->blocked_locks,
+                               &pl_inode->blocked_ext_list);
+        else
+                pl_itree_insert (&pl_inode->ext_tree, &lock->node,
+                                 lock->fl_start, lock->fl_end);
+
 	return;
 }
 
@@ -548,17 +673,24 @@ same_owner (posix_lock_t *l1, posix_lock_t *l2)
 }
 
 
-/* Delete all F_UNLCK locks */
-void
-__delete_unlck_locks (pl_inode_t *pl_inode)
+/* Delete all F_UNLCK locks in [start, end] */
+static void
+__delete_unlck_locks (pl_inode_t *pl_inode, off_t start, off_t end)
 {
-	posix_lock_t *l = NULL;
-	posix_lock_t *tmp = NULL;
+	posix_lock_t    *l = NULL;
+        pl_itree_node_t *n = NULL;
+
+        n = pl_itree_first (&pl_inode->ext_tree, start, end);
+        while (n) {
+                l = pl_itree_entry (n, posix_lock_t, node);
+                n = pl_itree_next (n, start, end);
 
-	list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
 		if (l->fl_type == F_UNLCK) {
 			__delete_lock (pl_inode, l);
 			__destroy_lock (l);
+
+                        /* removal reshapes the tree, start over */
+                        n = pl_itree_first (&pl_inode->ext_tree, start, end);
 		}
 	}
 }
@@ -578,6 +710,9 @@ add_locks (posix_lock_t *l1, posix_lock_t *l2)
 	sum->fl_start = min (l1->fl_start, l2->fl_start);
 	sum->fl_end   = max (l1->fl_end, l2->fl_end);
 
+	INIT_LIST_HEAD (&sum->list);
+	INIT_LIST_HEAD (&sum->blocked_locks);
+
 	return sum;
 }
 
@@ -694,24 +829,20 @@ done:
 }
 
 /*
-  Start searching from {begin}, and return the first lock that
-  conflicts, NULL if no conflict
-  If {begin} is NULL, then start from the beginning of the list
+  Return the granted lock with the lowest start that overlaps {lock},
+  NULL if there is none
 */
 static posix_lock_t *
 first_overlap (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
-        posix_lock_t *l = NULL;
+        pl_itree_node_t *n = NULL;
 
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (l->blocked)
-                        continue;
-
-                if (locks_overlap (l, lock))
-                        return l;
-        }
+        n = pl_itree_first (&pl_inode->ext_tree, lock->fl_start,
+                            lock->fl_end);
+        if (!n)
+                return NULL;
 
-        return NULL;
+        return pl_itree_entry (n, posix_lock_t, node);
 }
 
 
@@ -720,18 +851,22 @@ first_overlap (pl_inode_t *pl_inode, posix_lock_t *lock)
 static int
 __is_lock_grantable (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
-        posix_lock_t *l = NULL;
-        int           ret = 1;
-
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (!l->blocked && locks_overlap (lock, l)) {
-                        if (((l->fl_type == F_WRLCK)
-                             || (lock->fl_type == F_WRLCK))
-                            && (lock->fl_type != F_UNLCK)
-                            && !same_owner (l, lock)) {
-                                ret = 0;
-                                break;
-                        }
+        posix_lock_t    *l = NULL;
+        pl_itree_node_t *n = NULL;
+        int              ret = 1;
+
+        if (lock->fl_type == F_UNLCK)
+                return ret;
+
+        pl_itree_for_each_overlap (n, &pl_inode->ext_tree,
+                                   lock->fl_start, lock->fl_end) {
+                l = pl_itree_entry (n, posix_lock_t, node);
+
+                if (((l->fl_type == F_WRLCK)
+                     || (lock->fl_type == F_WRLCK))
+                    && !same_owner (l, lock)) {
+                        ret = 0;
+                        break;
                 }
         }
         return ret;
@@ -744,15 +879,18 @@ extern void do_blocked_rw (pl_inode_t *);
 static void
 __insert_and_merge (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
-        posix_lock_t  *conf = NULL;
-        posix_lock_t  *t = NULL;
-        posix_lock_t  *sum = NULL;
-        int            i = 0;
-        struct _values v = { .locks = {0, 0, 0} };
-
-        list_for_each_entry_safe (conf, t, &pl_inode->ext_list, list) {
-                if (!locks_overlap (conf, lock))
-                        continue;
+        posix_lock_t    *conf = NULL;
+        posix_lock_t    *sum = NULL;
+        pl_itree_node_t *n = NULL;
+        off_t            start = 0;
+        off_t            end = 0;
+        int              i = 0;
+        struct _values   v = { .locks = {0, 0, 0} };
+
+        /* every branch that changes the tree returns right away */
+        pl_itree_for_each_overlap (n, &pl_inode->ext_tree,
+                                   lock->fl_start, lock->fl_end) {
+                conf = pl_itree_entry (n, posix_lock_t, node);
 
                 if (same_owner (conf, lock)) {
                         if (conf->fl_type == lock->fl_type) {
@@ -788,6 +926,8 @@ __insert_and_merge (pl_inode_t *pl_inode, posix_lock_t *lock)
                                 __delete_lock (pl_inode, lock);
                                 __destroy_lock (lock);
 
+                                start = sum->fl_start;
+                                end   = sum->fl_end;
                                 __destroy_lock (sum);
 
                                 for (i = 0; i < 3; i++) {
@@ -795,11 +935,12 @@ __insert_and_merge (pl_inode_t *pl_inode, posix_lock_t *lock)
                                                 continue;
 
                                         INIT_LIST_HEAD (&v.locks[i]->list);
+                                        INIT_LIST_HEAD (&v.locks[i]->blocked_locks);
                                         __insert_and_merge (pl_inode,
                                                             v.locks[i]);
                                 }
 
-                                __delete_unlck_locks (pl_inode);
+                                __delete_unlck_locks (pl_inode, start, end);
                                 return;
                         }
                 }
@@ -833,15 +974,15 @@ __grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode, struct list_head *g
 
         INIT_LIST_HEAD (&tmp_list);
 
-        list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
-                if (l->blocked) {
-                        conf = first_overlap (pl_inode, l);
-                        if (conf)
-                                continue;
+        list_for_each_entry_safe (l, tmp, &pl_inode->blocked_ext_list,
+                                  blocked_locks) {
+                conf = first_overlap (pl_inode, l);
+                if (conf)
+                        continue;
 
-                        l->blocked = 0;
-                        list_move_tail (&l->list, &tmp_list);
-                }
+                __delete_lock (pl_inode, l);
+                l->blocked = 0;
+                list_add_tail (&l->list, &tmp_list);
         }
 
         list_for_each_entry_safe (l, tmp, &tmp_list, list) {
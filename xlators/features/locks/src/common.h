@@ -51,13 +51,21 @@ void __delete_lock (pl_inode_t *, posix_lock_t *);
 void __destroy_lock (posix_lock_t *);
 
 pl_dom_list_t *
-get_domain (pl_inode_t *pl_inode, const char *volume);
+get_domain (xlator_t *this, pl_inode_t *pl_inode, const char *volume);
+
+void pl_domain_granted (pl_domain_t *pdomain, struct timeval *granted);
+
+void pl_domain_blocked (pl_domain_t *pdomain);
+
+void pl_domain_released (pl_domain_t *pdomain, struct timeval *granted);
+
+void __destroy_entry_lock (pl_entry_lock_t *lock);
 
 void
 grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode, pl_dom_list_t *dom);
 
 void
-__delete_inode_lock (pl_inode_lock_t *lock);
+__delete_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock);
 
 void
 __destroy_inode_lock (pl_inode_lock_t *lock);
@@ -68,6 +76,9 @@ grant_blocked_entry_locks (xlator_t *this, pl_inode_t *pl_inode,
 
 void pl_update_refkeeper (xlator_t *this, inode_t *inode);
 
+inode_t *
+__pl_update_refkeeper (pl_inode_t *pl_inode, inode_t *inode);
+
 int32_t
 get_inodelk_count (xlator_t *this, inode_t *inode);
 
@@ -34,18 +34,23 @@
 #include "common.h"
 
 static pl_entry_lock_t *
-new_entrylk_lock (pl_inode_t *pinode, const char *basename, entrylk_type type,
-		  void *trans, pid_t client_pid, uint64_t owner, const char *volume)
+new_entrylk_lock (xlator_t *this, pl_inode_t *pinode, const char *basename,
+                  entrylk_type type, void *trans, pid_t client_pid,
+                  uint64_t owner, const char *volume)
 
 {
-	pl_entry_lock_t *newlock = NULL;
+        posix_locks_private_t *priv    = NULL;
+	pl_entry_lock_t       *newlock = NULL;
 
-	newlock = GF_CALLOC (1, sizeof (pl_entry_lock_t),
-                             gf_locks_mt_pl_entry_lock_t);
+        priv = this->private;
+
+	newlock = mem_get (priv->entrylk_pool);
 	if (!newlock) {
 		goto out;
 	}
 
+        memset (newlock, 0, sizeof (*newlock));
+        newlock->this           = this;
 	newlock->basename       = basename ? gf_strdup (basename) : NULL;
 	newlock->type           = type;
 	newlock->trans          = trans;
@@ -61,6 +66,20 @@ out:
 }
 
 
+void
+__destroy_entry_lock (pl_entry_lock_t *lock)
+{
+        posix_locks_private_t *priv = NULL;
+
+        priv = lock->this->private;
+
+        if (lock->basename)
+                GF_FREE ((char *)lock->basename);
+
+        mem_put (priv->entrylk_pool, lock);
+}
+
+
 /**
  * all_names - does a basename represent all names?
  * @basename: name to check
@@ -328,7 +347,8 @@ __lock_name (pl_inode_t *pinode, const char *basename, entrylk_type type,
         client_pid = frame->root->pid;
         owner      = frame->root->lk_owner;
 
-	lock = new_entrylk_lock (pinode, basename, type, trans, client_pid, owner, dom->domain);
+	lock = new_entrylk_lock (this, pinode, basename, type, trans,
+                                 client_pid, owner, dom->domain);
 	if (!lock) {
 		ret = -ENOMEM;
 		goto out;
@@ -337,8 +357,10 @@ __lock_name (pl_inode_t *pinode, const char *basename, entrylk_type type,
 	conf = __lock_grantable (dom, basename, type);
 	if (conf) {
 		ret = -EAGAIN;
-		if (nonblock)
+		if (nonblock) {
+                        __destroy_entry_lock (lock);
 			goto out;
+                }
 
 		lock->frame   = frame;
 		lock->this    = this;
@@ -354,8 +376,10 @@ __lock_name (pl_inode_t *pinode, const char *basename, entrylk_type type,
 
         if ( __blocked_lock_conflict (dom, basename, type) && !(__owner_has_lock (dom, lock))) {
                 ret = -EAGAIN;
-                if (nonblock)
+                if (nonblock) {
+                        __destroy_entry_lock (lock);
                         goto out;
+                }
                 lock->frame     = frame;
                 lock->this      = this;
 
@@ -373,12 +397,14 @@ __lock_name (pl_inode_t *pinode, const char *basename, entrylk_type type,
 
 	case ENTRYLK_WRLCK:
 		list_add (&lock->domain_list, &dom->entrylk_list);
+                pl_domain_granted (dom->pdomain, &lock->granted);
 		break;
 
         default:
 
                 gf_log (this->name, GF_LOG_DEBUG,
                         "Invalid type for entrylk specified: %d", type);
+                __destroy_entry_lock (lock);
                 ret = -EINVAL;
                 goto out;
 	}
@@ -415,6 +441,7 @@ __unlock_name (pl_dom_list_t *dom, const char *basename, entrylk_type type)
 
 		if (type == ENTRYLK_WRLCK) {
 			list_del (&lock->domain_list);
+                        pl_domain_released (dom->pdomain, &lock->granted);
 			ret_lock = lock;
 		}
 	} else {
@@ -457,9 +484,7 @@ __grant_blocked_entry_locks (xlator_t *this, pl_inode_t *pl_inode,
 		if (bl_ret == 0) {
 			list_add (&bl->blocked_locks, granted);
 		} else {
-			if (bl->basename)
-				GF_FREE ((char *)bl->basename);
-			GF_FREE (bl);
+                        __destroy_entry_lock (bl);
 		}
 	}
 	return;
@@ -491,12 +516,10 @@ grant_blocked_entry_locks (xlator_t *this, pl_inode_t *pl_inode,
 
 		STACK_UNWIND_STRICT (entrylk, lock->frame, 0, 0);
 
-		GF_FREE ((char *)lock->basename);
-		GF_FREE (lock);
+                __destroy_entry_lock (lock);
 	}
 
-	GF_FREE ((char *)unlocked->basename);
-	GF_FREE (unlocked);
+        __destroy_entry_lock (unlocked);
 
 	return;
 }
@@ -546,8 +569,8 @@ release_entry_locks_for_transport (xlator_t *this, pl_inode_t *pinode,
                                 "releasing lock on  held by "
                                 "{transport=%p}",trans);
 
-			GF_FREE ((char *)lock->basename);
-			GF_FREE (lock);
+                        pl_domain_released (dom->pdomain, &lock->granted);
+                        __destroy_entry_lock (lock);
 		}
 
 		__grant_blocked_entry_locks (this, pinode, dom, &granted);
@@ -561,9 +584,7 @@ release_entry_locks_for_transport (xlator_t *this, pl_inode_t *pinode,
 
                 STACK_UNWIND_STRICT (entrylk, lock->frame, -1, EAGAIN);
 
-                if (lock->basename)
-                        GF_FREE ((char *)lock->basename);
-                GF_FREE (lock);
+                __destroy_entry_lock (lock);
 
         }
 
@@ -572,9 +593,7 @@ release_entry_locks_for_transport (xlator_t *this, pl_inode_t *pinode,
 
 		STACK_UNWIND_STRICT (entrylk, lock->frame, 0, 0);
 
-		if (lock->basename)
-			GF_FREE ((char *)lock->basename);
-		GF_FREE (lock);
+                __destroy_entry_lock (lock);
 	}
 
 	return 0;
@@ -596,6 +615,9 @@ pl_common_entrylk (call_frame_t *frame, xlator_t *this,
 	int              ret      = -1;
 	pl_entry_lock_t *unlocked = NULL;
 	char             unwind   = 1;
+        inode_t         *unref    = NULL;
+        int              need_grant = 0;
+        int              update_refkeeper = 1;
 
 	pl_dom_list_t	  *dom = NULL;
 
@@ -607,7 +629,7 @@ pl_common_entrylk (call_frame_t *frame, xlator_t *this,
 		goto out;
 	}
 
-	dom = get_domain (pinode, volume);
+	dom = get_domain (this, pinode, volume);
 	if (!dom){
 		gf_log (this->name, GF_LOG_ERROR,
 			"Out of memory");
@@ -641,12 +663,16 @@ pl_common_entrylk (call_frame_t *frame, xlator_t *this,
 		{
 			ret = __lock_name (pinode, basename, type,
 					   frame, dom, this, 0);
+                        unref = __pl_update_refkeeper (pinode, inode);
 		}
 		pthread_mutex_unlock (&pinode->mutex);
+                update_refkeeper = 0;
 
 		if (ret < 0) {
-			if (ret == -EAGAIN)
+			if (ret == -EAGAIN) {
 				unwind = 0;
+                                pl_domain_blocked (dom->pdomain);
+                        }
 			op_errno = -ret;
 			goto out;
 		}
@@ -658,8 +684,10 @@ pl_common_entrylk (call_frame_t *frame, xlator_t *this,
 		{
 			ret = __lock_name (pinode, basename, type,
 					   frame, dom, this, 1);
+                        unref = __pl_update_refkeeper (pinode, inode);
 		}
 		pthread_mutex_unlock (&pinode->mutex);
+                update_refkeeper = 0;
 
 		if (ret < 0) {
 			op_errno = -ret;
@@ -672,11 +700,24 @@ pl_common_entrylk (call_frame_t *frame, xlator_t *this,
 		pthread_mutex_lock (&pinode->mutex);
 		{
                         unlocked = __unlock_name (dom, basename, type);
+
+                        /* nobody waiting, nothing more to do under the
+                           lock */
+                        need_grant = !list_empty (&dom->blocked_entrylks);
+                        if (!need_grant) {
+                                unref = __pl_update_refkeeper (pinode, inode);
+                                update_refkeeper = 0;
+                        }
 		}
 		pthread_mutex_unlock (&pinode->mutex);
 
-		if (unlocked)
-			grant_blocked_entry_locks (this, pinode, unlocked, dom);
+		if (unlocked) {
+                        if (need_grant)
+                                grant_blocked_entry_locks (this, pinode,
+                                                           unlocked, dom);
+                        else
+                                __destroy_entry_lock (unlocked);
+                }
 
 		break;
 
@@ -689,7 +730,10 @@ pl_common_entrylk (call_frame_t *frame, xlator_t *this,
 
 	op_ret = 0;
 out:
-        pl_update_refkeeper (this, inode);
+        if (unref)
+                inode_unref (unref);
+        if (update_refkeeper)
+                pl_update_refkeeper (this, inode);
 	if (unwind) {
                 entrylk_trace_out (this, frame, volume, fd, loc, basename,
                                    cmd, type, op_ret, op_errno);
@@ -34,15 +34,22 @@
 #include "common.h"
 
 void
-__delete_inode_lock (pl_inode_lock_t *lock)
+__delete_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 {
+        pl_itree_remove (&dom->inodelk_tree, &lock->node);
 	list_del (&lock->list);
+
+        pl_domain_released (dom->pdomain, &lock->granted);
 }
 
 void
 __destroy_inode_lock (pl_inode_lock_t *lock)
 {
-	GF_FREE (lock);
+        posix_locks_private_t *priv = NULL;
+
+        priv = lock->this->private;
+
+	mem_put (priv->inodelk_pool, lock);
 }
 
 /* Check if 2 inodelks are conflicting on type. Only 2 shared locks don't conflict */
@@ -145,9 +152,11 @@ __inodelk_grantable (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 {
 	pl_inode_lock_t *l = NULL;
 	pl_inode_lock_t *ret = NULL;
-	if (list_empty (&dom->inodelk_list))
-		goto out;
-	list_for_each_entry (l, &dom->inodelk_list, list){
+        pl_itree_node_t *n = NULL;
+
+        pl_itree_for_each_overlap (n, &dom->inodelk_tree,
+                                   lock->fl_start, lock->fl_end) {
+                l = pl_itree_entry (n, pl_inode_lock_t, node);
 		if (inodelk_conflict (lock, l)) {
 			ret = l;
 			goto out;
@@ -162,11 +171,14 @@ __blocked_lock_conflict (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 {
         pl_inode_lock_t *l   = NULL;
         pl_inode_lock_t *ret = NULL;
+        pl_itree_node_t *n   = NULL;
 
 	if (list_empty (&dom->blocked_entrylks))
 		return NULL;
 
-	list_for_each_entry (l, &dom->blocked_inodelks, blocked_locks) {
+        pl_itree_for_each_overlap (n, &dom->blocked_inodelk_tree,
+                                   lock->fl_start, lock->fl_end) {
+                l = pl_itree_entry (n, pl_inode_lock_t, node);
 		if (inodelk_conflict (lock, l)) {
 			ret = l;
 			goto out;
@@ -196,6 +208,33 @@ __owner_has_lock (pl_dom_list_t *dom, pl_inode_lock_t *newlock)
 }
 
 
+static void
+__add_blocked_inodelk (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+        list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+        pl_itree_insert (&dom->blocked_inodelk_tree, &lock->node,
+                         lock->fl_start, lock->fl_end);
+}
+
+static void
+__del_blocked_inodelk (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+        pl_itree_remove (&dom->blocked_inodelk_tree, &lock->node);
+        list_del_init (&lock->blocked_locks);
+}
+
+
+static void
+__grant_inodelk (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+	list_add (&lock->list, &dom->inodelk_list);
+        pl_itree_insert (&dom->inodelk_tree, &lock->node,
+                         lock->fl_start, lock->fl_end);
+
+        pl_domain_granted (dom->pdomain, &lock->granted);
+}
+
+
 /* Determines if lock can be granted and adds the lock. If the lock
  * is blocking, adds it to the blocked_inodelks list of the domain.
  */
@@ -212,7 +251,7 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
 		if (can_block == 0)
 			goto out;
 
-		list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+		__add_blocked_inodelk (dom, lock);
 
                 gf_log (this->name, GF_LOG_TRACE,
                         "%s (pid=%d) lk-owner:%"PRIu64" %"PRId64" - %"PRId64" => Blocked",
@@ -231,7 +270,7 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
                 if (can_block == 0)
                         goto out;
 
-                list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+                __add_blocked_inodelk (dom, lock);
 
                 gf_log (this->name, GF_LOG_TRACE,
                         "Lock is grantable, but blocking to prevent starvation");
@@ -246,7 +285,8 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
 
 		goto out;
         }
-	list_add (&lock->list, &dom->inodelk_list);
+
+        __grant_inodelk (dom, lock);
 
 	ret = 0;
 
@@ -270,7 +310,11 @@ static pl_inode_lock_t *
 find_matching_inodelk (pl_inode_lock_t *lock, pl_dom_list_t *dom)
 {
 	pl_inode_lock_t *l = NULL;
-	list_for_each_entry (l, &dom->inodelk_list, list) {
+        pl_itree_node_t *n = NULL;
+
+        pl_itree_for_each_overlap (n, &dom->inodelk_tree,
+                                   lock->fl_start, lock->fl_end) {
+                l = pl_itree_entry (n, pl_inode_lock_t, node);
 		if (inodelks_equal (l, lock))
 			return l;
 	}
@@ -292,7 +336,7 @@ __inode_unlock_lock (xlator_t *this, pl_inode_lock_t *lock, pl_dom_list_t *dom)
                         " Matching lock not found for unlock");
 		goto out;
         }
-	__delete_inode_lock (conf);
+	__delete_inode_lock (dom, conf);
         gf_log (this->name, GF_LOG_DEBUG,
                 " Matching lock found for unlock");
         __destroy_inode_lock (lock);
@@ -316,6 +360,9 @@ __grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode,
         INIT_LIST_HEAD (&blocked_list);
         list_splice_init (&dom->blocked_inodelks, &blocked_list);
 
+        /* the ones that still cannot be granted go back in, in order */
+        pl_itree_init (&dom->blocked_inodelk_tree);
+
 	list_for_each_entry_safe (bl, tmp, &blocked_list, blocked_locks) {
 
 		list_del_init (&bl->blocked_locks);
@@ -394,7 +441,7 @@ release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
                         if (l->transport != trans)
                                 continue;
 
-                        list_del_init (&l->blocked_locks);
+                        __del_blocked_inodelk (dom, l);
 
                         if (inode_path (inode, NULL, &path) < 0) {
                                 gf_log (this->name, GF_LOG_TRACE,
@@ -417,13 +464,12 @@ release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
                         if (l->transport != trans)
                                 continue;
 
-                        __delete_inode_lock (l);
-			__destroy_inode_lock (l);
-
+                        __delete_inode_lock (dom, l);
 
                         if (inode_path (inode, NULL, &path) < 0) {
                                 gf_log (this->name, GF_LOG_TRACE,
                                         "inode_path failed");
+                                __destroy_inode_lock (l);
                                 goto unlock;
                         }
 
@@ -434,6 +480,7 @@ release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
                                 (uint64_t) l->client_pid,
                                 l->owner);
 
+			__destroy_inode_lock (l);
 
                 }
         }
@@ -447,7 +494,7 @@ unlock:
                 list_del_init (&l->blocked_locks);
 
                 STACK_UNWIND_STRICT (inodelk, l->frame, -1, EAGAIN);
-                GF_FREE (l);
+                __destroy_inode_lock (l);
         }
 
 	grant_blocked_inode_locks (this, pinode, dom);
@@ -455,17 +502,32 @@ unlock:
 }
 
 
+/*
+ * Also keeps the inode ref'd while it has locks. The blocked locks are
+ * looked at again only when a lock went away and there are some.
+ */
 static int
 pl_inode_setlk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
-		int can_block,  pl_dom_list_t *dom)
+		int can_block,  pl_dom_list_t *dom, inode_t *inode)
 {
 	int ret = -EINVAL;
+        int need_grant = 0;
         pl_inode_lock_t *retlock = NULL;
+        inode_t         *unref   = NULL;
 
 	pthread_mutex_lock (&pl_inode->mutex);
 	{
 		if (lock->fl_type != F_UNLCK) {
-			ret = __lock_inodelk (this, pl_inode, lock, can_block, dom);
+                        if (list_empty (&dom->inodelk_list)
+                            && list_empty (&dom->blocked_inodelks)) {
+                                /* fast path, nothing to conflict with */
+                                __grant_inodelk (dom, lock);
+                                ret = 0;
+                        } else {
+                                ret = __lock_inodelk (this, pl_inode, lock,
+                                                      can_block, dom);
+                        }
+
 			if (ret == 0)
 				gf_log (this->name, GF_LOG_TRACE,
                                         "%s (pid=%d) (lk-owner=%"PRIu64") %"PRId64" - %"PRId64" => OK",
@@ -475,7 +537,7 @@ pl_inode_setlk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
                                         lock->fl_start,
                                         lock->fl_end);
 
-			if (ret == -EAGAIN)
+			if (ret == -EAGAIN) {
 				gf_log (this->name, GF_LOG_TRACE,
                                         "%s (pid=%d) (lk-owner=%"PRIu64") %"PRId64" - %"PRId64" => NOK",
 					lock->fl_type == F_UNLCK ? "Unlock" : "Lock",
@@ -484,6 +546,10 @@ pl_inode_setlk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
 					lock->user_flock.l_start,
 					lock->user_flock.l_len);
 
+                                if (can_block)
+                                        pl_domain_blocked (dom->pdomain);
+                        }
+
 			goto out;
 		}
 
@@ -499,28 +565,43 @@ pl_inode_setlk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
 
                 ret = 0;
 
-
+                need_grant = !list_empty (&dom->blocked_inodelks);
 	}
 out:
+        if (!need_grant)
+                unref = __pl_update_refkeeper (pl_inode, inode);
 	pthread_mutex_unlock (&pl_inode->mutex);
-	grant_blocked_inode_locks (this, pl_inode, dom);
+
+        if (unref)
+                inode_unref (unref);
+
+        if (need_grant) {
+                grant_blocked_inode_locks (this, pl_inode, dom);
+                pl_update_refkeeper (this, inode);
+        }
+
         return ret;
 }
 
 /* Create a new inode_lock_t */
 pl_inode_lock_t *
-new_inode_lock (struct flock *flock, void *transport, pid_t client_pid,
-                uint64_t owner, const char *volume)
+new_inode_lock (xlator_t *this, struct flock *flock, void *transport,
+                pid_t client_pid, uint64_t owner, const char *volume)
 
 {
-	pl_inode_lock_t *lock = NULL;
+        posix_locks_private_t *priv = NULL;
+	pl_inode_lock_t       *lock = NULL;
+
+        priv = this->private;
 
-	lock = GF_CALLOC (1, sizeof (*lock),
-                          gf_locks_mt_pl_inode_lock_t);
+	lock = mem_get (priv->inodelk_pool);
 	if (!lock) {
 		return NULL;
 	}
 
+        memset (lock, 0, sizeof (*lock));
+        lock->this       = this;
+
 	lock->fl_start = flock->l_start;
 	lock->fl_type  = flock->l_type;
 
@@ -550,6 +631,7 @@ pl_common_inodelk (call_frame_t *frame, xlator_t *this,
 	int32_t op_errno = 0;
 	int     ret      = -1;
 	int     can_block = 0;
+        int     update_refkeeper = 1;
 	void *                  transport  = NULL;
 	pid_t                   client_pid = -1;
         uint64_t                owner      = -1;
@@ -580,7 +662,13 @@ pl_common_inodelk (call_frame_t *frame, xlator_t *this,
 		goto unwind;
 	}
 
-	dom = get_domain (pinode, volume);
+	dom = get_domain (this, pinode, volume);
+	if (!dom) {
+		gf_log (this->name, GF_LOG_ERROR,
+			"Out of memory.");
+		op_errno = ENOMEM;
+		goto unwind;
+	}
 
 	if (client_pid == 0) {
 		/*
@@ -594,7 +682,8 @@ pl_common_inodelk (call_frame_t *frame, xlator_t *this,
 		goto unwind;
 	}
 
-	reqlock = new_inode_lock (flock, transport, client_pid, owner, volume);
+	reqlock = new_inode_lock (this, flock, transport, client_pid, owner,
+                                  dom->domain);
 
 	if (!reqlock) {
 		gf_log (this->name, GF_LOG_ERROR,
@@ -615,7 +704,8 @@ pl_common_inodelk (call_frame_t *frame, xlator_t *this,
 	case F_SETLK:
 		memcpy (&reqlock->user_flock, flock, sizeof (struct flock));
 		ret = pl_inode_setlk (this, pinode, reqlock,
-                                      can_block, dom);
+                                      can_block, dom, inode);
+                update_refkeeper = 0;
 
 		if (ret < 0) {
                         if (can_block) {
@@ -636,6 +726,7 @@ pl_common_inodelk (call_frame_t *frame, xlator_t *this,
                         "Lock command F_GETLK not supported for [f]inodelk "
                         "(cmd=%d)",
                         cmd);
+                __destroy_inode_lock (reqlock);
                 goto unwind;
         }
 
@@ -643,7 +734,8 @@ pl_common_inodelk (call_frame_t *frame, xlator_t *this,
 
 unwind:
 	if ((inode != NULL) && (flock !=NULL)) {
-		pl_update_refkeeper (this, inode);
+                if (update_refkeeper)
+                        pl_update_refkeeper (this, inode);
 		pl_trace_out (this, frame, fd, loc, cmd, flock, op_ret, op_errno, volume);
 	}
 
@@ -0,0 +1,245 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "interval-tree.h"
+
+
+void
+pl_itree_init (pl_itree_t *tree)
+{
+        tree->root  = NULL;
+        tree->count = 0;
+        tree->seed  = 2463534242U;
+}
+
+
+/* xorshift, good enough to keep the treap balanced */
+static uint32_t
+__pl_itree_prio (pl_itree_t *tree)
+{
+        uint32_t x = tree->seed;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        tree->seed = x;
+
+        return x;
+}
+
+
+static off_t
+__pl_itree_max_end (pl_itree_node_t *node)
+{
+        off_t max_end = node->end;
+
+        if (node->left && (node->left->max_end > max_end))
+                max_end = node->left->max_end;
+
+        if (node->right && (node->right->max_end > max_end))
+                max_end = node->right->max_end;
+
+        return max_end;
+}
+
+
+/* move @node one level up, above its parent */
+static void
+__pl_itree_rotate_up (pl_itree_t *tree, pl_itree_node_t *node)
+{
+        pl_itree_node_t *parent = NULL;
+        pl_itree_node_t *grand  = NULL;
+
+        parent = node->parent;
+        grand  = parent->parent;
+
+        if (parent->left == node) {
+                parent->left = node->right;
+                if (node->right)
+                        node->right->parent = parent;
+                node->right = parent;
+        } else {
+                parent->right = node->left;
+                if (node->left)
+                        node->left->parent = parent;
+                node->left = parent;
+        }
+
+        parent->parent = node;
+        node->parent   = grand;
+
+        if (!grand)
+                tree->root = node;
+        else if (grand->left == parent)
+                grand->left = node;
+        else
+                grand->right = node;
+
+        /* the subtree under @node is what was under @parent, so nothing
+           above needs updating */
+        parent->max_end = __pl_itree_max_end (parent);
+        node->max_end   = __pl_itree_max_end (node);
+}
+
+
+void
+pl_itree_insert (pl_itree_t *tree, pl_itree_node_t *node,
+                 off_t start, off_t end)
+{
+        pl_itree_node_t  *parent = NULL;
+        pl_itree_node_t **link   = NULL;
+
+        node->start   = start;
+        node->end     = end;
+        node->max_end = end;
+        node->left    = NULL;
+        node->right   = NULL;
+        node->prio    = __pl_itree_prio (tree);
+
+        link = &tree->root;
+        while (*link) {
+                parent = *link;
+
+                if (parent->max_end < end)
+                        parent->max_end = end;
+
+                if (start < parent->start)
+                        link = &parent->left;
+                else
+                        link = &parent->right;
+        }
+
+        node->parent = parent;
+        *link = node;
+
+        while (node->parent && (node->prio > node->parent->prio))
+                __pl_itree_rotate_up (tree, node);
+
+        tree->count++;
+}
+
+
+void
+pl_itree_remove (pl_itree_t *tree, pl_itree_node_t *node)
+{
+        pl_itree_node_t *child  = NULL;
+        pl_itree_node_t *parent = NULL;
+
+        /* push it down until it has at most one child */
+        while (node->left && node->right) {
+                if (node->left->prio > node->right->prio)
+                        __pl_itree_rotate_up (tree, node->left);
+                else
+                        __pl_itree_rotate_up (tree, node->right);
+        }
+
+        child  = node->left ? node->left : node->right;
+        parent = node->parent;
+
+        if (child)
+                child->parent = parent;
+
+        if (!parent)
+                tree->root = child;
+        else if (parent->left == node)
+                parent->left = child;
+        else
+                parent->right = child;
+
+        for (; parent; parent = parent->parent)
+                parent->max_end = __pl_itree_max_end (parent);
+
+        node->parent = NULL;
+        node->left   = NULL;
+        node->right  = NULL;
+
+        tree->count--;
+}
+
+
+/*
+ * the leftmost node overlapping [start, end] in the subtree of @node.
+ * once a subtree has a node ending at or after @start, either that
+ * subtree has the leftmost match or there is no match at all, since
+ * everything to its right starts after that node.
+ */
+static pl_itree_node_t *
+__pl_itree_subtree_first (pl_itree_node_t *node, off_t start, off_t end)
+{
+        for (;;) {
+                if (node->left && (node->left->max_end >= start)) {
+                        node = node->left;
+                        continue;
+                }
+
+                if (node->start > end)
+                        return NULL;
+
+                if (node->end >= start)
+                        return node;
+
+                if (!node->right || (node->right->max_end < start))
+                        return NULL;
+
+                node = node->right;
+        }
+}
+
+
+pl_itree_node_t *
+pl_itree_first (pl_itree_t *tree, off_t start, off_t end)
+{
+        if (!tree->root || (tree->root->max_end < start))
+                return NULL;
+
+        return __pl_itree_subtree_first (tree->root, start, end);
+}
+
+
+pl_itree_node_t *
+pl_itree_next (pl_itree_node_t *node, off_t start, off_t end)
+{
+        pl_itree_node_t *prev = NULL;
+
+        for (;;) {
+                if (node->right && (node->right->max_end >= start))
+                        return __pl_itree_subtree_first (node->right,
+                                                         start, end);
+
+                /* climb until we come up from a left child */
+                do {
+                        prev = node;
+                        node = node->parent;
+                        if (!node)
+                                return NULL;
+                } while (node->right == prev);
+
+                if (node->start > end)
+                        return NULL;
+
+                if (node->end >= start)
+                        return node;
+        }
+}
@@ -0,0 +1,90 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PL_INTERVAL_TREE_H__
+#define __PL_INTERVAL_TREE_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/*
+ * An interval tree of lock ranges [start, end]: a treap ordered by start,
+ * where each node also keeps the largest end in its subtree, so that all
+ * the locks overlapping a range can be found in O(log n + matches).
+ *
+ * Nodes are embedded in the locks (like list_heads) and the tree does no
+ * allocation. A node can be in one tree at a time.
+ */
+
+struct pl_itree_node {
+        struct pl_itree_node *parent;
+        struct pl_itree_node *left;
+        struct pl_itree_node *right;
+
+        off_t                 start;
+        off_t                 end;
+        off_t                 max_end;    /* largest end in this subtree */
+        uint32_t              prio;
+};
+typedef struct pl_itree_node pl_itree_node_t;
+
+struct pl_itree {
+        pl_itree_node_t      *root;
+        uint32_t              count;
+        uint32_t              seed;       /* for node priorities */
+};
+typedef struct pl_itree pl_itree_t;
+
+#define pl_itree_entry(ptr, type, member) list_entry(ptr, type, member)
+
+void
+pl_itree_init (pl_itree_t *tree);
+
+void
+pl_itree_insert (pl_itree_t *tree, pl_itree_node_t *node,
+                 off_t start, off_t end);
+
+void
+pl_itree_remove (pl_itree_t *tree, pl_itree_node_t *node);
+
+/* the overlapping node with the lowest start, NULL if there is none */
+pl_itree_node_t *
+pl_itree_first (pl_itree_t *tree, off_t start, off_t end);
+
+/* the overlapping node after @node, in the order of start */
+pl_itree_node_t *
+pl_itree_next (pl_itree_node_t *node, off_t start, off_t end);
+
+/*
+ * walk all the nodes overlapping [start, end]. the tree must not be
+ * changed during the walk.
+ */
+#define pl_itree_for_each_overlap(pos, tree, start, end)                \
+        for (pos = pl_itree_first (tree, start, end); pos;              \
+             pos = pl_itree_next (pos, start, end))
+
+#endif /* __PL_INTERVAL_TREE_H__ */
@@ -33,6 +33,7 @@ enum gf_locks_mem_types_ {
         gf_locks_mt_pl_rw_req_t,
         gf_locks_mt_posix_locks_private_t,
         gf_locks_mt_pl_local_t,
+        gf_locks_mt_pl_domain_t,
         gf_locks_mt_end
 };
 #endif
@@ -28,12 +28,36 @@
 #include "compat-errno.h"
 #include "stack.h"
 #include "call-stub.h"
+#include "mem-pool.h"
 #include "locks-mem-types.h"
+#include "interval-tree.h"
 
 struct __pl_fd;
 
+#define PL_DOMAIN_HASH_SIZE 64
+
+/* lock objects kept ready in each of the inodelk and entrylk pools */
+#define PL_LOCK_POOL_SIZE   1024
+
+/* A lock domain name in use on the brick. The per inode domains point to
+   it, so that they are looked up by pointer, and it counts the inodelks
+   and entrylks of all the inodes in the domain. Freed only in fini. */
+struct __pl_domain {
+        struct list_head   hash;         /* in posix_locks_private_t */
+        char              *name;
+
+        gf_lock_t          lock;         /* for the counters */
+        uint64_t           grants;       /* locks granted */
+        uint64_t           blocks;       /* lock requests that had to wait */
+        uint64_t           releases;     /* granted locks let go */
+        uint64_t           hold_usec;    /* time the released locks were held */
+};
+typedef struct __pl_domain pl_domain_t;
+
 struct __posix_lock {
         struct list_head   list;
+        struct list_head   blocked_locks; /* list_head pointing to blocked_ext_list */
+        pl_itree_node_t    node;          /* in ext_tree while granted */
 
         short              fl_type;
         off_t              fl_start;
@@ -58,6 +82,7 @@ typedef struct __posix_lock posix_lock_t;
 struct __pl_inode_lock {
         struct list_head   list;
         struct list_head   blocked_locks; /* list_head pointing to blocked_inodelks */
+        pl_itree_node_t    node;          /* in inodelk_tree or blocked_inodelk_tree */
 
         short              fl_type;
         off_t              fl_start;
@@ -70,6 +95,7 @@ struct __pl_inode_lock {
         fd_t              *fd;
 
         call_frame_t      *frame;
+        struct timeval     granted;      /* when it was granted */
 
         /* These two together serve to uniquely identify each process
            across nodes */
@@ -89,11 +115,14 @@ typedef struct __pl_rw_req_t pl_rw_req_t;
 
 struct __pl_dom_list_t {
         struct list_head   inode_list;       /* list_head back to pl_inode_t */
-        const char        *domain;
+        const char        *domain;           /* pdomain->name */
+        pl_domain_t       *pdomain;
         struct list_head   entrylk_list;     /* List of entry locks */
         struct list_head   blocked_entrylks; /* List of all blocked entrylks */
         struct list_head   inodelk_list;     /* List of inode locks */
         struct list_head   blocked_inodelks; /* List of all blocked inodelks */
+        pl_itree_t         inodelk_tree;     /* inodelk_list by lock range */
+        pl_itree_t         blocked_inodelk_tree; /* blocked_inodelks by lock range */
 };
 typedef struct __pl_dom_list_t pl_dom_list_t;
 
@@ -103,6 +132,7 @@ struct __entry_lock {
 
         call_frame_t     *frame;
         xlator_t         *this;
+        struct timeval    granted;        /* when it was granted */
 
         const char       *volume;
 
@@ -124,6 +154,8 @@ struct __pl_inode {
 
         struct list_head dom_list;       /* list of domains */
         struct list_head ext_list;       /* list of fcntl locks */
+        struct list_head blocked_ext_list; /* blocked fcntl locks, oldest first */
+        pl_itree_t       ext_tree;       /* granted fcntl locks by range */
         struct list_head rw_list;        /* list of waiting r/w requests */
         int              mandatory;      /* if mandatory locking is enabled */
 
@@ -142,6 +174,12 @@ typedef struct __pl_fd pl_fd_t;
 typedef struct {
         gf_boolean_t    mandatory;      /* if mandatory locking is enabled */
         gf_boolean_t    trace;          /* trace lock requests in and out */
+
+        gf_lock_t         lock;         /* for domains */
+        struct list_head  domains[PL_DOMAIN_HASH_SIZE]; /* pl_domain_t */
+
+        struct mem_pool  *inodelk_pool;
+        struct mem_pool  *entrylk_pool;
 } posix_locks_private_t;
 
 typedef struct {
@@ -79,9 +79,10 @@ truncate_allowed (pl_inode_t *pl_inode,
                   void *transport, pid_t client_pid,
                   uint64_t owner, off_t offset)
 {
-        posix_lock_t *l = NULL;
-        posix_lock_t  region = {.list = {0, }, };
-        int           ret = 1;
+        posix_lock_t    *l = NULL;
+        posix_lock_t     region = {.list = {0, }, };
+        pl_itree_node_t *n = NULL;
+        int              ret = 1;
 
         region.fl_start   = offset;
         region.fl_end     = LLONG_MAX;
@@ -91,10 +92,11 @@ truncate_allowed (pl_inode_t *pl_inode,
 
         pthread_mutex_lock (&pl_inode->mutex);
         {
-                list_for_each_entry (l, &pl_inode->ext_list, list) {
-                        if (!l->blocked
-                            && locks_overlap (&region, l)
-                            && !same_owner (&region, l)) {
+                pl_itree_for_each_overlap (n, &pl_inode->ext_tree,
+                                           region.fl_start, region.fl_end) {
+                        l = pl_itree_entry (n, posix_lock_t, node);
+
+                        if (!same_owner (&region, l)) {
                                 ret = 0;
                                 break;
                         }
@@ -251,11 +253,11 @@ delete_locks_of_fd (xlator_t *this, pl_inode_t *pl_inode, fd_t *fd)
 
                list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
                        if ((l->fd_num == fd_to_fdnum(fd))) {
+                               __delete_lock (pl_inode, l);
                                if (l->blocked) {
-                                       list_move_tail (&l->list, &blocked_list);
+                                       list_add_tail (&l->list, &blocked_list);
                                        continue;
                                }
-                               __delete_lock (pl_inode, l);
                                __destroy_lock (l);
                        }
                }
@@ -533,11 +535,15 @@ static int
 __rw_allowable (pl_inode_t *pl_inode, posix_lock_t *region,
                 glusterfs_fop_t op)
 {
-        posix_lock_t *l = NULL;
-        int           ret = 1;
+        posix_lock_t    *l = NULL;
+        pl_itree_node_t *n = NULL;
+        int              ret = 1;
 
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (locks_overlap (l, region) && !same_owner (l, region)) {
+        pl_itree_for_each_overlap (n, &pl_inode->ext_tree,
+                                   region->fl_start, region->fl_end) {
+                l = pl_itree_entry (n, posix_lock_t, node);
+
+                if (!same_owner (l, region)) {
                         if ((op == GF_FOP_READ) && (l->fl_type != F_WRLCK))
                                 continue;
                         ret = 0;
@@ -904,7 +910,7 @@ pl_forget (xlator_t *this,
 					"Pending inode locks found, releasing.");
 
 				list_for_each_entry_safe (ino_l, ino_tmp, &dom->inodelk_list, list) {
-					__delete_inode_lock (ino_l);
+					__delete_inode_lock (dom, ino_l);
 					__destroy_inode_lock (ino_l);
 				}
 
@@ -919,9 +925,9 @@ pl_forget (xlator_t *this,
 				list_for_each_entry_safe (entry_l, entry_tmp, &dom->entrylk_list, domain_list) {
 					list_del_init (&entry_l->domain_list);
 
-					if (entry_l->basename)
-						GF_FREE ((char *)entry_l->basename);
-					GF_FREE (entry_l);
+                                        pl_domain_released (dom->pdomain,
+                                                            &entry_l->granted);
+                                        __destroy_entry_lock (entry_l);
 				}
 
 				list_splice_init (&dom->blocked_entrylks, &entrylks_released);
@@ -930,7 +936,6 @@ pl_forget (xlator_t *this,
 			list_del (&dom->inode_list);
 			gf_log ("posix-locks", GF_LOG_TRACE,
 				" Cleaning up domain: %s", dom->domain);
-			GF_FREE ((char *)(dom->domain));
 			GF_FREE (dom);
 		}
 
@@ -952,9 +957,7 @@ pl_forget (xlator_t *this,
 	list_for_each_entry_safe (entry_l, entry_tmp, &entrylks_released, blocked_locks) {
 
 		STACK_UNWIND_STRICT (entrylk, entry_l->frame, -1, 0);
-		if (entry_l->basename)
-			GF_FREE ((char *)entry_l->basename);
-		GF_FREE (entry_l);
+                __destroy_entry_lock (entry_l);
 
 	}
 
@@ -1421,6 +1424,69 @@ pl_dump_inode_priv (xlator_t *this, inode_t *inode)
 
 
 
+/*
+ * pl_priv_dump - grant/block counters of each lock domain seen by this
+ * brick
+ */
+int
+pl_priv_dump (xlator_t *this)
+{
+        posix_locks_private_t *priv    = NULL;
+        pl_domain_t           *pdomain = NULL;
+        char                   key_prefix[GF_DUMP_MAX_BUF_LEN];
+        char                   key[GF_DUMP_MAX_BUF_LEN];
+        uint64_t               grants    = 0;
+        uint64_t               blocks    = 0;
+        uint64_t               releases  = 0;
+        uint64_t               hold_usec = 0;
+        int                    i = 0;
+
+        assert (this);
+        priv = this->private;
+
+        assert (priv);
+
+        gf_proc_dump_build_key (key_prefix, "xlator.features.locks",
+                                "priv");
+        gf_proc_dump_add_section (key_prefix);
+
+        LOCK (&priv->lock);
+        {
+                for (i = 0; i < PL_DOMAIN_HASH_SIZE; i++) {
+                        list_for_each_entry (pdomain, &priv->domains[i],
+                                             hash) {
+                                LOCK (&pdomain->lock);
+                                {
+                                        grants    = pdomain->grants;
+                                        blocks    = pdomain->blocks;
+                                        releases  = pdomain->releases;
+                                        hold_usec = pdomain->hold_usec;
+                                }
+                                UNLOCK (&pdomain->lock);
+
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "%s.grants",
+                                                        pdomain->name);
+                                gf_proc_dump_write (key, "%"PRIu64, grants);
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "%s.blocks",
+                                                        pdomain->name);
+                                gf_proc_dump_write (key, "%"PRIu64, blocks);
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "%s.avg_hold_usec",
+                                                        pdomain->name);
+                                gf_proc_dump_write (key, "%"PRIu64,
+                                                    releases ?
+                                                    hold_usec / releases : 0);
+                        }
+                }
+        }
+        UNLOCK (&priv->lock);
+
+        return 0;
+}
+
+
 /*
  * pl_dump_inode - inode dump function for posix locks
  *
@@ -1465,6 +1531,7 @@ init (xlator_t *this)
         xlator_list_t         *trav = NULL;
         data_t                *mandatory = NULL;
 	data_t                *trace = NULL;
+        int                    i = 0;
 
         if (!this->children || this->children->next) {
                 gf_log (this->name, GF_LOG_CRITICAL,
@@ -1490,6 +1557,24 @@ init (xlator_t *this)
 
 	priv = GF_CALLOC (1, sizeof (*priv),
                           gf_locks_mt_posix_locks_private_t);
+        if (!priv) {
+                gf_log (this->name, GF_LOG_ERROR, "Out of memory.");
+                return -1;
+        }
+
+        LOCK_INIT (&priv->lock);
+        for (i = 0; i < PL_DOMAIN_HASH_SIZE; i++)
+                INIT_LIST_HEAD (&priv->domains[i]);
+
+        priv->inodelk_pool = mem_pool_new (pl_inode_lock_t,
+                                           PL_LOCK_POOL_SIZE);
+        priv->entrylk_pool = mem_pool_new (pl_entry_lock_t,
+                                           PL_LOCK_POOL_SIZE);
+        if (!priv->inodelk_pool || !priv->entrylk_pool) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not create lock pools");
+                goto err;
+        }
 
         mandatory = dict_get (this->options, "mandatory-locks");
         if (mandatory)
@@ -1502,21 +1587,52 @@ init (xlator_t *this)
 				       &priv->trace) == -1) {
 			gf_log (this->name, GF_LOG_ERROR,
 				"'trace' takes on only boolean values.");
-			return -1;
+			goto err;
 		}
 	}
 
         this->private = priv;
         return 0;
+
+err:
+        if (priv->inodelk_pool)
+                mem_pool_destroy (priv->inodelk_pool);
+        if (priv->entrylk_pool)
+                mem_pool_destroy (priv->entrylk_pool);
+        LOCK_DESTROY (&priv->lock);
+        GF_FREE (priv);
+
+        return -1;
 }
 
 
 int
 fini (xlator_t *this)
 {
-        posix_locks_private_t *priv = NULL;
+        posix_locks_private_t *priv    = NULL;
+        pl_domain_t           *pdomain = NULL;
+        pl_domain_t           *tmp     = NULL;
+        int                    i = 0;
 
         priv = this->private;
+        if (!priv)
+                return 0;
+
+        for (i = 0; i < PL_DOMAIN_HASH_SIZE; i++) {
+                list_for_each_entry_safe (pdomain, tmp, &priv->domains[i],
+                                          hash) {
+                        list_del (&pdomain->hash);
+                        LOCK_DESTROY (&pdomain->lock);
+                        GF_FREE (pdomain->name);
+                        GF_FREE (pdomain);
+                }
+        }
+
+        mem_pool_destroy (priv->inodelk_pool);
+        mem_pool_destroy (priv->entrylk_pool);
+        LOCK_DESTROY (&priv->lock);
+
+        this->private = NULL;
         GF_FREE (priv);
 
         return 0;
@@ -1560,6 +1676,7 @@ struct xlator_fops fops = {
 
 struct xlator_dumpops dumpops = {
         .inodectx    = pl_dump_inode_priv,
+        .priv        = pl_priv_dump,
 };
 
 struct xlator_cbks cbks = {
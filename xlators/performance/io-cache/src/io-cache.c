@@ -26,6 +26,7 @@
 #include "logging.h"
 #include "dict.h"
 #include "xlator.h"
+#include "defaults.h"
 #include "io-cache.h"
 #include "ioc-mem-types.h"
 #include "statedump.h"
@@ -51,35 +52,15 @@ ioc_hashfn (void *data, int len)
         return (offset >> ioc_log2_page_size);
 }
 
-inline ioc_inode_t *
-ioc_inode_reupdate (ioc_inode_t *ioc_inode)
-{
-	ioc_table_t *table = ioc_inode->table;
-
-	list_add_tail (&ioc_inode->inode_lru, 
-		       &table->inode_lru[ioc_inode->weight]);
-  
-	return ioc_inode;
-}
-
 inline ioc_inode_t *
 ioc_get_inode (dict_t *dict, char *name)
 {
 	ioc_inode_t *ioc_inode = NULL;
 	data_t      *ioc_inode_data = dict_get (dict, name);
-	ioc_table_t *table = NULL;
 
 	if (ioc_inode_data) {
 		ioc_inode = data_to_ptr (ioc_inode_data);
-		table = ioc_inode->table;
-
-		ioc_table_lock (table);
-		{
-			if (list_empty (&ioc_inode->inode_lru)) {
-				ioc_inode = ioc_inode_reupdate (ioc_inode);
-			}
-		}
-		ioc_table_unlock (table);
+		ioc_inode_touch (ioc_inode);
 	}
   
 	return ioc_inode;
@@ -92,6 +73,9 @@ ioc_inode_need_revalidate (ioc_inode_t *ioc_inode)
 	struct timeval tv = {0,};
 	ioc_table_t    *table = ioc_inode->table;
 
+        if (table->cache_invalidation && !table->invalidation_refused)
+                return 0;
+
 	gettimeofday (&tv, NULL);
 
 	if (time_elapsed (&tv, &ioc_inode->cache.tv) >= table->cache_timeout)
@@ -137,11 +121,11 @@ ioc_inode_flush (ioc_inode_t *ioc_inode)
 	ioc_inode_unlock (ioc_inode);
   
 	if (destroy_size) {
-		ioc_table_lock (ioc_inode->table);
+		ioc_shard_lock (ioc_inode->shard);
 		{
-			ioc_inode->table->cache_used -= destroy_size;
+			ioc_inode->shard->cache_used -= destroy_size;
 		}
-		ioc_table_unlock (ioc_inode->table);
+		ioc_shard_unlock (ioc_inode->shard);
 	}
 
 	return;
@@ -235,12 +219,7 @@ ioc_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 ioc_inode_flush (ioc_inode);
         } 
 		
-        ioc_table_lock (ioc_inode->table);
-        {
-                list_move_tail (&ioc_inode->inode_lru,
-                                &table->inode_lru[ioc_inode->weight]);
-        }
-        ioc_table_unlock (ioc_inode->table);
+        ioc_inode_touch (ioc_inode);
 	
 out:
         if (frame->local != NULL) {
@@ -357,11 +336,11 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	}
 
 	if (destroy_size) {
-		ioc_table_lock (ioc_inode->table);
+		ioc_shard_lock (ioc_inode->shard);
 		{
-			ioc_inode->table->cache_used -= destroy_size;
+			ioc_inode->shard->cache_used -= destroy_size;
 		}
-		ioc_table_unlock (ioc_inode->table);
+		ioc_shard_unlock (ioc_inode->shard);
 	}
 
 	if (op_ret < 0)
@@ -530,12 +509,7 @@ ioc_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                 inode_ctx_get (fd->inode, this, &tmp_ioc_inode);
                 ioc_inode = (ioc_inode_t *)(long)tmp_ioc_inode;
                         
-                ioc_table_lock (ioc_inode->table);
-                {
-                        list_move_tail (&ioc_inode->inode_lru,
-                                        &table->inode_lru[ioc_inode->weight]);
-                }
-                ioc_table_unlock (ioc_inode->table);
+                ioc_inode_touch (ioc_inode);
 
                 ioc_inode_lock (ioc_inode);
                 {
@@ -845,21 +819,62 @@ ioc_readv_disabled_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 }
 
 
-int32_t
-ioc_need_prune (ioc_table_t *table)
+/*
+ * ioc_cache_used - what all the shards hold together. read without the
+ *                  shard locks, it is only used to decide on pruning.
+ */
+uint64_t
+ioc_cache_used (ioc_table_t *table)
 {
-	int64_t cache_difference = 0;
-  
-	ioc_table_lock (table);
-	{
-		cache_difference = table->cache_used - table->cache_size;
-	}
-	ioc_table_unlock (table);
+        uint64_t cache_used = 0;
+        uint32_t i = 0;
 
-	if (cache_difference > 0)
-		return 1;
-	else 
-		return 0;
+        for (i = 0; i < table->shard_count; i++)
+                cache_used += table->shards[i].cache_used;
+
+        return cache_used;
+}
+
+/*
+ * ioc_need_prune - a shard may hold more than its share of cache-size as
+ *                  long as the whole cache is within cache-size, so that
+ *                  one hot file is not held to a fraction of the cache.
+ *                  once the cache is full, @shard is pruned if it is over
+ *                  its share, or else the shard which is most over its
+ *                  share.
+ *
+ * @shard: shard which just grew
+ */
+ioc_shard_t *
+ioc_need_prune (ioc_shard_t *shard)
+{
+        ioc_table_t *table  = NULL;
+        ioc_shard_t *victim = NULL;
+        int64_t      excess = 0;
+        int64_t      most   = 0;
+        uint32_t     i      = 0;
+
+        table = shard->table;
+
+        if (ioc_cache_used (table) <= table->cache_size)
+                goto out;
+
+        if (shard->cache_used > shard->cache_size) {
+                victim = shard;
+                goto out;
+        }
+
+        for (i = 0; i < table->shard_count; i++) {
+                excess = table->shards[i].cache_used
+                        - table->shards[i].cache_size;
+                if (excess > most) {
+                        most = excess;
+                        victim = &table->shards[i];
+                }
+        }
+
+out:
+        return victim;
 }
 
 /*
@@ -876,6 +891,7 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 {
 	ioc_local_t *local = NULL;
 	ioc_table_t *table = NULL;
+        ioc_shard_t *shard = NULL;
 	ioc_page_t  *trav = NULL;
 	ioc_waitq_t *waitq = NULL;
 	off_t       rounded_offset = 0;
@@ -975,7 +991,7 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 
 		if (fault) {
 			fault = 0;
-			/* new page created, increase the table->cache_used */
+			/* new page created, increase the shard->cache_used */
 			ioc_page_fault (ioc_inode, frame, fd, trav_offset);
 		}
 
@@ -1005,8 +1021,9 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 out:
 	ioc_frame_return (frame);
 
-	if (ioc_need_prune (ioc_inode->table)) {
-		ioc_prune (ioc_inode->table);
+        shard = ioc_need_prune (ioc_inode->shard);
+	if (shard) {
+		ioc_prune (shard);
 	}
 
 	return;
@@ -1030,9 +1047,7 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
 	uint64_t     tmp_ioc_inode = 0;
 	ioc_inode_t  *ioc_inode = NULL;
 	ioc_local_t  *local = NULL;
-	uint32_t     weight = 0;
         ioc_table_t  *table = NULL;
-        uint32_t     num_pages = 0;
         int32_t      op_errno = -1;
 
         if (!this) {
@@ -1060,28 +1075,6 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
         }
 
 
-        ioc_table_lock (table);
-        {
-                if (!table->mem_pool) {
-
-                        num_pages = (table->cache_size / table->page_size)
-                                + ((table->cache_size % table->page_size) 
-                                ? 1 : 0);
-
-                        table->mem_pool
-                                =  mem_pool_new (rbthash_entry_t, num_pages);
-
-                        if (!table->mem_pool) {
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "Unable to allocate mem_pool");
-                                op_errno = ENOMEM;
-                                ioc_table_unlock (table);
-                                goto out;
-                        }
-                }
-        }
-        ioc_table_unlock (table);
-
         ioc_inode_lock (ioc_inode);
         {
                 if (!ioc_inode->cache.page_table) {
@@ -1130,14 +1123,7 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
 		"NEW REQ (%p) offset = %"PRId64" && size = %"GF_PRI_SIZET"", 
 		frame, offset, size);
 
-	weight = ioc_inode->weight;
-
-	ioc_table_lock (ioc_inode->table);
-	{
-		list_move_tail (&ioc_inode->inode_lru, 
-				&ioc_inode->table->inode_lru[weight]);
-	}
-	ioc_table_unlock (ioc_inode->table);
+	ioc_inode_touch (ioc_inode);
 
 	ioc_dispatch_requests (frame, ioc_inode, fd, offset, size);
 	return 0;
@@ -1463,6 +1449,26 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+static void
+ioc_shards_destroy (ioc_table_t *table)
+{
+        uint32_t i = 0;
+
+        if (table->shards == NULL)
+                return;
+
+        for (i = 0; i < table->shard_count; i++) {
+                if (table->shards[i].inode_lru == NULL)
+                        break;
+
+                pthread_mutex_destroy (&table->shards[i].shard_lock);
+                GF_FREE (table->shards[i].inode_lru);
+        }
+
+        GF_FREE (table->shards);
+        table->shards = NULL;
+}
+
 /*
  * init - 
  * @this:
@@ -1472,8 +1478,11 @@ int32_t
 init (xlator_t *this)
 {
 	ioc_table_t     *table = NULL;
+        ioc_shard_t     *shard = NULL;
 	dict_t          *options = this->options;
 	uint32_t         index = 0;
+        uint32_t         i = 0;
+        uint32_t         num_pages = 0;
 	char            *cache_size_string = NULL, *tmp = NULL;
         int32_t          ret = -1;
         glusterfs_ctx_t *ctx = NULL;
@@ -1575,8 +1584,6 @@ init (xlator_t *this)
                 gf_log (this->name, GF_LOG_TRACE,
                         "using max-file-size %"PRIu64"", table->max_file_size);
         }
-	INIT_LIST_HEAD (&table->inodes);
-  
         if ((table->max_file_size >= 0)
             && (table->min_file_size > table->max_file_size)) {
                         gf_log ("io-cache", GF_LOG_ERROR, "minimum size (%"
@@ -1586,17 +1593,76 @@ init (xlator_t *this)
                         goto out;
         }
 
-	table->inode_lru = GF_CALLOC (table->max_pri, 
-                                      sizeof (struct list_head),
-                                      gf_ioc_mt_list_head);
-        if (table->inode_lru == NULL) {
+        tmp = data_to_str (dict_get (options, "cache-invalidation"));
+        if (tmp != NULL) {
+                if (gf_string2boolean (tmp,
+                                       &table->cache_invalidation) != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'cache-invalidation' takes only boolean "
+                                "options");
+                        goto out;
+                }
+
+                gf_log (this->name, GF_LOG_TRACE,
+                        "cache-invalidation %s",
+                        table->cache_invalidation ? "on" : "off");
+        }
+
+        table->shard_count = IOC_SHARD_COUNT;
+        if (dict_get (options, "shard-count")) {
+                table->shard_count =
+                        data_to_uint32 (dict_get (options, "shard-count"));
+                gf_log (this->name, GF_LOG_TRACE,
+                        "using shard-count %u", table->shard_count);
+        }
+
+        if ((table->shard_count < 1)
+            || (table->shard_count > IOC_MAX_SHARD_COUNT)) {
+                gf_log ("io-cache", GF_LOG_ERROR,
+                        "shard-count %u is out of range (1 - %d)",
+                        table->shard_count, IOC_MAX_SHARD_COUNT);
                 goto out;
         }
 
-	for (index = 0; index < (table->max_pri); index++)
-		INIT_LIST_HEAD (&table->inode_lru[index]);
+        table->shards = GF_CALLOC (table->shard_count, sizeof (ioc_shard_t),
+                                   gf_ioc_mt_ioc_shard_t);
+        if (table->shards == NULL) {
+                goto out;
+        }
+
+        for (i = 0; i < table->shard_count; i++) {
+                shard = &table->shards[i];
+
+                shard->table = table;
+                shard->cache_size = table->cache_size / table->shard_count;
+                if (i < (table->cache_size % table->shard_count))
+                        shard->cache_size++;
+
+                INIT_LIST_HEAD (&shard->inodes);
+
+                shard->inode_lru = GF_CALLOC (table->max_pri,
+                                              sizeof (struct list_head),
+                                              gf_ioc_mt_list_head);
+                if (shard->inode_lru == NULL) {
+                        goto out;
+                }
+
+                for (index = 0; index < (table->max_pri); index++)
+                        INIT_LIST_HEAD (&shard->inode_lru[index]);
+
+                pthread_mutex_init (&shard->shard_lock, NULL);
+        }
+
+        num_pages = (table->cache_size / table->page_size)
+                + ((table->cache_size % table->page_size) ? 1 : 0);
+
+        table->mem_pool = mem_pool_new (rbthash_entry_t, num_pages);
+        if (!table->mem_pool) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Unable to allocate mem_pool");
+                goto out;
+        }
 
-	pthread_mutex_init (&table->table_lock, NULL);
 	this->private = table;
         ret = 0;
 
@@ -1606,7 +1672,7 @@ init (xlator_t *this)
 out:
         if (ret == -1) {
                 if (table != NULL) {
-                        GF_FREE (table->inode_lru);
+                        ioc_shards_destroy (table);
                         GF_FREE (table);
                 }
         }
@@ -1614,12 +1680,86 @@ out:
 	return ret;
 }
 
+/*
+ * ioc_flush_all - drop the pages of every cached inode. invalidations
+ *                 sent while we were not connected are lost, so nothing
+ *                 cached from before can be trusted.
+ */
+void
+ioc_flush_all (ioc_table_t *table)
+{
+        ioc_shard_t *shard = NULL;
+        ioc_inode_t *curr = NULL;
+        uint32_t     i = 0;
+
+        for (i = 0; i < table->shard_count; i++) {
+                shard = &table->shards[i];
+
+                ioc_shard_lock (shard);
+                {
+                        list_for_each_entry (curr, &shard->inodes,
+                                             inode_list) {
+                                ioc_inode_lock (curr);
+                                {
+                                        shard->cache_used -=
+                                                __ioc_inode_flush (curr);
+                                }
+                                ioc_inode_unlock (curr);
+                        }
+                }
+                ioc_shard_unlock (shard);
+        }
+}
+
+
+int
+notify (xlator_t *this, int32_t event, void *data, ...)
+{
+        ioc_table_t *table = NULL;
+        uint64_t     ioc_inode = 0;
+
+        table = this->private;
+
+        switch (event) {
+        case GF_EVENT_UPCALL:
+                inode_ctx_get ((inode_t *) data, this, &ioc_inode);
+                if (ioc_inode)
+                        ioc_inode_flush ((ioc_inode_t *)(long)ioc_inode);
+                break;
+
+        case GF_EVENT_UPCALL_UNAVAILABLE:
+                if (table && table->cache_invalidation
+                    && !table->invalidation_refused) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "a brick does not send cache invalidations, "
+                                "revalidating after cache-timeout");
+                        table->invalidation_refused = 1;
+                }
+                break;
+
+        case GF_EVENT_CHILD_UP:
+        case GF_EVENT_CHILD_DOWN:
+                if (table && table->cache_invalidation)
+                        ioc_flush_all (table);
+                break;
+
+        default:
+                break;
+        }
+
+        return default_notify (this, event, data);
+}
+
+
 int
 ioc_priv_dump (xlator_t *this)
 {
         ioc_table_t     *priv = NULL;
+        ioc_shard_t     *shard = NULL;
         char            key_prefix[GF_DUMP_MAX_BUF_LEN];
         char            key[GF_DUMP_MAX_BUF_LEN];
+        uint32_t        inode_count = 0;
+        uint32_t        i = 0;
 
         assert (this);
         priv = this->private;
@@ -1635,9 +1775,26 @@ ioc_priv_dump (xlator_t *this)
         gf_proc_dump_build_key (key, key_prefix, "cache_size");
         gf_proc_dump_write (key, "%ld", priv->cache_size);
         gf_proc_dump_build_key (key, key_prefix, "cache_used");
-        gf_proc_dump_write (key, "%ld", priv->cache_used);
+        gf_proc_dump_write (key, "%"PRIu64, ioc_cache_used (priv));
+        gf_proc_dump_build_key (key, key_prefix, "cache_invalidation");
+        gf_proc_dump_write (key, "%d", priv->cache_invalidation);
+        gf_proc_dump_build_key (key, key_prefix, "invalidation_refused");
+        gf_proc_dump_write (key, "%d", priv->invalidation_refused);
+
+        for (i = 0; i < priv->shard_count; i++) {
+                shard = &priv->shards[i];
+                inode_count += shard->inode_count;
+
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard.%u.cache_used", i);
+                gf_proc_dump_write (key, "%"PRIu64, shard->cache_used);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard.%u.inode_count", i);
+                gf_proc_dump_write (key, "%u", shard->inode_count);
+        }
+
         gf_proc_dump_build_key (key, key_prefix, "inode_count");
-        gf_proc_dump_write (key, "%u", priv->inode_count);
+        gf_proc_dump_write (key, "%u", inode_count);
 
         return 0;
 }
@@ -1663,7 +1820,7 @@ fini (xlator_t *this)
                 table->mem_pool = NULL;
         }
 
-	pthread_mutex_destroy (&table->table_lock);
+        ioc_shards_destroy (table);
 	GF_FREE (table);
 
 	this->private = NULL;
@@ -1717,5 +1874,13 @@ struct volume_options options[] = {
           .min  = -1,
           .max  = -1
         },
+        { .key  = {"shard-count"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = IOC_MAX_SHARD_COUNT
+        },
+        { .key  = {"cache-invalidation"},
+          .type = GF_OPTION_TYPE_BOOL
+        },
 	{ .key = {NULL} },
 };
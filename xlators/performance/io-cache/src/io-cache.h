@@ -42,8 +42,11 @@
 #define IOC_PAGE_SIZE    (1024 * 128)   /* 128KB */
 #define IOC_CACHE_SIZE   (32 * 1024 * 1024)
 #define IOC_PAGE_TABLE_BUCKET_COUNT 1
+#define IOC_SHARD_COUNT  16
+#define IOC_MAX_SHARD_COUNT 64
 
 struct ioc_table;
+struct ioc_shard;
 struct ioc_local;
 struct ioc_page;
 struct ioc_inode;
@@ -107,6 +110,8 @@ struct ioc_local {
 	fd_t             *fd;
 	int32_t          need_xattr;
 	dict_t           *xattr_req;
+        uint64_t         invalidations;  /* of the inode when a page fault
+                                            was sent */
 };
 
 /*
@@ -126,6 +131,9 @@ struct ioc_page {
 	struct ioc_waitq    *waitq;
 	struct iobref       *iobref;
 	pthread_mutex_t     page_lock;
+        char                referenced; /* read since ioc_prune last
+                                         * looked at it
+                                         */
 };
 
 struct ioc_cache {
@@ -144,6 +152,7 @@ struct ioc_cache {
 
 struct ioc_inode {
 	struct ioc_table      *table;
+        struct ioc_shard      *shard;
         off_t                  ia_size;
         struct ioc_cache       cache;        
 	struct list_head       inode_list; /*
@@ -157,28 +166,49 @@ struct ioc_inode {
                                              * weight of the inode, increases
                                              * on each read
                                              */
+        char                   referenced;  /*
+                                             * read since ioc_prune last
+                                             * looked at it
+                                             */
+};
+
+/*
+ * ioc_shard - inodes are spread over the shards by hash. each shard has
+ *             its own lock, lru lists and share of cache-size, so that
+ *             readers of different files do not contend on one lock.
+ */
+struct ioc_shard {
+        struct ioc_table *table;
+        uint64_t          cache_size;  /* this shard's share */
+        uint64_t          cache_used;
+        struct list_head  inodes;      /* list of inodes cached */
+        struct list_head *inode_lru;   /* one list per priority */
+        uint32_t          inode_count;
+        pthread_mutex_t   shard_lock;
 };
 
 struct ioc_table {
 	uint64_t         page_size;
 	uint64_t         cache_size;
-	uint64_t         cache_used;
         int64_t          min_file_size;
         int64_t          max_file_size;
-	struct list_head inodes; /* list of inodes cached */
 	struct list_head active; 
-	struct list_head *inode_lru;
 	struct list_head priority_list;
 	int32_t          readv_count;
-	pthread_mutex_t  table_lock;
 	xlator_t         *xl;
-	uint32_t         inode_count;
 	int32_t          cache_timeout;
 	int32_t          max_pri;
         struct mem_pool  *mem_pool;
+        struct ioc_shard *shards;
+        uint32_t          shard_count;
+        gf_boolean_t      cache_invalidation; /* the bricks tell us about
+                                                 changes, no revalidation */
+        gf_boolean_t      invalidation_refused; /* a brick does not, so
+                                                   revalidate after all */
 };
 
 typedef struct ioc_table ioc_table_t;
+typedef struct ioc_shard ioc_shard_t;
 typedef struct ioc_local ioc_local_t;
 typedef struct ioc_page ioc_page_t;
 typedef struct ioc_inode ioc_inode_t;
@@ -248,19 +278,19 @@ ioc_frame_fill (ioc_page_t *page, call_frame_t *frame, off_t offset,
 	} while (0)
 
 
-#define ioc_table_lock(table)					\
+#define ioc_shard_lock(shard)					\
 	do {							\
-		gf_log (table->xl->name, GF_LOG_TRACE,		\
-			"locked table(%p)", table);		\
-		pthread_mutex_lock (&table->table_lock);	\
+		gf_log (shard->table->xl->name, GF_LOG_TRACE,	\
+			"locked shard(%p)", shard);		\
+		pthread_mutex_lock (&shard->shard_lock);	\
 	} while (0)
 
 
-#define ioc_table_unlock(table)					\
+#define ioc_shard_unlock(shard)					\
 	do {							\
-		gf_log (table->xl->name, GF_LOG_TRACE,		\
-			"unlocked table(%p)", table);		\
-		pthread_mutex_unlock (&table->table_lock);	\
+		gf_log (shard->table->xl->name, GF_LOG_TRACE,	\
+			"unlocked shard(%p)", shard);		\
+		pthread_mutex_unlock (&shard->shard_lock);	\
 	} while (0)
 
 
@@ -333,11 +363,17 @@ ioc_inode_wakeup (call_frame_t *frame, ioc_inode_t *ioc_inode,
 int8_t
 ioc_cache_still_valid (ioc_inode_t *ioc_inode, struct iatt *stbuf);
 
-int32_t
-ioc_prune (ioc_table_t *table);
+void
+ioc_inode_touch (ioc_inode_t *ioc_inode);
+
+uint64_t
+ioc_cache_used (ioc_table_t *table);
 
 int32_t
-ioc_need_prune (ioc_table_t *table);
+ioc_prune (ioc_shard_t *shard);
+
+ioc_shard_t *
+ioc_need_prune (ioc_shard_t *shard);
 
 inline uint32_t
 ioc_hashfn (void *data, int len);
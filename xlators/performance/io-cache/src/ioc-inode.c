@@ -156,7 +156,8 @@ ioc_inode_t *
 ioc_inode_update (ioc_table_t *table, inode_t *inode, uint32_t weight)
 {
 	ioc_inode_t     *ioc_inode   = NULL;
-        unsigned long    no_of_pages = 0;
+        ioc_shard_t     *shard       = NULL;
+        uint32_t         hash        = 0;
 
         ioc_inode = GF_CALLOC (1, sizeof (ioc_inode_t),
                                gf_ioc_mt_ioc_inode_t);
@@ -164,24 +165,25 @@ ioc_inode_update (ioc_table_t *table, inode_t *inode, uint32_t weight)
                 goto out;
         }
   
-	ioc_inode->table = table;
+        hash = SuperFastHash ((char *)&inode, sizeof (inode));
+        shard = &table->shards[hash % table->shard_count];
 
-        no_of_pages = (table->cache_size / table->page_size)
-                + ((table->cache_size % table->page_size) ? 1 : 0);
+	ioc_inode->table = table;
+        ioc_inode->shard = shard;
 
 	INIT_LIST_HEAD (&ioc_inode->cache.page_lru);
 
-	ioc_table_lock (table);
+	ioc_shard_lock (shard);
 
-	table->inode_count++;
-	list_add (&ioc_inode->inode_list, &table->inodes);
-	list_add_tail (&ioc_inode->inode_lru, &table->inode_lru[weight]);
+	shard->inode_count++;
+	list_add (&ioc_inode->inode_list, &shard->inodes);
+	list_add_tail (&ioc_inode->inode_lru, &shard->inode_lru[weight]);
 
 	gf_log (table->xl->name,
 		GF_LOG_TRACE,
-		"adding to inode_lru[%d]", weight);
+		"adding to inode_lru[%d] of shard %p", weight, shard);
 
-	ioc_table_unlock (table);
+	ioc_shard_unlock (shard);
 
 	pthread_mutex_init (&ioc_inode->inode_lock, NULL);
 	ioc_inode->weight = weight;
@@ -201,15 +203,15 @@ out:
 void
 ioc_inode_destroy (ioc_inode_t *ioc_inode)
 {
-	ioc_table_t *table = NULL;
+	ioc_shard_t *shard = NULL;
 
-        table = ioc_inode->table;
+        shard = ioc_inode->shard;
 
-	ioc_table_lock (table);
-	table->inode_count--;
+	ioc_shard_lock (shard);
+	shard->inode_count--;
 	list_del (&ioc_inode->inode_list);
 	list_del (&ioc_inode->inode_lru);
-	ioc_table_unlock (table);
+	ioc_shard_unlock (shard);
   
 	ioc_inode_flush (ioc_inode);
         rbthash_table_destroy (ioc_inode->cache.page_table);
@@ -217,3 +219,34 @@ ioc_inode_destroy (ioc_inode_t *ioc_inode)
 	pthread_mutex_destroy (&ioc_inode->inode_lock);
 	GF_FREE (ioc_inode);
 }
+
+
+/*
+ * ioc_inode_touch - mark the inode as recently used. only the reference
+ *                   bit is set, which ioc_prune looks at. the shard is
+ *                   locked only if pruning had taken the inode off its
+ *                   lru list.
+ *
+ * @ioc_inode: 
+ */
+void
+ioc_inode_touch (ioc_inode_t *ioc_inode)
+{
+        ioc_shard_t *shard = NULL;
+
+        shard = ioc_inode->shard;
+
+        ioc_inode->referenced = 1;
+
+        if (!list_empty (&ioc_inode->inode_lru))
+                return;
+
+        ioc_shard_lock (shard);
+        {
+                if (list_empty (&ioc_inode->inode_lru)) {
+                        list_add_tail (&ioc_inode->inode_lru,
+                                       &shard->inode_lru[ioc_inode->weight]);
+                }
+        }
+        ioc_shard_unlock (shard);
+}
@@ -51,8 +51,8 @@ ioc_page_get (ioc_inode_t *ioc_inode, off_t offset)
                             sizeof (rounded_offset));
 
         if (page != NULL) {
-		/* push the page to the end of the lru list */
-		list_move_tail (&page->page_lru, &ioc_inode->cache.page_lru);
+		/* ioc_prune moves it to the end of the lru list */
+		page->referenced = 1;
 	}
 
 	return page;
@@ -102,77 +102,132 @@ ioc_page_destroy (ioc_page_t *page)
 	return page_size;
 }
 
+/*
+ * __ioc_inode_prune - destroy pages of the inode, oldest first, till
+ *                     @size_to_prune bytes are freed. pages read since
+ *                     the last pass get a second chance instead and move
+ *                     to the end of the list.
+ *
+ * @ioc_inode:
+ * @size_to_prune:
+ *
+ * assumes the inode lock is held
+ */
+static uint64_t
+__ioc_inode_prune (ioc_inode_t *ioc_inode, uint64_t size_to_prune)
+{
+	ioc_page_t  *page = NULL, *next = NULL;
+	int64_t     ret = 0;
+	uint64_t    size_pruned = 0;
+
+	list_for_each_entry_safe (page, next, &ioc_inode->cache.page_lru,
+                                  page_lru) {
+                if (page->referenced) {
+                        page->referenced = 0;
+                        list_move_tail (&page->page_lru,
+                                        &ioc_inode->cache.page_lru);
+                        continue;
+                }
+
+                ret = ioc_page_destroy (page);
+                if (ret != -1)
+                        size_pruned += ret;
+
+                if (size_pruned >= size_to_prune)
+                        break;
+        }
+
+        return size_pruned;
+}
+
 /*
  * ioc_prune - prune the cache. we have a limit to the number of pages we
  *             can have in-memory.
  *
- * @table: ioc_table_t of this translator
+ *             this is a CLOCK: the hand is the head of each lru list.
+ *             an inode read since the hand last passed it only loses its
+ *             reference bit and goes to the end of its list, so reads
+ *             never have to move inodes or pages around.
+ *
+ * @shard: shard to prune, see ioc_need_prune
  *
  */
 int32_t
-ioc_prune (ioc_table_t *table)
+ioc_prune (ioc_shard_t *shard)
 {
-	ioc_inode_t *curr = NULL, *next_ioc_inode = NULL;
-	ioc_page_t  *page = NULL, *next = NULL;
-	int32_t     ret = -1;
+	ioc_table_t *table = NULL;
+	ioc_inode_t *curr = NULL;
 	int32_t     index = 0;
+        uint32_t    visits = 0;
+        uint64_t    cache_used = 0;
 	uint64_t    size_to_prune = 0;
 	uint64_t    size_pruned = 0;
+        uint64_t    ret = 0;
 
-	ioc_table_lock (table);
+        table = shard->table;
+
+	ioc_shard_lock (shard);
 	{
-		size_to_prune = table->cache_used - table->cache_size;
+                cache_used = ioc_cache_used (table);
+                if ((shard->cache_used <= shard->cache_size)
+                    || (cache_used <= table->cache_size))
+                        goto unlock;
+
+		size_to_prune = min (shard->cache_used - shard->cache_size,
+                                     cache_used - table->cache_size);
+
 		/* take out the least recently used inode */
 		for (index=0; index < table->max_pri; index++) {
-			list_for_each_entry_safe (curr, next_ioc_inode, 
-						  &table->inode_lru[index], 
-						  inode_lru) {
-				/* prune page-by-page for this inode, till 
-				 * we reach the equilibrium */
+                        /* every inode can be passed over once */
+                        visits = 2 * shard->inode_count;
+
+                        while (!list_empty (&shard->inode_lru[index])
+                               && visits--) {
+                                curr = list_entry (shard->inode_lru[index].next,
+                                                   ioc_inode_t, inode_lru);
+
+                                if (curr->referenced) {
+                                        curr->referenced = 0;
+                                        list_move_tail (&curr->inode_lru,
+                                                        &shard->inode_lru[index]);
+                                        continue;
+                                }
+
 				ioc_inode_lock (curr);
-				/* { */
-
-				list_for_each_entry_safe (page, next, 
-							  &curr->cache.page_lru,
-                                                          page_lru) {
-					/* done with all pages, and not 
-					 * reached equilibrium yet??
-					 * continue with next inode in 
-					 * lru_list */
-					size_pruned += page->size;
-					ret = ioc_page_destroy (page);
-
-					if (ret != -1)
-						table->cache_used -= ret;
-	    
-					gf_log (table->xl->name,
-						GF_LOG_TRACE,
-						"index = %d && table->cache_"
-						"used = %"PRIu64" && table->"
-						"cache_size = %"PRIu64, 
-						index, table->cache_used, 
-						table->cache_size);
-	    
-					if (size_pruned >= size_to_prune)
-						break;
-				} /* list_for_each_entry_safe(page...) */
-				if (ioc_empty (&curr->cache)) {
-					list_del_init (&curr->inode_lru);
+				{
+                                        ret = __ioc_inode_prune
+                                                (curr,
+                                                 size_to_prune - size_pruned);
+
+                                        if (ioc_empty (&curr->cache)) {
+                                                list_del_init (&curr->inode_lru);
+                                        } else {
+                                                list_move_tail (&curr->inode_lru,
+                                                                &shard->inode_lru[index]);
+                                        }
 				}
-
-				/* } */ 
 				ioc_inode_unlock (curr);
-	
+
+                                shard->cache_used -= ret;
+                                size_pruned += ret;
+
+                                gf_log (table->xl->name, GF_LOG_TRACE,
+                                        "index = %d && shard->cache_used = "
+                                        "%"PRIu64" && shard->cache_size = "
+                                        "%"PRIu64, index, shard->cache_used,
+                                        shard->cache_size);
+
 				if (size_pruned >= size_to_prune)
 					break;
-			} /* list_for_each_entry_safe (curr...) */
+			}
       
 			if (size_pruned >= size_to_prune)
 				break;
 		} /* for(index=0;...) */
 
-	} /* ioc_inode_table locked region end */
-	ioc_table_unlock (table);
+	} /* shard locked region end */
+unlock:
+	ioc_shard_unlock (shard);
 
 	return 0;
 }
@@ -338,6 +393,7 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	off_t       offset = 0;
 	ioc_inode_t *ioc_inode = NULL;
 	ioc_table_t *table = NULL;
+        ioc_shard_t *shard = NULL;
 	ioc_page_t  *page = NULL;
 	off_t       trav_offset = 0;
 	size_t      payload_size = 0;
@@ -346,11 +402,14 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	ioc_waitq_t *waitq = NULL;
         size_t      iobref_page_size = 0;
         char        zero_filled = 0;
+        fd_t        *fd = NULL;
 
         local = frame->local;
         offset = local->pending_offset;
         ioc_inode = local->inode;
         table = ioc_inode->table;
+        shard = ioc_inode->shard;
+        fd = local->fd;
 
 	trav_offset = offset;
 	payload_size = op_ret;
@@ -442,6 +501,15 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 					 * the frame which triggered fault */
 					waitq = ioc_page_wakeup (page);
 				} /* if(page->waitq) */
+
+                                /* another client changed the file while
+                                 * the read was in flight, the data may be
+                                 * from before: hand it out, don't keep it */
+                                if (local->invalidations
+                                    != inode_invalidation_seq (fd->inode)) {
+                                        ioc_page_destroy (page);
+                                        iobref_page_size = 0;
+                                }
 			} /* if(!page)...else */
 		} /* if(op_ret < 0)...else */
 	} /* ioc_inode locked region end */
@@ -451,23 +519,31 @@ unlock:
 	ioc_waitq_return (waitq);
 
 	if (iobref_page_size) {
-		ioc_table_lock (table);
+		ioc_shard_lock (shard);
 		{
-			table->cache_used += iobref_page_size;
+			shard->cache_used += iobref_page_size;
+
+                        /* pruning may have taken the inode off the lru
+                         * list while it had no pages */
+                        if (list_empty (&ioc_inode->inode_lru)) {
+                                list_add_tail (&ioc_inode->inode_lru,
+                                               &shard->inode_lru[ioc_inode->weight]);
+                        }
 		}
-		ioc_table_unlock (table);
+		ioc_shard_unlock (shard);
 	}
 
 	if (destroy_size) {
-		ioc_table_lock (table);
+		ioc_shard_lock (shard);
 		{
-			table->cache_used -= destroy_size;
+			shard->cache_used -= destroy_size;
 		}
-		ioc_table_unlock (table);
+		ioc_shard_unlock (shard);
 	}
 
-	if (ioc_need_prune (ioc_inode->table)) {
-		ioc_prune (ioc_inode->table);
+        shard = ioc_need_prune (shard);
+	if (shard) {
+		ioc_prune (shard);
 	}
 
 	gf_log (this->name, GF_LOG_TRACE, "fault frame %p returned", frame);
@@ -532,6 +608,7 @@ ioc_page_fault (ioc_inode_t *ioc_inode,	call_frame_t *frame, fd_t *fd,
 	fault_local->pending_offset = offset;
 	fault_local->pending_size = table->page_size;
 	fault_local->inode = ioc_inode;
+        fault_local->invalidations = inode_invalidation_seq (fd->inode);
 
 	gf_log (frame->this->name, GF_LOG_TRACE,
 		"stack winding page fault for offset = %"PRId64" with "
@@ -561,21 +638,19 @@ ioc_frame_fill (ioc_page_t *page, call_frame_t *frame, off_t offset,
 	off_t       src_offset = 0;
 	off_t       dst_offset = 0;
 	ssize_t     copy_size = 0;
-	ioc_inode_t *ioc_inode = NULL;
         ioc_fill_t  *new = NULL;
         int8_t      found = 0;
         int32_t     ret = 0;
   
         local = frame->local;
-        ioc_inode = page->inode;
 
 	gf_log (frame->this->name, GF_LOG_TRACE,
 		"frame (%p) offset = %"PRId64" && size = %"GF_PRI_SIZET" "
 		"&& page->size = %"GF_PRI_SIZET" && wait_count = %d", 
 		frame, offset, size, page->size, local->wait_count);
 
-	/* immediately move this page to the end of the page_lru list */
-	list_move_tail (&page->page_lru, &ioc_inode->cache.page_lru);
+	/* ioc_prune moves this page to the end of the page_lru list */
+	page->referenced = 1;
 	/* fill local->pending_size bytes from local->pending_offset */
 	if (local->op_ret != -1 && page->size) {
 		if (offset > page->offset)
@@ -855,7 +930,7 @@ ioc_page_error (ioc_page_t *page, int32_t op_ret, int32_t op_errno)
 	ioc_waitq_t  *waitq = NULL, *trav = NULL;
 	call_frame_t *frame = NULL;
 	int64_t      ret = 0;
-	ioc_table_t  *table = NULL;
+	ioc_shard_t  *shard = NULL;
 	ioc_local_t  *local = NULL;
 
 	waitq = page->waitq;
@@ -879,11 +954,11 @@ ioc_page_error (ioc_page_t *page, int32_t op_ret, int32_t op_errno)
 		ioc_local_unlock (local);
 	}
 
-	table = page->inode->table;
+	shard = page->inode->shard;
 	ret = ioc_page_destroy (page);
 
 	if (ret != -1) {
-		table->cache_used -= ret;
+		shard->cache_used -= ret;
 	}
 
 	return waitq;
@@ -22,6 +22,19 @@
 
 #define QR_DEFAULT_CACHE_SIZE 134217728
 
+/* the sketch gets a counter for every QR_SKETCH_FILE_SIZE bytes of cache */
+#define QR_SKETCH_FILE_SIZE    4096
+#define QR_SKETCH_MIN_WIDTH    1024
+#define QR_SKETCH_MAX_WIDTH    (1 << 22)
+#define QR_SKETCH_DEPTH        4
+#define QR_SKETCH_MAX_COUNT    15
+
+/* a file is not let in if it would take more evictions than this */
+#define QR_ADMIT_MAX_VICTIMS   16
+
+/* files of one readdirp reply whose content is fetched ahead of time */
+#define QR_PREFETCH_MAX        64
+
 void
 qr_local_free (qr_local_t *local)
 {
@@ -37,6 +50,8 @@ qr_local_free (qr_local_t *local)
                 GF_FREE (local->path);
         }
 
+        loc_wipe (&local->loc);
+
         GF_FREE (local);
 
 out:
@@ -276,6 +291,150 @@ done:
 	return;
 }
 
+int
+qr_sketch_init (qr_sketch_t *sketch, uint64_t cache_size)
+{
+        uint64_t width = QR_SKETCH_MIN_WIDTH;
+
+        while ((width < QR_SKETCH_MAX_WIDTH)
+               && (width * QR_SKETCH_FILE_SIZE < cache_size))
+                width <<= 1;
+
+        sketch->counters = GF_CALLOC (width, sizeof (*sketch->counters),
+                                      gf_qr_mt_qr_sketch_t);
+        if (sketch->counters == NULL)
+                return -1;
+
+        sketch->mask = width - 1;
+        sketch->sample_size = width * 10;
+
+        return 0;
+}
+
+
+static inline uint32_t
+qr_sketch_index (qr_sketch_t *sketch, uint64_t ino, int i)
+{
+        uint64_t hash = ino;
+
+        /* splitmix64 finalizer, the two halves make the i'th probe */
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        hash = hash ^ (hash >> 31);
+
+        return ((uint32_t) hash + i * (uint32_t) (hash >> 32)) & sketch->mask;
+}
+
+
+/* To be called with table->lock held */
+uint32_t
+__qr_sketch_freq (qr_sketch_t *sketch, uint64_t ino)
+{
+        uint32_t freq = QR_SKETCH_MAX_COUNT;
+        uint32_t count = 0;
+        int      i = 0;
+
+        if (sketch->counters == NULL)
+                return 0;
+
+        for (i = 0; i < QR_SKETCH_DEPTH; i++) {
+                count = sketch->counters[qr_sketch_index (sketch, ino, i)];
+                if (count < freq)
+                        freq = count;
+        }
+
+        return freq;
+}
+
+
+/* count an access to @ino, return the new estimate of its frequency.
+   To be called with table->lock held */
+uint32_t
+__qr_sketch_touch (qr_sketch_t *sketch, uint64_t ino)
+{
+        uint32_t freq = 0;
+        uint32_t index = 0;
+        uint32_t i = 0;
+
+        if (sketch->counters == NULL)
+                return 0;
+
+        freq = __qr_sketch_freq (sketch, ino);
+        if (freq == QR_SKETCH_MAX_COUNT)
+                return freq;
+
+        /* conservative update: only the counters at the minimum grow */
+        for (i = 0; i < QR_SKETCH_DEPTH; i++) {
+                index = qr_sketch_index (sketch, ino, i);
+                if (sketch->counters[index] == freq)
+                        sketch->counters[index]++;
+        }
+
+        if (++sketch->additions >= sketch->sample_size) {
+                for (i = 0; i <= sketch->mask; i++)
+                        sketch->counters[i] >>= 1;
+                sketch->additions /= 2;
+        }
+
+        return freq + 1;
+}
+
+
+/*
+ * decide whether a file of @size bytes seen @freq times recently may
+ * come into the cache. if it does not fit, the files which would be
+ * pruned to make room for it must all be less popular than it is, so
+ * that a scan over many files read once does not flush the ones that
+ * are read all the time.
+ *
+ * To be called with priv->table.lock held
+ */
+int
+__qr_admit (xlator_t *this, uint32_t freq, uint64_t size)
+{
+        qr_private_t     *priv = NULL;
+        qr_conf_t        *conf = NULL;
+        qr_inode_table_t *table = NULL;
+        qr_inode_t       *curr = NULL;
+        uint64_t          needed = 0;
+        uint64_t          freed = 0;
+        int               victims = 0;
+        int               index = 0;
+
+        priv = this->private;
+        conf = &priv->conf;
+        table = &priv->table;
+
+        if (!conf->tinylfu || (table->cache_used + size <= conf->cache_size))
+                return 1;
+
+        if (size > conf->cache_size)
+                return 0;
+
+        needed = table->cache_used + size - conf->cache_size;
+
+        /* same order as __qr_cache_prune */
+        for (index = 0; index < conf->max_pri; index++) {
+                list_for_each_entry (curr, &table->lru[index], lru) {
+                        if (curr->xattr == NULL)
+                                continue;
+
+                        if ((++victims > QR_ADMIT_MAX_VICTIMS)
+                            || (__qr_sketch_freq (&table->sketch,
+                                                  curr->stbuf.ia_ino)
+                                >= freq))
+                                return 0;
+
+                        freed += curr->stbuf.ia_size;
+                        if (freed >= needed)
+                                return 1;
+                }
+        }
+
+        return 0;
+}
+
+
 /* To be called with table->lock held */
 inline char
 __qr_need_cache_prune (qr_conf_t *conf, qr_inode_table_t *table)
@@ -284,57 +443,65 @@ __qr_need_cache_prune (qr_conf_t *conf, qr_inode_table_t *table)
 }
 
 
-int32_t
-qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-               int32_t op_ret, int32_t op_errno, inode_t *inode,
-               struct iatt *buf, dict_t *dict, struct iatt *postparent)
+/*
+ * keep @dict, which carries the content of the file, as the cached
+ * content of @inode. @accessed tells whether this is an access by the
+ * application, or only a prefetch which must not make the file look
+ * more popular than it is. @invalidations is inode_invalidation_seq of
+ * @inode when the lookup was sent; if it moved, another client changed
+ * the file meanwhile and the content may be from before.
+ *
+ * returns 0 (also if the file is not let in) or -errno.
+ */
+int
+qr_cache_content (xlator_t *this, inode_t *inode, char *path,
+                  struct iatt *buf, dict_t *dict, gf_boolean_t accessed,
+                  uint64_t invalidations)
 {
-        data_t           *content  = NULL;
         qr_inode_t       *qr_inode = NULL;
         uint64_t          value    = 0;
         int               ret      = -1;
         qr_conf_t        *conf     = NULL;
         qr_inode_table_t *table    = NULL;
         qr_private_t     *priv     = NULL;
-        qr_local_t       *local    = NULL;
-
-        if ((op_ret == -1) || (dict == NULL)) {
-                goto out;
-        }
+        uint32_t          freq     = 0;
 
         priv = this->private;
         conf = &priv->conf;
         table = &priv->table;
 
-        local = frame->local;
+        LOCK (&table->lock);
+        {
+                if (accessed) {
+                        freq = __qr_sketch_touch (&table->sketch, buf->ia_ino);
+                } else {
+                        freq = __qr_sketch_freq (&table->sketch, buf->ia_ino);
+                }
 
-        if (buf->ia_size > conf->max_file_size) {
-                goto out;
-        }
+                if (inode_invalidation_seq (inode) != invalidations) {
+                        ret = 0;
+                        goto unlock;
+                }
 
-        if (IA_ISDIR (buf->ia_type)) {
-                goto out;
-        }
+                ret = inode_ctx_get (inode, this, &value);
+                if (ret == 0) {
+                        qr_inode = (qr_inode_t *)(long)value;
+                }
 
-        if (inode == NULL) {
-                op_ret = -1;
-                op_errno = EINVAL;
-                goto out;
-        }
+                if ((qr_inode == NULL) || (qr_inode->xattr == NULL)) {
+                        if (!__qr_admit (this, freq, buf->ia_size)) {
+                                table->rejected++;
+                                ret = 0;
+                                goto unlock;
+                        }
 
-        content = dict_get (dict, GLUSTERFS_CONTENT_KEY);
-        if (content == NULL) {
-                goto out;
-        }
+                        table->admitted++;
+                }
 
-        LOCK (&table->lock);
-        {
-                ret = inode_ctx_get (inode, this, &value);
                 if (ret == -1) {
-                        qr_inode = __qr_inode_alloc (this, local->path, inode);
+                        qr_inode = __qr_inode_alloc (this, path, inode);
                         if (qr_inode == NULL) {
-                                op_ret = -1;
-                                op_errno = ENOMEM;
+                                ret = -ENOMEM;
                                 goto unlock;
                         }
                 
@@ -343,17 +510,12 @@ qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         if (ret == -1) {
                                 __qr_inode_free (qr_inode);
                                 qr_inode = NULL;
-                                op_ret = -1;
-                                op_errno = EINVAL;
-                                goto unlock;
-                        }
-                } else {
-                        qr_inode = (qr_inode_t *)(long)value;
-                        if (qr_inode == NULL) {
-                                op_ret = -1;
-                                op_errno = EINVAL;
+                                ret = -EINVAL;
                                 goto unlock;
                         }
+                } else if (qr_inode == NULL) {
+                        ret = -EINVAL;
+                        goto unlock;
                 }
 
                 if (qr_inode->xattr) {
@@ -370,10 +532,62 @@ qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 if (__qr_need_cache_prune (conf, table)) {
                         __qr_cache_prune (this);
                 }
+
+                ret = 0;
         }
 unlock:
         UNLOCK (&table->lock);
 
+        return ret;
+}
+
+
+int32_t
+qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+               int32_t op_ret, int32_t op_errno, inode_t *inode,
+               struct iatt *buf, dict_t *dict, struct iatt *postparent)
+{
+        data_t           *content  = NULL;
+        int               ret      = -1;
+        qr_conf_t        *conf     = NULL;
+        qr_private_t     *priv     = NULL;
+        qr_local_t       *local    = NULL;
+
+        if ((op_ret == -1) || (dict == NULL)) {
+                goto out;
+        }
+
+        priv = this->private;
+        conf = &priv->conf;
+
+        local = frame->local;
+
+        if (buf->ia_size > conf->max_file_size) {
+                goto out;
+        }
+
+        if (IA_ISDIR (buf->ia_type)) {
+                goto out;
+        }
+
+        if (inode == NULL) {
+                op_ret = -1;
+                op_errno = EINVAL;
+                goto out;
+        }
+
+        content = dict_get (dict, GLUSTERFS_CONTENT_KEY);
+        if (content == NULL) {
+                goto out;
+        }
+
+        ret = qr_cache_content (this, inode, local->path, buf, dict,
+                                _gf_true, local->invalidations);
+        if (ret < 0) {
+                op_ret = -1;
+                op_errno = -ret;
+        }
+
 
 out:
         /*
@@ -387,6 +601,209 @@ out:
 }
 
 
+int32_t
+qr_prefetch_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno, inode_t *inode,
+                 struct iatt *buf, dict_t *dict, struct iatt *postparent)
+{
+        qr_private_t *priv   = NULL;
+        qr_local_t   *local  = NULL;
+        inode_t      *linked = NULL;
+
+        priv = this->private;
+        local = frame->local;
+        frame->local = NULL;
+
+        if ((op_ret == -1) || (dict == NULL) || !IA_ISREG (buf->ia_type)
+            || (buf->ia_size > priv->conf.max_file_size)
+            || (dict_get (dict, GLUSTERFS_CONTENT_KEY) == NULL)) {
+                goto out;
+        }
+
+        /* the lookup from the application which follows finds this inode
+           by name, and with it the content */
+        linked = inode_link (inode, local->loc.parent, local->loc.name, buf);
+        if (linked == NULL) {
+                goto out;
+        }
+
+        qr_cache_content (this, linked, (char *)local->loc.path, buf, dict,
+                          _gf_false, local->invalidations);
+
+        inode_unref (linked);
+
+out:
+        qr_local_free (local);
+        STACK_DESTROY (frame->root);
+        return 0;
+}
+
+
+/* To be called with priv->table.lock held */
+static int
+__qr_prefetch_worthwhile (xlator_t *this, inode_t *inode, struct iatt *stbuf)
+{
+        qr_private_t *priv  = NULL;
+        uint64_t      value = 0;
+
+        priv = this->private;
+
+        if (inode && (inode_ctx_get (inode, this, &value) == 0) && value
+            && ((qr_inode_t *)(long)value)->xattr) {
+                return 0;
+        }
+
+        return __qr_admit (this, __qr_sketch_freq (&priv->table.sketch,
+                                                   stbuf->ia_ino),
+                           stbuf->ia_size);
+}
+
+
+/*
+ * look up the small regular files of a readdirp reply in the
+ * background, asking for their content, so that it is in the cache
+ * before the application gets to open them.
+ */
+void
+qr_prefetch_entries (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                     gf_dirent_t *entries)
+{
+        qr_private_t *priv     = NULL;
+        qr_conf_t    *conf     = NULL;
+        gf_dirent_t  *entry    = NULL;
+        inode_t      *inode    = NULL;
+        qr_local_t   *local    = NULL;
+        call_frame_t *prefetch = NULL;
+        dict_t       *req      = NULL;
+        char         *path     = NULL;
+        int           count    = 0;
+        int           ret      = 0;
+        int           worth    = 0;
+
+        priv = this->private;
+        conf = &priv->conf;
+
+        req = dict_new ();
+        if (req == NULL) {
+                goto out;
+        }
+
+        ret = dict_set (req, GLUSTERFS_CONTENT_KEY,
+                        data_from_uint64 (conf->max_file_size));
+        if (ret < 0) {
+                goto out;
+        }
+
+        list_for_each_entry (entry, &entries->list, list) {
+                if (count == QR_PREFETCH_MAX) {
+                        break;
+                }
+
+                if (!IA_ISREG (entry->d_stat.ia_type)
+                    || (entry->d_stat.ia_size == 0)
+                    || (entry->d_stat.ia_size > conf->max_file_size)) {
+                        continue;
+                }
+
+                inode = inode_grep (fd->inode->table, fd->inode,
+                                    entry->d_name);
+
+                LOCK (&priv->table.lock);
+                {
+                        worth = __qr_prefetch_worthwhile (this, inode,
+                                                          &entry->d_stat);
+                }
+                UNLOCK (&priv->table.lock);
+
+                if (!worth) {
+                        if (inode) {
+                                inode_unref (inode);
+                        }
+                        continue;
+                }
+
+                ret = inode_path (fd->inode, entry->d_name, &path);
+                if (ret < 0) {
+                        if (inode) {
+                                inode_unref (inode);
+                        }
+                        continue;
+                }
+
+                local = GF_CALLOC (1, sizeof (*local), gf_qr_mt_qr_local_t);
+                prefetch = copy_frame (frame);
+                if ((local == NULL) || (prefetch == NULL)) {
+                        GF_FREE (local);
+                        GF_FREE (path);
+                        if (inode) {
+                                inode_unref (inode);
+                        }
+                        if (prefetch) {
+                                STACK_DESTROY (prefetch->root);
+                        }
+                        break;
+                }
+
+                local->loc.path = path;
+                local->loc.name = strrchr (path, '/') + 1;
+                local->loc.parent = inode_ref (fd->inode);
+                local->loc.inode = inode ? inode
+                        : inode_new (fd->inode->table);
+                local->loc.ino = local->loc.inode->ino;
+                local->invalidations =
+                        inode_invalidation_seq (local->loc.inode);
+
+                prefetch->local = local;
+                count++;
+
+                STACK_WIND (prefetch, qr_prefetch_cbk, FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->lookup, &local->loc,
+                            req);
+        }
+
+out:
+        if (req) {
+                dict_unref (req);
+        }
+
+        return;
+}
+
+
+int32_t
+qr_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno, gf_dirent_t *entries)
+{
+        qr_private_t *priv = NULL;
+        fd_t         *fd   = NULL;
+
+        priv = this->private;
+        fd = frame->local;
+        frame->local = NULL;
+
+        if ((op_ret > 0) && priv->conf.prefetch_directory) {
+                qr_prefetch_entries (frame, this, fd, entries);
+        }
+
+        STACK_UNWIND_STRICT (readdirp, frame, op_ret, op_errno, entries);
+
+        fd_unref (fd);
+        return 0;
+}
+
+
+int32_t
+qr_readdirp (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
+             off_t off)
+{
+        frame->local = fd_ref (fd);
+
+        STACK_WIND (frame, qr_readdirp_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readdirp, fd, size, off);
+        return 0;
+}
+
+
 int32_t
 qr_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
 {
@@ -419,6 +836,8 @@ qr_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
         local->path = gf_strdup (loc->path);
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, local, unwind, op_errno,
                                         ENOMEM);
+        local->invalidations = inode_invalidation_seq (loc->inode);
+
         LOCK (&table->lock);
         {
                 op_ret = inode_ctx_get (loc->inode, this, &value);
@@ -696,7 +1115,10 @@ qr_need_validation (qr_conf_t *conf, qr_inode_t *qr_inode)
 {
         struct timeval now = {0, };
         char           need_validation = 0;
-        
+
+        if (conf->cache_invalidation && !conf->invalidation_refused)
+                return 0;
+
         gettimeofday (&now, NULL);
 
         if (qr_time_elapsed (&now, &qr_inode->tv) >= conf->cache_timeout)
@@ -965,6 +1387,13 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 ret = inode_ctx_get (fd->inode, this, &value);
                 if (ret == 0) {
                         qr_inode = (qr_inode_t *)(long)value;
+                }
+
+                if ((qr_inode == NULL) || (qr_inode->xattr == NULL)) {
+                        table->misses++;
+                }
+
+                if (ret == 0) {
                         if (qr_inode) {
                                 if (qr_inode->xattr){
                                         if (!just_validated
@@ -974,6 +1403,9 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                                                 goto unlock;
                                         }
 
+                                        __qr_sketch_touch (&table->sketch,
+                                                           qr_inode->stbuf.ia_ino);
+
                                         content = dict_get (qr_inode->xattr,
                                                             GLUSTERFS_CONTENT_KEY);
 
@@ -997,6 +1429,9 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                                                 }
                                         }
 
+                                        table->hits++;
+                                        table->bytes_saved += op_ret;
+
                                         ctx = this->ctx;
                                         count = (op_ret / iobuf_pool->page_size);
                                         if ((op_ret % iobuf_pool->page_size)
@@ -2336,6 +2771,83 @@ qr_forget (xlator_t *this, inode_t *inode)
         return 0;
 }
 
+/* To be called with priv->table.lock held */
+void
+__qr_inode_drop (xlator_t *this, qr_inode_t *qr_inode)
+{
+        qr_private_t *priv = NULL;
+
+        priv = this->private;
+
+        if (qr_inode->xattr)
+                priv->table.cache_used -= qr_inode->stbuf.ia_size;
+
+        inode_ctx_del (qr_inode->inode, this, NULL);
+        __qr_inode_free (qr_inode);
+}
+
+
+int
+notify (xlator_t *this, int32_t event, void *data, ...)
+{
+        qr_private_t *priv = NULL;
+        qr_inode_t   *curr = NULL, *next = NULL;
+        uint64_t      value = 0;
+        int           index = 0;
+
+        priv = this->private;
+        if (!priv)
+                goto out;
+
+        switch (event) {
+        case GF_EVENT_UPCALL:
+                LOCK (&priv->table.lock);
+                {
+                        if (inode_ctx_get ((inode_t *) data, this, &value) == 0)
+                                __qr_inode_drop (this,
+                                                 (qr_inode_t *)(long) value);
+                }
+                UNLOCK (&priv->table.lock);
+                break;
+
+        case GF_EVENT_UPCALL_UNAVAILABLE:
+                if (priv->conf.cache_invalidation
+                    && !priv->conf.invalidation_refused) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "a brick does not send cache invalidations, "
+                                "revalidating after cache-timeout");
+                        priv->conf.invalidation_refused = 1;
+                }
+                break;
+
+        case GF_EVENT_CHILD_UP:
+        case GF_EVENT_CHILD_DOWN:
+                /* invalidations may have been missed while disconnected */
+                if (!priv->conf.cache_invalidation)
+                        break;
+
+                LOCK (&priv->table.lock);
+                {
+                        for (index = 0; index < priv->conf.max_pri; index++) {
+                                list_for_each_entry_safe (curr, next,
+                                                          &priv->table.lru[index],
+                                                          lru) {
+                                        __qr_inode_drop (this, curr);
+                                }
+                        }
+                }
+                UNLOCK (&priv->table.lock);
+                break;
+
+        default:
+                break;
+        }
+
+out:
+        return default_notify (this, event, data);
+}
+
+
 int
 qr_priv_dump (xlator_t *this)
 {
@@ -2392,6 +2904,22 @@ qr_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%d", file_count);
         gf_proc_dump_build_key (key, key_prefix, "total_cache_used");
         gf_proc_dump_write (key, "%d", total_size);
+        gf_proc_dump_build_key (key, key_prefix, "eviction_policy");
+        gf_proc_dump_write (key, "%s", conf->tinylfu ? "tinylfu" : "lru");
+        gf_proc_dump_build_key (key, key_prefix, "hits");
+        gf_proc_dump_write (key, "%"PRIu64, table->hits);
+        gf_proc_dump_build_key (key, key_prefix, "misses");
+        gf_proc_dump_write (key, "%"PRIu64, table->misses);
+        gf_proc_dump_build_key (key, key_prefix, "hit_ratio");
+        gf_proc_dump_write (key, "%.2f", (table->hits + table->misses)
+                            ? (double) table->hits
+                            / (table->hits + table->misses) : 0.0);
+        gf_proc_dump_build_key (key, key_prefix, "bytes_saved");
+        gf_proc_dump_write (key, "%"PRIu64, table->bytes_saved);
+        gf_proc_dump_build_key (key, key_prefix, "admitted");
+        gf_proc_dump_write (key, "%"PRIu64, table->admitted);
+        gf_proc_dump_build_key (key, key_prefix, "rejected");
+        gf_proc_dump_write (key, "%"PRIu64, table->rejected);
 
 out:
         return 0;
@@ -2587,6 +3115,43 @@ init (xlator_t *this)
                 } 
         }
 
+        conf->tinylfu = _gf_true;
+        ret = dict_get_str (this->options, "eviction-policy", &str);
+        if (ret == 0) {
+                if (strcmp (str, "lru") == 0) {
+                        conf->tinylfu = _gf_false;
+                } else if (strcmp (str, "tinylfu") != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid eviction-policy value %s", str);
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        ret = dict_get_str (this->options, "prefetch-directory", &str);
+        if (ret == 0) {
+                ret = gf_string2boolean (str, &conf->prefetch_directory);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'prefetch-directory' takes only boolean "
+                                "options");
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        ret = dict_get_str (this->options, "cache-invalidation", &str);
+        if (ret == 0) {
+                ret = gf_string2boolean (str, &conf->cache_invalidation);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'cache-invalidation' takes only boolean "
+                                "options");
+                        ret = -1;
+                        goto out;
+                }
+        }
+
 	INIT_LIST_HEAD (&conf->priority_list);
 	conf->max_pri = 1;
 	if (dict_get (this->options, "priority")) {
@@ -2617,6 +3182,14 @@ init (xlator_t *this)
                 INIT_LIST_HEAD (&priv->table.lru[i]);
         }
 
+        if (conf->tinylfu) {
+                ret = qr_sketch_init (&priv->table.sketch, conf->cache_size);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR, "out of memory");
+                        goto out;
+                }
+        }
+
         ret = 0;
 
         this->private = priv;
@@ -2651,6 +3224,7 @@ struct xlator_fops fops = {
         .ftruncate   = qr_ftruncate,
         .lk          = qr_lk,
         .fsetattr    = qr_fsetattr,
+        .readdirp    = qr_readdirp,
 };
 
 
@@ -2683,4 +3257,15 @@ struct volume_options options[] = {
           .min  = 0,
           .max  = 1 * GF_UNIT_KB * 1000,
         },
+        { .key  = {"eviction-policy"},
+          .type = GF_OPTION_TYPE_STR,
+          .value = {"lru", "tinylfu"}
+        },
+        { .key  = {"prefetch-directory"},
+          .type = GF_OPTION_TYPE_BOOL
+        },
+        { .key  = {"cache-invalidation"},
+          .type = GF_OPTION_TYPE_BOOL
+        },
+        { .key  = {NULL} },
 };
@@ -66,6 +66,9 @@ struct qr_local {
         int32_t      op_ret;
         int32_t      op_errno;
         call_stub_t *stub;
+        loc_t        loc;           /* of a prefetch lookup */
+        uint64_t     invalidations; /* of the inode when the lookup was
+                                       sent */
 };
 typedef struct qr_local qr_local_t;
 
@@ -92,13 +95,39 @@ struct qr_conf {
         uint64_t         cache_size;
         int              max_pri;
         struct list_head priority_list;
+        gf_boolean_t     cache_invalidation; /* no revalidation, the bricks
+                                                tell us about changes */
+        gf_boolean_t     invalidation_refused; /* a brick does not, so
+                                                  revalidate after all */
+        gf_boolean_t     tinylfu;            /* eviction-policy tinylfu */
+        gf_boolean_t     prefetch_directory;
 };
 typedef struct qr_conf qr_conf_t;
 
+/*
+ * qr_sketch - approximate count of recent accesses to each file, kept in
+ *             a counting bloom filter of 4-bit counters. all counters
+ *             are halved every sample_size accesses, so that old
+ *             popularity fades away.
+ */
+struct qr_sketch {
+        uint8_t          *counters;
+        uint32_t          mask;          /* number of counters - 1 */
+        uint32_t          additions;
+        uint32_t          sample_size;
+};
+typedef struct qr_sketch qr_sketch_t;
+
 struct qr_inode_table {
         uint64_t          cache_used;
         struct list_head *lru;
         gf_lock_t         lock;
+        qr_sketch_t       sketch;
+        uint64_t          hits;          /* reads served from the cache */
+        uint64_t          misses;
+        uint64_t          bytes_saved;
+        uint64_t          admitted;
+        uint64_t          rejected;      /* not worth what they displace */
 };
 typedef struct qr_inode_table qr_inode_table_t;
 
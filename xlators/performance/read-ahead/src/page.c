@@ -467,6 +467,9 @@ ra_page_wakeup (ra_page_t *page)
 void
 ra_page_purge (ra_page_t *page)
 {
+	if (page->prefetched)
+		page->file->wasted++;
+
 	page->prev->next = page->next;
 	page->next->prev = page->prev;
 
@@ -537,6 +540,14 @@ ra_file_destroy (ra_file_t *file)
 		trav = file->pages.next;
 	}
 
+	ra_conf_lock (conf);
+	{
+		conf->hits   += file->hits;
+		conf->misses += file->misses;
+		conf->wasted += file->wasted;
+	}
+	ra_conf_unlock (conf);
+
 	pthread_mutex_destroy (&file->file_lock);
 	GF_FREE (file);
 }
@@ -39,7 +39,7 @@
 #include <sys/time.h>
 
 static void
-read_ahead (call_frame_t *frame, ra_file_t *file);
+read_ahead (call_frame_t *frame, ra_file_t *file, ra_stream_t *stream);
 
 
 int
@@ -77,7 +77,6 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 file->disabled = 1;
         }
 
-	file->offset = (unsigned long long) 0;
 	file->conf = conf;
 	file->pages.next = &file->pages;
 	file->pages.prev = &file->pages;
@@ -94,14 +93,10 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	ra_conf_unlock (conf);
 
 	file->fd = fd;
-	file->page_count = conf->page_count;
+	file->stream_count = conf->stream_count;
 	file->page_size = conf->page_size;
 	pthread_mutex_init (&file->file_lock, NULL);
 
-	if (!file->disabled) {
-		file->page_count = 1;
-	}
-
 	ret = fd_ctx_set (fd, this, (uint64_t)(long)file);
         if (ret == -1) {
                 ra_file_destroy (file);
@@ -148,7 +143,6 @@ ra_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	if ((fd->flags & O_DIRECT) || ((fd->flags & O_ACCMODE) == O_WRONLY))
 			file->disabled = 1;
 
-	file->offset = (unsigned long long) 0;
 	//file->size = fd->inode->buf.ia_size;
 	file->conf = conf;
 	file->pages.next = &file->pages;
@@ -166,7 +160,7 @@ ra_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	ra_conf_unlock (conf);
 
 	file->fd = fd;
-	file->page_count = conf->page_count;
+	file->stream_count = conf->stream_count;
 	file->page_size = conf->page_size;
 	pthread_mutex_init (&file->file_lock, NULL);
 
@@ -254,70 +248,214 @@ ra_release (xlator_t *this, fd_t *fd)
 }
 
 
-void
-read_ahead (call_frame_t *frame, ra_file_t *file)
+/* drop the pages that are in no stream's window, and that nobody
+   waits on */
+
+static void
+ra_prune (ra_file_t *file)
 {
-	off_t      ra_offset = 0;
-	size_t     ra_size = 0;
-	off_t      trav_offset = 0;
-	ra_page_t  *trav = NULL;
-	off_t      cap = 0;
-	char       fault = 0;
+	ra_page_t   *trav = NULL;
+	ra_page_t   *next = NULL;
+	ra_stream_t *stream = NULL;
+	int          keep = 0;
+	int          i = 0;
+
+	ra_file_lock (file);
+	{
+		trav = file->pages.next;
+		while (trav != &file->pages) {
+			next = trav->next;
+
+			keep = (trav->waitq != NULL);
+			for (i = 0; !keep && i < file->stream_count; i++) {
+				stream = &file->streams[i];
+				if (stream->active
+				    && trav->offset >= stream->start
+				    && trav->offset < stream->end)
+					keep = 1;
+			}
+
+			if (!keep)
+				ra_page_purge (trav);
+
+			trav = next;
+		}
+	}
+	ra_file_unlock (file);
+}
+
+
+/* the pages that @stream will read next, page_count pages' worth of
+   them for sequential readers, page_count reads' worth for strided ones */
+
+static void
+ra_stream_window (ra_file_t *file, ra_stream_t *stream)
+{
+	off_t reach = 0;
 
-	if (!file->page_count)
+	stream->start = floor (stream->last, file->page_size);
+	stream->end   = roof (stream->last + stream->size, file->page_size);
+
+	if (!stream->page_count || !stream->stride)
 		return;
 
-	ra_size   = file->page_size * file->page_count;
-	ra_offset = floor (file->offset, file->page_size);
-	cap       = file->size ? file->size : file->offset + ra_size;
+	if (stream->sequential)
+		reach = stream->page_count * file->page_size;
+	else if (stream->stride > 0)
+		reach = stream->page_count * stream->stride;
+	else
+		reach = stream->page_count * -stream->stride;
+
+	if (stream->stride > 0)
+		stream->end = roof (stream->last + stream->size + reach,
+				    file->page_size);
+	else
+		stream->start = floor (max (stream->last - reach, 0),
+				       file->page_size);
+}
 
-	while (ra_offset < min (file->offset + ra_size, cap)) {
 
-		ra_file_lock (file);
-		{
-			trav = ra_page_get (file, ra_offset);
+/* find the stream that a read of @size bytes at @offset carries on, or
+   start a new one in place of the one idle the longest. returns a copy
+   of it, as other readers of the fd may change it once we unlock. */
+
+static void
+ra_stream_match (ra_file_t *file, off_t offset, size_t size,
+		 ra_stream_t *copy)
+{
+	ra_conf_t   *conf = NULL;
+	ra_stream_t *stream = NULL;
+	ra_stream_t *victim = NULL;
+	off_t        stride = 0;
+	int          sequential = 0;
+	int          i = 0;
+
+	conf = file->conf;
+
+	file->tick++;
+
+	for (i = 0; i < file->stream_count; i++) {
+		stream = &file->streams[i];
+
+		if (!stream->active) {
+			if (!victim || victim->active)
+				victim = stream;
+			continue;
 		}
-		ra_file_unlock (file);
 
-		if (!trav)
-			break;
+		stride = offset - stream->last;
+		if (stride && ((stride == stream->stride)
+			       || (stride == (off_t)stream->size)
+			       || (stride == -(off_t)size)))
+			goto found;
 
-		ra_offset += file->page_size;
+		if (!victim || (victim->active && stream->used < victim->used))
+			victim = stream;
 	}
 
-	if (trav)
-		/* comfortable enough */
+	stream = victim ? victim : &file->streams[0];
+	memset (stream, 0, sizeof (*stream));
+	stream->active = 1;
+
+	/* reading from the start, most likely reading it all */
+	if (!offset) {
+		stream->stride     = size;
+		stream->sequential = 1;
+	}
+	goto out;
+
+found:
+	if (stride == (off_t)stream->size)
+		sequential = 1;
+	else if (stride == -(off_t)size)
+		sequential = -1;
+
+	if ((sequential != stream->sequential)
+	    || (!sequential && (stride != stream->stride))) {
+		/* a new pattern, or a new direction */
+		stream->sequential = sequential;
+		stream->expected   = 0;
+	}
+
+	/* where the next read will be; a strided read has pages of its own */
+	if (sequential) {
+		stream->stride    = sequential * (off_t)size;
+		stream->expected += size;
+	} else {
+		stream->stride    = stride;
+		stream->expected += roof (size, file->page_size);
+	}
+
+	stream->page_count = min ((stream->expected / file->page_size),
+				  conf->page_count);
+
+out:
+	stream->last = offset;
+	stream->size = size;
+	stream->used = file->tick;
+
+	ra_stream_window (file, stream);
+
+	*copy = *stream;
+}
+
+
+void
+read_ahead (call_frame_t *frame, ra_file_t *file, ra_stream_t *stream)
+{
+	off_t      pred = 0;
+	off_t      trav_offset = 0;
+	off_t      pred_end = 0;
+	ra_page_t  *trav = NULL;
+	char       fault = 0;
+	int        i = 0;
+
+	if (!stream->page_count || !stream->stride || !stream->size)
 		return;
 
-	trav_offset = ra_offset;
+	for (i = 1; ; i++) {
+		pred     = stream->last + (i * stream->stride);
+		pred_end = pred + stream->size;
 
-	cap  = file->size ? file->size : ra_offset + ra_size;
+		if ((pred >= stream->end) || (pred_end <= stream->start))
+			break;
 
-	while (trav_offset < min(ra_offset + ra_size, cap)) {
-		fault = 0;
-		ra_file_lock (file);
-		{
-			trav = ra_page_get (file, trav_offset);
-			if (!trav) {
-				fault = 1;
-				trav = ra_page_create (file, trav_offset);
-				if (trav) 
-					trav->dirty = 1;
+		/* nothing there to read */
+		if (file->stbuf.ia_size && (pred >= file->stbuf.ia_size))
+			break;
+
+		trav_offset = max (floor (pred, file->page_size),
+				   stream->start);
+
+		while (trav_offset < min (pred_end, stream->end)) {
+			fault = 0;
+			ra_file_lock (file);
+			{
+				trav = ra_page_get (file, trav_offset);
+				if (!trav) {
+					fault = 1;
+					trav = ra_page_create (file,
+							       trav_offset);
+					if (trav) {
+						trav->dirty = 1;
+						trav->prefetched = 1;
+					}
+				}
 			}
-		}
-		ra_file_unlock (file);
+			ra_file_unlock (file);
 
-		if (!trav) {
-			/* OUT OF MEMORY */
-			break;
-		}
+			if (!trav) {
+				/* OUT OF MEMORY */
+				return;
+			}
 
-		if (fault) {
-			gf_log (frame->this->name, GF_LOG_TRACE,
-				"RA at offset=%"PRId64, trav_offset);
-			ra_page_fault (file, frame, trav_offset);
+			if (fault) {
+				gf_log (frame->this->name, GF_LOG_TRACE,
+					"RA at offset=%"PRId64, trav_offset);
+				ra_page_fault (file, frame, trav_offset);
+			}
+			trav_offset += file->page_size;
 		}
-		trav_offset += file->page_size;
 	}
 
 	return;
@@ -365,6 +503,10 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
 				trav = ra_page_create (file, trav_offset);
 				fault = 1;
 				need_atime_update = 0;
+				file->misses++;
+			} else if (trav->prefetched) {
+				trav->prefetched = 0;
+				file->hits++;
 			}
 
 			if (!trav) {
@@ -436,12 +578,9 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 {
 	ra_file_t    *file = NULL;
 	ra_local_t   *local = NULL;
-	ra_conf_t    *conf = NULL;
 	int          op_errno = 0;
-	char         expected_offset = 1;
 	uint64_t     tmp_file = 0;
-
-	conf = this->private;
+	ra_stream_t  stream = {0, };
 
 	gf_log (this->name, GF_LOG_TRACE,
 		"NEW REQ at offset=%"PRId64" for size=%"GF_PRI_SIZET"",
@@ -457,27 +596,11 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto unwind;
         }
 
-	if (file->offset != offset) {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"unexpected offset (%"PRId64" != %"PRId64") resetting",
-			file->offset, offset);
-
-		expected_offset = file->expected = file->page_count = 0;
-	} else {
-		gf_log (this->name, GF_LOG_TRACE,
-			"expected offset (%"PRId64") when page_count=%d",
-			offset, file->page_count);
-
-		if (file->expected < (conf->page_size * conf->page_count)) {
-			file->expected += size;
-			file->page_count = min ((file->expected / file->page_size),
-						conf->page_count);
-		}
-	}
-
-	if (!expected_offset) {
-		flush_region (frame, file, 0, file->pages.prev->offset + 1);
+	ra_file_lock (file);
+	{
+		ra_stream_match (file, offset, size, &stream);
 	}
+	ra_file_unlock (file);
 
 	if (file->disabled) {
 		STACK_WIND (frame, ra_readv_disabled_cbk,
@@ -510,14 +633,12 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 
 	dispatch_requests (frame, file);
 
-	flush_region (frame, file, 0, floor (offset, file->page_size));
+        read_ahead (frame, file, &stream);
 
-        read_ahead (frame, file);
+	ra_prune (file);
 
 	ra_frame_return (frame);
 
-	file->offset = offset + size;
-
 	return 0;
 
 unwind:
@@ -637,6 +758,7 @@ ra_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
 	ra_file_t *file = NULL;
 	uint64_t  tmp_file = 0;
         int32_t   op_errno = 0;
+        int       i = 0;
 
 	fd_ctx_get (fd, this, &tmp_file);
 	file = (ra_file_t *)(long)tmp_file;
@@ -650,7 +772,14 @@ ra_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
         flush_region (frame, file, 0, file->pages.prev->offset+1);
 
         /* reset the read-ahead counters too */
-        file->expected = file->page_count = 0;
+        ra_file_lock (file);
+        {
+                for (i = 0; i < file->stream_count; i++) {
+                        file->streams[i].expected   = 0;
+                        file->streams[i].page_count = 0;
+                }
+        }
+        ra_file_unlock (file);
 
 	frame->local = fd;
 
@@ -785,6 +914,10 @@ int
 ra_priv_dump (xlator_t *this)
 {
         ra_conf_t       *conf = NULL;
+        ra_file_t       *file = NULL;
+        uint64_t        hits = 0;
+        uint64_t        misses = 0;
+        uint64_t        wasted = 0;
         int             ret = -1;
         char            key[GF_DUMP_MAX_BUF_LEN];
         char            key_prefix[GF_DUMP_MAX_BUF_LEN];
@@ -818,6 +951,25 @@ ra_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%d", conf->page_count);
         gf_proc_dump_build_key (key, key_prefix, "force_atime_update");
         gf_proc_dump_write (key, "%d", conf->force_atime_update);
+        gf_proc_dump_build_key (key, key_prefix, "stream_count");
+        gf_proc_dump_write (key, "%u", conf->stream_count);
+
+        hits   = conf->hits;
+        misses = conf->misses;
+        wasted = conf->wasted;
+        for (file = conf->files.next; file != &conf->files;
+             file = file->next) {
+                hits   += file->hits;
+                misses += file->misses;
+                wasted += file->wasted;
+        }
+
+        gf_proc_dump_build_key (key, key_prefix, "prefetch_hits");
+        gf_proc_dump_write (key, "%"PRIu64, hits);
+        gf_proc_dump_build_key (key, key_prefix, "misses");
+        gf_proc_dump_write (key, "%"PRIu64, misses);
+        gf_proc_dump_build_key (key, key_prefix, "prefetch_wasted_pages");
+        gf_proc_dump_write (key, "%"PRIu64, wasted);
 
         pthread_mutex_unlock (&conf->conf_lock);
 
@@ -873,6 +1025,7 @@ init (xlator_t *this)
 
 	conf->page_size = this->ctx->page_size;
 	conf->page_count = 4;
+	conf->stream_count = 4;
 
 	if (dict_get (options, "page-count"))
 		page_count_string = data_to_str (dict_get (options, 
@@ -908,6 +1061,21 @@ init (xlator_t *this)
                                 "updates on cache hit");
 	}
 
+	if (dict_get (options, "stream-count")) {
+		if (gf_string2uint_base10 (data_to_str (dict_get (options,
+								  "stream-count")),
+					   &conf->stream_count) != 0
+		    || conf->stream_count < 1
+		    || conf->stream_count > RA_MAX_STREAMS) {
+			gf_log (this->name, GF_LOG_ERROR,
+				"invalid \"option stream-count\", expected "
+				"1 - %d", RA_MAX_STREAMS);
+			goto out;
+		}
+		gf_log (this->name, GF_LOG_DEBUG,
+			"Using conf->stream_count = %u", conf->stream_count);
+	}
+
 	conf->files.next = &conf->files;
 	conf->files.prev = &conf->files;
 
@@ -969,5 +1137,10 @@ struct volume_options options[] = {
 	  .min  = 1, 
 	  .max  = 16 
 	},
+	{ .key  = {"stream-count"},
+	  .type = GF_OPTION_TYPE_INT,
+	  .min  = 1,
+	  .max  = RA_MAX_STREAMS
+	},
 	{ .key = {NULL} },
 };
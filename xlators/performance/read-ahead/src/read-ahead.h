@@ -38,6 +38,10 @@ struct ra_local;
 struct ra_page;
 struct ra_file;
 struct ra_waitq;
+struct ra_stream;
+
+/* most readers of one fd told apart */
+#define RA_MAX_STREAMS 16
 
 
 struct ra_waitq {
@@ -84,6 +88,26 @@ struct ra_page {
 	size_t            size;
 	struct ra_waitq  *waitq;
         struct iobref    *iobref;
+	char              prefetched; /* by read-ahead, not read yet */
+};
+
+
+/*
+ * a reader of an fd: reads of 'size' bytes, each 'stride' bytes away
+ * from the one before. sequential readers have stride == size, backward
+ * ones stride == -size. pages in [start, end) are its read-ahead window.
+ */
+struct ra_stream {
+	char              active;
+	off_t             last;       /* offset of the last read */
+	size_t            size;       /* and its size */
+	off_t             stride;     /* 0 until a second read matches */
+	int               sequential; /* 1 forward, -1 backward, 0 strided */
+	size_t            expected;   /* bytes read along the stride */
+	uint32_t          page_count; /* window size */
+	off_t             start;
+	off_t             end;
+	uint64_t          used;       /* file->tick when it last matched */
 };
 
 
@@ -93,15 +117,18 @@ struct ra_file {
 	struct ra_conf    *conf;
 	fd_t              *fd;
 	int                disabled;
-	size_t             expected;
 	struct ra_page     pages;
-	off_t              offset;
 	size_t             size;
 	int32_t            refcount;
 	pthread_mutex_t    file_lock;
 	struct iatt        stbuf;
 	uint64_t           page_size;
-	uint32_t           page_count;
+	struct ra_stream   streams[RA_MAX_STREAMS];
+	uint32_t           stream_count;
+	uint64_t           tick;
+	uint64_t           hits;      /* reads served by read-ahead */
+	uint64_t           misses;    /* pages faulted by reads */
+	uint64_t           wasted;    /* read-ahead pages never read */
 };
 
 
@@ -111,6 +138,10 @@ struct ra_conf {
 	void             *cache_block;
 	struct ra_file    files;
 	gf_boolean_t      force_atime_update;
+	uint32_t          stream_count;
+	uint64_t          hits;       /* of the files closed so far */
+	uint64_t          misses;
+	uint64_t          wasted;
 	pthread_mutex_t   conf_lock;
 };
 
@@ -121,6 +152,7 @@ typedef struct ra_page ra_page_t;
 typedef struct ra_file ra_file_t;
 typedef struct ra_waitq ra_waitq_t;
 typedef struct ra_fill ra_fill_t;
+typedef struct ra_stream ra_stream_t;
 
 ra_page_t *
 ra_page_get (ra_file_t *file,
@@ -21,6 +21,7 @@
 
 #define GF_SP_CACHE_BUCKETS 1
 #define GF_SP_CACHE_ENTRIES_EXPECTED 1048576
+#define GF_SP_CACHE_SIZE             (16 * GF_UNIT_MB)
 
 typedef enum {
         SP_EXPECT,
@@ -28,6 +29,18 @@ typedef enum {
         SP_DONT_CARE
 }sp_expect_t;
 
+void
+sp_cache_free (sp_cache_t *cache);
+
+sp_cache_t *
+sp_cache_ref (sp_cache_t *cache);
+
+void
+sp_cache_unref (sp_cache_t *cache);
+
+int32_t
+sp_cache_remove_entry (sp_cache_t *cache, char *name, char remove_all);
+
 
 void
 sp_inode_ctx_free (xlator_t *this, sp_inode_ctx_t *ctx)
@@ -58,6 +71,10 @@ sp_inode_ctx_free (xlator_t *this, sp_inode_ctx_t *ctx)
         }
         UNLOCK (&ctx->lock);
 
+        if (ctx->cache) {
+                sp_cache_free (ctx->cache);
+        }
+
         LOCK_DESTROY (&ctx->lock);
         GF_FREE (ctx);
 
@@ -191,6 +208,87 @@ out:
 }
 
 
+/*
+ * sp_cache_account - @cache grew (or shrank, if @delta is negative) by
+ *                    @delta bytes. a cache which grows moves to the tail
+ *                    of the lru list, and if all the caches hold more
+ *                    than cache-size together, those at the head are
+ *                    emptied.
+ */
+void
+sp_cache_account (xlator_t *this, sp_cache_t *cache, int64_t delta)
+{
+        sp_private_t *priv   = NULL;
+        sp_cache_t   *victim = NULL;
+        sp_cache_t   *head   = NULL;
+        uint64_t      size   = 0;
+
+        priv = this->private;
+        if (priv == NULL) {
+                goto out;
+        }
+
+        LOCK (&priv->lock);
+        {
+                priv->cache_used += delta;
+
+                LOCK (&cache->lock);
+                {
+                        size = cache->size;
+                }
+                UNLOCK (&cache->lock);
+
+                if (size == 0) {
+                        list_del_init (&cache->lru);
+                } else if (delta > 0) {
+                        list_move_tail (&cache->lru, &priv->caches);
+                }
+        }
+        UNLOCK (&priv->lock);
+
+        /* only growing evicts, emptying a victim comes back here */
+        while (delta > 0) {
+                victim = NULL;
+
+                LOCK (&priv->lock);
+                {
+                        while ((priv->cache_used > priv->cache_size)
+                               && !list_empty (&priv->caches)) {
+                                head = list_entry (priv->caches.next,
+                                                   sp_cache_t, lru);
+                                list_del_init (&head->lru);
+
+                                /* a cache whose last ref is gone is being
+                                   freed, sp_cache_unref accounts for it */
+                                LOCK (&head->lock);
+                                {
+                                        if (head->ref > 0) {
+                                                head->ref++;
+                                                victim = head;
+                                        }
+                                }
+                                UNLOCK (&head->lock);
+
+                                if (victim != NULL) {
+                                        break;
+                                }
+                        }
+                }
+                UNLOCK (&priv->lock);
+
+                if (victim == NULL) {
+                        break;
+                }
+
+                sp_cache_remove_entry (victim, NULL, 1);
+                sp_cache_unref (victim);
+        }
+
+out:
+        return;
+}
+
+
 sp_cache_t *
 sp_cache_ref (sp_cache_t *cache)
 {
@@ -212,7 +310,8 @@ out:
 void
 sp_cache_unref (sp_cache_t *cache)
 {
-        int refcount = 0;
+        int      refcount = 0;
+        int64_t  size     = 0;
         if (cache == NULL) {
                 goto out;
         }
@@ -224,6 +323,9 @@ sp_cache_unref (sp_cache_t *cache)
         UNLOCK (&cache->lock);
 
         if (refcount == 0) {
+                size = cache->size;
+                cache->size = 0;
+                sp_cache_account (cache->this, cache, -size);
                 rbthash_table_destroy (cache->table);
                 GF_FREE (cache);
         }
@@ -328,6 +430,23 @@ sp_hashfn (void *data, int len)
         return gf_dm_hashfn ((const char *)data, len);
 }
  
+void
+sp_cache_entry_free (void *data)
+{
+        sp_cache_entry_t *entry = data;
+
+        if (entry == NULL) {
+                goto out;
+        }
+
+        GF_FREE (entry->dirent);
+        GF_FREE (entry);
+
+out:
+        return;
+}
+
+
 sp_cache_t *
 sp_cache_init (xlator_t *this)
 {
@@ -346,7 +465,7 @@ sp_cache_init (xlator_t *this)
         if (cache) {
                 cache->table =
                         rbthash_table_init (GF_SP_CACHE_BUCKETS,
-                                            sp_hashfn, __gf_free,
+                                            sp_hashfn, sp_cache_entry_free,
                                             0, priv->mem_pool);
                 if (cache->table == NULL) {
                         GF_FREE (cache);
@@ -355,6 +474,7 @@ sp_cache_init (xlator_t *this)
                 }
 
                 LOCK_INIT (&cache->lock);
+                INIT_LIST_HEAD (&cache->lru);
                 cache->this = this;
         }
 
@@ -373,6 +493,14 @@ sp_local_free (sp_local_t *local)
 }
 
 
+static inline int64_t
+sp_cache_entry_size (sp_cache_entry_t *entry)
+{
+        return sizeof (*entry) + sizeof (*entry->dirent)
+                + strlen (entry->dirent->d_name) + 1;
+}
+
+
 int32_t
 sp_cache_remove_entry (sp_cache_t *cache, char *name, char remove_all)
 {
@@ -381,6 +509,7 @@ sp_cache_remove_entry (sp_cache_t *cache, char *name, char remove_all)
         xlator_t        *this;
         sp_private_t    *priv = NULL;
         void            *data = NULL;
+        int64_t          freed = 0;
 
         if ((cache == NULL) || ((name == NULL) && !remove_all)) {
                 goto out;
@@ -402,24 +531,35 @@ sp_cache_remove_entry (sp_cache_t *cache, char *name, char remove_all)
                         table = cache->table;
                         cache->table = rbthash_table_init (GF_SP_CACHE_BUCKETS,
                                                            sp_hashfn,
-                                                           __gf_free,
+                                                           sp_cache_entry_free,
                                                            0,
                                                            priv->mem_pool);
                         if (cache->table == NULL) {
                                 cache->table = table;
                         } else {
                                 rbthash_table_destroy (table);
+                                freed = cache->size;
+                                cache->size = 0;
                                 ret = 0;
                         }
                 } else {
                         data = rbthash_remove (cache->table, name,
                                                strlen (name));
-                        GF_FREE (data);
+                        if (data != NULL) {
+                                freed = sp_cache_entry_size (data);
+                                cache->size -= freed;
+                                sp_cache_entry_free (data);
+                        }
+
                         ret = 0;
                 }
         }
         UNLOCK (&cache->lock);
 
+        if (freed) {
+                sp_cache_account (this, cache, -freed);
+        }
+
 out:
         return ret;    
 }
@@ -428,27 +568,37 @@ out:
 int32_t
 sp_cache_get_entry (sp_cache_t *cache, char *name, gf_dirent_t **entry)
 {
-        int32_t      ret = -1;
-        gf_dirent_t *tmp = NULL, *new = NULL;
+        int32_t           ret = -1;
+        sp_cache_entry_t *tmp = NULL;
+        gf_dirent_t      *new = NULL;
+        sp_private_t     *priv = NULL;
+        struct timeval    now = {0, };
 
         if ((cache == NULL) || (name == NULL) || (entry == NULL)) {
                 goto out;
         }
 
+        priv = cache->this->private;
+        gettimeofday (&now, NULL);
+
         LOCK (&cache->lock);
         {
                 tmp = rbthash_get (cache->table, name, strlen (name));
-                if (tmp != NULL) {
-                        new = gf_dirent_for_name (tmp->d_name);
+
+                /* entries may have been changed by other clients since */
+                if ((tmp != NULL)
+                    && ((now.tv_sec - tmp->filled.tv_sec)
+                        < priv->cache_timeout)) {
+                        new = gf_dirent_for_name (tmp->dirent->d_name);
                         if (new == NULL) {
                                 goto unlock;
                         }
 
-                        new->d_ino  = tmp->d_ino;
-                        new->d_off  = tmp->d_off;
-                        new->d_len  = tmp->d_len;
-                        new->d_type = tmp->d_type;
-                        new->d_stat = tmp->d_stat;
+                        new->d_ino  = tmp->dirent->d_ino;
+                        new->d_off  = tmp->dirent->d_off;
+                        new->d_len  = tmp->dirent->d_len;
+                        new->d_type = tmp->dirent->d_type;
+                        new->d_stat = tmp->dirent->d_stat;
 
                         *entry = new;
                         ret = 0;
@@ -470,51 +620,6 @@ sp_cache_free (sp_cache_t *cache)
 }
 
 
-sp_cache_t *
-__sp_get_cache_fd (xlator_t *this, fd_t *fd)
-{
-        int32_t      ret   = -1;
-        sp_cache_t  *cache = NULL;
-        uint64_t     value = 0;
-        sp_fd_ctx_t *fd_ctx = NULL;
-
-        ret = __fd_ctx_get (fd, this, &value);
-        if (ret == -1) {
-                goto out;
-        }
-
-        fd_ctx = (void *)(long) value;
-
-        cache = fd_ctx->cache;
-
-out:
-        return cache;
-}
-
-
-sp_cache_t *
-sp_get_cache_fd (xlator_t *this, fd_t *fd)
-{
-        sp_cache_t  *cache     = NULL;
-
-        if (fd == NULL) {
-                goto out;
-        }
-
-        LOCK (&fd->lock);
-        {
-                cache = __sp_get_cache_fd (this, fd);
-                if (cache != NULL) {
-                        sp_cache_ref (cache);
-                }
-        }
-        UNLOCK (&fd->lock);
-
-out:
-        return cache;
-}
-
-
 void
 sp_fd_ctx_free (sp_fd_ctx_t *fd_ctx)
 {
@@ -532,10 +637,6 @@ sp_fd_ctx_free (sp_fd_ctx_t *fd_ctx)
                 fd_ctx->name = NULL;
         }
 
-        if (fd_ctx->cache) {
-                sp_cache_free (fd_ctx->cache);
-        }
-
         GF_FREE (fd_ctx);
 out:
         return;
@@ -554,7 +655,7 @@ sp_fd_ctx_init (void)
 
 
 sp_fd_ctx_t *
-sp_fd_ctx_new (xlator_t *this, inode_t *parent, char *name, sp_cache_t *cache)
+sp_fd_ctx_new (xlator_t *this, inode_t *parent, char *name)
 {
         sp_fd_ctx_t *fd_ctx = NULL;
 
@@ -577,35 +678,32 @@ sp_fd_ctx_new (xlator_t *this, inode_t *parent, char *name, sp_cache_t *cache)
                 }
         }
 
-        fd_ctx->cache = cache;
-
 out:
         return fd_ctx;
 }
 
 
 sp_cache_t *
-sp_del_cache_fd (xlator_t *this, fd_t *fd)
+sp_get_cache_inode (xlator_t *this, inode_t *inode)
 {
-        sp_cache_t  *cache = NULL;
-        uint64_t     value = 0;
-        int32_t      ret   = -1;
-        sp_fd_ctx_t *fd_ctx = NULL;
+        sp_cache_t     *cache     = NULL;
+        sp_inode_ctx_t *inode_ctx = NULL;
+        uint64_t        value     = 0;
 
-        if (fd == NULL) {
+        if ((inode == NULL) || (inode_ctx_get (inode, this, &value) != 0)) {
                 goto out;
         }
 
-        LOCK (&fd->lock);
+        inode_ctx = (sp_inode_ctx_t *)(long) value;
+        if (inode_ctx == NULL) {
+                goto out;
+        }
+
+        LOCK (&inode_ctx->lock);
         {
-                ret = __fd_ctx_get (fd, this, &value);
-                if (ret == 0) {
-                        fd_ctx = (void *)(long) value;
-                        cache = fd_ctx->cache;
-                        fd_ctx->cache = NULL;
-                }
+                cache = sp_cache_ref (inode_ctx->cache);
         }
-        UNLOCK (&fd->lock);
+        UNLOCK (&inode_ctx->lock);
 
 out:
         return cache;
@@ -613,88 +711,63 @@ out:
 
 
 sp_cache_t *
-sp_get_cache_inode (xlator_t *this, inode_t *inode, int32_t pid)
+sp_get_cache_fd (xlator_t *this, fd_t *fd)
 {
-        fd_t       *fd    = NULL;
         sp_cache_t *cache = NULL;
 
-        if (inode == NULL) {
-                goto out;
-        }
-
-        fd = fd_lookup (inode, pid);
         if (fd == NULL) {
                 goto out;
         }
 
-        cache = sp_get_cache_fd (this, fd);
+        cache = sp_get_cache_inode (this, fd->inode);
 
-        fd_unref (fd);
 out:
         return cache;
 }
 
 
-inline int32_t
-__sp_put_cache (xlator_t *this, fd_t *fd, sp_cache_t *cache)
+/* the cache of directory @inode, created if it has none yet */
+sp_cache_t *
+sp_get_or_create_cache_inode (xlator_t *this, inode_t *inode,
+                              glusterfs_fop_t caller)
 {
-        sp_fd_ctx_t *fd_ctx = NULL;
-        int32_t      ret    = -1; 
-        uint64_t     value  = 0;
+        sp_cache_t     *cache     = NULL;
+        sp_inode_ctx_t *inode_ctx = NULL;
 
-        ret = __fd_ctx_get (fd, this, &value);
-        if (!ret) {
-                fd_ctx = (void *)(long)value;
-        } else {
-                fd_ctx = sp_fd_ctx_init ();
-                if (fd_ctx == NULL) {
-                        gf_log (this->name, GF_LOG_ERROR, "out of memory");
-                        ret = -1;
-                        goto out;
-                }
+        inode_ctx = sp_check_and_create_inode_ctx (this, inode, SP_DONT_CARE,
+                                                   caller);
+        if (inode_ctx == NULL) {
+                goto out;
+        }
 
-                ret = __fd_ctx_set (fd, this, (long)(void *)fd_ctx);
-                if (ret == -1) {
-                        sp_fd_ctx_free (fd_ctx); 
-                        goto out;
+        LOCK (&inode_ctx->lock);
+        {
+                if (inode_ctx->cache == NULL) {
+                        inode_ctx->cache = sp_cache_init (this);
+                        sp_cache_ref (inode_ctx->cache);
                 }
-        }
 
-        if (fd_ctx->cache) {
-                sp_cache_free (fd_ctx->cache);
+                cache = sp_cache_ref (inode_ctx->cache);
         }
-
-        fd_ctx->cache = cache;
+        UNLOCK (&inode_ctx->lock);
 
 out:
-        return ret;
-}
-
-
-inline int32_t
-sp_put_cache (xlator_t *this, fd_t *fd, sp_cache_t *cache)
-{
-        int32_t ret = -1;
-        
-        if (fd != NULL) { 
-                LOCK (&fd->lock);
-                {
-                        ret = __sp_put_cache (this, fd, cache);
-                }
-                UNLOCK (&fd->lock);
-        }
-
-        return ret;
+        return cache;
 }
 
 
 int32_t
 sp_cache_add_entries (sp_cache_t *cache, gf_dirent_t *entries)
 {
-        gf_dirent_t *entry           = NULL, *new = NULL;
-        int32_t      ret             = -1;
-        uint64_t     expected_offset = 0;
-        
+        gf_dirent_t      *entry           = NULL, *new = NULL;
+        sp_cache_entry_t *cached          = NULL, *old = NULL;
+        int32_t           ret             = -1;
+        uint64_t          expected_offset = 0;
+        int64_t           added           = 0;
+        struct timeval    now             = {0, };
+
+        gettimeofday (&now, NULL);
+
         LOCK (&cache->lock);
         {
                 list_for_each_entry (entry, &entries->list, list) {
@@ -713,13 +786,35 @@ sp_cache_add_entries (sp_cache_t *cache, gf_dirent_t *entries)
                         new->d_type = entry->d_type;
                         new->d_stat = entry->d_stat;
 
-                        ret = rbthash_insert (cache->table, new, new->d_name,
+                        cached = GF_CALLOC (1, sizeof (*cached),
+                                            gf_sp_mt_sp_cache_entry_t);
+                        if (cached == NULL) {
+                                GF_FREE (new);
+                                goto unlock;
+                        }
+
+                        cached->dirent = new;
+                        cached->filled = now;
+
+                        /* rbthash keeps the first of two equal keys */
+                        old = rbthash_remove (cache->table, new->d_name,
+                                              strlen (new->d_name));
+                        if (old != NULL) {
+                                added -= sp_cache_entry_size (old);
+                                cache->size -= sp_cache_entry_size (old);
+                                sp_cache_entry_free (old);
+                        }
+
+                        ret = rbthash_insert (cache->table, cached,
+                                              new->d_name,
                                               strlen (new->d_name));
                         if (ret == -1) {
-                                GF_FREE (new);
+                                sp_cache_entry_free (cached);
                                 continue;
                         }
 
+                        added += sp_cache_entry_size (cached);
+                        cache->size += sp_cache_entry_size (cached);
                         expected_offset = new->d_off;
                 }
 
@@ -730,6 +825,10 @@ sp_cache_add_entries (sp_cache_t *cache, gf_dirent_t *entries)
 unlock:
         UNLOCK (&cache->lock);
 
+        if (added) {
+                sp_cache_account (cache->this, cache, added);
+        }
+
         return ret;
 }
 
@@ -758,8 +857,7 @@ sp_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 goto out;
         }
         if (op_ret == -1) {
-                cache = sp_get_cache_inode (this, local->loc.parent,
-                                            frame->root->pid);
+                cache = sp_get_cache_inode (this, local->loc.parent);
 
                 if (cache) {
                         sp_cache_remove_entry (cache, (char *)local->loc.name,
@@ -850,8 +948,7 @@ sp_cache_remove_parent_entry (call_frame_t *frame, xlator_t *this,
         if (grand_parent && strcmp (grand_parent, "/")) {
                 inode_gp = inode_from_path (itable, grand_parent);
                 if (inode_gp) {
-                        cache_gp = sp_get_cache_inode (this, inode_gp,
-                                                       frame->root->pid);
+                        cache_gp = sp_get_cache_inode (this, inode_gp);
                         if (cache_gp) {
                                 cpy = gf_strdup (parent);
                                 GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name,
@@ -1003,7 +1100,7 @@ sp_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
                 goto wind;
         }
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 ret = sp_cache_get_entry (cache, (char *)loc->name, &dirent);
                 if (ret == 0) {
@@ -1020,7 +1117,7 @@ sp_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
                         GF_FREE (dirent);
                 } 
         } else if (IA_ISDIR (loc->inode->ia_type)) {
-                cache = sp_get_cache_inode (this, loc->inode, frame->root->pid);
+                cache = sp_get_cache_inode (this, loc->inode);
                 if (cache) {
                         ret = sp_cache_get_entry (cache, ".", &dirent);
                         if (ret == 0) {
@@ -1113,8 +1210,6 @@ sp_readdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         sp_local_t      *local       = NULL;
         sp_cache_t      *cache       = NULL;
         fd_t            *fd          = NULL;
-        int32_t         ret         = 0;
-        char            was_present = 1;
         sp_private_t    *priv = NULL;
 
         if (op_ret == -1) {
@@ -1145,33 +1240,11 @@ sp_readdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (!priv->mem_pool)
                 goto out;
 
-        LOCK (&fd->lock);
-        {
-                cache = __sp_get_cache_fd (this, fd);
-                if (cache == NULL) {
-                        was_present = 0;
-                        cache = sp_cache_init (this);
-                        if (cache == NULL) {
-                                goto unlock;
-                        }
-
-                        ret = __sp_put_cache (this, fd, cache);
-                        if (ret == -1) {
-                                sp_cache_free (cache);
-                                goto unlock;
-                        }
-                }
-
-                sp_cache_ref (cache);
-        }
-unlock:
-        UNLOCK (&fd->lock);
-
+        cache = sp_get_or_create_cache_inode (this, fd->inode,
+                                              GF_FOP_READDIRP);
         if (cache != NULL) {
                 sp_cache_add_entries (cache, entries);
-                if (was_present) {
-                        sp_cache_unref (cache);
-                }
+                sp_cache_unref (cache);
         }
 
 out:
@@ -1269,7 +1342,7 @@ sp_fd_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                                         EINVAL);
 
         fd_ctx = sp_fd_ctx_new (this, local->loc.parent,
-                                (char *)local->loc.name, NULL);
+                                (char *)local->loc.name);
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, fd_ctx, out, op_errno,
                                         ENOMEM);
 
@@ -1410,7 +1483,7 @@ sp_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                              NULL, postparent, NULL, NULL);
 
         fd_ctx = sp_fd_ctx_new (this, local->loc.parent,
-                                (char *)local->loc.name, NULL);
+                                (char *)local->loc.name);
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, fd_ctx, out, op_errno,
                                         ENOMEM);
 
@@ -1879,7 +1952,7 @@ sp_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc, loc_t *newloc)
                 goto out;
         }
 
-        cache = sp_get_cache_inode (this, oldloc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, oldloc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)oldloc->name, 0);
                 sp_cache_unref (cache);
@@ -1966,7 +2039,7 @@ sp_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->name, out, op_errno,
                                         EINVAL);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -2018,7 +2091,7 @@ sp_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
         name   = fd_ctx->name;
         parent = fd_ctx->parent_inode;
 
-        cache = sp_get_cache_inode (this, parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, parent);
         if (cache) {
                 sp_cache_remove_entry (cache, name, 0);
                 sp_cache_unref (cache);
@@ -2100,7 +2173,7 @@ sp_setattr (call_frame_t *frame, xlator_t *this,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->name, out, op_errno,
                                         EINVAL);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -2197,7 +2270,7 @@ sp_readlink (call_frame_t *frame, xlator_t *this, loc_t *loc, size_t size)
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->name, out,
                                         op_errno, EINVAL);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -2304,7 +2377,7 @@ sp_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->name, out, op_errno,
                                         EINVAL);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -2345,22 +2418,15 @@ out:
 
 
 void
-sp_remove_caches_from_all_fds_opened (xlator_t *this, inode_t *inode)
+sp_remove_cache_of_inode (xlator_t *this, inode_t *inode)
 {
-        fd_t       *fd    = NULL;
         sp_cache_t *cache = NULL;
 
-        LOCK (&inode->lock);
-        {
-                list_for_each_entry (fd, &inode->fd_list, inode_list) {
-                        cache = sp_get_cache_fd (this, fd);
-                        if (cache) {
-                                sp_cache_remove_entry (cache, NULL, 1);
-                                sp_cache_unref (cache);
-                        }
-                }
+        cache = sp_get_cache_inode (this, inode);
+        if (cache) {
+                sp_cache_remove_entry (cache, NULL, 1);
+                sp_cache_unref (cache);
         }
-        UNLOCK (&inode->lock);
 }
 
 
@@ -2422,9 +2488,9 @@ sp_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc)
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->inode, out,
                                         op_errno, EINVAL);
 
-        sp_remove_caches_from_all_fds_opened (this, loc->inode);
+        sp_remove_cache_of_inode (this, loc->inode);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -2496,7 +2562,7 @@ sp_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
         name   = fd_ctx->name;
         parent = fd_ctx->parent_inode;
 
-        cache = sp_get_cache_inode (this, parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, parent);
         if (cache) {
                 sp_cache_remove_entry (cache, name, 0);
                 sp_cache_unref (cache);
@@ -2533,7 +2599,7 @@ sp_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
         name   = fd_ctx->name;
         parent = fd_ctx->parent_inode;
 
-        cache = sp_get_cache_inode (this, parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, parent);
         if (cache) {
                 sp_cache_remove_entry (cache, name, 0);
                 sp_cache_unref (cache);
@@ -2570,7 +2636,7 @@ sp_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t flags)
         name   = fd_ctx->name;
         parent = fd_ctx->parent_inode;
 
-        cache = sp_get_cache_inode (this, parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, parent);
         if (cache) {
                 sp_cache_remove_entry (cache, name, 0);
                 sp_cache_unref (cache);
@@ -2706,13 +2772,13 @@ sp_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,loc_t *newloc)
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, newloc->path, out,
                                         op_errno, EINVAL);
 
-        cache = sp_get_cache_inode (this, oldloc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, oldloc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)oldloc->name, 0);
                 sp_cache_unref (cache);
         }
 
-        cache = sp_get_cache_inode (this, newloc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, newloc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)newloc->name, 0);
                 sp_cache_unref (cache);
@@ -2733,7 +2799,7 @@ sp_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,loc_t *newloc)
         }
 
         if (IA_ISDIR (oldloc->inode->ia_type)) {
-                sp_remove_caches_from_all_fds_opened (this, oldloc->inode);
+                sp_remove_cache_of_inode (this, oldloc->inode);
         }
 
         stub = fop_rename_stub (frame, sp_rename_helper, oldloc, newloc);
@@ -2872,7 +2938,7 @@ sp_setxattr (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *dict,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->name, out, op_errno,
                                         EINVAL);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -2961,7 +3027,7 @@ sp_removexattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->name, out, op_errno,
                                         EINVAL);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -3147,7 +3213,7 @@ sp_xattrop (call_frame_t *frame, xlator_t *this, loc_t *loc,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->name, out, op_errno,
                                         EINVAL);
 
-        cache = sp_get_cache_inode (this, loc->parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, loc->parent);
         if (cache) {
                 sp_cache_remove_entry (cache, (char *)loc->name, 0);
                 sp_cache_unref (cache);
@@ -3200,7 +3266,7 @@ sp_fxattrop (call_frame_t *frame, xlator_t *this, fd_t *fd,
         name   = fd_ctx->name;
         parent = fd_ctx->parent_inode;
 
-        cache = sp_get_cache_inode (this, parent, frame->root->pid);
+        cache = sp_get_cache_inode (this, parent);
         if (cache) {
                 sp_cache_remove_entry (cache, name, 0);
                 sp_cache_unref (cache);
@@ -3553,14 +3619,12 @@ out:
 int32_t
 sp_forget (xlator_t *this, inode_t *inode)
 {
-        struct iatt *buf   = NULL;
-        uint64_t     value = 0;
+        uint64_t value = 0;
 
         inode_ctx_del (inode, this, &value);
         
         if (value) {
-                buf = (void *)(long)value;
-                GF_FREE (buf);
+                sp_inode_ctx_free (this, (sp_inode_ctx_t *)(long)value);
         }
         
         return 0;
@@ -3573,17 +3637,10 @@ sp_release (xlator_t *this, fd_t *fd)
         sp_fd_ctx_t *fd_ctx = NULL;
         uint64_t     value  = 0;
         int32_t      ret    = 0;
-        sp_cache_t  *cache  = NULL;
 
         ret = fd_ctx_del (fd, this, &value);
         if (!ret) {
                 fd_ctx = (void *)(long) value;
-                cache = fd_ctx->cache;
-                if (cache) {
-                        gf_log (this->name, GF_LOG_DEBUG, "cache hits: %lu, "
-                                "cache miss: %lu", cache->hits, cache->miss);
-                }
-
                 sp_fd_ctx_free (fd_ctx);      
         }
 
@@ -3614,6 +3671,7 @@ init (xlator_t *this)
 {
         int32_t         ret = -1;
         sp_private_t    *priv = NULL;
+        char            *str = NULL;
 
         if (!this->children || this->children->next) {
                 gf_log ("stat-prefetch",
@@ -3625,12 +3683,47 @@ init (xlator_t *this)
 
         priv = GF_CALLOC (1, sizeof(sp_private_t),
                           gf_sp_mt_sp_private_t);
+        if (priv == NULL) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory");
+                goto out;
+        }
+
         LOCK_INIT (&priv->lock);
+        INIT_LIST_HEAD (&priv->caches);
+
+        priv->cache_size = GF_SP_CACHE_SIZE;
+        ret = dict_get_str (this->options, "cache-size", &str);
+        if (ret == 0) {
+                ret = gf_string2bytesize (str, &priv->cache_size);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid cache-size value %s", str);
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        priv->cache_timeout = 1;
+        ret = dict_get_str (this->options, "cache-timeout", &str);
+        if (ret == 0) {
+                ret = gf_string2int32 (str, &priv->cache_timeout);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid cache-timeout value %s", str);
+                        ret = -1;
+                        goto out;
+                }
+        }
 
         this->private = priv;
 
         ret = 0;
 out:
+        if ((ret == -1) && priv) {
+                LOCK_DESTROY (&priv->lock);
+                GF_FREE (priv);
+        }
+
         return ret;
 }
 
@@ -3678,3 +3771,17 @@ struct xlator_cbks cbks = {
         .release    = sp_release,
         .releasedir = sp_release
 };
+
+struct volume_options options[] = {
+        { .key  = {"cache-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 0,
+          .max  = 1 * GF_UNIT_GB,
+        },
+        { .key  = {"cache-timeout"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 60
+        },
+        { .key  = {NULL} },
+};
@@ -35,7 +35,13 @@
 #include "call-stub.h"
 #include "stat-prefetch-mem-types.h"
 #include <libgen.h>
+#include <sys/time.h>
 
+/*
+ * sp_cache - entries of a directory, as read by readdirp. it hangs off
+ *            the inode of the directory, so that it outlives the fd the
+ *            directory was read through.
+ */
 struct sp_cache {
         rbthash_table_t *table;
         xlator_t        *this;
@@ -46,11 +52,21 @@ struct sp_cache {
         unsigned long    miss;
         unsigned long    hits;
         uint32_t         ref;
+        uint64_t         size;               /* memory held by the entries */
+        struct list_head lru;                /* in sp_private, if not empty.
+                                              * protected by priv->lock
+                                              */
 };
 typedef struct sp_cache sp_cache_t;
 
+/* an entry of a sp_cache, and when it was read */
+struct sp_cache_entry {
+        struct timeval   filled;
+        gf_dirent_t     *dirent;
+};
+typedef struct sp_cache_entry sp_cache_entry_t;
+
 struct sp_fd_ctx {
-        sp_cache_t *cache;
         inode_t    *parent_inode;       /*
                                          * inode corresponding to dirname (path)
                                          */
@@ -77,12 +93,17 @@ struct sp_inode_ctx {
         struct iatt      stbuf;  
         gf_lock_t        lock;
         struct list_head waiting_ops;
+        sp_cache_t      *cache;         /* of a directory */
 };
 typedef struct sp_inode_ctx sp_inode_ctx_t;
 
 struct sp_private {
         struct mem_pool  *mem_pool;
         gf_lock_t        lock;
+        uint64_t         cache_size;    /* for all directories together */
+        uint64_t         cache_used;
+        int32_t          cache_timeout;
+        struct list_head caches;        /* lru list of non-empty caches */
 };
 typedef struct sp_private sp_private_t;
 
@@ -40,6 +40,9 @@
 #define MAX_VECTOR_COUNT 8
 #define WB_AGGREGATE_SIZE 131072 /* 128 KB */
 #define WB_WINDOW_SIZE 1048576 /* 1MB */
+#define WB_MAX_WINDOW_SIZE 16777216 /* 16MB */
+#define WB_TOTAL_WINDOW_SIZE 134217728 /* 128MB */
+#define WB_MAX_MERGE_DEPTH 64 /* extents searched for a write to join */
  
 typedef struct list_head list_head_t;
 struct wb_conf;
@@ -52,6 +55,9 @@ typedef struct wb_file {
         uint64_t     disable_till;
         size_t       window_conf;
         size_t       window_current;
+        off_t        offset_expected; /* where a sequential writer
+                                       * continues
+                                       */
         int32_t      flags;
         size_t       aggregate_current;
         int32_t      refcount;
@@ -62,6 +68,7 @@ typedef struct wb_file {
         fd_t        *fd;
         gf_lock_t    lock;
         xlator_t    *this;
+        list_head_t  list;            /* conf->files */
 }wb_file_t;
 
 
@@ -104,6 +111,18 @@ struct wb_conf {
         gf_boolean_t enable_O_SYNC;
         gf_boolean_t flush_behind;
         gf_boolean_t enable_trickling_writes;
+
+        /*
+         * write-behind memory shared by all the files: a file may only
+         * unwind a write early if the data it leaves behind fits into
+         * both its own window and what is left of total_window_size.
+         */
+        uint64_t     max_window_size;
+        uint64_t     total_window_size;
+        uint64_t     total_window_current;
+        uint64_t     total_window_full;
+        list_head_t  files;
+        gf_lock_t    lock;
 };
 
 
@@ -304,6 +323,7 @@ wb_file_create (xlator_t *this, fd_t *fd, int32_t flags)
 
         INIT_LIST_HEAD (&file->request);
         INIT_LIST_HEAD (&file->passive_requests);
+        INIT_LIST_HEAD (&file->list);
 
         /* 
            fd_ref() not required, file should never decide the existance of
@@ -316,6 +336,12 @@ wb_file_create (xlator_t *this, fd_t *fd, int32_t flags)
         file->window_conf = conf->window_size;
         file->flags = flags;
 
+        LOCK (&conf->lock);
+        {
+                list_add_tail (&file->list, &conf->files);
+        }
+        UNLOCK (&conf->lock);
+
         fd_ctx_set (fd, this, (uint64_t)(long)file);
 
 out:
@@ -325,7 +351,10 @@ out:
 void
 wb_file_destroy (wb_file_t *file)
 {
-        int32_t refcount = 0;
+        wb_conf_t *conf     = NULL;
+        int32_t    refcount = 0;
+
+        conf = file->this->private;
 
         LOCK (&file->lock);
         {
@@ -334,6 +363,12 @@ wb_file_destroy (wb_file_t *file)
         UNLOCK (&file->lock);
 
         if (!refcount){
+                LOCK (&conf->lock);
+                {
+                        list_del_init (&file->list);
+                }
+                UNLOCK (&conf->lock);
+
                 LOCK_DESTROY (&file->lock);
                 GF_FREE (file);
         }
@@ -351,6 +386,8 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
         wb_file_t    *file = NULL;
         wb_request_t *request = NULL, *dummy = NULL;
         wb_local_t   *per_request_local = NULL;
+        wb_conf_t    *conf = NULL;
+        size_t        written_behind = 0;
         int32_t       ret = -1;
         fd_t         *fd  = NULL;
 
@@ -358,6 +395,7 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
         local = frame->local;
         winds = &local->winds;
         file = local->file;
+        conf = this->private;
 
         LOCK (&file->lock);
         {
@@ -373,10 +411,19 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
 
                         if (request->flags.write_request.write_behind) {
                                 file->window_current -= request->write_size;
+                                written_behind += request->write_size;
                         }
 
                         __wb_request_unref (request);
                 }
+
+                if (written_behind) {
+                        LOCK (&conf->lock);
+                        {
+                                conf->total_window_current -= written_behind;
+                        }
+                        UNLOCK (&conf->lock);
+                }
                 
                 if (op_ret == -1) {
                         file->op_ret = op_ret;
@@ -1580,8 +1627,10 @@ size_t
 __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
 {
         size_t        written_behind = 0;
+        size_t        window_added   = 0;
         wb_request_t *request        = NULL;
         wb_file_t    *file           = NULL;
+        wb_conf_t    *conf           = NULL;
 
         if (list_empty (list)) {
                 goto out;
@@ -1589,6 +1638,7 @@ __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
 
         request = list_entry (list->next, typeof (*request), list);
         file = request->file;
+        conf = file->this->private;
 
         list_for_each_entry (request, list, list)
         {
@@ -1605,6 +1655,7 @@ __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
                                 
                                 if (!request->flags.write_request.got_reply) {
                                         file->window_current += request->write_size;
+                                        window_added += request->write_size;
                                 }
                         }
                 } else {
@@ -1612,16 +1663,33 @@ __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
                 }
         }
 
+        if (window_added) {
+                LOCK (&conf->lock);
+                {
+                        conf->total_window_current += window_added;
+                }
+                UNLOCK (&conf->lock);
+        }
+
 out:
         return written_behind;
 }
 
 
-void
+/*
+ * returns 1 if the write-behind memory of all the files together is used
+ * up. nothing is unwound early then, and the window of this file, if it
+ * had grown, is halved so that streaming writers give memory back first.
+ */
+int
 __wb_mark_unwinds (list_head_t *list, list_head_t *unwinds)
 {
         wb_request_t *request        = NULL;
         wb_file_t    *file           = NULL;
+        wb_conf_t    *conf           = NULL;
+        uint64_t      total_left     = 0;
+        size_t        size           = 0;
+        int           full           = 0;
 
         if (list_empty (list)) {
                 goto out;
@@ -1629,13 +1697,68 @@ __wb_mark_unwinds (list_head_t *list, list_head_t *unwinds)
 
         request = list_entry (list->next, typeof (*request), list);
         file = request->file;
+        conf = file->this->private;
+
+        LOCK (&conf->lock);
+        {
+                if (conf->total_window_current < conf->total_window_size) {
+                        total_left = conf->total_window_size
+                                - conf->total_window_current;
+                } else {
+                        conf->total_window_full++;
+                        full = 1;
+                }
+        }
+        UNLOCK (&conf->lock);
+
+        if (full) {
+                if (file->window_conf > conf->aggregate_size) {
+                        file->window_conf = max (file->window_conf / 2,
+                                                 conf->aggregate_size);
+                }
+                goto out;
+        }
 
         if (file->window_current <= file->window_conf) {
-                __wb_mark_unwind_till (list, unwinds,
-                                       file->window_conf - file->window_current);
+                size = min (file->window_conf - file->window_current,
+                            total_left);
+                __wb_mark_unwind_till (list, unwinds, size);
         }
 
 out:
+        return full;
+}
+
+
+/*
+ * a writer which continues where its previous write ended and keeps its
+ * window full gets the window doubled, up to max-window-size. any other
+ * write puts the window back to window-size.
+ */
+void
+__wb_adapt_window (wb_file_t *file, off_t offset, size_t size)
+{
+        wb_conf_t *conf = NULL;
+
+        conf = file->this->private;
+
+        /* caching is disabled for this file (O_SYNC, O_DIRECT ...) */
+        if (file->window_conf == 0) {
+                goto out;
+        }
+
+        if (offset == file->offset_expected) {
+                if ((file->window_current + size > file->window_conf)
+                    && (file->window_conf < conf->max_window_size)) {
+                        file->window_conf = min (file->window_conf * 2,
+                                                 conf->max_window_size);
+                }
+        } else {
+                file->window_conf = conf->window_size;
+        }
+
+out:
+        file->offset_expected = offset + size;
         return;
 }
 
@@ -1763,18 +1886,33 @@ out:
 }
 
 
-inline int
+/*
+ * copy the data of @request into @holder, whose write then covers both
+ * of them. the holder's own data is moved into a fresh iobuf first, if it
+ * is still sitting in the buffers the application gave us.
+ */
+int
 __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
 {
-        char          *ptr    = NULL;
-        struct iobuf  *iobuf  = NULL;
-        struct iobref *iobref = NULL;
-        int            ret    = -1;
+        char          *ptr           = NULL;
+        struct iobuf  *iobuf         = NULL;
+        struct iobref *iobref        = NULL;
+        wb_file_t     *file          = NULL;
+        wb_conf_t     *conf          = NULL;
+        off_t          holder_offset = 0;
+        off_t          offset        = 0;
+        off_t          start         = 0;
+        off_t          end           = 0;
+        size_t         overlap       = 0;
+        int            ret           = -1;
+
+        file = request->file;
+        conf = file->this->private;
 
         if (holder->flags.write_request.virgin) {
-                iobuf = iobuf_get (request->file->this->ctx->iobuf_pool);
+                iobuf = iobuf_get (file->this->ctx->iobuf_pool);
                 if (iobuf == NULL) {
-                        gf_log (request->file->this->name, GF_LOG_ERROR,
+                        gf_log (file->this->name, GF_LOG_ERROR,
                                 "out of memory");
                         goto out;
                 }
@@ -1782,44 +1920,79 @@ __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
                 iobref = iobref_new ();
                 if (iobref == NULL) {
                         iobuf_unref (iobuf);
-                        gf_log (request->file->this->name, GF_LOG_ERROR,
+                        gf_log (file->this->name, GF_LOG_ERROR,
                                 "out of memory");
                         goto out;
                 }
-                                                                          
+
                 ret = iobref_add (iobref, iobuf);
                 if (ret != 0) {
                         iobuf_unref (iobuf);
                         iobref_unref (iobref);
-                        gf_log (request->file->this->name, GF_LOG_DEBUG,
+                        gf_log (file->this->name, GF_LOG_DEBUG,
                                 "cannot add iobuf (%p) into iobref (%p)",
                                 iobuf, iobref);
                         goto out;
                 }
-                                                                          
+
                 iov_unload (iobuf->ptr, holder->stub->args.writev.vector,
                             holder->stub->args.writev.count);
                 holder->stub->args.writev.vector[0].iov_base = iobuf->ptr;
-                                                                          
+                holder->stub->args.writev.vector[0].iov_len
+                        = holder->write_size;
+                holder->stub->args.writev.count = 1;
+
                 iobref_unref (holder->stub->args.writev.iobref);
                 holder->stub->args.writev.iobref = iobref;
-                                                                          
+
                 iobuf_unref (iobuf);
 
                 holder->flags.write_request.virgin = 0;
         }
 
-        ptr = holder->stub->args.writev.vector[0].iov_base + holder->write_size;
+        holder_offset = holder->stub->args.writev.off;
+        offset = request->stub->args.writev.off;
+
+        start = min (holder_offset, offset);
+        end = max (holder_offset + (off_t)holder->write_size,
+                   offset + (off_t)request->write_size);
 
-        iov_unload (ptr,
+        ptr = holder->stub->args.writev.vector[0].iov_base;
+
+        /* request begins before the holder, make room in front */
+        if (start < holder_offset) {
+                memmove (ptr + (holder_offset - start), ptr,
+                         holder->write_size);
+        }
+
+        /* request is the later write, its data wins where they overlap */
+        iov_unload (ptr + (offset - start),
                     request->stub->args.writev.vector,
                     request->stub->args.writev.count);
 
-        holder->stub->args.writev.vector[0].iov_len += request->write_size;
-        holder->write_size += request->write_size;
+        overlap = holder->write_size + request->write_size - (end - start);
+
+        holder->stub->args.writev.off = start;
+        holder->stub->args.writev.vector[0].iov_len = end - start;
+        holder->write_size = end - start;
+
+        /*
+         * both were counted in full, in the aggregate and in the windows,
+         * but the bytes they share are sent only once.
+         */
+        if (overlap) {
+                file->aggregate_current -= overlap;
+                file->window_current -= overlap;
+
+                LOCK (&conf->lock);
+                {
+                        conf->total_window_current -= overlap;
+                }
+                UNLOCK (&conf->lock);
+        }
 
         request->flags.write_request.stack_wound = 1;
-        list_move_tail (&request->list, &request->file->passive_requests);
+        list_move_tail (&request->list, &file->passive_requests);
 
         ret = 0;
 out:
@@ -1827,54 +2000,111 @@ out:
 }
 
 
-/* this procedure assumes that write requests have only one vector to write */
+static inline int
+__wb_requests_overlap (wb_request_t *one, wb_request_t *two)
+{
+        off_t one_offset = one->stub->args.writev.off;
+        off_t two_offset = two->stub->args.writev.off;
+
+        return ((one_offset < two_offset + (off_t)two->write_size)
+                && (two_offset < one_offset + (off_t)one->write_size));
+}
+
+
+/*
+ * @request can be folded into @holder if the two overlap or touch, and
+ * what they cover together fits into one iobuf. extents never grow across
+ * a page_size boundary just by touching it, so that applications writing
+ * page-aligned blocks end up with extents that are page-aligned too.
+ */
+static int
+__wb_can_merge (wb_request_t *holder, wb_request_t *request,
+                size_t page_size)
+{
+        off_t holder_offset = 0;
+        off_t holder_end    = 0;
+        off_t offset        = 0;
+        off_t end           = 0;
+
+        holder_offset = holder->stub->args.writev.off;
+        holder_end = holder_offset + holder->write_size;
+        offset = request->stub->args.writev.off;
+        end = offset + request->write_size;
+
+        if ((offset > holder_end) || (holder_offset > end)) {
+                return 0;
+        }
+
+        if ((max (holder_end, end) - min (holder_offset, offset))
+            > (off_t)page_size) {
+                return 0;
+        }
+
+        if (((offset == holder_end) && !(offset % page_size))
+            || ((end == holder_offset) && !(end % page_size))) {
+                return 0;
+        }
+
+        /* with O_APPEND, the server decides where the data goes */
+        if ((request->file->flags & O_APPEND) && (offset != holder_end)) {
+                return 0;
+        }
+
+        return 1;
+}
+
+
+/*
+ * fold writes which are already unwound but not yet sent into extents of
+ * at most page_size, held in iobufs of our own. a write is merged into the
+ * nearest earlier extent it overlaps or touches, as long as no extent in
+ * between overlaps it, since that one would then overwrite its data.
+ */
 void
 __wb_collapse_write_bufs (list_head_t *requests, size_t page_size)
 {
-        off_t         offset_expected = 0;
-        size_t        space_left      = 0;
-        wb_request_t *request         = NULL, *tmp = NULL, *holder = NULL;
-        int           ret             = 0;
+        list_head_t  *barrier = requests;
+        list_head_t  *pos     = NULL;
+        wb_request_t *request = NULL, *tmp = NULL, *holder = NULL;
+        int           depth   = 0;
+        int           ret     = 0;
 
         list_for_each_entry_safe (request, tmp, requests, list) {
                 if ((request->stub == NULL)
                     || (request->stub->fop != GF_FOP_WRITE)
                     || (request->flags.write_request.stack_wound)) {
-                        holder = NULL;
+                        barrier = &request->list;
                         continue;
                 }
 
-                if (request->flags.write_request.write_behind) {
-                        if (holder == NULL) {
-                                holder = request;
-                                continue;
-                        }
-
-                        offset_expected = holder->stub->args.writev.off
-                                + holder->write_size;
-
-                        if (request->stub->args.writev.off != offset_expected) {
-                                holder = request;
-                                continue;
-                        }
+                if (!request->flags.write_request.write_behind) {
+                        break;
+                }
 
-                        space_left = page_size - holder->write_size;
+                depth = 0;
+                for (pos = request->list.prev;
+                     (pos != barrier) && (depth < WB_MAX_MERGE_DEPTH);
+                     pos = pos->prev, depth++) {
+                        holder = list_entry (pos, wb_request_t, list);
 
-                        if (space_left >= request->write_size) {
+                        if (__wb_can_merge (holder, request, page_size)) {
                                 ret = __wb_copy_into_holder (holder, request);
                                 if (ret != 0) {
-                                        break;
+                                        goto out;
                                 }
-                                
+
                                 __wb_request_unref (request);
-                        } else {
-                                holder = request;
+                                break;
+                        }
+
+                        if ((request->file->flags & O_APPEND)
+                            || __wb_requests_overlap (holder, request)) {
+                                break;
                         }
-                } else { 
-                        break;
                 }
         }
 
+out:
         return;
 }
 
@@ -1887,6 +2117,7 @@ wb_process_queue (call_frame_t *frame, wb_file_t *file)
         wb_conf_t  *conf = NULL;
         uint32_t    count = 0;
         int32_t     ret = -1; 
+        int         full = 0;
 
         INIT_LIST_HEAD (&winds);
         INIT_LIST_HEAD (&unwinds);
@@ -1907,7 +2138,7 @@ wb_process_queue (call_frame_t *frame, wb_file_t *file)
                  * an iobuf) are packed properly so that iobufs are filled to
                  * their maximum capacity, before calling __wb_mark_winds.
                  */
-                __wb_mark_unwinds (&file->request, &unwinds);
+                full = __wb_mark_unwinds (&file->request, &unwinds);
 
                 __wb_collapse_write_bufs (&file->request,
                                           file->this->ctx->page_size);
@@ -1915,9 +2146,14 @@ wb_process_queue (call_frame_t *frame, wb_file_t *file)
                 count = __wb_get_other_requests (&file->request,
                                                  &other_requests);
 
+                /*
+                 * once write-behind memory is used up, send whatever is
+                 * queued right away instead of aggregating it.
+                 */
                 if (count == 0) {
                         __wb_mark_winds (&file->request, &winds, size,
-                                         conf->enable_trickling_writes);
+                                         (conf->enable_trickling_writes
+                                          || full));
                 }
 
         }
@@ -1993,6 +2229,10 @@ wb_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
                                 }
                                 wb_disabled = 1;
                         }
+
+                        if ((op_ret == 0) && !wb_disabled) {
+                                __wb_adapt_window (file, offset, size);
+                        }
                 }
                 UNLOCK (&file->lock);
         } else {
@@ -2529,8 +2769,10 @@ int
 wb_priv_dump (xlator_t *this)
 {
         wb_conf_t       *conf = NULL;
+        wb_file_t       *file = NULL;
         char            key[GF_DUMP_MAX_BUF_LEN];
         char            key_prefix[GF_DUMP_MAX_BUF_LEN];
+        int             i = 0;
 
         if (!this)
                 return -1;
@@ -2560,6 +2802,41 @@ wb_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%d", conf->flush_behind);
         gf_proc_dump_build_key (key, key_prefix, "enable_trickling_writes");
         gf_proc_dump_write (key, "%d", conf->enable_trickling_writes);
+        gf_proc_dump_build_key (key, key_prefix, "max_window_size");
+        gf_proc_dump_write (key, "%"PRIu64, conf->max_window_size);
+        gf_proc_dump_build_key (key, key_prefix, "total_window_size");
+        gf_proc_dump_write (key, "%"PRIu64, conf->total_window_size);
+
+        LOCK (&conf->lock);
+        {
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "total_window_current");
+                gf_proc_dump_write (key, "%"PRIu64,
+                                    conf->total_window_current);
+                gf_proc_dump_build_key (key, key_prefix, "total_window_full");
+                gf_proc_dump_write (key, "%"PRIu64, conf->total_window_full);
+
+                list_for_each_entry (file, &conf->files, list) {
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "file.%d.fd", i);
+                        gf_proc_dump_write (key, "%p", file->fd);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "file.%d.window_conf", i);
+                        gf_proc_dump_write (key, "%"GF_PRI_SIZET,
+                                            file->window_conf);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "file.%d.window_current", i);
+                        gf_proc_dump_write (key, "%"GF_PRI_SIZET,
+                                            file->window_current);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "file.%d.aggregate_current",
+                                                i);
+                        gf_proc_dump_write (key, "%"GF_PRI_SIZET,
+                                            file->aggregate_current);
+                        i++;
+                }
+        }
+        UNLOCK (&conf->lock);
 
         return 0;
 }
@@ -2701,6 +2978,48 @@ init (xlator_t *this)
                 }
         }
 
+        /* configure 'option max-window-size <size>' */
+        conf->max_window_size = max (WB_MAX_WINDOW_SIZE, conf->window_size);
+        ret = dict_get_str (options, "max-window-size", &str);
+        if (ret == 0) {
+                ret = gf_string2bytesize (str, &conf->max_window_size);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid number format \"%s\" of \"option "
+                                "max-window-size\"", str);
+                        GF_FREE (conf);
+                        return -1;
+                }
+        }
+
+        if (conf->max_window_size < conf->window_size) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "setting max-window-size to be equal to "
+                        "window-size(%"PRIu64")", conf->window_size);
+                conf->max_window_size = conf->window_size;
+        }
+
+        /* configure 'option total-window-size <size>' */
+        conf->total_window_size = WB_TOTAL_WINDOW_SIZE;
+        ret = dict_get_str (options, "total-window-size", &str);
+        if (ret == 0) {
+                ret = gf_string2bytesize (str, &conf->total_window_size);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid number format \"%s\" of \"option "
+                                "total-window-size\"", str);
+                        GF_FREE (conf);
+                        return -1;
+                }
+        }
+
+        if (conf->total_window_size < conf->max_window_size) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "setting total-window-size to be equal to "
+                        "max-window-size(%"PRIu64")", conf->max_window_size);
+                conf->total_window_size = conf->max_window_size;
+        }
+
         conf->enable_trickling_writes = _gf_true;
         ret = dict_get_str (options, "enable-trickling-writes",
                             &str);
@@ -2715,6 +3034,9 @@ init (xlator_t *this)
                 }
         }
 
+        INIT_LIST_HEAD (&conf->files);
+        LOCK_INIT (&conf->lock);
+
         this->private = conf;
         return 0;
 }
@@ -2725,6 +3047,7 @@ fini (xlator_t *this)
 {
         wb_conf_t *conf = this->private;
 
+        LOCK_DESTROY (&conf->lock);
         GF_FREE (conf);
         return;
 }
@@ -2773,5 +3096,15 @@ struct volume_options options[] = {
         { .key = {"enable-trickling-writes"},
           .type = GF_OPTION_TYPE_BOOL,
         },
+        { .key  = {"max-window-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 512 * GF_UNIT_KB,
+          .max  = 1 * GF_UNIT_GB
+        },
+        { .key  = {"total-window-size", "total-cache-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 1 * GF_UNIT_MB,
+          .max  = 32 * GF_UNIT_GB
+        },
         { .key = {NULL} },
 };
@@ -384,6 +384,7 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         char                 *process_uuid  = NULL;
         char                 *remote_error  = NULL;
         char                 *remote_subvol = NULL;
+        char                 *invalidation  = NULL;
         gf_setvolume_rsp      rsp           = {0,};
         int                   ret           = 0;
         int32_t               op_ret        = 0;
@@ -485,6 +486,18 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
                 conf->rpc->conn.trans->peerinfo.identifier,
                 remote_subvol);
 
+        /* before CHILD_UP, so that no reply from this brick is cached
+           on the assumption that it will be invalidated */
+        if (dict_get_str (reply, "cache-invalidation", &invalidation)) {
+                if (conf->cache_invalidation)
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "remote volume '%s' does not send cache "
+                                "invalidations, caches above fall back to "
+                                "revalidating", remote_subvol);
+
+                default_notify (this, GF_EVENT_UPCALL_UNAVAILABLE, NULL);
+        }
+
         rpc_clnt_set_connected (&conf->rpc->conn);
 
         op_ret = 0;
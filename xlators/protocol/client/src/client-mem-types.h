@@ -28,6 +28,7 @@ enum gf_client_mem_types_ {
         gf_client_mt_clnt_local_t,
         gf_client_mt_clnt_req_buf_t,
         gf_client_mt_clnt_fdctx_t,
+        gf_client_mt_cached_inode_t,
         gf_client_mt_end,
 };
 #endif /* __CLIENT_MEM_TYPES_H__ */
@@ -123,10 +123,85 @@ out:
 }
 
 
+static inline struct list_head *
+client_cache_bucket (clnt_conf_t *conf, uint64_t ino, uint64_t gen)
+{
+        return &conf->cached_inodes[(ino ^ gen) % CLIENT_CACHE_HASH_SIZE];
+}
+
+
+/* remember which local inode stands for the remote {ino, gen}, so that
+   an invalidation from the server can be delivered to it */
+void
+client_cache_record (xlator_t *this, inode_t *inode, uint64_t ino,
+                     uint64_t gen)
+{
+        clnt_conf_t         *conf   = NULL;
+        clnt_cached_inode_t *cached = NULL;
+        clnt_cached_inode_t *new    = NULL;
+        struct list_head    *bucket = NULL;
+
+        conf = this->private;
+        if (!conf->cache_invalidation || !inode)
+                return;
+
+        bucket = client_cache_bucket (conf, ino, gen);
+
+        pthread_mutex_lock (&conf->cache_lock);
+        {
+                list_for_each_entry (cached, bucket, hash) {
+                        if ((cached->ino == ino) && (cached->gen == gen)) {
+                                cached->inode = inode;
+                                goto unlock;
+                        }
+                }
+
+                new = GF_CALLOC (1, sizeof (*new),
+                                 gf_client_mt_cached_inode_t);
+                if (!new)
+                        goto unlock;
+
+                new->ino   = ino;
+                new->gen   = gen;
+                new->inode = inode;
+                list_add (&new->hash, bucket);
+        }
+unlock:
+        pthread_mutex_unlock (&conf->cache_lock);
+}
+
+
 int32_t
 client_forget (xlator_t *this, inode_t *inode)
 {
-        /* Nothing here */
+        clnt_conf_t         *conf   = NULL;
+        clnt_cached_inode_t *cached = NULL;
+        clnt_cached_inode_t *tmp    = NULL;
+        uint64_t             ino    = 0;
+        uint64_t             gen    = 0;
+
+        conf = this->private;
+        if (!conf || !conf->cache_invalidation)
+                return 0;
+
+        if (inode_ctx_get2 (inode, this, &ino, &gen))
+                return 0;
+
+        pthread_mutex_lock (&conf->cache_lock);
+        {
+                list_for_each_entry_safe (cached, tmp,
+                                          client_cache_bucket (conf, ino, gen),
+                                          hash) {
+                        if (cached->inode != inode)
+                                continue;
+
+                        list_del (&cached->hash);
+                        GF_FREE (cached);
+                        break;
+                }
+        }
+        pthread_mutex_unlock (&conf->cache_lock);
+
 	return 0;
 }
 
@@ -1540,6 +1615,8 @@ client_rpc_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
                                         "handshake msg returned %d", ret);
                 } else {
                         //conf->rpc->connected = 1;
+                        default_notify (this, GF_EVENT_UPCALL_UNAVAILABLE,
+                                        NULL);
                         ret = default_notify (this, GF_EVENT_CHILD_UP, NULL);
                         if (ret)
                                 gf_log (this->name, GF_LOG_DEBUG,
@@ -1567,6 +1644,69 @@ client_rpc_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
 }
 
 
+/* the server tells us another client changed an inode we cache */
+static int
+client_cbk_invalidate (struct rpc_clnt *rpc, void *mydata, struct iovec *iov)
+{
+        xlator_t               *this   = NULL;
+        clnt_conf_t            *conf   = NULL;
+        clnt_cached_inode_t    *cached = NULL;
+        inode_t                *inode  = NULL;
+        gf_cbk_invalidate_req   req    = {0,};
+
+        this = mydata;
+        conf = this->private;
+
+        if (xdr_to_cbk_invalidate_req (*iov, &req) < 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "failed to decode invalidation request");
+                return -1;
+        }
+
+        pthread_mutex_lock (&conf->cache_lock);
+        {
+                list_for_each_entry (cached,
+                                     client_cache_bucket (conf, req.ino,
+                                                          req.gen),
+                                     hash) {
+                        if ((cached->ino == req.ino)
+                            && (cached->gen == req.gen)) {
+                                inode = inode_ref_unless_retired (cached->inode);
+                                break;
+                        }
+                }
+        }
+        pthread_mutex_unlock (&conf->cache_lock);
+
+        if (!inode)
+                return 0;
+
+        gf_log (this->name, GF_LOG_TRACE,
+                "invalidating %"PRId64"/%"PRId64, req.ino, req.gen);
+
+        inode_invalidation_bump (inode);
+        default_notify (this, GF_EVENT_UPCALL, inode);
+
+        inode_unref (inode);
+
+        return 0;
+}
+
+rpcclnt_cb_actor_t client_cbk_actors[GF_CBK_MAXVALUE] = {
+        [GF_CBK_NULL]       = {"NULL", GF_CBK_NULL, NULL},
+        [GF_CBK_INVALIDATE] = {"INVALIDATE", GF_CBK_INVALIDATE,
+                               client_cbk_invalidate},
+};
+
+rpcclnt_cb_program_t client_cbk_prog = {
+        .progname  = "GlusterFS Callback",
+        .prognum   = GLUSTER_CBK_PROGRAM,
+        .progver   = GLUSTER_CBK_VERSION,
+        .actors    = client_cbk_actors,
+        .numactors = GF_CBK_MAXVALUE,
+};
+
+
 int
 notify (xlator_t *this, int32_t event, void *data, ...)
 {
@@ -1609,7 +1749,8 @@ notify (xlator_t *this, int32_t event, void *data, ...)
 int
 build_client_config (xlator_t *this, clnt_conf_t *conf)
 {
-        int ret = 0;
+        int   ret      = 0;
+        char *temp_str = NULL;
 
         ret = dict_get_int32 (this->options, "frame-timeout",
                               &conf->rpc_conf.rpc_timeout);
@@ -1644,6 +1785,18 @@ build_client_config (xlator_t *this, clnt_conf_t *conf)
                 conf->opt.ping_timeout = GF_UNIVERSAL_ANSWER;
         }
 
+        ret = dict_get_str (this->options, "cache-invalidation", &temp_str);
+        if (!ret) {
+                ret = gf_string2boolean (temp_str, &conf->cache_invalidation);
+                if (ret) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'cache-invalidation' takes only boolean "
+                                "options");
+                        ret = -1;
+                        goto out;
+                }
+        }
+
         ret = dict_get_str (this->options, "remote-subvolume",
                             &conf->opt.remote_subvolume);
         if (ret) {
@@ -1727,6 +1880,14 @@ client_init_rpc (xlator_t *this)
         if (ret)
                 goto out;
 
+        if (conf->cache_invalidation) {
+                client_cbk_prog.mydata = this;
+                ret = rpcclnt_cbk_program_register (conf->rpc,
+                                                    &client_cbk_prog);
+                if (ret)
+                        goto out;
+        }
+
         conf->handshake = &clnt_handshake_prog;
         conf->dump      = &clnt_dump_prog;
 
@@ -1741,6 +1902,7 @@ int
 init (xlator_t *this)
 {
         int          ret = -1;
+        int          i   = 0;
         clnt_conf_t *conf = NULL;
 
         /* */
@@ -1765,6 +1927,16 @@ init (xlator_t *this)
 
         this->private = conf;
 
+        pthread_mutex_init (&conf->cache_lock, NULL);
+        conf->cached_inodes = GF_CALLOC (CLIENT_CACHE_HASH_SIZE,
+                                         sizeof (struct list_head),
+                                         gf_common_mt_list_head);
+        if (!conf->cached_inodes)
+                goto out;
+
+        for (i = 0; i < CLIENT_CACHE_HASH_SIZE; i++)
+                INIT_LIST_HEAD (&conf->cached_inodes[i]);
+
         /* If it returns -1, then its a failure, if it returns +1 we need
            have to understand that 'this' is subvolume of a xlator which,
            will set the remote host and remote subvolume in a setxattr
@@ -1791,7 +1963,10 @@ out:
 void
 fini (xlator_t *this)
 {
-        clnt_conf_t *conf = NULL;
+        clnt_conf_t         *conf   = NULL;
+        clnt_cached_inode_t *cached = NULL;
+        clnt_cached_inode_t *tmp    = NULL;
+        int                  i      = 0;
 
         conf = this->private;
         this->private = NULL;
@@ -1805,6 +1980,19 @@ fini (xlator_t *this)
 
                 pthread_mutex_destroy (&conf->lock);
 
+                if (conf->cached_inodes) {
+                        for (i = 0; i < CLIENT_CACHE_HASH_SIZE; i++) {
+                                list_for_each_entry_safe (cached, tmp,
+                                                          &conf->cached_inodes[i],
+                                                          hash) {
+                                        list_del (&cached->hash);
+                                        GF_FREE (cached);
+                                }
+                        }
+                        GF_FREE (conf->cached_inodes);
+                }
+                pthread_mutex_destroy (&conf->cache_lock);
+
                 GF_FREE (conf);
         }
         return;
@@ -1977,5 +2165,8 @@ struct volume_options options[] = {
           .min   = 1,
           .max   = 1013,
         },
+        { .key   = {"cache-invalidation"},
+          .type  = GF_OPTION_TYPE_BOOL
+        },
         { .key   = {NULL} },
 };
@@ -34,6 +34,9 @@
 #define CLIENT_CMD_CONNECT "trusted.glusterfs.client-connect"
 #define CLIENT_CMD_DISCONNECT "trusted.glusterfs.client-disconnect"
 
+/* buckets of the remote inode -> inode_t map used by cache invalidation */
+#define CLIENT_CACHE_HASH_SIZE 1024
+
 struct clnt_options {
         char *remote_subvolume;
         int   ping_timeout;
@@ -54,8 +57,21 @@ typedef struct clnt_conf {
         rpc_clnt_prog_t       *mgmt;
         rpc_clnt_prog_t       *handshake;
         rpc_clnt_prog_t       *dump;
+
+        gf_boolean_t           cache_invalidation;
+        pthread_mutex_t        cache_lock;     /* protects cached_inodes */
+        struct list_head      *cached_inodes;
 } clnt_conf_t;
 
+/* an inode the server may tell us about. the inode is not ref'd, the
+   entry goes away in forget. */
+typedef struct clnt_cached_inode {
+        struct list_head  hash;
+        uint64_t          ino;
+        uint64_t          gen;
+        inode_t          *inode;
+} clnt_cached_inode_t;
+
 typedef struct _client_fd_ctx {
         struct list_head  sfd_pos;      /*  Stores the reference to this
                                             fd's position in the saved_fds list.
@@ -135,5 +151,8 @@ int unserialize_rsp_direntp (struct gfs3_readdirp_rsp *rsp, gf_dirent_t *entries
 int clnt_readdir_rsp_cleanup (gfs3_readdir_rsp *rsp);
 int clnt_readdirp_rsp_cleanup (gfs3_readdirp_rsp *rsp);
 
+void client_cache_record (xlator_t *this, inode_t *inode, uint64_t ino,
+                          uint64_t gen);
+
 
 #endif /* !_CLIENT_H */
@@ -1470,6 +1470,9 @@ client3_1_create_cbk (struct rpc_req *req, struct iovec *iov, int count,
                                 "remote inode number to inode ctx",
                                 local->loc.parent->ino, local->loc.name,
                                 local->loc.path);
+                } else {
+                        client_cache_record (frame->this, inode,
+                                             stbuf.ia_ino, stbuf.ia_gen);
                 }
 
                 gf_stat_to_iatt (&rsp.preparent, &preparent);
@@ -1923,6 +1926,9 @@ client3_1_lookup_cbk (struct rpc_req *req, struct iovec *iov, int count,
                                 local->loc.parent->ino : (uint64_t) 0,
                                 local->loc.name,
                                 local->loc.path);
+                } else {
+                        client_cache_record (frame->this, inode,
+                                             stbuf.ia_ino, stbuf.ia_gen);
                 }
 
                 if (rsp.dict.dict_len > 0) {
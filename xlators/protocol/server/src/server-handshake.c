@@ -343,7 +343,9 @@ server_setvolume (rpcsvc_request_t *req)
         xlator_t            *xl            = NULL;
         char                *msg           = NULL;
         char                *volfile_key   = NULL;
+        char                *invalidation  = NULL;
         xlator_t            *this          = NULL;
+        gf_boolean_t         invalidate    = _gf_false;
         uint32_t             checksum      = 0;
         int32_t              ret           = -1;
         int32_t              op_ret        = -1;
@@ -565,6 +567,18 @@ server_setvolume (rpcsvc_request_t *req)
                                                           conn->bound_xl);
         }
 
+        /* tell the client whether it will hear about changes made by
+           others to what it caches */
+        if (conf->cache_invalidation
+            && !dict_get_str (params, "cache-invalidation", &invalidation)
+            && !gf_string2boolean (invalidation, &invalidate) && invalidate
+            && !server_cache_client_add (this, conn, req->conn->trans)) {
+                ret = dict_set_str (reply, "cache-invalidation", "on");
+                if (ret)
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "failed to set 'cache-invalidation'");
+        }
+
         ret = dict_set_str (reply, "process-uuid",
                             this->ctx->process_uuid);
         if (ret)
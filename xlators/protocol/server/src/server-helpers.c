@@ -24,6 +24,7 @@
 
 #include "server.h"
 #include "server-helpers.h"
+#include "glusterfs3.h"
 
 int
 server_decode_groups (call_frame_t *frame, rpcsvc_request_t *req)
@@ -830,6 +831,17 @@ server_build_config (xlator_t *this, server_conf_t *conf)
                 }
         }
 
+        data = dict_get (this->options, "cache-invalidation");
+        if (data) {
+                ret = gf_string2boolean (data->data,
+                                         &conf->cache_invalidation);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "'cache-invalidation' takes on only boolean "
+                                "values. Neglecting option");
+                }
+        }
+
         data = dict_get (this->options, "trace");
 	if (data) {
                 ret = gf_string2boolean (data->data, &conf->trace);
@@ -939,6 +951,240 @@ destroy_server_conn_state (server_connection_t *conn)
 }
 
 
+/*
+ * cache invalidation
+ *
+ * clients which asked for it in their handshake get a cache slot. whenever
+ * one of them looks up, opens or reads an inode, its slot's bit is set in
+ * the inode ctx. when the inode is then changed, every client whose bit is
+ * set (except the one making the change) is sent a GF_CBK_INVALIDATE call
+ * and the bits are cleared, so that a file which is only being written to
+ * costs no more than a look at its ctx per write.
+ *
+ * a reply read before the change may reach the client after the
+ * invalidation. the client counts the invalidations of every inode
+ * (inode_invalidation_seq) and the caches do not keep a reply if the count
+ * moved while it was in flight.
+ */
+
+int
+server_cache_client_add (xlator_t *this, server_connection_t *conn,
+                         rpc_transport_t *xprt)
+{
+        server_conf_t    *conf    = NULL;
+        rpc_transport_t **clients = NULL;
+        int               slot    = -1;
+        int               i       = 0;
+
+        conf = this->private;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                if (conn->cache_slot
+                    && (conn->cache_slot <= conf->cache_client_count)) {
+                        /* a reconnect: keep the slot, take the new
+                           transport */
+                        slot = conn->cache_slot - 1;
+                        if (conf->cache_clients[slot])
+                                rpc_transport_unref (conf->cache_clients[slot]);
+                        conf->cache_clients[slot] = rpc_transport_ref (xprt);
+                        goto unlock;
+                }
+
+                for (i = 0; i < conf->cache_client_count; i++) {
+                        if (conf->cache_clients[i] == NULL) {
+                                slot = i;
+                                break;
+                        }
+                }
+
+                if (slot == -1) {
+                        clients = GF_REALLOC (conf->cache_clients,
+                                              (conf->cache_client_count + 1)
+                                              * sizeof (*clients));
+                        if (clients == NULL)
+                                goto unlock;
+
+                        conf->cache_clients = clients;
+                        slot = conf->cache_client_count++;
+                }
+
+                conf->cache_clients[slot] = rpc_transport_ref (xprt);
+                conn->cache_slot = slot + 1;
+        }
+unlock:
+        pthread_mutex_unlock (&conf->mutex);
+
+        if (slot == -1) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory");
+                return -1;
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG, "cache slot %d given to %s", slot,
+                xprt->peerinfo.identifier);
+
+        return 0;
+}
+
+
+void
+server_cache_client_del (xlator_t *this, rpc_transport_t *xprt)
+{
+        server_conf_t   *conf  = NULL;
+        rpc_transport_t *found = NULL;
+        int              i     = 0;
+
+        conf = this->private;
+        if (!conf->cache_invalidation)
+                return;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                for (i = 0; i < conf->cache_client_count; i++) {
+                        if (conf->cache_clients[i] == xprt) {
+                                conf->cache_clients[i] = NULL;
+                                found = xprt;
+                                break;
+                        }
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        /* bits of the slot left set in inode ctxs will, at worst, get its
+           next owner an invalidation too many */
+        if (found)
+                rpc_transport_unref (found);
+}
+
+
+void
+server_cache_record (xlator_t *this, server_state_t *state, inode_t *inode)
+{
+        server_conf_t *conf    = NULL;
+        uint64_t       clients = 0;
+        uint64_t       bit     = 0;
+
+        conf = this->private;
+
+        if (!conf->cache_invalidation || !inode || !state->conn
+            || !state->conn->cache_slot)
+                return;
+
+        bit = SERVER_CACHE_SLOT_BIT (state->conn->cache_slot - 1);
+
+        LOCK (&inode->lock);
+        {
+                __inode_ctx_get (inode, this, &clients);
+                if (!(clients & bit))
+                        __inode_ctx_put (inode, this, clients | bit);
+        }
+        UNLOCK (&inode->lock);
+}
+
+
+void
+server_cache_invalidate (xlator_t *this, server_state_t *state,
+                         inode_t *inode)
+{
+        server_conf_t          *conf    = NULL;
+        rpc_transport_t       **xprts   = NULL;
+        struct iobuf           *iob     = NULL;
+        struct iobref          *iobref  = NULL;
+        gf_cbk_invalidate_req   req     = {0, };
+        struct iovec            iov     = {0, };
+        uint64_t                clients = 0;
+        ssize_t                 len     = 0;
+        int                     own     = -1;
+        int                     count   = 0;
+        int                     i       = 0;
+
+        conf = this->private;
+
+        if (!conf->cache_invalidation || !inode)
+                return;
+
+        LOCK (&inode->lock);
+        {
+                __inode_ctx_get (inode, this, &clients);
+                if (clients)
+                        __inode_ctx_put (inode, this, 0);
+        }
+        UNLOCK (&inode->lock);
+
+        if (!clients)
+                return;
+
+        if (state->conn)
+                own = state->conn->cache_slot - 1;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                xprts = GF_CALLOC (conf->cache_client_count, sizeof (*xprts),
+                                   gf_server_mt_cache_clients_t);
+                if (xprts == NULL)
+                        goto unlock;
+
+                for (i = 0; i < conf->cache_client_count; i++) {
+                        if ((i == own) || !conf->cache_clients[i]
+                            || !(clients & SERVER_CACHE_SLOT_BIT (i)))
+                                continue;
+
+                        xprts[count++] = rpc_transport_ref (conf->cache_clients[i]);
+                }
+        }
+unlock:
+        pthread_mutex_unlock (&conf->mutex);
+
+        if (!count)
+                goto out;
+
+        iob = iobuf_get (this->ctx->iobuf_pool);
+        if (iob == NULL) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory");
+                goto out;
+        }
+
+        req.ino = inode->ino;
+        req.gen = inode->generation;
+
+        iobuf_to_iovec (iob, &iov);
+
+        len = xdr_from_cbk_invalidate_req (iov, &req);
+        if (len == -1) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "failed to encode the invalidation of %"PRId64,
+                        inode->ino);
+                goto out;
+        }
+        iov.iov_len = len;
+
+        for (i = 0; i < count; i++) {
+                iobref = iobref_new ();
+                if (iobref == NULL)
+                        break;
+
+                iobref_add (iobref, iob);
+
+                rpcsvc_callback_submit (conf->rpc, xprts[i],
+                                        GLUSTER_CBK_PROGRAM,
+                                        GLUSTER_CBK_VERSION,
+                                        GF_CBK_INVALIDATE, &iov, 1, iobref);
+
+                iobref_unref (iobref);
+        }
+
+out:
+        if (iob)
+                iobuf_unref (iob);
+
+        for (i = 0; i < count; i++)
+                rpc_transport_unref (xprts[i]);
+
+        if (xprts)
+                GF_FREE (xprts);
+}
+
+
 void
 print_caller (char *str, int size, call_frame_t *frame)
 {
@@ -77,6 +77,20 @@ destroy_server_conn_state (server_connection_t *conn);
 int
 server_build_config (xlator_t *this, server_conf_t *conf);
 
+int
+server_cache_client_add (xlator_t *this, server_connection_t *conn,
+                         rpc_transport_t *xprt);
+
+void
+server_cache_client_del (xlator_t *this, rpc_transport_t *xprt);
+
+void
+server_cache_record (xlator_t *this, server_state_t *state, inode_t *inode);
+
+void
+server_cache_invalidate (xlator_t *this, server_state_t *state,
+                         inode_t *inode);
+
 int serialize_rsp_dirent (gf_dirent_t *entries, gfs3_readdir_rsp *rsp);
 int serialize_rsp_direntp (gf_dirent_t *entries, gfs3_readdirp_rsp *rsp);
 int readdirp_rsp_cleanup (gfs3_readdirp_rsp *rsp);
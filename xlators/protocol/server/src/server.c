@@ -391,6 +391,8 @@ server_rpc_notify (rpcsvc_t *rpc, void *xl, rpcsvc_event_t event,
                 break;
         }
         case RPCSVC_EVENT_DISCONNECT:
+                server_cache_client_del (this, xprt);
+
                 conn = get_server_conn_state (this, xprt);
                 if (conn)
                         destroy_server_conn_state (conn);
@@ -616,6 +618,9 @@ struct volume_options options[] = {
         { .key   = {"trace"},
           .type  = GF_OPTION_TYPE_BOOL
         },
+        { .key   = {"cache-invalidation"},
+          .type  = GF_OPTION_TYPE_BOOL
+        },
         { .key   = {"config-directory",
                     "conf-dir"},
           .type  = GF_OPTION_TYPE_PATH,
@@ -32,6 +32,10 @@
 #define DEFAULT_BLOCK_SIZE         4194304   /* 4MB */
 #define DEFAULT_VOLUME_FILE_PATH   CONFDIR "/glusterfs.vol"
 
+/* clients which may have cached an inode are remembered as a bitmap in the
+ * inode ctx, one bit per cache slot (clients beyond 64 share the bits) */
+#define SERVER_CACHE_SLOT_BIT(slot) (1ULL << ((slot) % 64))
+
 typedef struct _server_state server_state_t;
 
 struct _locker {
@@ -64,6 +68,8 @@ struct _server_connection {
 	struct _lock_table *ltable;
 	xlator_t           *bound_xl;
         xlator_t           *this;
+        int                 cache_slot;  /* 1 + index in conf->cache_clients,
+                                            0 if not invalidated */
 };
 
 typedef struct _server_connection server_connection_t;
@@ -98,6 +104,12 @@ struct server_conf {
 	dict_t                 *auth_modules;
 	pthread_mutex_t         mutex;
 	struct list_head        conns;
+
+        /* transports of the clients which get told about changes to the
+           inodes they have cached, by cache slot. under mutex. */
+        gf_boolean_t            cache_invalidation;
+        rpc_transport_t       **cache_clients;
+        int                     cache_client_count;
 };
 typedef struct server_conf server_conf_t;
 
@@ -139,6 +139,7 @@ server_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         link_inode = inode_link (inode, state->loc.parent,
                                                  state->loc.name, stbuf);
                         inode_lookup (link_inode);
+                        server_cache_record (this, state, link_inode);
                         inode_unref (link_inode);
                 }
         } else {
@@ -656,8 +657,9 @@ int
 server_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         int32_t op_ret, int32_t op_errno)
 {
-        gf_common_rsp     rsp = {0,};
-        rpcsvc_request_t *req = NULL;
+        gf_common_rsp     rsp   = {0,};
+        server_state_t   *state = NULL;
+        rpcsvc_request_t *req   = NULL;
 
         req           = frame->local;
 
@@ -665,6 +667,11 @@ server_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         rsp.op_ret    = op_ret;
         rsp.op_errno  = gf_errno_to_error (op_errno);
 
+        if (op_ret == 0) {
+                state = CALL_STATE (frame);
+                server_cache_invalidate (this, state, state->loc.inode);
+        }
+
         server_submit_reply (frame, req, &rsp, NULL, 0, NULL,
                              xdr_serialize_common_rsp);
 
@@ -794,8 +801,9 @@ int
 server_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                      int32_t op_ret, int32_t op_errno)
 {
-        gf_common_rsp     rsp = {0,};
-        rpcsvc_request_t *req = NULL;
+        gf_common_rsp     rsp   = {0,};
+        server_state_t   *state = NULL;
+        rpcsvc_request_t *req   = NULL;
 
         req           = frame->local;
 
@@ -803,6 +811,11 @@ server_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         rsp.op_ret    = op_ret;
         rsp.op_errno  = gf_errno_to_error (op_errno);
 
+        if (op_ret == 0) {
+                state = CALL_STATE (frame);
+                server_cache_invalidate (this, state, state->loc.inode);
+        }
+
         server_submit_reply (frame, req, &rsp, NULL, 0, NULL,
                              xdr_serialize_common_rsp);
 
@@ -814,8 +827,9 @@ int
 server_fsetxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                       int32_t op_ret, int32_t op_errno)
 {
-        gf_common_rsp     rsp = {0,};
-        rpcsvc_request_t *req = NULL;
+        gf_common_rsp     rsp   = {0,};
+        server_state_t   *state = NULL;
+        rpcsvc_request_t *req   = NULL;
 
         req           = frame->local;
 
@@ -823,6 +837,11 @@ server_fsetxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         rsp.op_ret    = op_ret;
         rsp.op_errno  = gf_errno_to_error (op_errno);
 
+        if (op_ret == 0) {
+                state = CALL_STATE (frame);
+                server_cache_invalidate (this, state, state->fd->inode);
+        }
+
         server_submit_reply (frame, req, &rsp, NULL, 0, NULL,
                              xdr_serialize_common_rsp);
 
@@ -858,6 +877,13 @@ server_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         state->loc.parent->ino, state->loc.name,
                         state->loc2.parent->ino, state->loc2.name);
 
+                /* the inode moved, and the one it replaced lost a name */
+                server_cache_invalidate (this, state, state->loc.inode);
+                if (state->loc2.inode
+                    && (state->loc2.inode != state->loc.inode))
+                        server_cache_invalidate (this, state,
+                                                 state->loc2.inode);
+
                 inode_rename (state->itable,
                               state->loc.parent, state->loc.name,
                               state->loc2.parent, state->loc2.name,
@@ -901,6 +927,8 @@ server_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         frame->root->unique, state->loc.parent->ino,
                         state->loc.name, state->loc.inode->ino);
 
+                server_cache_invalidate (this, state, state->loc.inode);
+
                 inode_unlink (state->loc.inode, state->loc.parent,
                               state->loc.name);
 
@@ -1042,6 +1070,7 @@ server_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (op_ret == 0) {
                 gf_stat_from_iatt (&rsp.prestat, prebuf);
                 gf_stat_from_iatt (&rsp.poststat, postbuf);
+                server_cache_invalidate (this, state, state->loc.inode);
         } else {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "%"PRId64": TRUNCATE %s (%"PRId64") ==> %"PRId32" (%s)",
@@ -1108,6 +1137,7 @@ server_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (op_ret == 0) {
                 gf_stat_from_iatt (&rsp.prestat, prebuf);
                 gf_stat_from_iatt (&rsp.poststat, postbuf);
+                server_cache_invalidate (this, state, state->fd->inode);
         } else {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "%"PRId64": FTRUNCATE %"PRId64" (%"PRId64") ==> %"PRId32" (%s)",
@@ -1224,6 +1254,7 @@ server_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (op_ret >= 0) {
                 gf_stat_from_iatt (&rsp.prestat, prebuf);
                 gf_stat_from_iatt (&rsp.poststat, postbuf);
+                server_cache_invalidate (this, state, state->fd->inode);
         } else {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "%"PRId64": WRITEV %"PRId64" (%"PRId64") ==> %"PRId32" (%s)",
@@ -1318,6 +1349,9 @@ server_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 fd_bind (fd);
                 fd_no = gf_fd_unused_get (conn->fdtable, fd);
                 fd_ref (fd);
+
+                if (state->flags & O_TRUNC)
+                        server_cache_invalidate (this, state, fd->inode);
         } else {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "%"PRId64": OPEN %s (%"PRId64") ==> %"PRId32" (%s)",
@@ -1507,6 +1541,7 @@ server_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (op_ret == 0) {
                 gf_stat_from_iatt (&rsp.statpre, statpre);
                 gf_stat_from_iatt (&rsp.statpost, statpost);
+                server_cache_invalidate (this, state, state->loc.inode);
         } else {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "%"PRId64": SETATTR %s (%"PRId64") ==> %"PRId32" (%s)",
@@ -1535,6 +1570,7 @@ server_fsetattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (op_ret == 0) {
                 gf_stat_from_iatt (&rsp.statpre, statpre);
                 gf_stat_from_iatt (&rsp.statpost, statpost);
+                server_cache_invalidate (this, state, state->fd->inode);
         } else {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "%"PRId64": FSETATTR %"PRId64" (%"PRId64") ==> "
@@ -2253,7 +2289,7 @@ server_fsetxattr_resume (call_frame_t *frame, xlator_t *bound_xl)
         if (state->resolve.op_ret != 0)
                 goto err;
 
-        STACK_WIND (frame, server_setxattr_cbk,
+        STACK_WIND (frame, server_fsetxattr_cbk,
                     bound_xl, bound_xl->fops->fsetxattr,
                     state->fd, state->dict, state->flags);
         return 0;
@@ -2467,6 +2503,9 @@ server_readv_resume (call_frame_t *frame, xlator_t *bound_xl)
         if (state->resolve.op_ret != 0)
                 goto err;
 
+        /* before the read, so that a write racing with it is not missed */
+        server_cache_record (frame->this, state, state->fd->inode);
+
         STACK_WIND (frame, server_readv_cbk,
                     bound_xl, bound_xl->fops->readv,
                     state->fd, state->size, state->offset);
@@ -2520,6 +2559,8 @@ server_open_resume (call_frame_t *frame, xlator_t *bound_xl)
         state->fd = fd_create (state->loc.inode, frame->root->pid);
         state->fd->flags = state->flags;
 
+        server_cache_record (frame->this, state, state->loc.inode);
+
         STACK_WIND (frame, server_open_cbk,
                     bound_xl, bound_xl->fops->open,
                     &state->loc, state->flags, state->fd, 0);
@@ -2626,10 +2667,12 @@ server_lookup_resume (call_frame_t *frame, xlator_t *bound_xl)
         if (state->resolve.op_ret != 0)
                 goto err;
 
-        if (!state->loc.inode)
+        if (!state->loc.inode) {
                 state->loc.inode = inode_new (state->itable);
-        else
+        } else {
                 state->is_revalidate = 1;
+                server_cache_record (frame->this, state, state->loc.inode);
+        }
 
         STACK_WIND (frame, server_lookup_cbk,
                     bound_xl, bound_xl->fops->lookup,
@@ -0,0 +1,1802 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * the log itself: segment files, the in-memory index of the files they
+ * hold, replay of the segments at startup and compaction.
+ *
+ * Every update of a file appends a record with its whole content and a
+ * new sequence number, and the index is pointed at it. On replay the
+ * record with the highest sequence number of a file wins.
+ *
+ * Updates of a file are serialized by its write lock (one of
+ * LGS_WRITE_LOCKS, hashed by inode number), which is always taken
+ * before priv->lock. An entry is only freed or moved with its write
+ * lock held, so a thread holding it can use the entry without
+ * priv->lock. Readers only take priv->lock, and a reference on the
+ * segment they read from.
+ *
+ * The compactor cleans the oldest segment: it copies the records still
+ * in the index to the tail of the log and then deletes the segment. As
+ * nothing older than the oldest segment remains, the delete records in
+ * it can be dropped.
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "logstore.h"
+#include "logstore-mem-types.h"
+#include "checksum.h"
+#include "common-utils.h"
+#include "byte-order.h"
+
+/* records are read back through a buffer of this size */
+#define LGS_SCAN_BUFFER       (2 * LGS_MAX_PAYLOAD)
+
+/* seconds to wait before retrying a failed compaction */
+#define LGS_COMPACT_RETRY     10
+
+typedef int (*lgs_scan_fn_t) (xlator_t *this, lgs_segment_t *seg, off_t off,
+                              lgs_record_t *rec, char *raw);
+
+
+static uint32_t
+lgs_hash (uint64_t ino, uint64_t gen)
+{
+        uint64_t hash = 0;
+
+        hash = (ino * 0x9e3779b97f4a7c15ULL) ^ gen;
+
+        return (uint32_t) ((hash >> 32) ^ hash) & (LGS_INDEX_BUCKETS - 1);
+}
+
+
+static pthread_mutex_t *
+lgs_write_lock (lgs_private_t *priv, uint64_t ino)
+{
+        return &priv->write_locks[ino % LGS_WRITE_LOCKS];
+}
+
+
+/* {{{ index */
+
+static lgs_entry_t *
+__lgs_entry_get (lgs_private_t *priv, uint64_t ino, uint64_t gen)
+{
+        lgs_entry_t *entry = NULL;
+
+        for (entry = priv->index[lgs_hash (ino, gen)]; entry;
+             entry = entry->next) {
+                if ((entry->ino == ino) && (entry->gen == gen))
+                        break;
+        }
+
+        return entry;
+}
+
+
+static lgs_entry_t *
+__lgs_entry_new (lgs_private_t *priv, uint64_t ino, uint64_t gen)
+{
+        lgs_entry_t  *entry  = NULL;
+        lgs_entry_t **bucket = NULL;
+
+        entry = GF_CALLOC (1, sizeof (*entry), gf_lgs_mt_lgs_entry_t);
+        if (!entry)
+                return NULL;
+
+        entry->ino = ino;
+        entry->gen = gen;
+
+        bucket = &priv->index[lgs_hash (ino, gen)];
+        entry->next = *bucket;
+        *bucket = entry;
+
+        priv->entries++;
+
+        return entry;
+}
+
+
+/* take @entry out of the index, its record becomes dead */
+static void
+__lgs_entry_unlink (lgs_private_t *priv, lgs_entry_t *entry)
+{
+        lgs_entry_t **link = NULL;
+        off_t         len  = 0;
+
+        link = &priv->index[lgs_hash (entry->ino, entry->gen)];
+        while (*link != entry)
+                link = &(*link)->next;
+
+        *link = entry->next;
+
+        if (entry->seg) {
+                len = LGS_RECORD_LEN (entry->len);
+                entry->seg->live -= len;
+                priv->live -= len;
+        }
+
+        priv->entries--;
+}
+
+
+/* point @entry at a new record, the old one becomes dead */
+static void
+__lgs_entry_set (lgs_private_t *priv, lgs_entry_t *entry, lgs_segment_t *seg,
+                 off_t off, uint64_t seq, uint64_t size, uint32_t len)
+{
+        off_t old_len = 0;
+
+        if (entry->seg) {
+                old_len = LGS_RECORD_LEN (entry->len);
+                entry->seg->live -= old_len;
+                priv->live -= old_len;
+        }
+
+        entry->seg  = seg;
+        entry->off  = off;
+        entry->seq  = seq;
+        entry->size = size;
+        entry->len  = len;
+
+        seg->live  += LGS_RECORD_LEN (len);
+        priv->live += LGS_RECORD_LEN (len);
+}
+
+/* }}} */
+
+
+/* {{{ segments */
+
+static void
+lgs_segment_path (lgs_private_t *priv, uint32_t id, char *path)
+{
+        snprintf (path, PATH_MAX, "%s/segment.%010u", priv->segment_dir, id);
+}
+
+
+static lgs_segment_t *
+lgs_segment_open (xlator_t *this, uint32_t id, int flags)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+        struct stat    buf  = {0, };
+        char           path[PATH_MAX];
+        int            fd   = -1;
+
+        priv = this->private;
+
+        lgs_segment_path (priv, id, path);
+
+        fd = open (path, O_RDWR | flags, 0600);
+        if (fd == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not open segment %s (%s)",
+                        path, strerror (errno));
+                goto err;
+        }
+
+        if (fstat (fd, &buf) == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not stat segment %s (%s)",
+                        path, strerror (errno));
+                goto err;
+        }
+
+        seg = GF_CALLOC (1, sizeof (*seg), gf_lgs_mt_lgs_segment_t);
+        if (!seg) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                goto err;
+        }
+
+        INIT_LIST_HEAD (&seg->list);
+        seg->id   = id;
+        seg->fd   = fd;
+        seg->tail = buf.st_size;
+
+        return seg;
+
+err:
+        if (fd != -1)
+                close (fd);
+
+        return NULL;
+}
+
+
+static void
+lgs_segment_free (lgs_segment_t *seg)
+{
+        close (seg->fd);
+        GF_FREE (seg);
+}
+
+
+static void
+__lgs_segment_unref (lgs_segment_t *seg)
+{
+        seg->refs--;
+
+        if (!seg->refs && seg->retired)
+                lgs_segment_free (seg);
+}
+
+
+/* seal the active segment, new records go to a new one */
+static int
+__lgs_segment_rotate (xlator_t *this)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+
+        priv = this->private;
+
+        seg = lgs_segment_open (this, priv->active->id + 1,
+                                O_CREAT | O_EXCL);
+        if (!seg)
+                return -1;
+
+        list_add_tail (&seg->list, &priv->segments);
+        priv->active = seg;
+
+        return 0;
+}
+
+
+static int
+__lgs_need_compaction (lgs_private_t *priv)
+{
+        lgs_segment_t *oldest = NULL;
+
+        if (list_empty (&priv->segments))
+                return 0;
+
+        oldest = list_entry (priv->segments.next, lgs_segment_t, list);
+        if (oldest == priv->active)
+                return 0;
+
+        return ((priv->used - priv->live) * 100
+                >= priv->used * priv->compact_threshold);
+}
+
+
+static void
+__lgs_kick_compactor (lgs_private_t *priv)
+{
+        if (__lgs_need_compaction (priv))
+                pthread_cond_signal (&priv->compact_cond);
+}
+
+/* }}} */
+
+
+/* {{{ records */
+
+static void
+lgs_record_fill (char *raw, lgs_record_type_t type, uint64_t ino,
+                 uint64_t gen, uint64_t seq, uint64_t size, uint32_t len)
+{
+        lgs_record_t *rec = NULL;
+        size_t        end = 0;
+
+        rec = (lgs_record_t *) raw;
+
+        rec->magic = hton32 (LGS_RECORD_MAGIC);
+        rec->type  = hton32 (type);
+        rec->ino   = hton64 (ino);
+        rec->gen   = hton64 (gen);
+        rec->seq   = hton64 (seq);
+        rec->size  = hton64 (size);
+        rec->len   = hton32 (len);
+        rec->csum  = 0;
+
+        end = sizeof (*rec) + len;
+        memset (raw + end, 0, LGS_RECORD_LEN (len) - end);
+
+        rec->csum = hton32 (gf_rsync_weak_checksum (raw, end));
+}
+
+
+/*
+ * decode the record at @raw, of which @avail bytes are at hand. returns
+ * its length on disk, 0 if it is not a valid record, or -1 if more
+ * bytes are needed to tell.
+ */
+static ssize_t
+lgs_record_check (char *raw, size_t avail, lgs_record_t *rec)
+{
+        lgs_record_t *disk = NULL;
+        uint32_t      csum = 0;
+        size_t        len  = 0;
+
+        disk = (lgs_record_t *) raw;
+
+        rec->magic = ntoh32 (disk->magic);
+        rec->type  = ntoh32 (disk->type);
+        rec->ino   = ntoh64 (disk->ino);
+        rec->gen   = ntoh64 (disk->gen);
+        rec->seq   = ntoh64 (disk->seq);
+        rec->size  = ntoh64 (disk->size);
+        rec->len   = ntoh32 (disk->len);
+        rec->csum  = ntoh32 (disk->csum);
+
+        if ((rec->magic != LGS_RECORD_MAGIC)
+            || ((rec->type != LGS_RECORD_PUT)
+                && (rec->type != LGS_RECORD_DEL)
+                && (rec->type != LGS_RECORD_UNLINKED))
+            || (rec->len > LGS_MAX_PAYLOAD)
+            || (rec->size < rec->len))
+                return 0;
+
+        len = LGS_RECORD_LEN (rec->len);
+        if (len > avail)
+                return -1;
+
+        disk->csum = 0;
+        csum = gf_rsync_weak_checksum (raw, sizeof (*disk) + rec->len);
+        disk->csum = hton32 (rec->csum);
+
+        if (csum != rec->csum)
+                return 0;
+
+        return len;
+}
+
+
+/*
+ * write a record at the tail of the log. on success the segment it went
+ * to is returned with a reference, which the caller drops once it has
+ * pointed the index at it.
+ */
+static int
+lgs_append (xlator_t *this, char *raw, size_t len, lgs_segment_t **segp,
+            off_t *offp)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+        off_t          off  = 0;
+        ssize_t        ret  = 0;
+        int            op_errno = 0;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (priv->active->tail
+                    && (priv->active->tail + len > priv->segment_size)) {
+                        /* keep appending to the old one if we can't */
+                        __lgs_segment_rotate (this);
+                }
+
+                seg = priv->active;
+                off = seg->tail;
+
+                seg->tail  += len;
+                priv->used += len;
+                seg->refs++;
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        ret = pwrite (seg->fd, raw, len, off);
+        if (ret != len) {
+                op_errno = (ret == -1) ? errno : ENOSPC;
+
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not append %"GF_PRI_SIZET" bytes to segment "
+                        "%u (%s)", len, seg->id, strerror (op_errno));
+
+                /* the space stays reserved, and is skipped on replay */
+                pthread_mutex_lock (&priv->lock);
+                {
+                        __lgs_segment_unref (seg);
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                return -op_errno;
+        }
+
+        *segp = seg;
+        *offp = off;
+
+        return 0;
+}
+
+
+/* append a record with @len bytes of content at @raw + header */
+static int
+lgs_put (xlator_t *this, lgs_entry_t *entry, char *raw, uint64_t size,
+         uint32_t len)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+        off_t          off  = 0;
+        uint64_t       seq  = 0;
+        int            ret  = 0;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                seq = ++priv->seq;
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        lgs_record_fill (raw, LGS_RECORD_PUT, entry->ino, entry->gen, seq,
+                         size, len);
+
+        ret = lgs_append (this, raw, LGS_RECORD_LEN (len), &seg, &off);
+        if (ret < 0)
+                return ret;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                __lgs_entry_set (priv, entry, seg, off, seq, size, len);
+                __lgs_segment_unref (seg);
+
+                __lgs_kick_compactor (priv);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return 0;
+}
+
+
+static int
+lgs_del (xlator_t *this, uint64_t ino, uint64_t gen, uint64_t seq)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+        off_t          off  = 0;
+        char           raw[LGS_RECORD_LEN (0)];
+        int            ret  = 0;
+
+        priv = this->private;
+
+        lgs_record_fill (raw, LGS_RECORD_DEL, ino, gen, seq, 0, 0);
+
+        ret = lgs_append (this, raw, sizeof (raw), &seg, &off);
+        if (ret < 0)
+                return ret;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                __lgs_segment_unref (seg);
+
+                __lgs_kick_compactor (priv);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return 0;
+}
+
+
+/* like lgs_del(), but the record is on disk when it returns */
+static int
+lgs_unlinked (xlator_t *this, uint64_t ino, uint64_t gen, uint64_t seq)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+        off_t          off  = 0;
+        char           raw[LGS_RECORD_LEN (0)];
+        int            ret  = 0;
+
+        priv = this->private;
+
+        lgs_record_fill (raw, LGS_RECORD_UNLINKED, ino, gen, seq, 0, 0);
+
+        ret = lgs_append (this, raw, sizeof (raw), &seg, &off);
+        if (ret < 0)
+                return ret;
+
+        if (fdatasync (seg->fd) == -1) {
+                ret = -errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not sync segment %u (%s)", seg->id,
+                        strerror (-ret));
+        }
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                __lgs_segment_unref (seg);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return ret;
+}
+
+
+/*
+ * call @fn on each valid record of @seg. invalid records (torn writes,
+ * or the space of a failed append) are skipped a LGS_RECORD_ALIGN at a
+ * time until a valid one turns up.
+ */
+static int
+lgs_segment_scan (xlator_t *this, lgs_segment_t *seg, lgs_scan_fn_t fn)
+{
+        lgs_record_t  rec;
+        char         *buf     = NULL;
+        off_t         buf_off = 0;
+        ssize_t       buf_len = 0;
+        off_t         pos     = 0;
+        off_t         skipped = 0;
+        ssize_t       len     = 0;
+        int           ret     = 0;
+
+        buf = GF_MALLOC (LGS_SCAN_BUFFER, gf_lgs_mt_char);
+        if (!buf) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                return -1;
+        }
+
+        while (pos + (off_t) sizeof (rec) <= seg->tail) {
+                len = -1;
+                if (pos + (off_t) sizeof (rec) <= buf_off + buf_len)
+                        len = lgs_record_check (buf + (pos - buf_off),
+                                                buf_off + buf_len - pos,
+                                                &rec);
+
+                if (len == -1) {
+                        /* need more, read on from @pos */
+                        buf_off = pos;
+                        buf_len = pread (seg->fd, buf,
+                                         min (LGS_SCAN_BUFFER,
+                                              seg->tail - pos), pos);
+                        if (buf_len < (ssize_t) sizeof (rec)) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "could not read segment %u at %"
+                                        PRId64" (%s)", seg->id, pos,
+                                        (buf_len == -1) ? strerror (errno)
+                                        : "short read");
+                                ret = -1;
+                                break;
+                        }
+
+                        len = lgs_record_check (buf, buf_len, &rec);
+                        if (len == -1)
+                                len = 0;    /* runs past the end */
+                }
+
+                if (len == 0) {
+                        skipped += LGS_RECORD_ALIGN;
+                        pos += LGS_RECORD_ALIGN;
+                        continue;
+                }
+
+                ret = fn (this, seg, pos, &rec, buf + (pos - buf_off));
+                if (ret < 0)
+                        break;
+
+                pos += len;
+        }
+
+        if (skipped)
+                gf_log (this->name, GF_LOG_WARNING,
+                        "skipped %"PRId64" bytes of invalid records in "
+                        "segment %u", skipped, seg->id);
+
+        GF_FREE (buf);
+
+        return ret;
+}
+
+/* }}} */
+
+
+/* {{{ replay and compaction */
+
+static int
+lgs_replay_record (xlator_t *this, lgs_segment_t *seg, off_t off,
+                   lgs_record_t *rec, char *raw)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_entry_t   *entry = NULL;
+        int            ret   = 0;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (rec->seq > priv->seq)
+                        priv->seq = rec->seq;
+
+                entry = __lgs_entry_get (priv, rec->ino, rec->gen);
+
+                /* nothing brings back a file with no name left,
+                   whichever order its records come in. it is
+                   dropped with the others after the replay. */
+                if (rec->type == LGS_RECORD_UNLINKED) {
+                        if (!entry)
+                                entry = __lgs_entry_new (priv, rec->ino,
+                                                         rec->gen);
+                        if (entry)
+                                entry->unlinked = 1;
+                        goto unlock;
+                }
+
+                if (entry && entry->unlinked)
+                        goto unlock;
+
+                /* a copy made by compaction has the same seq, and
+                   comes later */
+                if (entry && (entry->seq > rec->seq))
+                        goto unlock;
+
+                if (rec->type == LGS_RECORD_DEL) {
+                        if (entry) {
+                                __lgs_entry_unlink (priv, entry);
+                                GF_FREE (entry);
+                        }
+                        goto unlock;
+                }
+
+                if (!entry) {
+                        entry = __lgs_entry_new (priv, rec->ino, rec->gen);
+                        if (!entry) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "out of memory :(");
+                                ret = -1;
+                                goto unlock;
+                        }
+                }
+
+                __lgs_entry_set (priv, entry, seg, off, rec->seq, rec->size,
+                                 rec->len);
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+
+        return ret;
+}
+
+
+/* copy the record to the tail of the log if the index still uses it */
+static int
+lgs_compact_record (xlator_t *this, lgs_segment_t *seg, off_t off,
+                    lgs_record_t *rec, char *raw)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        lgs_segment_t   *to    = NULL;
+        pthread_mutex_t *lock  = NULL;
+        off_t            to_off = 0;
+        size_t           len   = 0;
+        int              live  = 0;
+        int              ret   = 0;
+
+        priv = this->private;
+
+        /* nothing older is left for a delete record to cancel */
+        if (rec->type == LGS_RECORD_DEL)
+                return 0;
+
+        len  = LGS_RECORD_LEN (rec->len);
+        lock = lgs_write_lock (priv, rec->ino);
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, rec->ino, rec->gen);
+                        if (rec->type == LGS_RECORD_UNLINKED)
+                                /* until the file is forgotten, newer
+                                   records may be left for it to cancel */
+                                live = (entry && entry->unlinked);
+                        else
+                                live = (entry && (entry->seg == seg)
+                                        && (entry->off == off));
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if (!live)
+                        goto unlock;
+
+                /* the same bytes, seq and all */
+                ret = lgs_append (this, raw, len, &to, &to_off);
+                if (ret < 0)
+                        goto unlock;
+
+                if (rec->type == LGS_RECORD_UNLINKED) {
+                        pthread_mutex_lock (&priv->lock);
+                        {
+                                __lgs_segment_unref (to);
+                        }
+                        pthread_mutex_unlock (&priv->lock);
+                        goto unlock;
+                }
+
+                pthread_mutex_lock (&priv->lock);
+                {
+                        __lgs_entry_set (priv, entry, to, to_off, entry->seq,
+                                         entry->size, entry->len);
+                        __lgs_segment_unref (to);
+
+                        priv->compacted_bytes += len;
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
+unlock:
+        pthread_mutex_unlock (lock);
+
+        return ret;
+}
+
+
+/*
+ * the copies of the records of a compacted segment must be on disk
+ * before it goes. they went to @from, active when the copying began, or
+ * to segments rotation created after it, so those are synced, and the
+ * directory that has the new ones.
+ */
+static int
+lgs_compact_sync (xlator_t *this, lgs_segment_t *from)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+        lgs_segment_t *next = NULL;
+        int            fd   = -1;
+        int            ret  = 0;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                seg = from;
+                seg->refs++;
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        while (seg) {
+                if (fdatasync (seg->fd) == -1) {
+                        ret = -errno;
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not sync segment %u (%s)", seg->id,
+                                strerror (-ret));
+                }
+
+                pthread_mutex_lock (&priv->lock);
+                {
+                        next = NULL;
+                        if ((ret == 0)
+                            && (seg->list.next != &priv->segments)) {
+                                next = list_entry (seg->list.next,
+                                                   lgs_segment_t, list);
+                                next->refs++;
+                        }
+                        __lgs_segment_unref (seg);
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                seg = next;
+        }
+
+        if (ret < 0)
+                return ret;
+
+        fd = open (priv->segment_dir, O_RDONLY);
+        if ((fd == -1) || (fsync (fd) == -1)) {
+                ret = -errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not sync %s (%s)", priv->segment_dir,
+                        strerror (-ret));
+        }
+
+        if (fd != -1)
+                close (fd);
+
+        return ret;
+}
+
+
+static void *
+lgs_compactor (void *data)
+{
+        xlator_t        *this  = NULL;
+        lgs_private_t   *priv  = NULL;
+        lgs_segment_t   *seg   = NULL;
+        lgs_segment_t   *from  = NULL;
+        struct timespec  retry = {0, };
+        char             path[PATH_MAX];
+        char             retired = 0;
+        int              ret   = 0;
+
+        this = data;
+        priv = this->private;
+
+        THIS = this;
+
+        pthread_mutex_lock (&priv->lock);
+
+        while (!priv->fini) {
+                if (!__lgs_need_compaction (priv)) {
+                        pthread_cond_wait (&priv->compact_cond, &priv->lock);
+                        continue;
+                }
+
+                seg = list_entry (priv->segments.next, lgs_segment_t, list);
+                seg->refs++;
+
+                from = priv->active;
+                from->refs++;
+
+                pthread_mutex_unlock (&priv->lock);
+
+                ret = lgs_segment_scan (this, seg, lgs_compact_record);
+                if (ret == 0)
+                        ret = lgs_compact_sync (this, from);
+
+                pthread_mutex_lock (&priv->lock);
+
+                __lgs_segment_unref (from);
+
+                /* a record still being written when it was scanned
+                   leaves the segment live, it is copied next time */
+                retired = ((ret == 0) && (seg->live == 0));
+                if (retired) {
+                        list_del_init (&seg->list);
+                        priv->used -= seg->tail;
+                        priv->compactions++;
+                        seg->retired = 1;
+
+                        lgs_segment_path (priv, seg->id, path);
+                        unlink (path);
+
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "compacted segment %u", seg->id);
+                }
+
+                __lgs_segment_unref (seg);
+
+                if (!retired) {
+                        if (ret != 0)
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "compaction failed, retrying in %d "
+                                        "seconds", LGS_COMPACT_RETRY);
+
+                        retry.tv_sec = time (NULL) + LGS_COMPACT_RETRY;
+                        pthread_cond_timedwait (&priv->compact_cond,
+                                                &priv->lock, &retry);
+                }
+        }
+
+        pthread_mutex_unlock (&priv->lock);
+
+        return NULL;
+}
+
+
+/* the files with no name left when the brick stopped are gone */
+static void
+lgs_drop_unlinked (xlator_t *this)
+{
+        lgs_private_t  *priv  = NULL;
+        lgs_entry_t   **link  = NULL;
+        lgs_entry_t    *entry = NULL;
+        uint64_t        count = 0;
+        uint32_t        i     = 0;
+
+        priv = this->private;
+
+        for (i = 0; i < LGS_INDEX_BUCKETS; i++) {
+                link = &priv->index[i];
+                while ((entry = *link)) {
+                        if (!entry->unlinked) {
+                                link = &entry->next;
+                                continue;
+                        }
+
+                        __lgs_entry_unlink (priv, entry);
+                        GF_FREE (entry);
+                        count++;
+                }
+        }
+
+        if (count)
+                gf_log (this->name, GF_LOG_INFO,
+                        "dropped %"PRIu64" files unlinked before the "
+                        "restart", count);
+}
+
+
+static int
+lgs_load_segments (xlator_t *this)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_segment_t *seg   = NULL;
+        lgs_segment_t *tmp   = NULL;
+        DIR           *dir   = NULL;
+        struct dirent *entry = NULL;
+        uint32_t       id    = 0;
+        char           trail = 0;
+        int            ret   = -1;
+
+        priv = this->private;
+
+        dir = opendir (priv->segment_dir);
+        if (!dir) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not open segment directory %s (%s)",
+                        priv->segment_dir, strerror (errno));
+                goto out;
+        }
+
+        while ((entry = readdir (dir))) {
+                if (sscanf (entry->d_name, "segment.%u%c", &id, &trail) != 1)
+                        continue;
+
+                seg = lgs_segment_open (this, id, 0);
+                if (!seg)
+                        goto out;
+
+                /* keep them in the order they were written */
+                list_for_each_entry (tmp, &priv->segments, list) {
+                        if (tmp->id > id)
+                                break;
+                }
+                list_add_tail (&seg->list, &tmp->list);
+        }
+
+        list_for_each_entry (seg, &priv->segments, list) {
+                ret = lgs_segment_scan (this, seg, lgs_replay_record);
+                if (ret < 0)
+                        goto out;
+
+                priv->used += seg->tail;
+                id = seg->id;
+        }
+
+        lgs_drop_unlinked (this);
+
+        ret = 0;
+out:
+        if (dir)
+                closedir (dir);
+
+        return ret;
+}
+
+/* }}} */
+
+
+int
+lgs_store_init (xlator_t *this)
+{
+        lgs_private_t *priv = NULL;
+        lgs_segment_t *seg  = NULL;
+        uint32_t       id   = 0;
+        int            ret  = -1;
+        int            i    = 0;
+
+        priv = this->private;
+
+        pthread_mutex_init (&priv->lock, NULL);
+        pthread_cond_init (&priv->compact_cond, NULL);
+        for (i = 0; i < LGS_WRITE_LOCKS; i++)
+                pthread_mutex_init (&priv->write_locks[i], NULL);
+
+        INIT_LIST_HEAD (&priv->segments);
+
+        priv->index = GF_CALLOC (LGS_INDEX_BUCKETS, sizeof (lgs_entry_t *),
+                                 gf_lgs_mt_lgs_index_t);
+        if (!priv->index) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                goto out;
+        }
+
+        ret = lgs_load_segments (this);
+        if (ret < 0)
+                goto out;
+
+        if (!list_empty (&priv->segments)) {
+                seg = list_entry (priv->segments.prev, lgs_segment_t, list);
+                id  = seg->id;
+        }
+
+        /* never append after what could be a torn record */
+        priv->active = lgs_segment_open (this, id + 1, O_CREAT | O_EXCL);
+        if (!priv->active) {
+                ret = -1;
+                goto out;
+        }
+        list_add_tail (&priv->active->list, &priv->segments);
+
+        gf_log (this->name, GF_LOG_INFO,
+                "%"PRIu64" files in the log, %"PRIu64" of %"PRIu64" bytes "
+                "live", priv->entries, priv->live, priv->used);
+
+        ret = pthread_create (&priv->compactor, NULL, lgs_compactor, this);
+        if (ret != 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not start the compactor (%s)",
+                        strerror (ret));
+                ret = -1;
+                goto out;
+        }
+        priv->compactor_running = 1;
+
+        ret = 0;
+out:
+        return ret;
+}
+
+
+void
+lgs_store_fini (xlator_t *this)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_segment_t *seg   = NULL;
+        lgs_segment_t *tmp   = NULL;
+        lgs_entry_t   *entry = NULL;
+        uint32_t       i     = 0;
+
+        priv = this->private;
+
+        if (priv->compactor_running) {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        priv->fini = 1;
+                        pthread_cond_signal (&priv->compact_cond);
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                pthread_join (priv->compactor, NULL);
+        }
+
+        if (priv->index) {
+                for (i = 0; i < LGS_INDEX_BUCKETS; i++) {
+                        while ((entry = priv->index[i])) {
+                                priv->index[i] = entry->next;
+                                GF_FREE (entry->migration);
+                                GF_FREE (entry);
+                        }
+                }
+                GF_FREE (priv->index);
+        }
+
+        list_for_each_entry_safe (seg, tmp, &priv->segments, list) {
+                list_del (&seg->list);
+                lgs_segment_free (seg);
+        }
+
+        for (i = 0; i < LGS_WRITE_LOCKS; i++)
+                pthread_mutex_destroy (&priv->write_locks[i]);
+        pthread_cond_destroy (&priv->compact_cond);
+        pthread_mutex_destroy (&priv->lock);
+}
+
+
+lgs_state_t
+lgs_store_state (xlator_t *this, uint64_t ino, uint64_t gen)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_entry_t   *entry = NULL;
+        lgs_state_t    state = LGS_ABSENT;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                entry = __lgs_entry_get (priv, ino, gen);
+                if (entry)
+                        state = entry->migration ? LGS_MIGRATING
+                                : LGS_STORED;
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return state;
+}
+
+
+/* a new, empty file. it has no record until it is first written. */
+int
+lgs_store_add (xlator_t *this, uint64_t ino, uint64_t gen)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        pthread_mutex_t *lock  = NULL;
+        int              ret   = 0;
+
+        priv = this->private;
+        lock = lgs_write_lock (priv, ino);
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, ino, gen);
+                        if (!entry)
+                                entry = __lgs_entry_new (priv, ino, gen);
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if (!entry) {
+                        ret = -ENOMEM;
+                        goto unlock;
+                }
+
+                /* only if the generation was reused: forget what the
+                   log has under it */
+                if (entry->seg) {
+                        char raw[LGS_RECORD_LEN (0)];
+
+                        ret = lgs_put (this, entry, raw, 0, 0);
+                }
+        }
+unlock:
+        pthread_mutex_unlock (lock);
+
+        return ret;
+}
+
+
+/*
+ * copy the content at [@offset, @offset + @size) to @buf. returns the
+ * number of bytes copied, which stops short at the end of the content
+ * kept in the log (the rest, up to the file size, are zeroes).
+ */
+int
+lgs_store_read (xlator_t *this, uint64_t ino, uint64_t gen, char *buf,
+                off_t offset, size_t size)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_entry_t   *entry = NULL;
+        lgs_segment_t *seg   = NULL;
+        off_t          pos   = 0;
+        ssize_t        ret   = 0;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                entry = __lgs_entry_get (priv, ino, gen);
+                if (!entry) {
+                        ret = -ENOENT;
+                        goto unlock;
+                }
+
+                if (offset >= entry->len)
+                        goto unlock;
+
+                size = min (size, entry->len - offset);
+                pos  = entry->off + sizeof (lgs_record_t) + offset;
+                seg  = entry->seg;
+                seg->refs++;
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+
+        if (!seg)
+                return ret;
+
+        ret = pread (seg->fd, buf, size, pos);
+        if (ret != size) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not read segment %u at %"PRId64" (%s)",
+                        seg->id, pos,
+                        (ret == -1) ? strerror (errno) : "short read");
+                ret = -EIO;
+        }
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                __lgs_segment_unref (seg);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return ret;
+}
+
+
+/*
+ * write @vector at @offset (or at the end of the file with @append) by
+ * appending the new content of the whole file. returns -EFBIG if the
+ * content would not be small any more, and the file has to move to the
+ * child. on success the file is busy, as when it migrates, until the
+ * caller has resized the placeholder and called lgs_store_resize_end():
+ * resizes sent to the child in parallel can land in any order.
+ */
+int
+lgs_store_write (xlator_t *this, uint64_t ino, uint64_t gen,
+                 struct iovec *vector, int count, off_t offset,
+                 int append, uint64_t *size)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        lgs_segment_t   *seg   = NULL;
+        lgs_migration_t *busy  = NULL;
+        pthread_mutex_t *lock  = NULL;
+        char            *raw   = NULL;
+        char            *data  = NULL;
+        off_t            pos   = 0;
+        uint32_t         len   = 0;
+        uint64_t         new_size = 0;
+        uint64_t         new_len  = 0;
+        size_t           write_len = 0;
+        ssize_t          ret   = 0;
+
+        priv = this->private;
+        lock = lgs_write_lock (priv, ino);
+
+        write_len = iov_length (vector, count);
+
+        busy = GF_CALLOC (1, sizeof (*busy), gf_lgs_mt_lgs_migration_t);
+        if (!busy)
+                return -ENOMEM;
+
+        INIT_LIST_HEAD (&busy->waiting);
+        busy->resize = 1;
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, ino, gen);
+                        if (!entry) {
+                                ret = -ENOENT;
+                        } else if (entry->migration) {
+                                ret = -EBUSY;
+                        } else {
+                                seg = entry->seg;
+                                pos = entry->off + sizeof (lgs_record_t);
+                                len = entry->len;
+                                if (seg)
+                                        seg->refs++;
+                        }
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if (ret < 0)
+                        goto unlock;
+
+                if (append)
+                        offset = entry->size;
+
+                new_len  = max (len, offset + write_len);
+                new_size = max (entry->size, offset + write_len);
+
+                if (new_len > priv->small_file_size) {
+                        ret = -EFBIG;
+                        goto unlock;
+                }
+
+                raw = GF_MALLOC (LGS_RECORD_LEN (new_len), gf_lgs_mt_char);
+                if (!raw) {
+                        ret = -ENOMEM;
+                        goto unlock;
+                }
+                data = raw + sizeof (lgs_record_t);
+
+                if (len) {
+                        ret = pread (seg->fd, data, len, pos);
+                        if (ret != len) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "could not read segment %u at %"
+                                        PRId64" (%s)", seg->id, pos,
+                                        (ret == -1) ? strerror (errno)
+                                        : "short read");
+                                ret = -EIO;
+                                goto unlock;
+                        }
+                }
+
+                if (offset > len)
+                        memset (data + len, 0, offset - len);
+
+                iov_unload (data + offset, vector, count);
+
+                ret = lgs_put (this, entry, raw, new_size, new_len);
+                if (ret < 0)
+                        goto unlock;
+
+                *size = new_size;
+
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry->migration = busy;
+                        busy = NULL;
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
+unlock:
+        pthread_mutex_unlock (lock);
+
+        if (seg) {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        __lgs_segment_unref (seg);
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
+
+        if (raw)
+                GF_FREE (raw);
+
+        if (busy)
+                GF_FREE (busy);
+
+        return ret;
+}
+
+
+/* the placeholder has caught up with a write, the next update can go */
+void
+lgs_store_resize_end (xlator_t *this, uint64_t ino, uint64_t gen)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        lgs_migration_t *busy  = NULL;
+        call_stub_t     *stub  = NULL;
+        call_stub_t     *tmp   = NULL;
+
+        struct list_head waiting;
+
+        priv = this->private;
+
+        INIT_LIST_HEAD (&waiting);
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                entry = __lgs_entry_get (priv, ino, gen);
+                if (entry && entry->migration && entry->migration->resize) {
+                        busy = entry->migration;
+                        entry->migration = NULL;
+                        list_splice_init (&busy->waiting, &waiting);
+                }
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        if (busy)
+                GF_FREE (busy);
+
+        list_for_each_entry_safe (stub, tmp, &waiting, list) {
+                list_del_init (&stub->list);
+                call_resume (stub);
+        }
+}
+
+
+/*
+ * truncate the content in the log to @offset. on success the file is
+ * busy until lgs_store_resize_end(), as with lgs_store_write().
+ */
+int
+lgs_store_truncate (xlator_t *this, uint64_t ino, uint64_t gen,
+                    off_t offset)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        lgs_segment_t   *seg   = NULL;
+        lgs_migration_t *busy  = NULL;
+        pthread_mutex_t *lock  = NULL;
+        char            *raw   = NULL;
+        off_t            pos   = 0;
+        uint32_t         len   = 0;
+        ssize_t          ret   = 0;
+
+        priv = this->private;
+        lock = lgs_write_lock (priv, ino);
+
+        busy = GF_CALLOC (1, sizeof (*busy), gf_lgs_mt_lgs_migration_t);
+        if (!busy)
+                return -ENOMEM;
+
+        INIT_LIST_HEAD (&busy->waiting);
+        busy->resize = 1;
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, ino, gen);
+                        if (!entry) {
+                                ret = -ENOENT;
+                        } else if (entry->migration) {
+                                ret = -EBUSY;
+                        } else if (entry->size != offset) {
+                                seg = entry->seg;
+                                pos = entry->off + sizeof (lgs_record_t);
+                                len = min (entry->len, offset);
+                                if (seg)
+                                        seg->refs++;
+                        } else {
+                                /* the size is right, the placeholder's
+                                   may not be yet */
+                                entry->migration = busy;
+                                busy  = NULL;
+                                entry = NULL;
+                        }
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if ((ret < 0) || !entry)
+                        goto unlock;
+
+                raw = GF_MALLOC (LGS_RECORD_LEN (len), gf_lgs_mt_char);
+                if (!raw) {
+                        ret = -ENOMEM;
+                        goto unlock;
+                }
+
+                if (len) {
+                        ret = pread (seg->fd, raw + sizeof (lgs_record_t),
+                                     len, pos);
+                        if (ret != len) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "could not read segment %u at %"
+                                        PRId64" (%s)", seg->id, pos,
+                                        (ret == -1) ? strerror (errno)
+                                        : "short read");
+                                ret = -EIO;
+                                goto unlock;
+                        }
+                }
+
+                ret = lgs_put (this, entry, raw, offset, len);
+                if (ret < 0)
+                        goto unlock;
+
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry->migration = busy;
+                        busy = NULL;
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
+unlock:
+        pthread_mutex_unlock (lock);
+
+        if (seg) {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        __lgs_segment_unref (seg);
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
+
+        if (raw)
+                GF_FREE (raw);
+
+        if (busy)
+                GF_FREE (busy);
+
+        return ret;
+}
+
+
+/*
+ * the last name of the file is gone, but fds may still be open on it:
+ * its record stays until lgs_store_delete(), while the one written here
+ * makes sure a restart in between does not bring it back.
+ */
+int
+lgs_store_unlink (xlator_t *this, uint64_t ino, uint64_t gen)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        pthread_mutex_t *lock  = NULL;
+        uint64_t         seq   = 0;
+        int              ret   = 0;
+
+        priv = this->private;
+        lock = lgs_write_lock (priv, ino);
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, ino, gen);
+                        if (entry && !entry->unlinked) {
+                                entry->unlinked = 1;
+                                seq = ++priv->seq;
+                        }
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if (seq)
+                        ret = lgs_unlinked (this, ino, gen, seq);
+        }
+        pthread_mutex_unlock (lock);
+
+        return ret;
+}
+
+
+/* the file is gone. a file on its way out of the log is left alone,
+   lgs_migrate_end() drops it. */
+int
+lgs_store_delete (xlator_t *this, uint64_t ino, uint64_t gen)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        pthread_mutex_t *lock  = NULL;
+        uint64_t         seq   = 0;
+        int              ret   = 0;
+
+        priv = this->private;
+        lock = lgs_write_lock (priv, ino);
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, ino, gen);
+                        if (entry && !entry->migration) {
+                                __lgs_entry_unlink (priv, entry);
+                                if (entry->seg)
+                                        seq = ++priv->seq;
+                        } else {
+                                entry = NULL;
+                        }
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if (seq)
+                        ret = lgs_del (this, ino, gen, seq);
+        }
+        pthread_mutex_unlock (lock);
+
+        if (entry)
+                GF_FREE (entry);
+
+        return ret;
+}
+
+
+int
+lgs_store_sync (xlator_t *this, uint64_t ino, uint64_t gen, int datasync)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_entry_t   *entry = NULL;
+        lgs_segment_t *seg   = NULL;
+        int            ret   = 0;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                entry = __lgs_entry_get (priv, ino, gen);
+                if (entry && entry->seg) {
+                        seg = entry->seg;
+                        seg->refs++;
+                }
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        if (!seg)
+                return 0;
+
+        /* the segment only ever grows, so its data is all there is */
+        ret = fdatasync (seg->fd);
+        if (ret == -1)
+                ret = -errno;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                __lgs_segment_unref (seg);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return ret;
+}
+
+
+/* queue @stub until the file is out of the log. -1 if it already is. */
+int
+lgs_store_wait (xlator_t *this, uint64_t ino, uint64_t gen,
+                call_stub_t *stub)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_entry_t   *entry = NULL;
+        int            ret   = -1;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                entry = __lgs_entry_get (priv, ino, gen);
+                if (entry && entry->migration) {
+                        list_add_tail (&stub->list,
+                                       &entry->migration->waiting);
+                        ret = 0;
+                }
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return ret;
+}
+
+
+/*
+ * start moving a file out of the log: its content is returned in
+ * @vector (held by @iobref), to be written to the child, and updates
+ * wait for lgs_migrate_end(). returns the number of vectors.
+ */
+int
+lgs_migrate_begin (xlator_t *this, uint64_t ino, uint64_t gen,
+                   struct iovec *vector, struct iobref *iobref)
+{
+        lgs_private_t   *priv      = NULL;
+        lgs_entry_t     *entry     = NULL;
+        lgs_segment_t   *seg       = NULL;
+        lgs_migration_t *migration = NULL;
+        pthread_mutex_t *lock      = NULL;
+        struct iobuf    *iobuf     = NULL;
+        off_t            pos       = 0;
+        uint32_t         len       = 0;
+        ssize_t          ret       = 0;
+
+        priv = this->private;
+        lock = lgs_write_lock (priv, ino);
+
+        migration = GF_CALLOC (1, sizeof (*migration),
+                               gf_lgs_mt_lgs_migration_t);
+        if (!migration)
+                return -ENOMEM;
+
+        INIT_LIST_HEAD (&migration->waiting);
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, ino, gen);
+                        if (!entry) {
+                                ret = -ENOENT;
+                        } else if (entry->migration) {
+                                ret = -EBUSY;
+                        } else {
+                                entry->migration = migration;
+                                migration = NULL;
+
+                                seg = entry->seg;
+                                pos = entry->off + sizeof (lgs_record_t);
+                                len = entry->len;
+                                if (seg)
+                                        seg->refs++;
+                        }
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if ((ret < 0) || !len)
+                        goto unlock;
+
+                if (len > this->ctx->page_size) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "%u bytes of content do not fit in an "
+                                "iobuf", len);
+                        ret = -EFBIG;
+                        goto unlock;
+                }
+
+                iobuf = iobuf_get (this->ctx->iobuf_pool);
+                if (!iobuf) {
+                        ret = -ENOMEM;
+                        goto unlock;
+                }
+
+                ret = pread (seg->fd, iobuf->ptr, len, pos);
+                if (ret != len) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not read segment %u at %"PRId64
+                                " (%s)", seg->id, pos,
+                                (ret == -1) ? strerror (errno)
+                                : "short read");
+                        ret = -EIO;
+                        goto unlock;
+                }
+
+                iobref_add (iobref, iobuf);
+                vector->iov_base = iobuf->ptr;
+                vector->iov_len  = len;
+
+                ret = 1;
+        }
+unlock:
+        pthread_mutex_unlock (lock);
+
+        if (iobuf)
+                iobuf_unref (iobuf);
+
+        if (seg) {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        __lgs_segment_unref (seg);
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
+
+        if (migration) {
+                GF_FREE (migration);
+        } else if (ret < 0) {
+                /* we started it, undo it */
+                lgs_migrate_end (this, ino, gen, -1);
+        }
+
+        return ret;
+}
+
+
+/*
+ * the migration is over: on success the file leaves the log for good.
+ * either way the updates that waited for it go on.
+ */
+void
+lgs_migrate_end (xlator_t *this, uint64_t ino, uint64_t gen, int op_ret)
+{
+        lgs_private_t   *priv  = NULL;
+        lgs_entry_t     *entry = NULL;
+        pthread_mutex_t *lock  = NULL;
+        call_stub_t     *stub  = NULL;
+        call_stub_t     *tmp   = NULL;
+        uint64_t         seq   = 0;
+
+        struct list_head waiting;
+
+        priv = this->private;
+        lock = lgs_write_lock (priv, ino);
+
+        INIT_LIST_HEAD (&waiting);
+
+        pthread_mutex_lock (lock);
+        {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        entry = __lgs_entry_get (priv, ino, gen);
+                        if (entry && entry->migration) {
+                                list_splice_init (&entry->migration->waiting,
+                                                  &waiting);
+                                GF_FREE (entry->migration);
+                                entry->migration = NULL;
+                        } else {
+                                entry = NULL;
+                        }
+
+                        if (entry && (op_ret >= 0)) {
+                                __lgs_entry_unlink (priv, entry);
+                                if (entry->seg)
+                                        seq = ++priv->seq;
+
+                                priv->migrations++;
+                        } else {
+                                entry = NULL;
+                        }
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if (seq)
+                        lgs_del (this, ino, gen, seq);
+        }
+        pthread_mutex_unlock (lock);
+
+        if (entry)
+                GF_FREE (entry);
+
+        list_for_each_entry_safe (stub, tmp, &waiting, list) {
+                list_del_init (&stub->list);
+                call_resume (stub);
+        }
+}
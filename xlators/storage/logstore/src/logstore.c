@@ -0,0 +1,1817 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * storage/logstore - keep the content of small files in a log instead
+ * of one file each, in place of storage/bdb.
+ *
+ * It sits on the brick, directly above storage/posix, which still owns
+ * the namespace: every file has its inode, attributes and xattrs there
+ * as usual. The content of a regular file created through logstore goes
+ * to append-only segment files (option segment-directory) for as long
+ * as it fits in small-file-size, and the posix file is only a sparse
+ * placeholder of the right size, so stat and readdirp go straight
+ * through and lookup only swaps in the content quick-read asks for. A
+ * write that grows the content past small-file-size moves the file out
+ * of the log to the posix file, and from then on everything on it goes
+ * straight through too.
+ *
+ * Files are known by inode number and generation, which are never
+ * reused together on a brick. See logstore-ll.c for the log itself.
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "logstore.h"
+#include "logstore-mem-types.h"
+#include "checksum.h"
+#include "common-utils.h"
+#include "statedump.h"
+#include "md5.h"
+
+
+void
+lgs_local_wipe (lgs_local_t *local)
+{
+        if (!local)
+                return;
+
+        loc_wipe (&local->loc);
+        loc_wipe (&local->newloc);
+
+        if (local->fd)
+                fd_unref (local->fd);
+
+        if (local->migrate_fd)
+                fd_unref (local->migrate_fd);
+
+        if (local->stub)
+                call_stub_destroy (local->stub);
+
+        if (local->iobref)
+                iobref_unref (local->iobref);
+
+        GF_FREE (local);
+}
+
+
+static lgs_local_t *
+lgs_local_new (xlator_t *this)
+{
+        lgs_local_t *local = NULL;
+
+        local = GF_CALLOC (1, sizeof (*local), gf_lgs_mt_lgs_local_t);
+        if (!local)
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+
+        return local;
+}
+
+
+/* the key of a regular file, -1 for anything that can't be in the log */
+static int
+lgs_inode_key (inode_t *inode, uint64_t *ino, uint64_t *gen)
+{
+        if (!inode || !inode->ino || !IA_ISREG (inode->ia_type))
+                return -1;
+
+        *ino = inode->ino;
+        *gen = inode->generation;
+
+        return 0;
+}
+
+
+/*
+ * park @stub until the file is out of the log. returns 1 if it is
+ * parked, 0 if the migration is already over (and @stub is gone), -1 if
+ * there is no stub.
+ */
+static int
+lgs_defer (xlator_t *this, uint64_t ino, uint64_t gen, call_stub_t *stub)
+{
+        if (!stub) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                return -1;
+        }
+
+        if (lgs_store_wait (this, ino, gen, stub) == 0)
+                return 1;
+
+        call_stub_destroy (stub);
+
+        return 0;
+}
+
+
+/* {{{ lookup */
+
+/*
+ * posix fills LGS_CONTENT_KEY from the placeholder, which is all zeros
+ * for a file in the log. put the content from the log in its place, or
+ * take the key out if that can't be done, so quick-read never caches
+ * the placeholder.
+ */
+int32_t
+lgs_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                int32_t op_ret, int32_t op_errno, inode_t *inode,
+                struct iatt *buf, dict_t *dict, struct iatt *postparent)
+{
+        lgs_private_t *priv       = NULL;
+        lgs_local_t   *local      = NULL;
+        lgs_state_t    state      = LGS_ABSENT;
+        uint64_t       migrations = 0;
+        char          *content    = NULL;
+        int            ret        = 0;
+
+        priv  = this->private;
+        local = frame->local;
+
+        if (!local || (op_ret == -1) || !IA_ISREG (buf->ia_type) || !dict
+            || !dict_get (dict, LGS_CONTENT_KEY) || (buf->ia_size == 0))
+                goto out;
+
+        state = lgs_store_state (this, buf->ia_ino, buf->ia_gen);
+        if (state == LGS_ABSENT) {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        migrations = priv->migrations;
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                /* it may have left the log after posix read it */
+                if (migrations != local->migrations)
+                        dict_del (dict, LGS_CONTENT_KEY);
+                goto out;
+        }
+
+        content = GF_CALLOC (1, buf->ia_size, gf_lgs_mt_char);
+        if (!content) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                dict_del (dict, LGS_CONTENT_KEY);
+                goto out;
+        }
+
+        /* a short read is a hole up to the file size, already zeroed */
+        ret = lgs_store_read (this, buf->ia_ino, buf->ia_gen, content, 0,
+                              buf->ia_size);
+        if ((ret < 0)
+            || (dict_set_bin (dict, LGS_CONTENT_KEY, content,
+                              buf->ia_size) < 0)) {
+                GF_FREE (content);
+                dict_del (dict, LGS_CONTENT_KEY);
+        }
+
+out:
+        LGS_STACK_UNWIND (lookup, frame, op_ret, op_errno, inode, buf, dict,
+                          postparent);
+        return 0;
+}
+
+
+int32_t
+lgs_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
+            dict_t *xattr_req)
+{
+        lgs_private_t *priv  = NULL;
+        lgs_local_t   *local = NULL;
+
+        priv = this->private;
+
+        if (!xattr_req || !dict_get (xattr_req, LGS_CONTENT_KEY))
+                goto wind;
+
+        local = lgs_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (lookup, frame, -1, ENOMEM, NULL, NULL,
+                                     NULL, NULL);
+                return 0;
+        }
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                local->migrations = priv->migrations;
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        frame->local = local;
+
+wind:
+        STACK_WIND (frame, lgs_lookup_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->lookup,
+                    loc, xattr_req);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ create, mknod */
+
+int32_t
+lgs_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                int32_t op_ret, int32_t op_errno, fd_t *fd, inode_t *inode,
+                struct iatt *buf, struct iatt *preparent,
+                struct iatt *postparent)
+{
+        int ret = 0;
+
+        /* an existing file opened without O_EXCL stays where it is */
+        if ((op_ret == 0) && (buf->ia_size == 0)) {
+                ret = lgs_store_add (this, buf->ia_ino, buf->ia_gen);
+                if (ret < 0)
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "could not add %"PRIu64" to the log (%s), "
+                                "it stays with %s", buf->ia_ino,
+                                strerror (-ret), FIRST_CHILD (this)->name);
+        }
+
+        STACK_UNWIND_STRICT (create, frame, op_ret, op_errno, fd, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+lgs_create (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
+            mode_t mode, fd_t *fd)
+{
+        STACK_WIND (frame, lgs_create_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->create,
+                    loc, flags, mode, fd);
+        return 0;
+}
+
+
+int32_t
+lgs_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+               int32_t op_ret, int32_t op_errno, inode_t *inode,
+               struct iatt *buf, struct iatt *preparent,
+               struct iatt *postparent)
+{
+        int ret = 0;
+
+        if ((op_ret == 0) && IA_ISREG (buf->ia_type)) {
+                ret = lgs_store_add (this, buf->ia_ino, buf->ia_gen);
+                if (ret < 0)
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "could not add %"PRIu64" to the log (%s), "
+                                "it stays with %s", buf->ia_ino,
+                                strerror (-ret), FIRST_CHILD (this)->name);
+        }
+
+        STACK_UNWIND_STRICT (mknod, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int32_t
+lgs_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+           dev_t rdev)
+{
+        STACK_WIND (frame, lgs_mknod_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->mknod,
+                    loc, mode, rdev);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ open */
+
+int32_t
+lgs_truncate_log (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  off_t offset);
+
+
+int32_t
+lgs_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+              int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (local && (op_ret == 0)) {
+                local->fd = fd_ref (fd);
+                lgs_truncate_log (frame, this, fd, 0);
+                return 0;
+        }
+
+        LGS_STACK_UNWIND (open, frame, op_ret, op_errno, fd);
+        return 0;
+}
+
+
+int32_t
+lgs_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
+          fd_t *fd, int32_t wbflags)
+{
+        lgs_local_t *local = NULL;
+        lgs_state_t  state = LGS_ABSENT;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+        int          ret   = 0;
+
+        if (!(flags & O_TRUNC) || (lgs_inode_key (loc->inode, &ino, &gen) < 0))
+                goto wind;
+
+again:
+        state = lgs_store_state (this, ino, gen);
+        if (state == LGS_ABSENT)
+                goto wind;
+
+        if (state == LGS_MIGRATING) {
+                ret = lgs_defer (this, ino, gen,
+                                 fop_open_stub (frame, lgs_open, loc, flags,
+                                                fd, wbflags));
+                if (ret == 0)
+                        goto again;
+                if (ret < 0)
+                        STACK_UNWIND_STRICT (open, frame, -1, ENOMEM, fd);
+                return 0;
+        }
+
+        local = lgs_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (open, frame, -1, ENOMEM, fd);
+                return 0;
+        }
+
+        local->fop = GF_FOP_OPEN;
+        local->ino = ino;
+        local->gen = gen;
+        loc_copy (&local->loc, loc);
+        frame->local = local;
+
+wind:
+        STACK_WIND (frame, lgs_open_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->open,
+                    loc, flags, fd, wbflags);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ readv */
+
+int32_t
+lgs_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+               int32_t op_ret, int32_t op_errno, struct iovec *vector,
+               int32_t count, struct iatt *stbuf, struct iobref *iobref)
+{
+        LGS_STACK_UNWIND (readv, frame, op_ret, op_errno, vector, count,
+                          stbuf, iobref);
+        return 0;
+}
+
+
+int32_t
+lgs_readv_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *buf)
+{
+        lgs_local_t   *local    = NULL;
+        struct iovec  *vector   = NULL;
+        struct iobref *iobref   = NULL;
+        struct iobuf  *iobuf    = NULL;
+        size_t         pagesize = 0;
+        size_t         size     = 0;
+        size_t         done     = 0;
+        size_t         len      = 0;
+        int32_t        count    = 0;
+        int            ret      = 0;
+        int            i        = 0;
+
+        local = frame->local;
+
+        if (op_ret == -1)
+                goto out;
+
+        if (local->offset >= buf->ia_size) {
+                op_ret = 0;
+                goto out;
+        }
+
+        size = min (local->size, buf->ia_size - local->offset);
+
+        pagesize = this->ctx->page_size;
+        count    = (size + pagesize - 1) / pagesize;
+
+        vector = GF_CALLOC (count, sizeof (*vector), gf_lgs_mt_iovec);
+        iobref = iobref_new ();
+        if (!vector || !iobref) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                op_ret   = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
+
+        for (i = 0; i < count; i++, done += len) {
+                len = min (pagesize, size - done);
+
+                iobuf = iobuf_get (this->ctx->iobuf_pool);
+                if (!iobuf) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "out of memory :(");
+                        op_ret   = -1;
+                        op_errno = ENOMEM;
+                        goto out;
+                }
+
+                iobref_add (iobref, iobuf);
+                iobuf_unref (iobuf);
+
+                ret = lgs_store_read (this, local->ino, local->gen,
+                                      iobuf->ptr, local->offset + done, len);
+                if (ret == -ENOENT) {
+                        /* moved out of the log since we looked */
+                        GF_FREE (vector);
+                        iobref_unref (iobref);
+
+                        STACK_WIND (frame, lgs_readv_cbk,
+                                    FIRST_CHILD (this),
+                                    FIRST_CHILD (this)->fops->readv,
+                                    local->fd, local->size, local->offset);
+                        return 0;
+                }
+
+                if (ret < 0) {
+                        op_ret   = -1;
+                        op_errno = -ret;
+                        goto out;
+                }
+
+                /* a hole up to the file size */
+                if (ret < len)
+                        memset (iobuf->ptr + ret, 0, len - ret);
+
+                vector[i].iov_base = iobuf->ptr;
+                vector[i].iov_len  = len;
+        }
+
+        op_ret = size;
+out:
+        if (op_ret < 0)
+                count = 0;
+
+        LGS_STACK_UNWIND (readv, frame, op_ret, op_errno, vector, count, buf,
+                          iobref);
+
+        if (vector)
+                GF_FREE (vector);
+
+        if (iobref)
+                iobref_unref (iobref);
+
+        return 0;
+}
+
+
+int32_t
+lgs_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
+           off_t offset)
+{
+        lgs_local_t *local = NULL;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+
+        if ((lgs_inode_key (fd->inode, &ino, &gen) < 0)
+            || (lgs_store_state (this, ino, gen) == LGS_ABSENT))
+                goto wind;
+
+        local = lgs_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (readv, frame, -1, ENOMEM, NULL, 0, NULL,
+                                     NULL);
+                return 0;
+        }
+
+        local->fd     = fd_ref (fd);
+        local->ino    = ino;
+        local->gen    = gen;
+        local->size   = size;
+        local->offset = offset;
+        frame->local  = local;
+
+        /* the size of the file is the placeholder's */
+        STACK_WIND (frame, lgs_readv_fstat_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->fstat,
+                    fd);
+        return 0;
+
+wind:
+        STACK_WIND (frame, lgs_readv_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->readv,
+                    fd, size, offset);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ writev */
+
+int32_t
+lgs_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                struct iatt *postbuf)
+{
+        LGS_STACK_UNWIND (writev, frame, op_ret, op_errno, prebuf, postbuf);
+        return 0;
+}
+
+
+/*
+ * the content is in the log, the placeholder has the new size. the next
+ * update of the file can go, its resize lands after this one.
+ */
+int32_t
+lgs_writev_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno,
+                         struct iatt *prebuf, struct iatt *postbuf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        lgs_store_resize_end (this, local->ino, local->gen);
+
+        if (op_ret == 0)
+                op_ret = local->op_ret;
+
+        LGS_STACK_UNWIND (writev, frame, op_ret, op_errno, prebuf, postbuf);
+        return 0;
+}
+
+
+/*
+ * the content is safe with the child, the log can forget it. the delete
+ * record must not be on disk before the content is, or a crash loses
+ * what the client had synced.
+ */
+int32_t
+lgs_migrate_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                       struct iatt *postbuf)
+{
+        lgs_local_t *local = NULL;
+        call_stub_t *stub  = NULL;
+
+        local = frame->local;
+
+        if (op_ret == -1)
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not move %"PRIu64" out of the log (%s)",
+                        local->ino, strerror (op_errno));
+
+        lgs_migrate_end (this, local->ino, local->gen, op_ret);
+
+        if (op_ret == -1) {
+                LGS_STACK_UNWIND (writev, frame, -1, op_errno, NULL, NULL);
+                return 0;
+        }
+
+        /* the file is with the child now, and so is the write */
+        stub = local->stub;
+        local->stub = NULL;
+
+        frame->local = NULL;
+        lgs_local_wipe (local);
+
+        call_resume (stub);
+        return 0;
+}
+
+
+int32_t
+lgs_migrate_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                        struct iatt *postbuf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (op_ret == -1) {
+                lgs_migrate_fsync_cbk (frame, NULL, this, op_ret, op_errno,
+                                       NULL, NULL);
+                return 0;
+        }
+
+        STACK_WIND (frame, lgs_migrate_fsync_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->fsync,
+                    local->migrate_fd, 1);
+        return 0;
+}
+
+
+int32_t
+lgs_migrate_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (op_ret == -1) {
+                lgs_migrate_writev_cbk (frame, NULL, this, op_ret, op_errno,
+                                        NULL, NULL);
+                return 0;
+        }
+
+        STACK_WIND (frame, lgs_migrate_writev_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->writev,
+                    local->migrate_fd, &local->vector, 1, 0, local->iobref);
+        return 0;
+}
+
+
+int32_t
+lgs_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+            struct iovec *vector, int32_t count, off_t offset,
+            struct iobref *iobref);
+
+
+/*
+ * the write does not fit in the log any more: write the content of the
+ * file to the child, then let the write through.
+ */
+static int
+lgs_migrate (call_frame_t *frame, xlator_t *this, fd_t *fd,
+             struct iovec *vector, int32_t count, off_t offset,
+             struct iobref *iobref, uint64_t ino, uint64_t gen)
+{
+        lgs_local_t *local    = NULL;
+        call_stub_t *stub     = NULL;
+        char        *path     = NULL;
+        int32_t      op_errno = ENOMEM;
+        int          ret      = 0;
+
+        local = lgs_local_new (this);
+        if (!local)
+                goto err;
+
+        local->ino = ino;
+        local->gen = gen;
+
+        local->stub = fop_writev_stub (frame, lgs_writev, fd, vector, count,
+                                       offset, iobref);
+        local->iobref = iobref_new ();
+        if (!local->stub || !local->iobref) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                goto err;
+        }
+
+        ret = lgs_migrate_begin (this, ino, gen, &local->vector,
+                                 local->iobref);
+        if ((ret == -ENOENT) || (ret == -EBUSY) || (ret == 0)) {
+                if (ret == 0)
+                        lgs_migrate_end (this, ino, gen, 0);
+
+                /* nothing to move, or somebody else moved it */
+                stub = local->stub;
+                local->stub = NULL;
+                lgs_local_wipe (local);
+
+                call_resume (stub);
+                return 0;
+        }
+
+        if (ret < 0) {
+                op_errno = -ret;
+                goto err;
+        }
+
+        frame->local = local;
+
+        if (!(fd->flags & O_APPEND)) {
+                local->migrate_fd = fd_ref (fd);
+
+                STACK_WIND (frame, lgs_migrate_writev_cbk,
+                            FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->writev,
+                            local->migrate_fd, &local->vector, 1, 0,
+                            local->iobref);
+                return 0;
+        }
+
+        /* the content goes at offset 0, which an O_APPEND fd won't do */
+        ret = inode_path (fd->inode, NULL, &path);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "no path for %"PRIu64", can't move it out of the log",
+                        ino);
+                lgs_migrate_writev_cbk (frame, NULL, this, -1, EIO, NULL,
+                                        NULL);
+                return 0;
+        }
+
+        local->loc.path  = path;
+        local->loc.name  = strrchr (path, '/');
+        if (local->loc.name)
+                local->loc.name++;
+        local->loc.inode = inode_ref (fd->inode);
+        local->loc.ino   = fd->inode->ino;
+
+        local->migrate_fd = fd_create (fd->inode, frame->root->pid);
+        if (!local->migrate_fd) {
+                lgs_migrate_writev_cbk (frame, NULL, this, -1, ENOMEM, NULL,
+                                        NULL);
+                return 0;
+        }
+
+        STACK_WIND (frame, lgs_migrate_open_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->open,
+                    &local->loc, O_WRONLY, local->migrate_fd, 0);
+        return 0;
+
+err:
+        lgs_local_wipe (local);
+
+        STACK_UNWIND_STRICT (writev, frame, -1, op_errno, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+lgs_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+            struct iovec *vector, int32_t count, off_t offset,
+            struct iobref *iobref)
+{
+        lgs_local_t *local = NULL;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+        uint64_t     size  = 0;
+        int          ret   = 0;
+
+        if (lgs_inode_key (fd->inode, &ino, &gen) < 0)
+                goto wind;
+
+again:
+        ret = lgs_store_write (this, ino, gen, vector, count, offset,
+                               (fd->flags & O_APPEND), &size);
+        switch (ret) {
+        case 0:
+                break;
+        case -ENOENT:
+                goto wind;
+        case -EFBIG:
+                return lgs_migrate (frame, this, fd, vector, count, offset,
+                                    iobref, ino, gen);
+        case -EBUSY:
+                ret = lgs_defer (this, ino, gen,
+                                 fop_writev_stub (frame, lgs_writev, fd,
+                                                  vector, count, offset,
+                                                  iobref));
+                if (ret == 0)
+                        goto again;
+                if (ret < 0)
+                        STACK_UNWIND_STRICT (writev, frame, -1, ENOMEM,
+                                             NULL, NULL);
+                return 0;
+        default:
+                STACK_UNWIND_STRICT (writev, frame, -1, -ret, NULL, NULL);
+                return 0;
+        }
+
+        local = lgs_local_new (this);
+        if (!local) {
+                lgs_store_resize_end (this, ino, gen);
+                STACK_UNWIND_STRICT (writev, frame, -1, ENOMEM, NULL, NULL);
+                return 0;
+        }
+
+        local->ino    = ino;
+        local->gen    = gen;
+        local->op_ret = iov_length (vector, count);
+        frame->local  = local;
+
+        /* bring the placeholder to the new size, and its times along */
+        STACK_WIND (frame, lgs_writev_truncate_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->ftruncate,
+                    fd, size);
+        return 0;
+
+wind:
+        STACK_WIND (frame, lgs_writev_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->writev,
+                    fd, vector, count, offset, iobref);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ truncate, ftruncate */
+
+/*
+ * open with O_TRUNC, truncate and ftruncate go to the child first, which
+ * checks the permissions, then to the log. a write resizing the
+ * placeholder in the meantime can land after the child's truncate, so
+ * the placeholder is truncated once more while the file is busy.
+ */
+static int32_t
+lgs_truncate_unwind (call_frame_t *frame, int32_t op_ret, int32_t op_errno,
+                     struct iatt *prebuf, struct iatt *postbuf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        switch (local->fop) {
+        case GF_FOP_OPEN:
+                LGS_STACK_UNWIND (open, frame, op_ret, op_errno, local->fd);
+                break;
+        case GF_FOP_FTRUNCATE:
+                LGS_STACK_UNWIND (ftruncate, frame, op_ret, op_errno, prebuf,
+                                  postbuf);
+                break;
+        default:
+                LGS_STACK_UNWIND (truncate, frame, op_ret, op_errno, prebuf,
+                                  postbuf);
+                break;
+        }
+
+        return 0;
+}
+
+
+int32_t
+lgs_truncate_resize_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno,
+                         struct iatt *prebuf, struct iatt *postbuf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        lgs_store_resize_end (this, local->ino, local->gen);
+
+        if (op_ret == -1)
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not truncate the placeholder of %"PRIu64
+                        " (%s)", local->ino, strerror (op_errno));
+
+        lgs_truncate_unwind (frame, op_ret, op_errno, &local->prebuf,
+                             postbuf);
+        return 0;
+}
+
+
+/* @fd is @local->fd, it is there for the stub */
+int32_t
+lgs_truncate_log (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  off_t offset)
+{
+        lgs_local_t *local = NULL;
+        int          ret   = 0;
+
+        local = frame->local;
+
+again:
+        ret = lgs_store_truncate (this, local->ino, local->gen,
+                                  local->offset);
+        if (ret == -EBUSY) {
+                ret = lgs_defer (this, local->ino, local->gen,
+                                 fop_ftruncate_stub (frame, lgs_truncate_log,
+                                                     fd, offset));
+                if (ret == 0)
+                        goto again;
+                if (ret < 0)
+                        lgs_truncate_unwind (frame, -1, ENOMEM,
+                                             &local->prebuf, &local->postbuf);
+                return 0;
+        }
+
+        if (ret == -ENOENT) {
+                /* moved out of the log, the child's truncate was all */
+                lgs_truncate_unwind (frame, 0, 0, &local->prebuf,
+                                     &local->postbuf);
+                return 0;
+        }
+
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not truncate %"PRIu64" in the log (%s)",
+                        local->ino, strerror (-ret));
+                lgs_truncate_unwind (frame, -1, -ret, &local->prebuf,
+                                     &local->postbuf);
+                return 0;
+        }
+
+        if (local->fop == GF_FOP_FTRUNCATE) {
+                STACK_WIND (frame, lgs_truncate_resize_cbk,
+                            FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->ftruncate,
+                            local->fd, local->offset);
+        } else {
+                STACK_WIND (frame, lgs_truncate_resize_cbk,
+                            FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->truncate,
+                            &local->loc, local->offset);
+        }
+        return 0;
+}
+
+
+int32_t
+lgs_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                  struct iatt *postbuf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (local && (op_ret == 0)) {
+                local->prebuf  = *prebuf;
+                local->postbuf = *postbuf;
+
+                lgs_truncate_log (frame, this, local->fd, local->offset);
+                return 0;
+        }
+
+        LGS_STACK_UNWIND (truncate, frame, op_ret, op_errno, prebuf, postbuf);
+        return 0;
+}
+
+
+int32_t
+lgs_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
+{
+        lgs_local_t *local = NULL;
+        lgs_state_t  state = LGS_ABSENT;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+        int          ret   = 0;
+
+        if (lgs_inode_key (loc->inode, &ino, &gen) < 0)
+                goto wind;
+
+again:
+        state = lgs_store_state (this, ino, gen);
+        if (state == LGS_ABSENT)
+                goto wind;
+
+        if (state == LGS_MIGRATING) {
+                ret = lgs_defer (this, ino, gen,
+                                 fop_truncate_stub (frame, lgs_truncate, loc,
+                                                    offset));
+                if (ret == 0)
+                        goto again;
+                if (ret < 0)
+                        STACK_UNWIND_STRICT (truncate, frame, -1, ENOMEM,
+                                             NULL, NULL);
+                return 0;
+        }
+
+        local = lgs_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (truncate, frame, -1, ENOMEM, NULL, NULL);
+                return 0;
+        }
+
+        local->fop    = GF_FOP_TRUNCATE;
+        local->ino    = ino;
+        local->gen    = gen;
+        local->offset = offset;
+        loc_copy (&local->loc, loc);
+        frame->local  = local;
+
+wind:
+        STACK_WIND (frame, lgs_truncate_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->truncate,
+                    loc, offset);
+        return 0;
+}
+
+
+int32_t
+lgs_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                   struct iatt *postbuf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (local && (op_ret == 0)) {
+                local->prebuf  = *prebuf;
+                local->postbuf = *postbuf;
+
+                lgs_truncate_log (frame, this, local->fd, local->offset);
+                return 0;
+        }
+
+        LGS_STACK_UNWIND (ftruncate, frame, op_ret, op_errno, prebuf,
+                          postbuf);
+        return 0;
+}
+
+
+int32_t
+lgs_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
+{
+        lgs_local_t *local = NULL;
+        lgs_state_t  state = LGS_ABSENT;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+        int          ret   = 0;
+
+        if (lgs_inode_key (fd->inode, &ino, &gen) < 0)
+                goto wind;
+
+again:
+        state = lgs_store_state (this, ino, gen);
+        if (state == LGS_ABSENT)
+                goto wind;
+
+        if (state == LGS_MIGRATING) {
+                ret = lgs_defer (this, ino, gen,
+                                 fop_ftruncate_stub (frame, lgs_ftruncate,
+                                                     fd, offset));
+                if (ret == 0)
+                        goto again;
+                if (ret < 0)
+                        STACK_UNWIND_STRICT (ftruncate, frame, -1, ENOMEM,
+                                             NULL, NULL);
+                return 0;
+        }
+
+        local = lgs_local_new (this);
+        if (!local) {
+                STACK_UNWIND_STRICT (ftruncate, frame, -1, ENOMEM, NULL,
+                                     NULL);
+                return 0;
+        }
+
+        local->fop    = GF_FOP_FTRUNCATE;
+        local->ino    = ino;
+        local->gen    = gen;
+        local->offset = offset;
+        local->fd     = fd_ref (fd);
+        frame->local  = local;
+
+wind:
+        STACK_WIND (frame, lgs_ftruncate_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->ftruncate,
+                    fd, offset);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ unlink, rename */
+
+/*
+ * the record of a file goes when its inode is forgotten with no name
+ * left, which is after the last fd on it is released. unlink and rename
+ * keep an fd of their own on the file they remove a name of, opened as
+ * root like dht does, to fstat it after the name is gone: no other name
+ * can appear once its link count is 0. the log is told right then, so
+ * that a restart before the forget drops the record too.
+ */
+static void
+lgs_frame_su_do (call_frame_t *frame)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        local->uid = frame->root->uid;
+        local->gid = frame->root->gid;
+
+        frame->root->uid = 0;
+        frame->root->gid = 0;
+}
+
+
+static void
+lgs_frame_su_undo (call_frame_t *frame)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        frame->root->uid = local->uid;
+        frame->root->gid = local->gid;
+}
+
+
+/* @local->fd to look at the file after its name is gone, if it opens */
+static int
+lgs_unlink_prepare (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        lgs_local_t *local = NULL;
+
+        local = lgs_local_new (this);
+        if (!local)
+                return -1;
+
+        local->fd = fd_create (loc->inode, frame->root->pid);
+        if (!local->fd) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                GF_FREE (local);
+                return -1;
+        }
+
+        frame->local = local;
+
+        return 0;
+}
+
+
+static void
+lgs_unlink_opened (call_frame_t *frame, xlator_t *this, int32_t op_ret,
+                   int32_t op_errno)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        lgs_frame_su_undo (frame);
+
+        if (op_ret == -1) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "could not open %"PRIu64" (%s), its record stays "
+                        "in the log", local->fd->inode->ino,
+                        strerror (op_errno));
+                fd_unref (local->fd);
+                local->fd = NULL;
+        }
+}
+
+
+static void
+lgs_unlink_done (call_frame_t *frame, xlator_t *this, int32_t op_ret,
+                 struct iatt *buf)
+{
+        lgs_local_t *local = NULL;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+        int          ret   = 0;
+
+        local = frame->local;
+
+        lgs_frame_su_undo (frame);
+
+        if ((op_ret == -1) || (buf->ia_nlink != 0)
+            || (lgs_inode_key (local->fd->inode, &ino, &gen) < 0))
+                return;
+
+        /* no name left: gone after a restart, and for lgs_forget */
+        ret = lgs_store_unlink (this, ino, gen);
+        if (ret < 0)
+                gf_log (this->name, GF_LOG_WARNING,
+                        "could not mark %"PRIu64" unlinked in the log (%s)",
+                        ino, strerror (-ret));
+
+        inode_ctx_put (local->fd->inode, this, 1);
+}
+
+
+int32_t
+lgs_unlink_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, struct iatt *buf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        lgs_unlink_done (frame, this, op_ret, buf);
+
+        LGS_STACK_UNWIND (unlink, frame, 0, 0, &local->preparent,
+                          &local->postparent);
+        return 0;
+}
+
+
+int32_t
+lgs_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+                struct iatt *postparent)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (!local || !local->fd || (op_ret == -1))
+                goto out;
+
+        local->preparent  = *preparent;
+        local->postparent = *postparent;
+
+        lgs_frame_su_do (frame);
+
+        STACK_WIND (frame, lgs_unlink_fstat_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->fstat,
+                    local->fd);
+        return 0;
+
+out:
+        LGS_STACK_UNWIND (unlink, frame, op_ret, op_errno, preparent,
+                          postparent);
+        return 0;
+}
+
+
+int32_t
+lgs_unlink_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        lgs_unlink_opened (frame, this, op_ret, op_errno);
+
+        STACK_WIND (frame, lgs_unlink_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->unlink,
+                    &local->loc);
+        return 0;
+}
+
+
+int32_t
+lgs_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        lgs_local_t *local = NULL;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+
+        if ((lgs_inode_key (loc->inode, &ino, &gen) < 0)
+            || (lgs_store_state (this, ino, gen) == LGS_ABSENT))
+                goto wind;
+
+        if (lgs_unlink_prepare (frame, this, loc) < 0) {
+                STACK_UNWIND_STRICT (unlink, frame, -1, ENOMEM, NULL, NULL);
+                return 0;
+        }
+
+        local = frame->local;
+        loc_copy (&local->loc, loc);
+
+        lgs_frame_su_do (frame);
+
+        STACK_WIND (frame, lgs_unlink_open_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->open,
+                    loc, O_RDONLY, local->fd, 0);
+        return 0;
+
+wind:
+        STACK_WIND (frame, lgs_unlink_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->unlink,
+                    loc);
+        return 0;
+}
+
+
+int32_t
+lgs_rename_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, struct iatt *buf)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        lgs_unlink_done (frame, this, op_ret, buf);
+
+        LGS_STACK_UNWIND (rename, frame, 0, 0, &local->stbuf,
+                          &local->preparent, &local->postparent,
+                          &local->prenewparent, &local->postnewparent);
+        return 0;
+}
+
+
+int32_t
+lgs_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                struct iatt *preoldparent, struct iatt *postoldparent,
+                struct iatt *prenewparent, struct iatt *postnewparent)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        if (!local || !local->fd || (op_ret == -1))
+                goto out;
+
+        local->stbuf         = *buf;
+        local->preparent     = *preoldparent;
+        local->postparent    = *postoldparent;
+        local->prenewparent  = *prenewparent;
+        local->postnewparent = *postnewparent;
+
+        lgs_frame_su_do (frame);
+
+        /* the replaced target, not the file renamed over it */
+        STACK_WIND (frame, lgs_rename_fstat_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->fstat,
+                    local->fd);
+        return 0;
+
+out:
+        LGS_STACK_UNWIND (rename, frame, op_ret, op_errno, buf, preoldparent,
+                          postoldparent, prenewparent, postnewparent);
+        return 0;
+}
+
+
+int32_t
+lgs_rename_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        lgs_local_t *local = NULL;
+
+        local = frame->local;
+
+        lgs_unlink_opened (frame, this, op_ret, op_errno);
+
+        STACK_WIND (frame, lgs_rename_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->rename,
+                    &local->loc, &local->newloc);
+        return 0;
+}
+
+
+int32_t
+lgs_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+            loc_t *newloc)
+{
+        lgs_local_t *local = NULL;
+        uint64_t     ino   = 0;
+        uint64_t     gen   = 0;
+
+        if ((lgs_inode_key (newloc->inode, &ino, &gen) < 0)
+            || (lgs_store_state (this, ino, gen) == LGS_ABSENT))
+                goto wind;
+
+        if (lgs_unlink_prepare (frame, this, newloc) < 0) {
+                STACK_UNWIND_STRICT (rename, frame, -1, ENOMEM, NULL, NULL,
+                                     NULL, NULL, NULL);
+                return 0;
+        }
+
+        local = frame->local;
+        loc_copy (&local->loc, oldloc);
+        loc_copy (&local->newloc, newloc);
+
+        lgs_frame_su_do (frame);
+
+        STACK_WIND (frame, lgs_rename_open_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->open,
+                    newloc, O_RDONLY, local->fd, 0);
+        return 0;
+
+wind:
+        STACK_WIND (frame, lgs_rename_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->rename,
+                    oldloc, newloc);
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ forget */
+
+/* a file marked by lgs_unlink_done() has no name and no fd left */
+int32_t
+lgs_forget (xlator_t *this, inode_t *inode)
+{
+        uint64_t doomed = 0;
+        uint64_t ino    = 0;
+        uint64_t gen    = 0;
+        int      ret    = 0;
+
+        inode_ctx_del (inode, this, &doomed);
+
+        if (!doomed || (lgs_inode_key (inode, &ino, &gen) < 0))
+                return 0;
+
+        ret = lgs_store_delete (this, ino, gen);
+        if (ret < 0)
+                gf_log (this->name, GF_LOG_WARNING,
+                        "could not delete %"PRIu64" from the log (%s)",
+                        ino, strerror (-ret));
+
+        return 0;
+}
+
+/* }}} */
+
+
+/* {{{ fsync, rchecksum */
+
+int32_t
+lgs_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+               int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+               struct iatt *postbuf)
+{
+        STACK_UNWIND_STRICT (fsync, frame, op_ret, op_errno, prebuf,
+                             postbuf);
+        return 0;
+}
+
+
+int32_t
+lgs_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t datasync)
+{
+        uint64_t ino = 0;
+        uint64_t gen = 0;
+        int      ret = 0;
+
+        if (lgs_inode_key (fd->inode, &ino, &gen) == 0) {
+                ret = lgs_store_sync (this, ino, gen, datasync);
+                if (ret < 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not sync %"PRIu64" in the log (%s)",
+                                ino, strerror (-ret));
+                        STACK_UNWIND_STRICT (fsync, frame, -1, -ret, NULL,
+                                             NULL);
+                        return 0;
+                }
+        }
+
+        /* the placeholder's size and times */
+        STACK_WIND (frame, lgs_fsync_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->fsync,
+                    fd, datasync);
+        return 0;
+}
+
+
+int32_t
+lgs_rchecksum_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, uint32_t weak_checksum,
+                   uint8_t *strong_checksum)
+{
+        STACK_UNWIND_STRICT (rchecksum, frame, op_ret, op_errno,
+                             weak_checksum, strong_checksum);
+        return 0;
+}
+
+
+int32_t
+lgs_rchecksum (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset,
+               int32_t len)
+{
+        char    *buf      = NULL;
+        uint64_t ino      = 0;
+        uint64_t gen      = 0;
+        int32_t  op_ret   = -1;
+        int32_t  op_errno = 0;
+        int32_t  weak_checksum = 0;
+        uint8_t  strong_checksum[MD5_DIGEST_LEN];
+        int      ret      = 0;
+
+        if ((lgs_inode_key (fd->inode, &ino, &gen) < 0)
+            || (lgs_store_state (this, ino, gen) == LGS_ABSENT))
+                goto wind;
+
+        memset (strong_checksum, 0, MD5_DIGEST_LEN);
+
+        buf = GF_CALLOC (1, len, gf_lgs_mt_char);
+        if (!buf) {
+                op_errno = ENOMEM;
+                goto out;
+        }
+
+        ret = lgs_store_read (this, ino, gen, buf, offset, len);
+        if (ret == -ENOENT) {
+                GF_FREE (buf);
+                goto wind;
+        }
+
+        if (ret < 0) {
+                op_errno = -ret;
+                goto out;
+        }
+
+        weak_checksum = gf_rsync_weak_checksum (buf, len);
+        gf_rsync_strong_checksum (buf, len, strong_checksum);
+
+        op_ret = 0;
+out:
+        STACK_UNWIND_STRICT (rchecksum, frame, op_ret, op_errno,
+                             weak_checksum, strong_checksum);
+
+        if (buf)
+                GF_FREE (buf);
+
+        return 0;
+
+wind:
+        STACK_WIND (frame, lgs_rchecksum_cbk,
+                    FIRST_CHILD (this), FIRST_CHILD (this)->fops->rchecksum,
+                    fd, offset, len);
+        return 0;
+}
+
+/* }}} */
+
+
+int
+lgs_priv_dump (xlator_t *this)
+{
+        lgs_private_t *priv = NULL;
+        char           key_prefix[GF_DUMP_MAX_BUF_LEN];
+        char           key[GF_DUMP_MAX_BUF_LEN];
+        uint64_t       entries     = 0;
+        uint64_t       segments    = 0;
+        uint64_t       used        = 0;
+        uint64_t       live        = 0;
+        uint64_t       compactions = 0;
+        uint64_t       compacted   = 0;
+        uint64_t       migrations  = 0;
+        lgs_segment_t *seg         = NULL;
+
+        priv = this->private;
+        if (!priv)
+                return -1;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                list_for_each_entry (seg, &priv->segments, list)
+                        segments++;
+
+                entries     = priv->entries;
+                used        = priv->used;
+                live        = priv->live;
+                compactions = priv->compactions;
+                compacted   = priv->compacted_bytes;
+                migrations  = priv->migrations;
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        gf_proc_dump_build_key (key_prefix, "xlator.storage.logstore",
+                                "priv");
+        gf_proc_dump_add_section (key_prefix);
+
+        gf_proc_dump_build_key (key, key_prefix, "segment_dir");
+        gf_proc_dump_write (key, "%s", priv->segment_dir);
+        gf_proc_dump_build_key (key, key_prefix, "files");
+        gf_proc_dump_write (key, "%"PRIu64, entries);
+        gf_proc_dump_build_key (key, key_prefix, "segments");
+        gf_proc_dump_write (key, "%"PRIu64, segments);
+        gf_proc_dump_build_key (key, key_prefix, "used_bytes");
+        gf_proc_dump_write (key, "%"PRIu64, used);
+        gf_proc_dump_build_key (key, key_prefix, "live_bytes");
+        gf_proc_dump_write (key, "%"PRIu64, live);
+        gf_proc_dump_build_key (key, key_prefix, "compactions");
+        gf_proc_dump_write (key, "%"PRIu64, compactions);
+        gf_proc_dump_build_key (key, key_prefix, "compacted_bytes");
+        gf_proc_dump_write (key, "%"PRIu64, compacted);
+        gf_proc_dump_build_key (key, key_prefix, "migrations");
+        gf_proc_dump_write (key, "%"PRIu64, migrations);
+
+        return 0;
+}
+
+
+int32_t
+mem_acct_init (xlator_t *this)
+{
+        int     ret = -1;
+
+        if (!this)
+                return ret;
+
+        ret = xlator_mem_acct_init (this, gf_lgs_mt_end + 1);
+
+        if (ret != 0) {
+                gf_log (this->name, GF_LOG_ERROR, "Memory accounting init"
+                        "failed");
+                return ret;
+        }
+
+        return ret;
+}
+
+
+int32_t
+init (xlator_t *this)
+{
+        lgs_private_t *priv = NULL;
+        struct stat    buf;
+        uint64_t       max_size = 0;
+
+        char    *segment_dir = NULL;
+        char    *str         = NULL;
+        int32_t  threshold   = 0;
+        int      ret         = -1;
+
+        if (!this->children || this->children->next) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "'logstore' not configured with exactly one child");
+                goto out;
+        }
+
+        if (!this->parents) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "dangling volume. check volfile ");
+        }
+
+        ret = dict_get_str (this->options, "segment-directory",
+                            &segment_dir);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "'option segment-directory' is required");
+                goto out;
+        }
+
+        ret = mkdir (segment_dir, 0700);
+        if ((ret == -1) && (errno != EEXIST)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not create segment directory %s (%s)",
+                        segment_dir, strerror (errno));
+                goto out;
+        }
+
+        ret = stat (segment_dir, &buf);
+        if ((ret == -1) || !S_ISDIR (buf.st_mode)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "segment-directory %s is not a directory",
+                        segment_dir);
+                ret = -1;
+                goto out;
+        }
+
+        priv = GF_CALLOC (1, sizeof (*priv), gf_lgs_mt_lgs_private_t);
+        if (!priv) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                ret = -1;
+                goto out;
+        }
+
+        priv->small_file_size   = LGS_DEFAULT_SMALL_FILE_SIZE;
+        priv->segment_size      = LGS_DEFAULT_SEGMENT_SIZE;
+        priv->compact_threshold = LGS_DEFAULT_COMPACT_THRESHOLD;
+
+        ret = dict_get_str (this->options, "small-file-size", &str);
+        if (ret == 0) {
+                ret = gf_string2bytesize (str, &priv->small_file_size);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid number format \"%s\" of \"option "
+                                "small-file-size\"", str);
+                        goto out;
+                }
+        }
+
+        /* a file moves out of the log in a single write */
+        max_size = min (this->ctx->page_size, LGS_MAX_PAYLOAD);
+        if (priv->small_file_size > max_size) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "small-file-size %"PRIu64" is too big, using %"
+                        PRIu64, priv->small_file_size, max_size);
+                priv->small_file_size = max_size;
+        }
+
+        ret = dict_get_str (this->options, "segment-size", &str);
+        if (ret == 0) {
+                ret = gf_string2bytesize (str, &priv->segment_size);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid number format \"%s\" of \"option "
+                                "segment-size\"", str);
+                        goto out;
+                }
+        }
+
+        ret = dict_get_int32 (this->options, "compaction-threshold",
+                              &threshold);
+        if (ret == 0) {
+                if ((threshold < 1) || (threshold > 99)) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "compaction-threshold %d is not between 1 "
+                                "and 99", threshold);
+                        ret = -1;
+                        goto out;
+                }
+                priv->compact_threshold = threshold;
+        }
+
+        priv->segment_dir = gf_strdup (segment_dir);
+        if (!priv->segment_dir) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                ret = -1;
+                goto out;
+        }
+
+        this->private = priv;
+
+        ret = lgs_store_init (this);
+        if (ret < 0) {
+                lgs_store_fini (this);
+                this->private = NULL;
+                goto out;
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG,
+                "files up to %"PRIu64" bytes go to %s, in segments of %"
+                PRIu64" bytes", priv->small_file_size, priv->segment_dir,
+                priv->segment_size);
+
+        ret = 0;
+out:
+        if ((ret != 0) && priv) {
+                if (priv->segment_dir)
+                        GF_FREE (priv->segment_dir);
+                GF_FREE (priv);
+        }
+
+        return ret;
+}
+
+
+void
+fini (xlator_t *this)
+{
+        lgs_private_t *priv = NULL;
+
+        priv = this->private;
+        if (!priv)
+                return;
+
+        lgs_store_fini (this);
+
+        this->private = NULL;
+
+        GF_FREE (priv->segment_dir);
+        GF_FREE (priv);
+
+        return;
+}
+
+
+struct xlator_fops fops = {
+        .lookup      = lgs_lookup,
+        .create      = lgs_create,
+        .mknod       = lgs_mknod,
+        .open        = lgs_open,
+        .readv       = lgs_readv,
+        .writev      = lgs_writev,
+        .truncate    = lgs_truncate,
+        .ftruncate   = lgs_ftruncate,
+        .unlink      = lgs_unlink,
+        .rename      = lgs_rename,
+        .fsync       = lgs_fsync,
+        .rchecksum   = lgs_rchecksum,
+};
+
+struct xlator_dumpops dumpops = {
+        .priv        = lgs_priv_dump,
+};
+
+struct xlator_cbks cbks = {
+        .forget      = lgs_forget,
+};
+
+struct volume_options options[] = {
+        { .key  = {"segment-directory"},
+          .type = GF_OPTION_TYPE_PATH
+        },
+        { .key  = {"small-file-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 1,
+          .max  = LGS_MAX_PAYLOAD
+        },
+        { .key  = {"segment-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 1 * GF_UNIT_MB
+        },
+        { .key  = {"compaction-threshold"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 99
+        },
+        { .key  = {NULL} },
+};
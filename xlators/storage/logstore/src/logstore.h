@@ -0,0 +1,244 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __LOGSTORE_H__
+#define __LOGSTORE_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+
+#include "glusterfs.h"
+#include "logging.h"
+#include "dict.h"
+#include "xlator.h"
+#include "defaults.h"
+#include "call-stub.h"
+
+/* default largest file kept in the log */
+#define LGS_DEFAULT_SMALL_FILE_SIZE   (64 * GF_UNIT_KB)
+
+/* default size at which a segment is sealed and a new one started */
+#define LGS_DEFAULT_SEGMENT_SIZE      (64 * GF_UNIT_MB)
+
+/* default percentage of dead bytes in the log that starts compaction */
+#define LGS_DEFAULT_COMPACT_THRESHOLD 50
+
+/* no record payload is ever larger than this, whatever the options */
+#define LGS_MAX_PAYLOAD               (1 * GF_UNIT_MB)
+
+#define LGS_INDEX_BUCKETS             (1 << 18)
+#define LGS_WRITE_LOCKS               64
+
+/* the content a lookup asks for, GLUSTERFS_CONTENT_KEY in quick-read */
+#define LGS_CONTENT_KEY               "glusterfs.content"
+
+#define LGS_RECORD_MAGIC              0x4c475331    /* "LGS1" */
+#define LGS_RECORD_ALIGN              8
+
+typedef enum {
+        LGS_RECORD_PUT = 1,     /* the whole content of a file */
+        LGS_RECORD_DEL,         /* the file is gone from the log */
+        LGS_RECORD_UNLINKED,    /* it has no name left, and is gone
+                                   for good once the brick restarts */
+} lgs_record_type_t;
+
+/*
+ * a record as it is on disk, in network byte order, followed by @len
+ * bytes of content and padded to LGS_RECORD_ALIGN. @csum is the weak
+ * checksum of the header (with @csum zero) and the content.
+ */
+struct lgs_record {
+        uint32_t          magic;
+        uint32_t          type;
+        uint64_t          ino;
+        uint64_t          gen;
+        uint64_t          seq;      /* version, the highest one wins */
+        uint64_t          size;     /* file size, can be more than @len */
+        uint32_t          len;
+        uint32_t          csum;
+} __attribute__((packed));
+typedef struct lgs_record lgs_record_t;
+
+#define LGS_RECORD_LEN(len)                                             \
+        (((sizeof (lgs_record_t) + (len)) + LGS_RECORD_ALIGN - 1)       \
+         & ~(LGS_RECORD_ALIGN - 1))
+
+struct lgs_segment {
+        struct list_head  list;     /* in lgs_private_t, oldest first */
+        uint32_t          id;
+        int               fd;
+        off_t             tail;     /* where the next record goes */
+        off_t             live;     /* bytes of records in the index */
+        int               refs;
+        char              retired;  /* compacted, close on last unref */
+};
+typedef struct lgs_segment lgs_segment_t;
+
+/*
+ * updates waiting for a file to move out of the log, or for a write to
+ * bring the placeholder to its size
+ */
+struct lgs_migration {
+        struct list_head  waiting;  /* call stubs */
+        char              resize;   /* not a migration, a write */
+};
+typedef struct lgs_migration lgs_migration_t;
+
+/* a file kept in the log, keyed by inode number and generation */
+struct lgs_entry {
+        struct lgs_entry *next;     /* hash chain */
+        uint64_t          ino;
+        uint64_t          gen;
+        uint64_t          seq;
+        uint64_t          size;
+        lgs_segment_t    *seg;      /* NULL until the first write */
+        off_t             off;      /* of the record in @seg */
+        uint32_t          len;
+        lgs_migration_t  *migration;
+        char              unlinked; /* see lgs_store_unlink() */
+};
+typedef struct lgs_entry lgs_entry_t;
+
+typedef enum {
+        LGS_ABSENT = 0,             /* not in the log, pass through */
+        LGS_STORED,
+        LGS_MIGRATING,              /* on its way to the child, or
+                                       its placeholder being resized */
+} lgs_state_t;
+
+typedef struct {
+        char             *segment_dir;
+        uint64_t          small_file_size;
+        uint64_t          segment_size;
+        uint32_t          compact_threshold;
+
+        pthread_mutex_t   lock;     /* index, segments and counters */
+        lgs_entry_t     **index;
+        uint64_t          entries;
+        struct list_head  segments;
+        lgs_segment_t    *active;
+        uint64_t          seq;
+        uint64_t          used;     /* bytes in all segments */
+        uint64_t          live;     /* of which still in the index */
+
+        /* serialize the updates of a file, hashed by inode number */
+        pthread_mutex_t   write_locks[LGS_WRITE_LOCKS];
+
+        pthread_t         compactor;
+        pthread_cond_t    compact_cond;
+        char              compactor_running;
+        char              fini;
+
+        uint64_t          compactions;
+        uint64_t          compacted_bytes;
+        uint64_t          migrations;
+} lgs_private_t;
+
+typedef struct {
+        loc_t             loc;
+        loc_t             newloc;
+        fd_t             *fd;
+        fd_t             *migrate_fd;
+        uint64_t          ino;
+        uint64_t          gen;
+        size_t            size;
+        off_t             offset;
+        glusterfs_fop_t   fop;      /* the one a truncate of the log is
+                                       for */
+        int32_t           op_ret;
+        uint64_t          migrations; /* when a lookup went down */
+        uid_t             uid;      /* of the caller, while we are root */
+        gid_t             gid;
+        struct iatt       prebuf;   /* of the child's truncate */
+        struct iatt       postbuf;
+        struct iatt       stbuf;    /* to unwind after the fstat */
+        struct iatt       preparent;
+        struct iatt       postparent;
+        struct iatt       prenewparent;
+        struct iatt       postnewparent;
+        call_stub_t      *stub;     /* the write a migration is for */
+        struct iovec      vector;   /* the content being migrated */
+        struct iobref    *iobref;
+} lgs_local_t;
+
+#define LGS_STACK_UNWIND(fop, frame, params ...) do {           \
+                lgs_local_t *__local = NULL;                    \
+                __local = frame->local;                         \
+                frame->local = NULL;                            \
+                STACK_UNWIND_STRICT (fop, frame, params);       \
+                lgs_local_wipe (__local);                       \
+        } while (0)
+
+void
+lgs_local_wipe (lgs_local_t *local);
+
+/* logstore-ll.c */
+int
+lgs_store_init (xlator_t *this);
+
+void
+lgs_store_fini (xlator_t *this);
+
+lgs_state_t
+lgs_store_state (xlator_t *this, uint64_t ino, uint64_t gen);
+
+int
+lgs_store_add (xlator_t *this, uint64_t ino, uint64_t gen);
+
+int
+lgs_store_read (xlator_t *this, uint64_t ino, uint64_t gen, char *buf,
+                off_t offset, size_t size);
+
+int
+lgs_store_write (xlator_t *this, uint64_t ino, uint64_t gen,
+                 struct iovec *vector, int count, off_t offset,
+                 int append, uint64_t *size);
+
+void
+lgs_store_resize_end (xlator_t *this, uint64_t ino, uint64_t gen);
+
+int
+lgs_store_truncate (xlator_t *this, uint64_t ino, uint64_t gen,
+                    off_t offset);
+
+int
+lgs_store_unlink (xlator_t *this, uint64_t ino, uint64_t gen);
+
+int
+lgs_store_delete (xlator_t *this, uint64_t ino, uint64_t gen);
+
+int
+lgs_store_sync (xlator_t *this, uint64_t ino, uint64_t gen, int datasync);
+
+int
+lgs_store_wait (xlator_t *this, uint64_t ino, uint64_t gen,
+                call_stub_t *stub);
+
+int
+lgs_migrate_begin (xlator_t *this, uint64_t ino, uint64_t gen,
+                   struct iovec *vector, struct iobref *iobref);
+
+void
+lgs_migrate_end (xlator_t *this, uint64_t ino, uint64_t gen, int op_ret);
+
+#endif /* __LOGSTORE_H__ */
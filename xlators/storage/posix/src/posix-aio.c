@@ -0,0 +1,616 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * linux native aio for readv, writev and fsync
+ *
+ * with the synchronous fops every request in flight on a brick holds a
+ * thread, so the depth of the disk queue is whatever io-threads allows.
+ * here the data fops are handed to the kernel with io_submit() and the
+ * calling thread returns right away. the kernel signals completions on
+ * an eventfd which is polled by the event pool, and the fops unwind from
+ * the event thread. a handful of threads can then keep a few hundred
+ * requests queued to the device.
+ *
+ * the kernel only does reads and writes asynchronously on files opened
+ * with O_DIRECT (see the o-direct option), others are completed inside
+ * io_submit(). whenever a request can not be submitted (queue full,
+ * unsupported by the file system) it is done synchronously instead.
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "glusterfs.h"
+#include "xlator.h"
+#include "logging.h"
+#include "common-utils.h"
+#include "event.h"
+#include "iobuf.h"
+
+#include "posix.h"
+#include "posix-aio.h"
+
+#ifdef HAVE_LINUX_AIO
+
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/aio_abi.h>
+
+struct posix_aio_cb {
+        struct iocb      iocb;
+        call_frame_t    *frame;
+        fd_t            *fd;
+        int              _fd;
+        glusterfs_fop_t  op;
+        off_t            offset;
+        struct iobuf    *iobuf;
+        struct iobref   *iobref;
+        struct iovec    *vector;
+        char            *buf;     /* aligned copy of a misaligned O_DIRECT write */
+        struct iatt      prebuf;
+};
+
+
+static inline int
+posix_io_setup (unsigned nr_events, aio_context_t *ctx)
+{
+        return syscall (__NR_io_setup, nr_events, ctx);
+}
+
+
+static inline int
+posix_io_destroy (aio_context_t ctx)
+{
+        return syscall (__NR_io_destroy, ctx);
+}
+
+
+static inline int
+posix_io_submit (aio_context_t ctx, long nr, struct iocb **iocbs)
+{
+        return syscall (__NR_io_submit, ctx, nr, iocbs);
+}
+
+
+static inline int
+posix_io_getevents (aio_context_t ctx, long min_nr, long nr,
+                    struct io_event *events, struct timespec *timeout)
+{
+        return syscall (__NR_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+
+static struct posix_aio_cb *
+posix_aio_cb_new (call_frame_t *frame, fd_t *fd, int _fd, glusterfs_fop_t op,
+                  off_t offset)
+{
+        struct posix_aio_cb *paiocb = NULL;
+
+        paiocb = GF_CALLOC (1, sizeof (*paiocb), gf_posix_mt_aio_cb);
+        if (!paiocb)
+                return NULL;
+
+        paiocb->frame  = frame;
+        paiocb->fd     = fd_ref (fd);
+        paiocb->_fd    = _fd;
+        paiocb->op     = op;
+        paiocb->offset = offset;
+
+        return paiocb;
+}
+
+
+static void
+posix_aio_cb_free (struct posix_aio_cb *paiocb)
+{
+        if (paiocb->fd)
+                fd_unref (paiocb->fd);
+        if (paiocb->iobref)
+                iobref_unref (paiocb->iobref);
+        if (paiocb->iobuf)
+                iobuf_unref (paiocb->iobuf);
+        if (paiocb->vector)
+                GF_FREE (paiocb->vector);
+        if (paiocb->buf)
+                GF_FREE (paiocb->buf);
+
+        GF_FREE (paiocb);
+}
+
+
+/*
+ * hand @paiocb over to the kernel. returns 0 if it took it, in which case
+ * the fop is unwound from posix_aio_event_handler, or -errno if the caller
+ * has to do the fop by itself.
+ */
+
+static int
+posix_aio_submit (xlator_t *this, struct posix_aio_cb *paiocb)
+{
+        struct posix_private *priv     = NULL;
+        struct iocb          *iocbs[1] = {NULL, };
+        int                   ret      = -1;
+
+        priv = this->private;
+
+        paiocb->iocb.aio_data   = (uint64_t)(long) paiocb;
+        paiocb->iocb.aio_fildes = paiocb->_fd;
+        paiocb->iocb.aio_flags  = IOCB_FLAG_RESFD;
+        paiocb->iocb.aio_resfd  = priv->aio_eventfd;
+
+        /* counted before the kernel can complete it */
+        LOCK (&priv->lock);
+        {
+                priv->aio_inflight++;
+                priv->aio_submitted++;
+        }
+        UNLOCK (&priv->lock);
+
+        iocbs[0] = &paiocb->iocb;
+
+        ret = posix_io_submit ((aio_context_t) priv->aio_ctx, 1, iocbs);
+        if (ret == 1)
+                return 0;
+
+        ret = (ret < 0) ? -errno : -EAGAIN;
+
+        LOCK (&priv->lock);
+        {
+                priv->aio_inflight--;
+                priv->aio_submitted--;
+                priv->aio_fallbacks++;
+        }
+        UNLOCK (&priv->lock);
+
+        return ret;
+}
+
+
+int
+posix_aio_readv (call_frame_t *frame, xlator_t *this,
+                 fd_t *fd, size_t size, off_t offset)
+{
+        struct posix_aio_cb *paiocb  = NULL;
+        struct posix_fd     *pfd     = NULL;
+        uint64_t             tmp_pfd = 0;
+        int                  ret     = -1;
+
+        /* posix_readv reports whatever is wrong with the request */
+        ret = fd_ctx_get (fd, this, &tmp_pfd);
+        if ((ret < 0) || !size)
+                goto sync;
+
+        pfd = (struct posix_fd *)(long) tmp_pfd;
+
+        paiocb = posix_aio_cb_new (frame, fd, pfd->fd, GF_FOP_READ, offset);
+        if (!paiocb)
+                goto sync;
+
+        paiocb->iobuf  = iobuf_get (this->ctx->iobuf_pool);
+        paiocb->iobref = iobref_new ();
+        if (!paiocb->iobuf || !paiocb->iobref)
+                goto sync;
+
+        iobref_add (paiocb->iobref, paiocb->iobuf);
+
+        paiocb->iocb.aio_lio_opcode = IOCB_CMD_PREAD;
+        paiocb->iocb.aio_buf        = (uint64_t)(long) paiocb->iobuf->ptr;
+        paiocb->iocb.aio_nbytes     = size;
+        paiocb->iocb.aio_offset     = offset;
+
+        ret = posix_aio_submit (this, paiocb);
+        if (ret == 0)
+                return 0;
+
+sync:
+        if (paiocb)
+                posix_aio_cb_free (paiocb);
+
+        return -1;
+}
+
+
+int
+posix_aio_writev (call_frame_t *frame, xlator_t *this,
+                  fd_t *fd, struct iovec *vector, int32_t count, off_t offset,
+                  struct iobref *iobref)
+{
+        struct posix_aio_cb *paiocb  = NULL;
+        struct posix_fd     *pfd     = NULL;
+        uint64_t             tmp_pfd = 0;
+        size_t               size    = 0;
+        char                *buf     = NULL;
+        int                  align   = 4096;
+        int                  ret     = -1;
+
+        ret = fd_ctx_get (fd, this, &tmp_pfd);
+        if ((ret < 0) || !vector)
+                goto sync;
+
+        pfd = (struct posix_fd *)(long) tmp_pfd;
+
+        /* each write has to be fsync'd before it is acknowledged */
+        if (pfd->flushwrites)
+                goto sync;
+
+        paiocb = posix_aio_cb_new (frame, fd, pfd->fd, GF_FOP_WRITE, offset);
+        if (!paiocb)
+                goto sync;
+
+        ret = posix_fstat_with_gen (this, pfd->fd, &paiocb->prebuf);
+        if (ret == -1)
+                goto sync;
+
+        if ((pfd->flags & O_DIRECT)
+            && (posix_iov_aligned_run (vector, count, align) != count)) {
+                /* page aligned buffer, as in __posix_writev */
+                size = iov_length (vector, count);
+
+                paiocb->buf = GF_MALLOC (size + align, gf_posix_mt_char);
+                if (!paiocb->buf)
+                        goto sync;
+
+                buf = ALIGN_BUF (paiocb->buf, align);
+                iov_unload (buf, vector, count);
+
+                paiocb->iocb.aio_lio_opcode = IOCB_CMD_PWRITE;
+                paiocb->iocb.aio_buf        = (uint64_t)(long) buf;
+                paiocb->iocb.aio_nbytes     = size;
+        } else {
+                paiocb->vector = iov_dup (vector, count);
+                if (!paiocb->vector)
+                        goto sync;
+
+                if (iobref)
+                        paiocb->iobref = iobref_ref (iobref);
+
+                paiocb->iocb.aio_lio_opcode = IOCB_CMD_PWRITEV;
+                paiocb->iocb.aio_buf        = (uint64_t)(long) paiocb->vector;
+                paiocb->iocb.aio_nbytes     = count;
+        }
+
+        paiocb->iocb.aio_offset = offset;
+
+        ret = posix_aio_submit (this, paiocb);
+        if (ret == 0)
+                return 0;
+
+sync:
+        if (paiocb)
+                posix_aio_cb_free (paiocb);
+
+        return -1;
+}
+
+
+int
+posix_aio_fsync (call_frame_t *frame, xlator_t *this,
+                 fd_t *fd, int32_t datasync)
+{
+        struct posix_private *priv    = NULL;
+        struct posix_aio_cb  *paiocb  = NULL;
+        struct posix_fd      *pfd     = NULL;
+        uint64_t              tmp_pfd = 0;
+        int                   ret     = -1;
+
+        priv = this->private;
+
+        /* batched fsyncs are posix_fsync's business */
+        if (!priv->aio_fsync
+            || (priv->batch_fsync_mode != POSIX_BATCH_FSYNC_NONE))
+                goto sync;
+
+        ret = fd_ctx_get (fd, this, &tmp_pfd);
+        if (ret < 0)
+                goto sync;
+
+        pfd = (struct posix_fd *)(long) tmp_pfd;
+
+        paiocb = posix_aio_cb_new (frame, fd, pfd->fd, GF_FOP_FSYNC, 0);
+        if (!paiocb)
+                goto sync;
+
+        ret = posix_fstat_with_gen (this, pfd->fd, &paiocb->prebuf);
+        if (ret == -1)
+                goto sync;
+
+        paiocb->iocb.aio_lio_opcode = datasync ? IOCB_CMD_FDSYNC
+                                               : IOCB_CMD_FSYNC;
+
+        ret = posix_aio_submit (this, paiocb);
+        if (ret == 0)
+                return 0;
+
+        if (ret == -EINVAL) {
+                gf_log (this->name, GF_LOG_NORMAL,
+                        "file system does not support aio fsync, "
+                        "using fsync()");
+                priv->aio_fsync = _gf_false;
+        }
+
+sync:
+        if (paiocb)
+                posix_aio_cb_free (paiocb);
+
+        return -1;
+}
+
+
+static void
+posix_aio_complete (xlator_t *this, struct posix_aio_cb *paiocb, int64_t res)
+{
+        struct posix_private *priv     = NULL;
+        struct iovec          vec      = {0, };
+        struct iatt           postbuf  = {0, };
+        int32_t               op_ret   = -1;
+        int32_t               op_errno = 0;
+
+        priv = this->private;
+
+        if (res < 0) {
+                op_errno = -res;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "aio on fd=%p (offset %"PRId64") failed: %s",
+                        paiocb->fd, paiocb->offset, strerror (op_errno));
+                goto out;
+        }
+
+        op_ret = posix_fstat_with_gen (this, paiocb->_fd, &postbuf);
+        if (op_ret == -1) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "post-operation fstat failed on fd=%p: %s",
+                        paiocb->fd, strerror (op_errno));
+                goto out;
+        }
+
+        op_ret = res;
+
+        switch (paiocb->op) {
+        case GF_FOP_READ:
+                LOCK (&priv->lock);
+                {
+                        priv->read_value += res;
+                }
+                UNLOCK (&priv->lock);
+
+                vec.iov_base = paiocb->iobuf->ptr;
+                vec.iov_len  = res;
+
+                /* Hack to notify higher layers of EOF, as posix_readv. */
+                if ((postbuf.ia_size == 0)
+                    || ((paiocb->offset + res) == postbuf.ia_size))
+                        op_errno = ENOENT;
+                break;
+
+        case GF_FOP_WRITE:
+                LOCK (&priv->lock);
+                {
+                        priv->write_value += res;
+                }
+                UNLOCK (&priv->lock);
+                break;
+
+        default:
+                op_ret = 0;
+                break;
+        }
+
+out:
+        switch (paiocb->op) {
+        case GF_FOP_READ:
+                STACK_UNWIND_STRICT (readv, paiocb->frame, op_ret, op_errno,
+                                     &vec, 1, &postbuf, paiocb->iobref);
+                break;
+
+        case GF_FOP_WRITE:
+                STACK_UNWIND_STRICT (writev, paiocb->frame, op_ret, op_errno,
+                                     &paiocb->prebuf, &postbuf);
+                break;
+
+        default:
+                STACK_UNWIND_STRICT (fsync, paiocb->frame, op_ret, op_errno,
+                                     &paiocb->prebuf, &postbuf);
+                break;
+        }
+
+        posix_aio_cb_free (paiocb);
+}
+
+
+static int
+posix_aio_event_handler (int fd, int idx, void *data,
+                         int poll_in, int poll_out, int poll_err)
+{
+        xlator_t             *this     = NULL;
+        xlator_t             *old_THIS = NULL;
+        struct posix_private *priv     = NULL;
+        struct io_event       events[POSIX_AIO_EVENTS_PER_POLL];
+        struct timespec       timeout  = {0, };
+        uint64_t              count    = 0;
+        int                   ret      = 0;
+        int                   i        = 0;
+
+        this = data;
+        priv = this->private;
+
+        /* reset the counter first, whatever completes while we reap
+           wakes us up again */
+        if (read (fd, &count, sizeof (count)) != sizeof (count))
+                return 0;
+
+        old_THIS = THIS;
+        THIS = this;
+
+        do {
+                ret = posix_io_getevents ((aio_context_t) priv->aio_ctx, 0,
+                                          POSIX_AIO_EVENTS_PER_POLL, events,
+                                          &timeout);
+                if (ret < 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "io_getevents failed: %s", strerror (errno));
+                        break;
+                }
+
+                LOCK (&priv->lock);
+                {
+                        priv->aio_inflight -= ret;
+                }
+                UNLOCK (&priv->lock);
+
+                for (i = 0; i < ret; i++)
+                        posix_aio_complete (this,
+                                            (void *)(long) events[i].data,
+                                            events[i].res);
+
+        } while (ret == POSIX_AIO_EVENTS_PER_POLL);
+
+        THIS = old_THIS;
+
+        return 0;
+}
+
+
+int
+posix_aio_init (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+        aio_context_t         ctx  = 0;
+        int                   ret  = -1;
+
+        priv = this->private;
+
+        if (!this->ctx->event_pool) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "no event pool to poll aio completions from");
+                goto out;
+        }
+
+        ret = posix_io_setup (priv->aio_depth, &ctx);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "io_setup failed: %s", strerror (errno));
+                goto out;
+        }
+
+        priv->aio_ctx = ctx;
+
+        priv->aio_eventfd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (priv->aio_eventfd < 0) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "eventfd failed: %s", strerror (errno));
+                ret = -1;
+                goto destroy;
+        }
+
+        ret = event_register (this->ctx->event_pool, priv->aio_eventfd,
+                              posix_aio_event_handler, this, 1, 0);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "could not register the aio eventfd");
+                close (priv->aio_eventfd);
+                goto destroy;
+        }
+
+        priv->aio_idx     = ret;
+        priv->aio_fsync   = _gf_true;
+        priv->aio_capable = _gf_true;
+
+        gf_log (this->name, GF_LOG_NORMAL,
+                "linux aio enabled, up to %d requests in flight",
+                priv->aio_depth);
+
+        ret = 0;
+        goto out;
+
+destroy:
+        posix_io_destroy (ctx);
+        priv->aio_ctx = 0;
+out:
+        return ret;
+}
+
+
+void
+posix_aio_fini (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+
+        priv = this->private;
+
+        if (!priv->aio_capable)
+                return;
+
+        event_unregister (this->ctx->event_pool, priv->aio_eventfd,
+                          priv->aio_idx);
+
+        /* waits for the requests in flight */
+        posix_io_destroy ((aio_context_t) priv->aio_ctx);
+        close (priv->aio_eventfd);
+
+        priv->aio_capable = _gf_false;
+}
+
+#else /* !HAVE_LINUX_AIO */
+
+int
+posix_aio_init (xlator_t *this)
+{
+        gf_log (this->name, GF_LOG_WARNING,
+                "linux-aio requested, but built without Linux native AIO "
+                "support");
+        return -1;
+}
+
+
+void
+posix_aio_fini (xlator_t *this)
+{
+        return;
+}
+
+
+int
+posix_aio_readv (call_frame_t *frame, xlator_t *this,
+                 fd_t *fd, size_t size, off_t offset)
+{
+        return -1;
+}
+
+
+int
+posix_aio_writev (call_frame_t *frame, xlator_t *this,
+                  fd_t *fd, struct iovec *vector, int32_t count, off_t offset,
+                  struct iobref *iobref)
+{
+        return -1;
+}
+
+
+int
+posix_aio_fsync (call_frame_t *frame, xlator_t *this,
+                 fd_t *fd, int32_t datasync)
+{
+        return -1;
+}
+
+#endif /* HAVE_LINUX_AIO */
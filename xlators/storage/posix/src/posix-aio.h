@@ -0,0 +1,59 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _POSIX_AIO_H
+#define _POSIX_AIO_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "glusterfs.h"
+
+/* default number of requests a brick keeps in flight */
+#define POSIX_AIO_DEFAULT_DEPTH 256
+
+/* completions reaped per io_getevents() call */
+#define POSIX_AIO_EVENTS_PER_POLL 64
+
+int
+posix_aio_init (xlator_t *this);
+
+void
+posix_aio_fini (xlator_t *this);
+
+/* the posix data fops try these first when aio_capable is set. 0 means
+   the request went to the kernel and is unwound on completion, -1 that
+   the caller has to do it synchronously. */
+int
+posix_aio_readv (call_frame_t *frame, xlator_t *this,
+                 fd_t *fd, size_t size, off_t offset);
+
+int
+posix_aio_writev (call_frame_t *frame, xlator_t *this,
+                  fd_t *fd, struct iovec *vector, int32_t count, off_t offset,
+                  struct iobref *iobref);
+
+int
+posix_aio_fsync (call_frame_t *frame, xlator_t *this,
+                 fd_t *fd, int32_t datasync);
+
+#endif /* _POSIX_AIO_H */
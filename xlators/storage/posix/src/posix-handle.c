@@ -0,0 +1,542 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * handle store of the brick.
+ *
+ * every file and directory has a generation number, kept in an xattr and
+ * stable across renames (see posix_fill_gen). with "option handle-store"
+ * the brick also keeps GF_HANDLE_DIR/xx/yy/<gen>: a hardlink of the file,
+ * or for a directory a symlink "../../../<path of the directory>", which
+ * rename re-points for the directory and every directory below it. the
+ * symlinks do not go through each other, so the depth of a directory is
+ * not limited by the kernel's limit on nested symlinks.
+ *
+ * root clients can then address an inode as "/GF_HANDLE_DIR/<gen>" and an
+ * entry of a directory as "/GF_HANDLE_DIR/<gen>/<name>", whatever their
+ * paths, which MAKE_REAL_PATH turns into paths through the handle.
+ *
+ * handles are made by the entry fops and lazily by lookup for files which
+ * were there before, and removed with the last name of their inode.
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "glusterfs.h"
+#include "xlator.h"
+#include "logging.h"
+#include "syscall.h"
+#include "byte-order.h"
+
+#include "posix.h"
+#include "posix-handle.h"
+
+/* "/GF_HANDLE_DIR/" */
+#define HANDLE_PREFIX     "/" GF_HANDLE_DIR "/"
+#define HANDLE_PREFIX_LEN (sizeof (HANDLE_PREFIX) - 1)
+
+/* "/GF_HANDLE_DIR/xx/yy/<gen>", no NUL */
+#define HANDLE_LEN        (HANDLE_PREFIX_LEN + 6 + POSIX_HANDLE_GEN_LEN)
+
+
+static int
+posix_handle_path (xlator_t *this, uint64_t gen, char *buf)
+{
+        return sprintf (buf, "%s" HANDLE_PREFIX "%02x/%02x/%016llx",
+                        POSIX_BASE_PATH (this), (unsigned) (gen & 0xff),
+                        (unsigned) ((gen >> 8) & 0xff),
+                        (unsigned long long) gen);
+}
+
+
+/* the generation number in the xattr of @path, without assigning one */
+static int
+posix_handle_get_gen (xlator_t *this, const char *path, uint64_t *gen)
+{
+        char      gen_key[1024] = {0, };
+        uint64_t  gen_val_be    = 0;
+        int       ret           = 0;
+
+        snprintf (gen_key, sizeof (gen_key), "trusted.%s.gen", this->name);
+
+        ret = sys_lgetxattr (path, gen_key, (void *) &gen_val_be,
+                             sizeof (gen_val_be));
+        if (ret != sizeof (gen_val_be))
+                return -1;
+
+        *gen = ntoh64 (gen_val_be);
+        return 0;
+}
+
+
+/* mkdir the fanout directories of @handle */
+static int
+posix_handle_mkdirs (xlator_t *this, char *handle)
+{
+        char   *slash = NULL;
+        int     ret   = 0;
+
+        slash = handle + POSIX_BASE_PATH_LEN (this) + HANDLE_PREFIX_LEN;
+
+        while ((slash = strchr (slash, '/')) != NULL) {
+                *slash = '\0';
+                ret = mkdir (handle, 0711);
+                *slash = '/';
+
+                if ((ret == -1) && (errno != EEXIST))
+                        return -1;
+                slash++;
+        }
+
+        return 0;
+}
+
+
+/*
+ * an existing handle is left alone unless @replace: only a rename knows
+ * that the directory moved, anyone else may be looking at a stale path.
+ * it is then replaced with rename(), so the handle never goes missing.
+ */
+static int
+posix_handle_symlink (xlator_t *this, const char *target, char *handle,
+                      int replace)
+{
+        char     buf[PATH_MAX] = {0, };
+        char     tmp[PATH_MAX] = {0, };
+        ssize_t  len           = 0;
+        int      ret           = 0;
+
+        ret = symlink (target, handle);
+        if ((ret == -1) && (errno == ENOENT)) {
+                if (posix_handle_mkdirs (this, handle) == 0)
+                        ret = symlink (target, handle);
+        }
+
+        if ((ret == -1) && (errno == EEXIST)) {
+                if (!replace)
+                        return 0;
+
+                len = readlink (handle, buf, sizeof (buf) - 1);
+                if ((len == strlen (target)) && !memcmp (buf, target, len))
+                        return 0;
+
+                snprintf (tmp, sizeof (tmp), "%s.new", handle);
+                unlink (tmp);
+
+                ret = symlink (target, tmp);
+                if (ret == 0) {
+                        ret = rename (tmp, handle);
+                        if (ret == -1)
+                                unlink (tmp);
+                }
+        }
+
+        return ret;
+}
+
+
+/*
+ * the target of the handle of directory @path, which is @name in @pgen:
+ * "../../.." and the path of the directory in the export. a client path
+ * is that path already; for an id path it is the target of the parent's
+ * handle plus @name.
+ */
+static int
+posix_handle_dir_target (xlator_t *this, const char *path, uint64_t pgen,
+                         const char *name, char *target)
+{
+        char     handle[PATH_MAX] = {0, };
+        ssize_t  len              = 0;
+
+        if (!pgen) {
+                /* the root of the export */
+                strcpy (target, "../../..");
+                return 0;
+        }
+
+        if (!posix_handle_is_id_path (this, path)) {
+                len = snprintf (target, PATH_MAX, "../../..%s", path);
+                goto out;
+        }
+
+        if (!name) {
+                name = strrchr (path, '/');
+                name = name ? name + 1 : path;
+        }
+
+        posix_handle_path (this, pgen, handle);
+
+        len = readlink (handle, target, PATH_MAX - 1);
+        if (len == -1)
+                return -1;
+
+        len += snprintf (target + len, PATH_MAX - len, "/%s", name);
+out:
+        if (len >= PATH_MAX) {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+
+        return 0;
+}
+
+
+static int
+__posix_handle_create (xlator_t *this, const char *path,
+                       const char *real_path, struct iatt *stbuf,
+                       uint64_t pgen, const char *name, int replace)
+{
+        char   handle[PATH_MAX]  = {0, };
+        char   target[PATH_MAX]  = {0, };
+        int    ret               = 0;
+
+        if (!stbuf->ia_gen)
+                return -1;
+
+        posix_handle_path (this, stbuf->ia_gen, handle);
+
+        if (IA_ISDIR (stbuf->ia_type)) {
+                ret = posix_handle_dir_target (this, path, pgen, name,
+                                               target);
+                if (ret == 0)
+                        ret = posix_handle_symlink (this, target, handle,
+                                                    replace);
+                goto out;
+        }
+
+        ret = link (real_path, handle);
+        if ((ret == -1) && (errno == ENOENT)) {
+                if (posix_handle_mkdirs (this, handle) == 0)
+                        ret = link (real_path, handle);
+        }
+
+        if ((ret == -1) && (errno == EEXIST))
+                ret = 0;
+
+        if ((ret == -1) && (errno == EXDEV)) {
+                /* span-devices, the file is not on the first device */
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "no handle for %s on another device", real_path);
+                return -1;
+        }
+
+out:
+        if (ret == -1)
+                gf_log (this->name, GF_LOG_WARNING,
+                        "creating handle %s of %s failed: %s",
+                        handle, real_path, strerror (errno));
+        return ret;
+}
+
+
+int
+posix_handle_create (xlator_t *this, const char *path, const char *real_path,
+                     struct iatt *stbuf, uint64_t pgen, const char *name)
+{
+        return __posix_handle_create (this, path, real_path, stbuf, pgen,
+                                      name, 0);
+}
+
+
+/*
+ * re-point the handles of the directories below @dir, whose handle now
+ * has @target. both buffers are PATH_MAX long and are restored on return.
+ */
+static void
+posix_handle_repoint (xlator_t *this, char *dir, char *target)
+{
+        char            handle[PATH_MAX] = {0, };
+        DIR            *dirp             = NULL;
+        struct dirent  *entry            = NULL;
+        struct stat     stbuf            = {0, };
+        uint64_t        gen              = 0;
+        size_t          dir_len          = 0;
+        size_t          target_len       = 0;
+
+        dirp = opendir (dir);
+        if (!dirp) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "opendir on %s failed: %s", dir, strerror (errno));
+                return;
+        }
+
+        dir_len    = strlen (dir);
+        target_len = strlen (target);
+
+        while ((entry = readdir (dirp)) != NULL) {
+                if (!strcmp (entry->d_name, ".")
+                    || !strcmp (entry->d_name, ".."))
+                        continue;
+
+                if ((snprintf (dir + dir_len, PATH_MAX - dir_len, "/%s",
+                               entry->d_name) >= PATH_MAX - dir_len)
+                    || (snprintf (target + target_len,
+                                  PATH_MAX - target_len, "/%s",
+                                  entry->d_name) >= PATH_MAX - target_len))
+                        goto next;
+
+                if ((lstat (dir, &stbuf) == -1) || !S_ISDIR (stbuf.st_mode))
+                        goto next;
+
+                if (posix_handle_get_gen (this, dir, &gen) == 0) {
+                        posix_handle_path (this, gen, handle);
+                        if (posix_handle_symlink (this, target, handle, 1))
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "re-pointing handle %s of %s "
+                                        "failed: %s", handle, dir,
+                                        strerror (errno));
+                }
+
+                posix_handle_repoint (this, dir, target);
+        next:
+                dir[dir_len]       = '\0';
+                target[target_len] = '\0';
+        }
+
+        closedir (dirp);
+}
+
+
+/*
+ * the directory @real_path was renamed to @path, @name in @pgen. the
+ * handles of the directories below it have the old path too, so the
+ * whole tree is walked; renaming a directory costs a readdir of every
+ * directory below it.
+ */
+int
+posix_handle_rename (xlator_t *this, const char *path, const char *real_path,
+                     struct iatt *stbuf, uint64_t pgen, const char *name)
+{
+        char   handle[PATH_MAX]  = {0, };
+        char   target[PATH_MAX]  = {0, };
+        char   dir[PATH_MAX]     = {0, };
+        int    ret               = 0;
+
+        ret = __posix_handle_create (this, path, real_path, stbuf, pgen,
+                                     name, 1);
+        if ((ret == -1) || !IA_ISDIR (stbuf->ia_type))
+                return ret;
+
+        posix_handle_path (this, stbuf->ia_gen, handle);
+
+        ret = readlink (handle, target, sizeof (target) - 1);
+        if ((ret == -1) || (strlen (real_path) >= sizeof (dir)))
+                return -1;
+
+        strcpy (dir, real_path);
+        posix_handle_repoint (this, dir, target);
+
+        return 0;
+}
+
+
+int
+posix_handle_remove (xlator_t *this, uint64_t gen, ia_type_t type)
+{
+        char         handle[PATH_MAX] = {0, };
+        struct stat  stbuf            = {0, };
+        int          ret              = 0;
+
+        if (!gen)
+                return 0;
+
+        posix_handle_path (this, gen, handle);
+
+        if (!IA_ISDIR (type)) {
+                /* keep it while other names of the inode are left */
+                ret = lstat (handle, &stbuf);
+                if ((ret == -1) || (stbuf.st_nlink > 1))
+                        return 0;
+        }
+
+        ret = unlink (handle);
+        if ((ret == -1) && (errno != ENOENT)) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "removing handle %s failed: %s", handle,
+                        strerror (errno));
+                return -1;
+        }
+
+        return 0;
+}
+
+
+/* is @path "/GF_HANDLE_DIR/<gen>" or "/GF_HANDLE_DIR/<gen>/..." */
+int
+posix_handle_is_id_path (xlator_t *this, const char *path)
+{
+        struct posix_private *priv = NULL;
+        int                   i    = 0;
+
+        priv = this->private;
+
+        if (!priv->handle_store)
+                return 0;
+
+        if (strncmp (path, HANDLE_PREFIX, HANDLE_PREFIX_LEN))
+                return 0;
+
+        path += HANDLE_PREFIX_LEN;
+        for (i = 0; i < POSIX_HANDLE_GEN_LEN; i++)
+                if (!isxdigit (path[i]))
+                        return 0;
+
+        return ((path[i] == '\0') || (path[i] == '/'));
+}
+
+
+/*
+ * is @path the handle directory or anything in it which is not an entry
+ * of a directory addressed by its handle. entry fops are refused on them.
+ */
+int
+posix_handle_is_reserved (xlator_t *this, const char *path)
+{
+        struct posix_private *priv = NULL;
+        const char           *rest = NULL;
+
+        priv = this->private;
+
+        if (!priv->handle_store)
+                return 0;
+
+        if (strncmp (path, HANDLE_PREFIX, HANDLE_PREFIX_LEN - 1))
+                return 0;
+
+        rest = path + HANDLE_PREFIX_LEN - 1;
+        if ((*rest != '\0') && (*rest != '/'))
+                return 0;   /* "/GF_HANDLE_DIRfoo" */
+
+        if (!posix_handle_is_id_path (this, path))
+                return 1;
+
+        /* the handle itself */
+        rest = path + HANDLE_PREFIX_LEN + POSIX_HANDLE_GEN_LEN;
+        return (*rest == '\0');
+}
+
+
+/*
+ * may the caller of @frame use @path. a handle reaches a file without
+ * going through its directories, so it would skip the search permission
+ * checks on them; the handle directory and everything addressed through
+ * it is for root only.
+ */
+int
+posix_handle_denied (call_frame_t *frame, xlator_t *this, const char *path)
+{
+        const char *rest = NULL;
+
+        if (strncmp (path, HANDLE_PREFIX, HANDLE_PREFIX_LEN - 1))
+                return 0;
+
+        rest = path + HANDLE_PREFIX_LEN - 1;
+        if ((*rest != '\0') && (*rest != '/'))
+                return 0;   /* "/GF_HANDLE_DIRfoo" */
+
+        return (frame->root->uid != 0);
+}
+
+
+/*
+ * real path of an id path, see posix_handle_is_id_path. @real_path has
+ * room for strlen (@path) + POSIX_BASE_PATH_LEN + POSIX_HANDLE_PATH_EXTRA.
+ */
+void
+posix_handle_real_path (xlator_t *this, const char *path, char *real_path)
+{
+        const char  *rest = NULL;
+        uint64_t     gen  = 0;
+        uint64_t     xgen = 0;
+        struct stat  stbuf = {0, };
+        int          len  = 0;
+
+        gen  = strtoull (path + HANDLE_PREFIX_LEN, NULL, 16);
+        rest = path + HANDLE_PREFIX_LEN + POSIX_HANDLE_GEN_LEN;
+
+        len = posix_handle_path (this, gen, real_path);
+
+        if (*rest) {
+                /* an entry of the directory, through its symlink */
+                strcpy (real_path + len, "/.");
+                strcpy (real_path + len + 2, rest);
+                return;
+        }
+
+        /* a symlink which is not the object itself is a directory handle,
+           and lgetxattr should see the directory, not the link */
+        if ((lstat (real_path, &stbuf) == 0) && S_ISLNK (stbuf.st_mode)) {
+                if ((posix_handle_get_gen (this, real_path, &xgen) != 0)
+                    || (xgen != gen))
+                        strcpy (real_path + len, "/.");
+        }
+}
+
+
+int
+posix_handle_init (xlator_t *this)
+{
+        struct posix_private *priv    = NULL;
+        char                 *path    = NULL;
+        struct iatt           stbuf   = {0, };
+        int                   ret     = 0;
+
+        priv = this->private;
+
+        path = alloca (POSIX_BASE_PATH_LEN (this) + HANDLE_PREFIX_LEN + 1);
+        strcpy (path, priv->base_path);
+        strcat (path, "/" GF_HANDLE_DIR);
+
+        ret = mkdir (path, 0711);
+        if ((ret == -1) && (errno != EEXIST)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "creating handle directory %s failed: %s",
+                        path, strerror (errno));
+                return -1;
+        }
+
+        ret = posix_lstat_with_gen (this, priv->base_path, &stbuf);
+        if (ret == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "stat on %s failed: %s", priv->base_path,
+                        strerror (errno));
+                return -1;
+        }
+
+        ret = posix_handle_create (this, "/", priv->base_path, &stbuf, 0,
+                                   NULL);
+        if (ret == -1)
+                return -1;
+
+        gf_log (this->name, GF_LOG_DEBUG, "handle store in %s", path);
+        return 0;
+}
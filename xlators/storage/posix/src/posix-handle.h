@@ -0,0 +1,68 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _POSIX_HANDLE_H
+#define _POSIX_HANDLE_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "glusterfs.h"
+
+/*
+ * the handle of the file with generation number G is
+ * GF_HANDLE_DIR/xx/yy/<G as 16 hex digits>, xx and yy being the two lowest
+ * bytes of G. it is a hardlink of the file, or for a directory a symlink
+ * to its path in the export.
+ */
+#define POSIX_HANDLE_GEN_LEN    16
+
+/* what the real path of "/GF_HANDLE_DIR/<gen>..." needs beyond the path */
+#define POSIX_HANDLE_PATH_EXTRA 16
+
+int
+posix_handle_init (xlator_t *this);
+
+int
+posix_handle_is_id_path (xlator_t *this, const char *path);
+
+int
+posix_handle_is_reserved (xlator_t *this, const char *path);
+
+int
+posix_handle_denied (call_frame_t *frame, xlator_t *this, const char *path);
+
+void
+posix_handle_real_path (xlator_t *this, const char *path, char *real_path);
+
+int
+posix_handle_create (xlator_t *this, const char *path, const char *real_path,
+                     struct iatt *stbuf, uint64_t pgen, const char *name);
+
+int
+posix_handle_rename (xlator_t *this, const char *path, const char *real_path,
+                     struct iatt *stbuf, uint64_t pgen, const char *name);
+
+int
+posix_handle_remove (xlator_t *this, uint64_t gen, ia_type_t type);
+
+#endif /* _POSIX_HANDLE_H */
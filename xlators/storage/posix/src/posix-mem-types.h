@@ -30,6 +30,12 @@ enum gf_posix_mem_types_ {
         gf_posix_mt_int32_t,
         gf_posix_mt_posix_dev_t,
         gf_posix_mt_trash_path,
+        gf_posix_mt_aio_cb,
+        gf_posix_mt_stat_batch,
+        gf_posix_mt_inode_ctx,
+        gf_posix_mt_xattr_val,
+        gf_posix_mt_fsync_req,
+        gf_posix_mt_unlink_req,
         gf_posix_mt_end
 };
 #endif
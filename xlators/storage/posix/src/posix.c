@@ -42,6 +42,7 @@
 #include "dict.h"
 #include "logging.h"
 #include "posix.h"
+#include "posix-aio.h"
 #include "xlator.h"
 #include "defaults.h"
 #include "common-utils.h"
@@ -84,12 +85,99 @@ typedef struct {
 	loc_t       *loc;
 } posix_xattr_filler_t;
 
+static void
+__posix_xattr_val_del (struct posix_xattr_val *val)
+{
+        list_del (&val->list);
+        GF_FREE (val->key);
+        GF_FREE (val->value);
+        GF_FREE (val);
+}
+
+
+static void
+__posix_xattr_vals_free (struct posix_inode_ctx *ctx)
+{
+        struct posix_xattr_val *val = NULL;
+        struct posix_xattr_val *tmp = NULL;
+
+        list_for_each_entry_safe (val, tmp, &ctx->xattrs, list)
+                __posix_xattr_val_del (val);
+}
+
+
+static struct posix_inode_ctx *
+posix_inode_ctx_get (xlator_t *this, inode_t *inode)
+{
+        struct posix_inode_ctx *ctx     = NULL;
+        uint64_t                tmp_ctx = 0;
+        int                     ret     = 0;
+
+        LOCK (&inode->lock);
+        {
+                ret = __inode_ctx_get (inode, this, &tmp_ctx);
+                if (ret == 0) {
+                        ctx = (struct posix_inode_ctx *)(long) tmp_ctx;
+                        goto unlock;
+                }
+
+                ctx = GF_CALLOC (1, sizeof (*ctx), gf_posix_mt_inode_ctx);
+                if (!ctx)
+                        goto unlock;
+
+                pthread_mutex_init (&ctx->xattrop_lock, NULL);
+                INIT_LIST_HEAD (&ctx->xattrs);
+
+                ret = __inode_ctx_put (inode, this, (uint64_t)(long) ctx);
+                if (ret < 0) {
+                        pthread_mutex_destroy (&ctx->xattrop_lock);
+                        GF_FREE (ctx);
+                        ctx = NULL;
+                }
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+        return ctx;
+}
+
+
+/*
+ * forget what xattrop left in @inode, its xattrs were changed otherwise
+ */
+static void
+posix_xattrop_cache_drop (xlator_t *this, inode_t *inode)
+{
+        struct posix_inode_ctx *ctx     = NULL;
+        uint64_t                tmp_ctx = 0;
+
+        if (!inode || inode_ctx_get (inode, this, &tmp_ctx))
+                return;
+
+        ctx = (struct posix_inode_ctx *)(long) tmp_ctx;
+
+        pthread_mutex_lock (&ctx->xattrop_lock);
+        {
+                __posix_xattr_vals_free (ctx);
+        }
+        pthread_mutex_unlock (&ctx->xattrop_lock);
+}
+
+
 int
 posix_forget (xlator_t *this, inode_t *inode)
 {
-	uint64_t tmp_cache = 0;
-	if (!inode_ctx_del (inode, this, &tmp_cache))
-		dict_destroy ((dict_t *)(long)tmp_cache);
+        struct posix_inode_ctx *ctx     = NULL;
+	uint64_t                tmp_ctx = 0;
+
+	if (inode_ctx_del (inode, this, &tmp_ctx))
+                return 0;
+
+        ctx = (struct posix_inode_ctx *)(long) tmp_ctx;
+
+        __posix_xattr_vals_free (ctx);
+        pthread_mutex_destroy (&ctx->xattrop_lock);
+        GF_FREE (ctx);
 
 	return 0;
 }
@@ -242,43 +330,24 @@ out:
 }
 
 
-int
-posix_lstat_with_gen (xlator_t *this, const char *path, struct iatt *stbuf_p)
+/*
+ * give @stbuf the generation number kept in an xattr of @path, assigning
+ * a new one if it has none yet.
+ */
+static int
+posix_fill_gen (xlator_t *this, const char *path, struct iatt *stbuf)
 {
         struct posix_private  *priv    = NULL;
         int                    ret     = 0;
         char                   gen_key[1024] = {0, };
         uint64_t               gen_val_be = 0;
         uint64_t               gen_val = 0;
-        struct stat            lstatbuf = {0, };
-        struct iatt            stbuf = {0, };
 
         priv = this->private;
 
-        ret = lstat (path, &lstatbuf);
-        if (ret == -1)
-                return -1;
-
-        iatt_from_stat (&stbuf, &lstatbuf);
-
-        ret = posix_scale_ia_ino (priv, &stbuf);
-        if ((ret == -1) && !strcmp (path, "..")) {
-                /* stat on ../ might land us outside the export directory,
-                   so don't panic */
-
-                gf_log (this->name, GF_LOG_WARNING,
-                        "Access to %s (on dev %lld) is crossing device (%lld)",
-                        path, (unsigned long long) stbuf.ia_dev,
-                        (unsigned long long) priv->st_device[0]);
-                errno = EXDEV;
-                return -1;
-        }
-
 #ifndef GF_LINUX_HOST_OS
-        if (!IA_ISDIR (stbuf.ia_type) && !IA_ISREG (stbuf.ia_type)) {
-                stbuf.ia_gen = (typeof(stbuf.ia_gen))stbuf.ia_mtime;
-                if (stbuf_p)
-                        *stbuf_p = stbuf;
+        if (!IA_ISDIR (stbuf->ia_type) && !IA_ISREG (stbuf->ia_type)) {
+                stbuf->ia_gen = (typeof(stbuf->ia_gen))stbuf->ia_mtime;
                 return 0;
         }
 #endif /* !GF_LINUX_HOST_OS */
@@ -307,15 +376,84 @@ posix_lstat_with_gen (xlator_t *this, const char *path, struct iatt *stbuf_p)
 
         if (ret >= 0) {
                 ret = 0;
-                stbuf.ia_gen = (typeof(stbuf.ia_gen))gen_val;
-                if (stbuf_p)
-                        *stbuf_p = stbuf;
+                stbuf->ia_gen = (typeof(stbuf->ia_gen))gen_val;
+        }
+
+        return ret;
+}
+
+
+static int
+posix_iatt_with_gen (xlator_t *this, const char *path, const char *name,
+                     struct stat *lstatbuf, struct iatt *stbuf_p)
+{
+        struct posix_private  *priv    = NULL;
+        int                    ret     = 0;
+        struct iatt            stbuf = {0, };
+
+        priv = this->private;
+
+        iatt_from_stat (&stbuf, lstatbuf);
+
+        ret = posix_scale_ia_ino (priv, &stbuf);
+        if ((ret == -1) && !strcmp (name, "..")) {
+                /* stat on ../ might land us outside the export directory,
+                   so don't panic */
+
+                gf_log (this->name, GF_LOG_WARNING,
+                        "Access to %s (on dev %lld) is crossing device (%lld)",
+                        path, (unsigned long long) stbuf.ia_dev,
+                        (unsigned long long) priv->st_device[0]);
+                errno = EXDEV;
+                return -1;
         }
 
+        ret = posix_fill_gen (this, path, &stbuf);
+        if ((ret == 0) && stbuf_p)
+                *stbuf_p = stbuf;
+
         return ret;
 }
 
 
+int
+posix_lstat_with_gen (xlator_t *this, const char *path, struct iatt *stbuf_p)
+{
+        int                    ret     = 0;
+        struct stat            lstatbuf = {0, };
+
+        ret = lstat (path, &lstatbuf);
+        if (ret == -1)
+                return -1;
+
+        return posix_iatt_with_gen (this, path, path, &lstatbuf, stbuf_p);
+}
+
+
+/*
+ * same as posix_lstat_with_gen, but @name is looked up relative to the
+ * open directory @dirfd, saving the kernel the walk down from the export.
+ * @path still names the same entry, for the generation xattr.
+ */
+static int
+posix_fstatat_with_gen (xlator_t *this, int dirfd, const char *name,
+                        const char *path, struct iatt *stbuf_p)
+{
+        int                    ret     = 0;
+        struct stat            lstatbuf = {0, };
+
+#ifdef AT_SYMLINK_NOFOLLOW
+        ret = fstatat (dirfd, name, &lstatbuf, AT_SYMLINK_NOFOLLOW);
+#else
+        ret = lstat (path, &lstatbuf);
+#endif
+        if (ret == -1)
+                return -1;
+
+        return posix_iatt_with_gen (this, path, name, &lstatbuf, stbuf_p);
+}
+
+
 int
 posix_fstat_with_gen (xlator_t *this, int fd, struct iatt *stbuf_p)
 {
@@ -463,6 +601,29 @@ out:
 }
 
 
+/*
+ * make the handle of a file which may have been there before the handle
+ * store was, once per inode.
+ */
+static void
+posix_lookup_handle (xlator_t *this, loc_t *loc, const char *real_path,
+                     struct iatt *buf, struct iatt *postparent)
+{
+        struct posix_inode_ctx *ctx = NULL;
+
+        if (!loc->inode)
+                return;
+
+        ctx = posix_inode_ctx_get (this, loc->inode);
+        if (!ctx || ctx->handle)
+                return;
+
+        if (posix_handle_create (this, loc->path, real_path, buf,
+                                 postparent->ia_gen, loc->name) == 0)
+                ctx->handle = 1;
+}
+
+
 int32_t
 posix_lookup (call_frame_t *frame, xlator_t *this,
               loc_t *loc, dict_t *xattr_req)
@@ -485,6 +646,12 @@ posix_lookup (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         priv = this->private;
 
         op_ret   = posix_lstat_with_gen (this, real_path, &buf);
@@ -513,6 +680,11 @@ parent:
 
                 parentpath = dirname (pathdup);
 
+                /* the parent of a handle is the handle directory, not
+                   where the symlink of a directory handle points to */
+                if (posix_handle_is_reserved (this, loc->path))
+                        MAKE_REAL_PATH (parentpath, this, "/" GF_HANDLE_DIR);
+
                 op_ret = posix_lstat_with_gen (this, parentpath, &postparent);
                 if (op_ret == -1) {
                         op_errno = errno;
@@ -523,6 +695,10 @@ parent:
                 }
         }
 
+        if ((entry_ret == 0) && loc->parent && priv->handle_store
+            && !posix_handle_is_reserved (this, loc->path))
+                posix_lookup_handle (this, loc, real_path, &buf, &postparent);
+
         op_ret = entry_ret;
 out:
         if (pathdup)
@@ -564,6 +740,12 @@ posix_stat (call_frame_t *frame,
         SET_FS_ID (frame->root->uid, frame->root->gid);
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         op_ret = posix_lstat_with_gen (this, real_path, &buf);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -660,6 +842,12 @@ posix_setattr (call_frame_t *frame, xlator_t *this,
         SET_FS_ID (frame->root->uid, frame->root->gid);
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         op_ret = posix_lstat_with_gen (this, real_path, &statpre);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -900,6 +1088,12 @@ posix_opendir (call_frame_t *frame, xlator_t *this,
         SET_FS_ID (frame->root->uid, frame->root->gid);
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         dir = opendir (real_path);
 
         if (dir == NULL) {
@@ -1036,6 +1230,12 @@ posix_readlink (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         op_ret = readlink (real_path, dest, size);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -1093,6 +1293,18 @@ posix_mknod (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, loc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
         gid = frame->root->gid;
 
         op_ret = posix_lstat_with_gen (this, real_path, &stbuf);
@@ -1176,6 +1388,10 @@ posix_mknod (call_frame_t *frame, xlator_t *this,
 
         SET_TO_OLD_FS_ID ();
 
+        if ((op_ret == 0) && priv->handle_store)
+                posix_handle_create (this, loc->path, real_path, &stbuf,
+                                     preparent.ia_gen, loc->name);
+
         STACK_UNWIND_STRICT (mknod, frame, op_ret, op_errno,
                              (loc)?loc->inode:NULL, &stbuf, &preparent, &postparent);
 
@@ -1332,90 +1548,346 @@ unlock:
 }
 
 
-int32_t
-posix_mkdir (call_frame_t *frame, xlator_t *this,
-             loc_t *loc, mode_t mode)
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+/*
+ * the end of the last data of @_fd below @size. holes are free already,
+ * so the reclaimer cuts from there instead of stepping through them: the
+ * tail is probed with SEEK_DATA in windows of @window bytes doubling
+ * each time, then the extents found are walked with SEEK_HOLE. @size if
+ * the file system cannot tell.
+ */
+static off_t
+posix_data_end (int _fd, off_t size, off_t window)
 {
-        int32_t               op_ret      = -1;
-        int32_t               op_errno    = 0;
-        char                 *real_path   = NULL;
-        struct iatt           stbuf       = {0, };
-        char                  was_present = 1;
-        struct posix_private *priv        = NULL;
-        gid_t                 gid         = 0;
-        char                 *pathdup   = NULL;
-        char                 *parentpath = NULL;
-        struct iatt           preparent = {0,};
-        struct iatt           postparent = {0,};
+        off_t from = 0;
+        off_t data = 0;
+        off_t end  = 0;
 
-        DECLARE_OLD_FS_ID_VAR;
+        for (;;) {
+                from = (size > window) ? (size - window) : 0;
 
-        VALIDATE_OR_GOTO (frame, out);
-        VALIDATE_OR_GOTO (this, out);
-        VALIDATE_OR_GOTO (loc, out);
+                data = lseek (_fd, from, SEEK_DATA);
+                if ((data == -1) && (errno != ENXIO))
+                        return size;
 
-        priv = this->private;
-        VALIDATE_OR_GOTO (priv, out);
+                if ((data != -1) && (data < size))
+                        break;
 
-        MAKE_REAL_PATH (real_path, this, loc->path);
+                /* no data at all */
+                if (from == 0)
+                        return 0;
 
-        gid = frame->root->gid;
+                window *= 2;
+        }
 
-        op_ret = posix_lstat_with_gen (this, real_path, &stbuf);
-        if ((op_ret == -1) && (errno == ENOENT)) {
-                was_present = 0;
+        for (;;) {
+                end = lseek (_fd, data, SEEK_HOLE);
+                if ((end == -1) || (end >= size))
+                        return size;
+
+                data = lseek (_fd, end, SEEK_DATA);
+                if ((data == -1) || (data >= size))
+                        return end;
         }
+}
+#endif
 
-        op_ret = setgid_override (this, real_path, &gid);
-        if (op_ret < 0)
-                goto out;
 
-        SET_FS_ID (frame->root->uid, gid);
-        pathdup = gf_strdup (real_path);
-        GF_VALIDATE_OR_GOTO (this->name, pathdup, out);
+/*
+ * posix_reclaimer - with background-unlink, a large file which is gone
+ * from the namespace but still holds its blocks is handed to this thread,
+ * which truncates it from the end at most background-unlink-chunk-size
+ * bytes at a time before closing it. freeing the blocks of a huge file in
+ * one go can stall the filesystem for seconds; this way nobody waits on
+ * more than a chunk. the files take turns, so a small one queued behind
+ * a huge one is not held up by it.
+ */
+static void *
+posix_reclaimer (void *data)
+{
+        xlator_t                *this  = NULL;
+        struct posix_private    *priv  = NULL;
+        struct posix_unlink_req *req   = NULL;
+        struct stat              stbuf = {0, };
+        uint64_t                 freed = 0;
+        off_t                    size  = 0;
+        gf_boolean_t             done  = _gf_false;
+        int                      ret   = 0;
 
-        parentpath = dirname (pathdup);
+        this = data;
+        priv = this->private;
 
-        op_ret = posix_lstat_with_gen (this, parentpath, &preparent);
-        if (op_ret == -1) {
-                op_errno = errno;
-                gf_log (this->name, GF_LOG_ERROR,
-                        "pre-operation lstat on parent of %s failed: %s",
-                        loc->path, strerror (op_errno));
-                goto out;
-        }
+        THIS = this;
 
-        op_ret = mkdir (real_path, mode);
-        if (op_ret == -1) {
-                op_errno = errno;
-                gf_log (this->name, GF_LOG_ERROR,
-                        "mkdir of %s failed: %s", loc->path, 
-                        strerror (op_errno));
-                goto out;
-        }
+        for (;;) {
+                pthread_mutex_lock (&priv->unlink_lock);
+                {
+                        while (list_empty (&priv->unlinks))
+                                pthread_cond_wait (&priv->unlink_cond,
+                                                   &priv->unlink_lock);
 
-#ifndef HAVE_SET_FSID
-        op_ret = chown (real_path, frame->root->uid, gid);
-        if (op_ret == -1) {
-                op_errno = errno;
-                gf_log (this->name, GF_LOG_ERROR,
-                        "chown on %s failed: %s", loc->path, 
-                        strerror (op_errno));
-                goto out;
-        }
+                        req = list_entry (priv->unlinks.next,
+                                          struct posix_unlink_req, list);
+                        list_del_init (&req->list);
+                }
+                pthread_mutex_unlock (&priv->unlink_lock);
+
+                size = req->size;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+                size = posix_data_end (req->_fd, size,
+                                       priv->unlink_chunk_size);
 #endif
+                if (size > priv->unlink_chunk_size)
+                        size -= priv->unlink_chunk_size;
+                else
+                        size = 0;
 
-        op_ret = posix_lstat_with_gen (this, real_path, &stbuf);
-        if (op_ret == -1) {
-                op_errno = errno;
-                gf_log (this->name, GF_LOG_ERROR,
-                        "lstat on %s failed: %s", loc->path, 
-                        strerror (op_errno));
-                goto out;
-        }
+                ret = ftruncate (req->_fd, size);
+                if (ret == 0)
+                        ret = fstat (req->_fd, &stbuf);
 
-        op_ret = posix_lstat_with_gen (this, parentpath, &postparent);
-        if (op_ret == -1) {
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "truncating unlinked file fd=%d failed: %s, "
+                                "closing it", req->_fd, strerror (errno));
+                        done = _gf_true;
+                } else {
+                        done = (size == 0);
+                }
+
+                /* the last close frees whatever is left */
+                if (done) {
+                        freed = req->pending;
+                } else {
+                        freed = req->pending
+                                - min (req->pending,
+                                       (uint64_t) stbuf.st_blocks * 512);
+                }
+
+                pthread_mutex_lock (&priv->unlink_lock);
+                {
+                        req->size     = size;
+                        req->pending -= freed;
+
+                        priv->unlink_pending_bytes   -= freed;
+                        priv->unlink_reclaimed_bytes += freed;
+
+                        if (done)
+                                priv->unlink_pending_files--;
+                        else
+                                list_add_tail (&req->list, &priv->unlinks);
+                }
+                pthread_mutex_unlock (&priv->unlink_lock);
+
+                if (done) {
+                        close (req->_fd);
+                        GF_FREE (req);
+                }
+
+                /* let the foreground i/o have the disk for a while */
+                if (priv->unlink_pause_msec)
+                        usleep (priv->unlink_pause_msec * 1000);
+        }
+
+        return NULL;
+}
+
+
+static void
+posix_spawn_reclaimer_thread (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+        int ret = 0;
+
+        priv = this->private;
+
+        pthread_mutex_init (&priv->unlink_lock, NULL);
+        pthread_cond_init (&priv->unlink_cond, NULL);
+        INIT_LIST_HEAD (&priv->unlinks);
+
+        if (!priv->background_unlink)
+                return;
+
+        ret = pthread_create (&priv->reclaimer, NULL, posix_reclaimer, this);
+        if (ret != 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "spawning reclaimer thread failed: %s, unlinked "
+                        "files will be freed in one go", strerror (ret));
+                return;
+        }
+
+        priv->reclaimer_present = _gf_true;
+}
+
+
+/*
+ * take over @_fd, the last reference to a file background unlink just
+ * removed. a file with few blocks is closed right away, a large one goes
+ * to the reclaimer.
+ */
+static void
+posix_unlink_reclaim (xlator_t *this, inode_t *inode, int _fd)
+{
+        struct posix_private    *priv  = NULL;
+        struct posix_unlink_req *req   = NULL;
+        struct stat              stbuf = {0, };
+        uint64_t                 allocated = 0;
+        char                     proc_path[64];
+        int                      wfd   = -1;
+        int                      ret   = 0;
+
+        priv = this->private;
+
+        if (!priv->reclaimer_present)
+                goto close;
+
+        ret = fstat (_fd, &stbuf);
+        if (ret == -1)
+                goto close;
+
+        allocated = (uint64_t) stbuf.st_blocks * 512;
+
+        /* truncating would show through other names or open fds, and
+           then the blocks are not freed by us anyway */
+        if ((stbuf.st_nlink != 0) || !fd_list_empty (inode)
+            || (allocated <= priv->unlink_chunk_size))
+                goto close;
+
+#ifdef GF_LINUX_HOST_OS
+        /* @_fd was opened read-only with the caller's credentials, this
+           gives us one we can truncate with */
+        snprintf (proc_path, sizeof (proc_path), "/proc/self/fd/%d", _fd);
+        wfd = open (proc_path, O_WRONLY);
+#endif
+        if (wfd == -1)
+                goto close;
+
+        close (_fd);
+        _fd = wfd;
+
+        req = GF_CALLOC (1, sizeof (*req), gf_posix_mt_unlink_req);
+        if (!req)
+                goto close;
+
+        INIT_LIST_HEAD (&req->list);
+        req->_fd     = _fd;
+        req->size    = stbuf.st_size;
+        req->pending = allocated;
+
+        pthread_mutex_lock (&priv->unlink_lock);
+        {
+                list_add_tail (&req->list, &priv->unlinks);
+
+                priv->unlink_pending_files++;
+                priv->unlink_pending_bytes += allocated;
+
+                pthread_cond_signal (&priv->unlink_cond);
+        }
+        pthread_mutex_unlock (&priv->unlink_lock);
+
+        return;
+
+close:
+        close (_fd);
+}
+
+
+int32_t
+posix_mkdir (call_frame_t *frame, xlator_t *this,
+             loc_t *loc, mode_t mode)
+{
+        int32_t               op_ret      = -1;
+        int32_t               op_errno    = 0;
+        char                 *real_path   = NULL;
+        struct iatt           stbuf       = {0, };
+        char                  was_present = 1;
+        struct posix_private *priv        = NULL;
+        gid_t                 gid         = 0;
+        char                 *pathdup   = NULL;
+        char                 *parentpath = NULL;
+        struct iatt           preparent = {0,};
+        struct iatt           postparent = {0,};
+
+        DECLARE_OLD_FS_ID_VAR;
+
+        VALIDATE_OR_GOTO (frame, out);
+        VALIDATE_OR_GOTO (this, out);
+        VALIDATE_OR_GOTO (loc, out);
+
+        priv = this->private;
+        VALIDATE_OR_GOTO (priv, out);
+
+        MAKE_REAL_PATH (real_path, this, loc->path);
+
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, loc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
+        gid = frame->root->gid;
+
+        op_ret = posix_lstat_with_gen (this, real_path, &stbuf);
+        if ((op_ret == -1) && (errno == ENOENT)) {
+                was_present = 0;
+        }
+
+        op_ret = setgid_override (this, real_path, &gid);
+        if (op_ret < 0)
+                goto out;
+
+        SET_FS_ID (frame->root->uid, gid);
+        pathdup = gf_strdup (real_path);
+        GF_VALIDATE_OR_GOTO (this->name, pathdup, out);
+
+        parentpath = dirname (pathdup);
+
+        op_ret = posix_lstat_with_gen (this, parentpath, &preparent);
+        if (op_ret == -1) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "pre-operation lstat on parent of %s failed: %s",
+                        loc->path, strerror (op_errno));
+                goto out;
+        }
+
+        op_ret = mkdir (real_path, mode);
+        if (op_ret == -1) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "mkdir of %s failed: %s", loc->path, 
+                        strerror (op_errno));
+                goto out;
+        }
+
+#ifndef HAVE_SET_FSID
+        op_ret = chown (real_path, frame->root->uid, gid);
+        if (op_ret == -1) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "chown on %s failed: %s", loc->path, 
+                        strerror (op_errno));
+                goto out;
+        }
+#endif
+
+        op_ret = posix_lstat_with_gen (this, real_path, &stbuf);
+        if (op_ret == -1) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "lstat on %s failed: %s", loc->path, 
+                        strerror (op_errno));
+                goto out;
+        }
+
+        op_ret = posix_lstat_with_gen (this, parentpath, &postparent);
+        if (op_ret == -1) {
                 op_errno = errno;
                 gf_log (this->name, GF_LOG_ERROR,
                         "post-operation lstat on parent of %s failed: %s",
@@ -1431,6 +1903,10 @@ posix_mkdir (call_frame_t *frame, xlator_t *this,
 
         SET_TO_OLD_FS_ID ();
 
+        if ((op_ret == 0) && priv->handle_store)
+                posix_handle_create (this, loc->path, real_path, &stbuf,
+                                     preparent.ia_gen, loc->name);
+
         STACK_UNWIND_STRICT (mkdir, frame, op_ret, op_errno,
                              (loc)?loc->inode:NULL, &stbuf, &preparent, &postparent);
 
@@ -1455,6 +1931,7 @@ posix_unlink (call_frame_t *frame, xlator_t *this,
         struct posix_private    *priv      = NULL;
         struct iatt            preparent = {0,};
         struct iatt            postparent = {0,};
+        struct iatt            stbuf = {0,};
 
         DECLARE_OLD_FS_ID_VAR;
 
@@ -1465,6 +1942,18 @@ posix_unlink (call_frame_t *frame, xlator_t *this,
         SET_FS_ID (frame->root->uid, frame->root->gid);
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, loc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
         pathdup = gf_strdup (real_path);
         GF_VALIDATE_OR_GOTO (this->name, pathdup, out);
 
@@ -1480,6 +1969,11 @@ posix_unlink (call_frame_t *frame, xlator_t *this,
         }
 
         priv = this->private;
+        if (priv->handle_store) {
+                /* the generation number, to drop the handle after */
+                posix_lstat_with_gen (this, real_path, &stbuf);
+        }
+
         if (priv->background_unlink) {
                 if (IA_ISREG (loc->inode->ia_type)) {
                         fd = open (real_path, O_RDONLY);
@@ -1520,11 +2014,18 @@ posix_unlink (call_frame_t *frame, xlator_t *this,
 
         SET_TO_OLD_FS_ID ();
 
+        /* the reclaimer only takes files with no name left */
+        if ((op_ret == 0) && priv->handle_store)
+                posix_handle_remove (this, stbuf.ia_gen, stbuf.ia_type);
+
         STACK_UNWIND_STRICT (unlink, frame, op_ret, op_errno,
                              &preparent, &postparent);
 
         if (fd != -1) {
-                close (fd);
+                if (op_ret == 0)
+                        posix_unlink_reclaim (this, loc->inode, fd);
+                else
+                        close (fd);
         }
 
         return 0;
@@ -1541,6 +2042,8 @@ posix_rmdir (call_frame_t *frame, xlator_t *this,
         char *  parentpath = NULL;
         struct iatt   preparent = {0,};
         struct iatt   postparent = {0,};
+        struct iatt   stbuf = {0,};
+        struct posix_private *priv = NULL;
 
         DECLARE_OLD_FS_ID_VAR;
 
@@ -1551,6 +2054,18 @@ posix_rmdir (call_frame_t *frame, xlator_t *this,
         SET_FS_ID (frame->root->uid, frame->root->gid);
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, loc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
         pathdup = gf_strdup (real_path);
         GF_VALIDATE_OR_GOTO (this->name, pathdup, out);
 
@@ -1565,6 +2080,10 @@ posix_rmdir (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
+        priv = this->private;
+        if (priv->handle_store)
+                posix_lstat_with_gen (this, real_path, &stbuf);
+
         op_ret = rmdir (real_path);
         op_errno = errno;
 
@@ -1597,6 +2116,9 @@ posix_rmdir (call_frame_t *frame, xlator_t *this,
 
         SET_TO_OLD_FS_ID ();
 
+        if ((op_ret == 0) && priv->handle_store)
+                posix_handle_remove (this, stbuf.ia_gen, IA_IFDIR);
+
         STACK_UNWIND_STRICT (rmdir, frame, op_ret, op_errno,
                              &preparent, &postparent);
 
@@ -1631,6 +2153,18 @@ posix_symlink (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, loc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
         op_ret = posix_lstat_with_gen (this, real_path, &stbuf);
         if ((op_ret == -1) && (errno == ENOENT)){
                 was_present = 0;
@@ -1703,6 +2237,10 @@ posix_symlink (call_frame_t *frame, xlator_t *this,
 
         SET_TO_OLD_FS_ID ();
 
+        if ((op_ret == 0) && priv->handle_store)
+                posix_handle_create (this, loc->path, real_path, &stbuf,
+                                     preparent.ia_gen, loc->name);
+
         STACK_UNWIND_STRICT (symlink, frame, op_ret, op_errno,
                              (loc)?loc->inode:NULL, &stbuf, &preparent, &postparent);
 
@@ -1733,6 +2271,7 @@ posix_rename (call_frame_t *frame, xlator_t *this,
         struct iatt           postoldparent = {0, };
         struct iatt           prenewparent  = {0, };
         struct iatt           postnewparent = {0, };
+        struct iatt           victim        = {0, };
 
         DECLARE_OLD_FS_ID_VAR;
 
@@ -1748,6 +2287,30 @@ posix_rename (call_frame_t *frame, xlator_t *this,
         MAKE_REAL_PATH (real_oldpath, this, oldloc->path);
         MAKE_REAL_PATH (real_newpath, this, newloc->path);
 
+        if (posix_handle_denied (frame, this, oldloc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_denied (frame, this, newloc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, oldloc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, newloc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
         oldpathdup = gf_strdup (real_oldpath);
         GF_VALIDATE_OR_GOTO (this->name, oldpathdup, out);
 
@@ -1780,6 +2343,8 @@ posix_rename (call_frame_t *frame, xlator_t *this,
         if ((op_ret == -1) && (errno == ENOENT)){
                 was_present = 0;
         }
+        if (op_ret == 0)
+                victim = stbuf;
 
         op_ret = rename (real_oldpath, real_newpath);
         if (op_ret == -1) {
@@ -1830,6 +2395,20 @@ posix_rename (call_frame_t *frame, xlator_t *this,
 
         SET_TO_OLD_FS_ID ();
 
+        if ((op_ret == 0) && priv->handle_store) {
+                /* the inode which was replaced lost a name */
+                if (victim.ia_gen != stbuf.ia_gen)
+                        posix_handle_remove (this, victim.ia_gen,
+                                             victim.ia_type);
+
+                /* a directory is reached through its parent */
+                if (IA_ISDIR (stbuf.ia_type))
+                        posix_handle_rename (this, newloc->path,
+                                             real_newpath, &stbuf,
+                                             postnewparent.ia_gen,
+                                             newloc->name);
+        }
+
         STACK_UNWIND_STRICT (rename, frame, op_ret, op_errno, &stbuf,
                              &preoldparent, &postoldparent,
                              &prenewparent, &postnewparent);
@@ -1872,6 +2451,24 @@ posix_link (call_frame_t *frame, xlator_t *this,
         MAKE_REAL_PATH (real_oldpath, this, oldloc->path);
         MAKE_REAL_PATH (real_newpath, this, newloc->path);
 
+        if (posix_handle_denied (frame, this, oldloc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_denied (frame, this, newloc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, newloc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
         op_ret = posix_lstat_with_gen (this, real_newpath, &stbuf);
         if ((op_ret == -1) && (errno == ENOENT)) {
                 was_present = 0;
@@ -1926,6 +2523,10 @@ posix_link (call_frame_t *frame, xlator_t *this,
                 GF_FREE (newpathdup);
         SET_TO_OLD_FS_ID ();
 
+        if ((op_ret == 0) && priv->handle_store)
+                posix_handle_create (this, newloc->path, real_newpath,
+                                     &stbuf, preparent.ia_gen, newloc->name);
+
         STACK_UNWIND_STRICT (link, frame, op_ret, op_errno,
                              (oldloc)?oldloc->inode:NULL, &stbuf, &preparent,
                              &postparent);
@@ -1963,6 +2564,12 @@ posix_truncate (call_frame_t *frame,
         SET_FS_ID (frame->root->uid, frame->root->gid);
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         op_ret = posix_lstat_with_gen (this, real_path, &prebuf);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -2035,6 +2642,18 @@ posix_create (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
+        if (posix_handle_is_reserved (this, loc->path)) {
+                op_ret = -1;
+                op_errno = EPERM;
+                goto out;
+        }
+
         gid = frame->root->gid;
 
         op_ret = setgid_override (this, real_path, &gid);
@@ -2147,6 +2766,10 @@ posix_create (call_frame_t *frame, xlator_t *this,
                 }
         }
 
+        if ((op_ret == 0) && priv->handle_store)
+                posix_handle_create (this, loc->path, real_path, &stbuf,
+                                     preparent.ia_gen, loc->name);
+
         STACK_UNWIND_STRICT (create, frame, op_ret, op_errno,
                              fd, (loc)?loc->inode:NULL, &stbuf, &preparent,
                              &postparent);
@@ -2181,6 +2804,12 @@ posix_open (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         op_ret = setgid_override (this, real_path, &gid);
         if (op_ret < 0)
                 goto out;
@@ -2266,9 +2895,6 @@ posix_open (call_frame_t *frame, xlator_t *this,
         return 0;
 }
 
-#define ALIGN_BUF(ptr,bound) ((void *)((unsigned long)(ptr + bound - 1) & \
-                                       (unsigned long)(~(bound - 1))))
-
 int
 posix_readv (call_frame_t *frame, xlator_t *this,
              fd_t *fd, size_t size, off_t offset)
@@ -2294,6 +2920,10 @@ posix_readv (call_frame_t *frame, xlator_t *this,
         priv = this->private;
         VALIDATE_OR_GOTO (priv, out);
 
+        if (priv->aio_capable
+            && (posix_aio_readv (frame, this, fd, size, offset) == 0))
+                return 0;
+
         ret = fd_ctx_get (fd, this, &tmp_pfd);
         if (ret < 0) {
                 op_errno = -ret;
@@ -2407,43 +3037,83 @@ err:
 }
 
 
-int32_t
-__posix_writev (int fd, struct iovec *vector, int count, off_t startoff,
-                int odirect)
+/*
+ * number of vectors, from the first one on, which can be written with
+ * O_DIRECT as they are: each starts at an @align boundary, and all but the
+ * last are a multiple of @align long.
+ */
+int
+posix_iov_aligned_run (struct iovec *vector, int count, int align)
 {
-        int32_t         op_ret = 0;
-        int             idx = 0;
-        int             align = 4096;
-        int             max_buf_size = 0;
-        int             retval = 0;
-        char            *buf = NULL;
-        char            *alloc_buf = NULL;
+        int idx = 0;
+
+        for (idx = 0; idx < count; idx++) {
+                if ((unsigned long) vector[idx].iov_base & (align - 1))
+                        break;
+
+                if (vector[idx].iov_len & (align - 1)) {
+                        /* can end a run, but not continue it */
+                        idx++;
+                        break;
+                }
+        }
+
+        return idx;
+}
+
+
+int32_t
+__posix_writev (int fd, struct iovec *vector, int count, off_t startoff,
+                int odirect)
+{
+        int32_t         op_ret = 0;
+        int             idx = 0;
+        int             run = 0;
+        int             align = 4096;
+        int             max_buf_size = 0;
+        int             retval = 0;
+        size_t          size = 0;
+        char            *buf = NULL;
+        char            *alloc_buf = NULL;
         off_t           internal_off = 0;
 
         /* Check for the O_DIRECT flag during open() */
         if (!odirect)
                 return __posix_pwritev (fd, vector, count, startoff);
 
-        for (idx = 0; idx < count; idx++) {
-                if (max_buf_size < vector[idx].iov_len)
-                        max_buf_size = vector[idx].iov_len;
-        }
+        /* the payload of a write comes in its own (page aligned) iobuf,
+           so only vectors that were put together otherwise are copied */
+        internal_off = startoff;
+        for (idx = 0; idx < count; idx += run) {
+                run = posix_iov_aligned_run (&vector[idx], count - idx, align);
+                if (run) {
+                        size = iov_length (&vector[idx], run);
+                        retval = pwritev (fd, &vector[idx], run, internal_off);
+                } else {
+                        run = 1;
+                        size = vector[idx].iov_len;
+
+                        if (max_buf_size < size) {
+                                if (alloc_buf)
+                                        GF_FREE (alloc_buf);
+
+                                max_buf_size = size;
+                                alloc_buf = GF_MALLOC (max_buf_size + align,
+                                                       gf_posix_mt_char);
+                                if (!alloc_buf) {
+                                        op_ret = -errno;
+                                        goto err;
+                                }
+                        }
 
-        alloc_buf = GF_MALLOC (1 * (max_buf_size + align), gf_posix_mt_char);
-        if (!alloc_buf) {
-                op_ret = -errno;
-                goto err;
-        }
+                        /* page aligned buffer */
+                        buf = ALIGN_BUF (alloc_buf, align);
 
-        internal_off = startoff;
-        for (idx = 0; idx < count; idx++) {
-                /* page aligned buffer */
-                buf = ALIGN_BUF (alloc_buf, align);
+                        memcpy (buf, vector[idx].iov_base, size);
 
-                memcpy (buf, vector[idx].iov_base, vector[idx].iov_len);
+                        retval = pwrite (fd, buf, size, internal_off);
+                }
 
-                /* not sure whether writev works on O_DIRECT'd fd */
-                retval = pwrite (fd, buf, vector[idx].iov_len, internal_off);
                 if (retval == -1) {
                         op_ret = -errno;
                         goto err;
@@ -2451,6 +3121,9 @@ __posix_writev (int fd, struct iovec *vector, int count, off_t startoff,
 
                 op_ret += retval;
                 internal_off += retval;
+
+                if (retval < size)
+                        break;
         }
 
 err:
@@ -2487,6 +3160,11 @@ posix_writev (call_frame_t *frame, xlator_t *this,
 
         VALIDATE_OR_GOTO (priv, out);
 
+        if (priv->aio_capable
+            && (posix_aio_writev (frame, this, fd, vector, count, offset,
+                                  iobref) == 0))
+                return 0;
+
         ret = fd_ctx_get (fd, this, &tmp_pfd);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_DEBUG,
@@ -2570,6 +3248,12 @@ posix_statfs (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         priv = this->private;
 
         op_ret = statvfs (real_path, &buf);
@@ -2582,6 +3266,18 @@ posix_statfs (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
+        /* what background unlink has yet to free is as good as free */
+        pthread_mutex_lock (&priv->unlink_lock);
+        {
+                if (buf.f_frsize) {
+                        buf.f_bfree  += priv->unlink_pending_bytes
+                                / buf.f_frsize;
+                        buf.f_bavail += priv->unlink_pending_bytes
+                                / buf.f_frsize;
+                }
+        }
+        pthread_mutex_unlock (&priv->unlink_lock);
+
         if (!priv->export_statfs) {
                 buf.f_blocks = 0;
                 buf.f_bfree  = 0;
@@ -2693,6 +3389,300 @@ posix_release (xlator_t *this,
 }
 
 
+static void
+posix_fsync_wait_account (struct posix_private *priv, struct timeval *start)
+{
+        struct timeval now    = {0, };
+        int64_t        usec   = 0;
+        int            bucket = 0;
+
+        gettimeofday (&now, NULL);
+
+        usec = (now.tv_sec - start->tv_sec) * 1000000
+                + (now.tv_usec - start->tv_usec);
+
+        while ((bucket < POSIX_FSYNC_HIST_BUCKETS - 1)
+               && (usec >= (1LL << bucket)))
+                bucket++;
+
+        LOCK (&priv->lock);
+        {
+                priv->fsync_wait[bucket]++;
+        }
+        UNLOCK (&priv->lock);
+}
+
+
+static int
+posix_fsync_fd (int _fd, int32_t datasync)
+{
+        int ret = 0;
+
+        if (datasync) {
+                ;
+#ifdef HAVE_FDATASYNC
+                ret = fdatasync (_fd);
+#endif
+        } else {
+                ret = fsync (_fd);
+        }
+
+        return (ret == -1) ? -errno : 0;
+}
+
+
+/*
+ * can one flush serve both @first and @req: the same device for syncfs,
+ * the same file for fsync.
+ */
+static gf_boolean_t
+posix_fsync_same_flush (posix_batch_fsync_mode_t mode,
+                        struct posix_fsync_req *first,
+                        struct posix_fsync_req *req)
+{
+        if (mode == POSIX_BATCH_FSYNC_SYNCFS)
+                return (first->preop.ia_dev == req->preop.ia_dev);
+
+        return (first->fd->inode == req->fd->inode);
+}
+
+
+/*
+ * flush what the fsyncs in @batch wait for, which is a single syncfs or
+ * fsync as they are all on the same device or file, and unwind them all.
+ */
+static void
+posix_fsync_batch (xlator_t *this, struct list_head *batch)
+{
+        struct posix_private   *priv     = NULL;
+        struct posix_fsync_req *first    = NULL;
+        struct posix_fsync_req *req      = NULL;
+        struct posix_fsync_req *tmp      = NULL;
+        struct iatt             postop   = {0, };
+        int32_t                 datasync = 1;
+        int                     ret      = 0;
+
+        priv = this->private;
+
+        first = list_entry (batch->next, struct posix_fsync_req, list);
+
+        list_for_each_entry (req, batch, list) {
+                if (!req->datasync)
+                        datasync = 0;
+        }
+
+#ifdef HAVE_SYNCFS
+        if (priv->batch_fsync_mode == POSIX_BATCH_FSYNC_SYNCFS)
+                ret = (syncfs (first->_fd) == -1) ? -errno : 0;
+        else
+#endif
+                ret = posix_fsync_fd (first->_fd, datasync);
+
+        if (ret < 0)
+                gf_log (this->name, GF_LOG_ERROR,
+                        "fsync on fd=%p failed: %s",
+                        first->fd, strerror (-ret));
+
+        list_for_each_entry_safe (req, tmp, batch, list) {
+                memset (&postop, 0, sizeof (postop));
+
+                if (ret < 0) {
+                        req->op_ret   = -1;
+                        req->op_errno = -ret;
+                } else {
+                        req->op_ret = posix_fstat_with_gen (this, req->_fd,
+                                                            &postop);
+                        if (req->op_ret == -1) {
+                                req->op_errno = errno;
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "post-operation fstat failed on "
+                                        "fd=%p: %s", req->fd,
+                                        strerror (req->op_errno));
+                        }
+                }
+
+                posix_fsync_wait_account (priv, &req->queued);
+
+                list_del (&req->list);
+
+                STACK_UNWIND_STRICT (fsync, req->frame, req->op_ret,
+                                     req->op_errno, &req->preop, &postop);
+
+                fd_unref (req->fd);
+                GF_FREE (req);
+        }
+}
+
+
+/*
+ * posix_fsyncer - with batch-fsync-mode, fsyncs which arrive while another
+ * one is being done are queued to these threads instead of being done by
+ * the thread of the fop. a thread waits batch-fsync-delay-usec for more of
+ * them to arrive after the first one, then takes the first queued fsync
+ * with every other one the same flush serves, so that concurrent fsyncs
+ * of a file (or of a device with syncfs) cost one flush. fsyncs of other
+ * files or devices are flushed by the other threads meanwhile.
+ */
+static void *
+posix_fsyncer (void *data)
+{
+        xlator_t               *this  = NULL;
+        struct posix_private   *priv  = NULL;
+        struct posix_fsync_req *first = NULL;
+        struct posix_fsync_req *req   = NULL;
+        struct posix_fsync_req *tmp   = NULL;
+        struct list_head        batch;
+
+        this = data;
+        priv = this->private;
+
+        THIS = this;
+
+        INIT_LIST_HEAD (&batch);
+
+        for (;;) {
+                pthread_mutex_lock (&priv->fsync_lock);
+                {
+                        while (list_empty (&priv->fsyncs))
+                                pthread_cond_wait (&priv->fsync_cond,
+                                                   &priv->fsync_lock);
+                }
+                pthread_mutex_unlock (&priv->fsync_lock);
+
+                if (priv->batch_fsync_delay_usec)
+                        usleep (priv->batch_fsync_delay_usec);
+
+                pthread_mutex_lock (&priv->fsync_lock);
+                {
+                        /* another thread may have taken them */
+                        if (!list_empty (&priv->fsyncs)) {
+                                first = list_entry (priv->fsyncs.next,
+                                                    struct posix_fsync_req,
+                                                    list);
+
+                                list_for_each_entry_safe (req, tmp,
+                                                          &priv->fsyncs,
+                                                          list) {
+                                        if (posix_fsync_same_flush (
+                                                    priv->batch_fsync_mode,
+                                                    first, req))
+                                                list_move_tail (&req->list,
+                                                                &batch);
+                                }
+                        }
+                }
+                pthread_mutex_unlock (&priv->fsync_lock);
+
+                if (list_empty (&batch))
+                        continue;
+
+                LOCK (&priv->lock);
+                {
+                        priv->fsync_batches++;
+                }
+                UNLOCK (&priv->lock);
+
+                posix_fsync_batch (this, &batch);
+        }
+
+        return NULL;
+}
+
+
+static void
+posix_spawn_fsyncers (xlator_t *this)
+{
+        struct posix_private *priv   = NULL;
+        pthread_t             thread;
+        int                   i      = 0;
+        int                   ret    = 0;
+
+        priv = this->private;
+
+        for (i = 0; i < priv->batch_fsync_threads; i++) {
+                ret = pthread_create (&thread, NULL, posix_fsyncer, this);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "spawning fsyncer thread failed: %s",
+                                strerror (ret));
+                        break;
+                }
+
+                pthread_detach (thread);
+        }
+
+        priv->batch_fsync_threads = i;
+
+        if (i == 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "no fsyncer thread, not batching fsyncs");
+                priv->batch_fsync_mode = POSIX_BATCH_FSYNC_NONE;
+        }
+}
+
+
+/*
+ * queue an fsync for the fsyncer threads. when no other fsync is being
+ * done it is not worth waiting for a batch: returns 1 and the caller does
+ * it right away, then calls posix_fsync_inline_done. returns 0 when
+ * queued, -1 if the fsync should be done right away all the same.
+ */
+static int
+posix_fsync_queue (xlator_t *this, call_frame_t *frame, fd_t *fd, int _fd,
+                   int32_t datasync, struct iatt *preop,
+                   struct timeval *start)
+{
+        struct posix_private   *priv = NULL;
+        struct posix_fsync_req *req  = NULL;
+        int                     ret  = 0;
+
+        priv = this->private;
+
+        req = GF_CALLOC (1, sizeof (*req), gf_posix_mt_fsync_req);
+        if (!req)
+                return -1;
+
+        req->frame    = frame;
+        req->_fd      = _fd;
+        req->datasync = datasync;
+        req->preop    = *preop;
+        req->queued   = *start;
+
+        pthread_mutex_lock (&priv->fsync_lock);
+        {
+                if (!priv->fsync_inline && list_empty (&priv->fsyncs)) {
+                        priv->fsync_inline++;
+                        ret = 1;
+                } else {
+                        req->fd = fd_ref (fd);
+                        list_add_tail (&req->list, &priv->fsyncs);
+                        pthread_cond_signal (&priv->fsync_cond);
+                }
+        }
+        pthread_mutex_unlock (&priv->fsync_lock);
+
+        if (ret == 1)
+                GF_FREE (req);
+
+        return ret;
+}
+
+
+static void
+posix_fsync_inline_done (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->fsync_lock);
+        {
+                priv->fsync_inline--;
+        }
+        pthread_mutex_unlock (&priv->fsync_lock);
+}
+
+
 int32_t
 posix_fsync (call_frame_t *frame, xlator_t *this,
              fd_t *fd, int32_t datasync)
@@ -2705,6 +3695,10 @@ posix_fsync (call_frame_t *frame, xlator_t *this,
 	uint64_t          tmp_pfd  = 0;
         struct iatt       preop = {0,};
         struct iatt       postop = {0,};
+        struct timeval    start = {0,};
+        int               batched = 0;
+
+        struct posix_private *priv = NULL;
 
         DECLARE_OLD_FS_ID_VAR;
 
@@ -2712,6 +3706,12 @@ posix_fsync (call_frame_t *frame, xlator_t *this,
         VALIDATE_OR_GOTO (this, out);
         VALIDATE_OR_GOTO (fd, out);
 
+        priv = this->private;
+
+        if (priv->aio_capable
+            && (posix_aio_fsync (frame, this, fd, datasync) == 0))
+                return 0;
+
         SET_FS_ID (frame->root->uid, frame->root->gid);
 
 #ifdef GF_DARWIN_HOST_OS
@@ -2731,6 +3731,8 @@ posix_fsync (call_frame_t *frame, xlator_t *this,
 
         _fd = pfd->fd;
 
+        gettimeofday (&start, NULL);
+
         op_ret = posix_fstat_with_gen (this, _fd, &preop);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -2740,22 +3742,32 @@ posix_fsync (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
-        if (datasync) {
-                ;
-#ifdef HAVE_FDATASYNC
-                op_ret = fdatasync (_fd);
-#endif
-        } else {
-                op_ret = fsync (_fd);
-                if (op_ret == -1) {
-                        op_errno = errno;
-                        gf_log (this->name, GF_LOG_ERROR, 
-                                "fsync on fd=%p failed: %s",
-                                fd, strerror (op_errno));
-                        goto out;
+        if (priv->batch_fsync_mode != POSIX_BATCH_FSYNC_NONE) {
+                ret = posix_fsync_queue (this, frame, fd, _fd, datasync,
+                                         &preop, &start);
+                if (ret == 0) {
+                        SET_TO_OLD_FS_ID ();
+                        return 0;
                 }
+                /* do it right here then */
+                batched = (ret == 1);
+        }
+
+        ret = posix_fsync_fd (_fd, datasync);
+
+        if (batched)
+                posix_fsync_inline_done (this);
+        if (ret < 0) {
+                op_ret = -1;
+                op_errno = -ret;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "fsync on fd=%p failed: %s",
+                        fd, strerror (op_errno));
+                goto out;
         }
 
+        posix_fsync_wait_account (priv, &start);
+
         op_ret = posix_fstat_with_gen (this, _fd, &postop);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -2927,6 +3939,12 @@ posix_setxattr (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         trav = dict->members_list;
 
         while (trav) {
@@ -2941,6 +3959,9 @@ posix_setxattr (call_frame_t *frame, xlator_t *this,
         op_ret = 0;
 
  out:
+        if (loc)
+                posix_xattrop_cache_drop (this, loc->inode);
+
         SET_TO_OLD_FS_ID ();
 
         STACK_UNWIND_STRICT (setxattr, frame, op_ret, op_errno);
@@ -3052,6 +4073,12 @@ posix_getxattr (call_frame_t *frame, xlator_t *this,
         SET_FS_ID (frame->root->uid, frame->root->gid);
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         priv = this->private;
 
         if (loc->inode && IA_ISDIR(loc->inode->ia_type) && name &&
@@ -3387,6 +4414,9 @@ posix_fsetxattr (call_frame_t *frame, xlator_t *this,
         op_ret = 0;
 
  out:
+        if (fd)
+                posix_xattrop_cache_drop (this, fd->inode);
+
         SET_TO_OLD_FS_ID ();
 
         STACK_UNWIND_STRICT (fsetxattr, frame, op_ret, op_errno);
@@ -3409,8 +4439,16 @@ posix_removexattr (call_frame_t *frame, xlator_t *this,
 
         SET_FS_ID (frame->root->uid, frame->root->gid);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         op_ret = sys_lremovexattr (real_path, name);
 
+        posix_xattrop_cache_drop (this, loc->inode);
+
         if (op_ret == -1) {
                 op_errno = errno;
 		if (op_errno != ENOATTR && op_errno != EPERM)
@@ -3493,46 +4531,192 @@ __add_array (int32_t *dest, int32_t *src, int count)
 }
 
 
-/**
- * xattrop - xattr operations - for internal use by GlusterFS
- * @optype: ADD_ARRAY:
- *            dict should contain:
- *               "key" ==> array of 32-bit numbers
- */
-
-int
-do_xattrop (call_frame_t *frame, xlator_t *this,
-            loc_t *loc, fd_t *fd, gf_xattrop_flags_t optype, dict_t *xattr)
+static struct posix_xattr_val *
+__posix_xattr_val_get (struct posix_inode_ctx *ctx, const char *key)
 {
-	char            *real_path = NULL;
-	int32_t         *array = NULL;
-	int              size = 0;
-	int              count = 0;
+        struct posix_xattr_val *val = NULL;
 
-	int              op_ret = 0;
-	int              op_errno = 0;
+        list_for_each_entry (val, &ctx->xattrs, list) {
+                if (!strcmp (val->key, key))
+                        return val;
+        }
 
-        int              ret = 0;
-	int              _fd = -1;
-        uint64_t         tmp_pfd = 0;
-	struct posix_fd *pfd = NULL;
+        return NULL;
+}
 
-	data_pair_t     *trav = NULL;
 
-        char *    path  = NULL;
-        inode_t * inode = NULL;
+/*
+ * is @key one of the names in @list, as returned by listxattr?
+ */
+static gf_boolean_t
+posix_xattr_listed (const char *list, ssize_t size, const char *key)
+{
+        ssize_t offset = 0;
 
-	VALIDATE_OR_GOTO (frame, out);
-	VALIDATE_OR_GOTO (xattr, out);
-	VALIDATE_OR_GOTO (this, out);
+        while (offset < size) {
+                if (!strcmp (list + offset, key))
+                        return _gf_true;
 
-	trav = xattr->members_list;
+                offset += strlen (list + offset) + 1;
+        }
 
-	if (fd) {
-		ret = fd_ctx_get (fd, this, &tmp_pfd);
-		if (ret < 0) {
-			gf_log (this->name, GF_LOG_DEBUG,
-				"failed to get pfd from fd=%p",
+        return _gf_false;
+}
+
+
+/*
+ * make sure every key of @xattr has its current value in @ctx. values
+ * which are not there yet are read from disk, and keys the file does not
+ * have count as all zeros. when more than one value is missing, a single
+ * listxattr tells which of them need a getxattr at all.
+ */
+static int
+__posix_xattrop_load (xlator_t *this, struct posix_inode_ctx *ctx,
+                      const char *real_path, int _fd, dict_t *xattr)
+{
+        struct posix_xattr_val *val       = NULL;
+        data_pair_t            *trav      = NULL;
+        char                   *list      = NULL;
+        ssize_t                 list_size = -1;
+        int                     missing   = 0;
+        ssize_t                 size      = 0;
+        int                     op_errno  = 0;
+
+        for (trav = xattr->members_list; trav; trav = trav->next) {
+                val = __posix_xattr_val_get (ctx, trav->key);
+                if (val && (val->len != trav->value->len))
+                        __posix_xattr_val_del (val);
+                else if (val)
+                        continue;
+
+                missing++;
+        }
+
+        if (missing > 1) {
+                if (real_path)
+                        list_size = sys_llistxattr (real_path, NULL, 0);
+                else
+                        list_size = sys_flistxattr (_fd, NULL, 0);
+
+                if (list_size > 0) {
+                        list = alloca (list_size);
+                        if (real_path)
+                                list_size = sys_llistxattr (real_path, list,
+                                                            list_size);
+                        else
+                                list_size = sys_flistxattr (_fd, list,
+                                                            list_size);
+                }
+                /* on failure every value is read on its own */
+        }
+
+        for (trav = xattr->members_list; missing && trav; trav = trav->next) {
+                if (__posix_xattr_val_get (ctx, trav->key))
+                        continue;
+
+                val = GF_CALLOC (1, sizeof (*val), gf_posix_mt_xattr_val);
+                if (!val)
+                        return -ENOMEM;
+
+                val->key   = gf_strdup (trav->key);
+                val->len   = trav->value->len;
+                val->value = GF_CALLOC (1, val->len, gf_posix_mt_xattr_val);
+                if (!val->key || !val->value) {
+                        GF_FREE (val->key);
+                        GF_FREE (val->value);
+                        GF_FREE (val);
+                        return -ENOMEM;
+                }
+
+                list_add_tail (&val->list, &ctx->xattrs);
+                missing--;
+
+                if ((list_size >= 0)
+                    && !posix_xattr_listed (list, list_size, trav->key))
+                        continue;
+
+                if (real_path)
+                        size = sys_lgetxattr (real_path, trav->key,
+                                              val->value, val->len);
+                else
+                        size = sys_fgetxattr (_fd, trav->key,
+                                              val->value, val->len);
+
+                if ((size == -1) && (errno != ENODATA) && (errno != ENOATTR)) {
+                        op_errno = errno;
+                        __posix_xattr_val_del (val);
+
+                        if (op_errno == ENOTSUP) {
+                                GF_LOG_OCCASIONALLY(gf_posix_xattr_enotsup_log,
+                                                    this->name,GF_LOG_WARNING,
+                                                    "Extended attributes not "
+                                                    "supported by filesystem");
+                        } else if (real_path) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "getxattr failed on %s while doing "
+                                        "xattrop: %s", real_path,
+                                        strerror (op_errno));
+                        } else {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "fgetxattr failed on fd=%d while "
+                                        "doing xattrop: %s", _fd,
+                                        strerror (op_errno));
+                        }
+
+                        return -op_errno;
+                }
+        }
+
+        return 0;
+}
+
+
+/**
+ * xattrop - xattr operations - for internal use by GlusterFS
+ * @optype: ADD_ARRAY:
+ *            dict should contain:
+ *               "key" ==> array of 32-bit numbers
+ *
+ * the values are kept in the inode context, so replicate's pre-op and
+ * post-op on a busy file are served without reading xattrs from disk,
+ * and only values the operation really changes are written back.
+ */
+
+int
+do_xattrop (call_frame_t *frame, xlator_t *this,
+            loc_t *loc, fd_t *fd, gf_xattrop_flags_t optype, dict_t *xattr)
+{
+	char                   *real_path = NULL;
+	int32_t                *array = NULL;
+	int                     size = 0;
+
+	int                     op_ret = 0;
+	int                     op_errno = 0;
+
+        int                     ret = 0;
+	int                     _fd = -1;
+        uint64_t                tmp_pfd = 0;
+	struct posix_fd        *pfd = NULL;
+        struct posix_private   *priv = NULL;
+        struct posix_inode_ctx *ctx = NULL;
+        struct posix_xattr_val *val = NULL;
+
+	data_pair_t            *trav = NULL;
+
+        char *    path  = NULL;
+        inode_t * inode = NULL;
+
+	VALIDATE_OR_GOTO (frame, out);
+	VALIDATE_OR_GOTO (xattr, out);
+	VALIDATE_OR_GOTO (this, out);
+
+        priv = this->private;
+
+	if (fd) {
+		ret = fd_ctx_get (fd, this, &tmp_pfd);
+		if (ret < 0) {
+			gf_log (this->name, GF_LOG_DEBUG,
+				"failed to get pfd from fd=%p",
 				fd);
 			op_ret = -1;
 			op_errno = EBADFD;
@@ -3545,6 +4729,13 @@ do_xattrop (call_frame_t *frame, xlator_t *this,
 	if (loc && loc->path)
 		MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (loc && loc->path
+            && posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         if (loc) {
                 path  = gf_strdup (loc->path);
                 inode = loc->inode;
@@ -3552,119 +4743,111 @@ do_xattrop (call_frame_t *frame, xlator_t *this,
                 inode = fd->inode;
         }
 
-	while (trav && inode) {
-		count = trav->value->len / sizeof (int32_t);
-		array = GF_CALLOC (count, sizeof (int32_t),
-                                   gf_posix_mt_int32_t);
+        if (!inode || !xattr->members_list)
+                goto out;
 
-                LOCK (&inode->lock);
-                {
-                        if (loc) {
-                                size = sys_lgetxattr (real_path, trav->key, (char *)array, 
-                                                      trav->value->len);
-                        } else {
-                                size = sys_fgetxattr (_fd, trav->key, (char *)array, 
-                                                      trav->value->len);
-                        }
+        if (optype != GF_XATTROP_ADD_ARRAY) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Unknown xattrop type (%d) on %s. Please send "
+                        "a bug report to gluster-devel@nongnu.org",
+                        optype, path);
+                op_ret = -1;
+                op_errno = EINVAL;
+                goto out;
+        }
 
-                        op_errno = errno;
-                        if ((size == -1) && (op_errno != ENODATA) && 
-                            (op_errno != ENOATTR)) {
-                                if (op_errno == ENOTSUP) {
-                                        GF_LOG_OCCASIONALLY(gf_posix_xattr_enotsup_log,
-                                                            this->name,GF_LOG_WARNING, 
-                                                            "Extended attributes not "
-                                                            "supported by filesystem");
-                                } else 	{
-                                        if (loc)
-                                                gf_log (this->name, GF_LOG_ERROR,
-                                                        "getxattr failed on %s while doing "
-                                                        "xattrop: %s", path,
-                                                        strerror (op_errno));
-                                        else
-                                                gf_log (this->name, GF_LOG_ERROR,
-                                                        "fgetxattr failed on fd=%d while doing "
-                                                        "xattrop: %s", _fd,
-                                                        strerror (op_errno));
-                                }
+        ctx = posix_inode_ctx_get (this, inode);
+        if (!ctx) {
+                op_ret = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
 
-                                op_ret = -1;
-                                goto unlock;
-                        }
+        pthread_mutex_lock (&ctx->xattrop_lock);
+
+        ret = __posix_xattrop_load (this, ctx, real_path, _fd, xattr);
+        if (ret < 0) {
+                op_ret = -1;
+                op_errno = -ret;
+                goto unlock;
+        }
 
-                        switch (optype) {
+	for (trav = xattr->members_list; trav; trav = trav->next) {
+                val = __posix_xattr_val_get (ctx, trav->key);
 
-                        case GF_XATTROP_ADD_ARRAY:
-                                __add_array (array, (int32_t *) trav->value->data, 
-                                             trav->value->len / 4);
-                                break;
+		array = GF_CALLOC (val->len, 1, gf_posix_mt_int32_t);
+                if (!array) {
+                        op_ret = -1;
+                        op_errno = ENOMEM;
+                        goto unlock;
+                }
 
-                        default:
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "Unknown xattrop type (%d) on %s. Please send "
-                                        "a bug report to gluster-devel@nongnu.org",
-                                        optype, path);
-                                op_ret = -1;
-                                op_errno = EINVAL;
-                                goto unlock;
-                        }
+                memcpy (array, val->value, val->len);
+                __add_array (array, (int32_t *) trav->value->data,
+                             trav->value->len / 4);
 
+                if (memcmp (array, val->value, val->len)) {
                         if (loc) {
-                                size = sys_lsetxattr (real_path, trav->key, array,
-                                                      trav->value->len, 0);
+                                size = sys_lsetxattr (real_path, trav->key,
+                                                      array, val->len, 0);
                         } else {
-                                size = sys_fsetxattr (_fd, trav->key, (char *)array,
-                                                      trav->value->len, 0);
+                                size = sys_fsetxattr (_fd, trav->key,
+                                                      (char *)array,
+                                                      val->len, 0);
                         }
-                }
-        unlock:
-                UNLOCK (&inode->lock);
 
-                if (op_ret == -1)
-                        goto out;
+                        if (size == -1) {
+                                op_errno = errno;
+                                if (loc)
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "setxattr failed on %s while "
+                                                "doing xattrop: key=%s (%s)",
+                                                path, trav->key,
+                                                strerror (op_errno));
+                                else
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "fsetxattr failed on fd=%d "
+                                                "while doing xattrop: "
+                                                "key=%s (%s)", _fd,
+                                                trav->key,
+                                                strerror (op_errno));
 
-		op_errno = errno;
-		if (size == -1) {
+                                /* don't know what is on disk now */
+                                __posix_xattr_val_del (val);
+                                op_ret = -1;
+                                goto unlock;
+                        }
+
+                        memcpy (val->value, array, val->len);
+                }
+
+                size = dict_set_bin (xattr, trav->key, array, val->len);
+                if (size != 0) {
                         if (loc)
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "setxattr failed on %s while doing xattrop: "
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "dict_set_bin failed (path=%s): "
                                         "key=%s (%s)", path,
-                                        trav->key, strerror (op_errno));
+                                        trav->key, strerror (-size));
                         else
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "fsetxattr failed on fd=%d while doing xattrop: "
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "dict_set_bin failed (fd=%d): "
                                         "key=%s (%s)", _fd,
-                                        trav->key, strerror (op_errno));
-
-			op_ret = -1;
-			goto out;
-		} else {
-			size = dict_set_bin (xattr, trav->key, array, 
-					     trav->value->len);
-
-			if (size != 0) {
-                                if (loc)
-                                        gf_log (this->name, GF_LOG_DEBUG,
-                                                "dict_set_bin failed (path=%s): "
-                                                "key=%s (%s)", path,
-                                                trav->key, strerror (-size));
-                                else
-                                        gf_log (this->name, GF_LOG_DEBUG,
-                                                "dict_set_bin failed (fd=%d): "
-                                                "key=%s (%s)", _fd,
-                                                trav->key, strerror (-size));
+                                        trav->key, strerror (-size));
 
-				op_ret = -1;
-				op_errno = EINVAL;
-				goto out;
-			}
-			array = NULL;
-		}
+                        op_ret = -1;
+                        op_errno = EINVAL;
+                        goto unlock;
+                }
 
 		array = NULL;
-		trav = trav->next;
 	}
 
+unlock:
+        if (!priv->xattrop_cache || (op_ret == -1))
+                __posix_xattr_vals_free (ctx);
+
+        pthread_mutex_unlock (&ctx->xattrop_lock);
+
 out:
 	if (array)
 		GF_FREE (array);
@@ -3712,6 +4895,12 @@ posix_access (call_frame_t *frame, xlator_t *this,
 
         MAKE_REAL_PATH (real_path, this, loc->path);
 
+        if (posix_handle_denied (frame, this, loc->path)) {
+                op_ret = -1;
+                op_errno = EACCES;
+                goto out;
+        }
+
         op_ret = access (real_path, mask & 07);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -3925,6 +5114,196 @@ posix_fentrylk (call_frame_t *frame, xlator_t *this,
 }
 
 
+static void
+posix_stat_batch_entry (xlator_t *this, struct posix_stat_batch *batch,
+                        int idx)
+{
+        gf_dirent_t *entry = NULL;
+        char        *path  = NULL;
+
+        entry = batch->entries[idx];
+
+        path = alloca (strlen (batch->dir_path) + strlen (entry->d_name) + 2);
+        sprintf (path, "%s/%s", batch->dir_path, entry->d_name);
+
+        batch->ret[idx] = posix_fstatat_with_gen (this, batch->dirfd,
+                                                  entry->d_name, path,
+                                                  &entry->d_stat);
+}
+
+
+/*
+ * stat entries of @batch until none is left, and wait for the ones other
+ * threads are still at. called with readdirp_lock held.
+ */
+static void
+__posix_stat_batch_work (xlator_t *this, struct posix_stat_batch *batch)
+{
+        struct posix_private *priv = NULL;
+        int                   idx  = 0;
+
+        priv = this->private;
+
+        while (batch->next < batch->count) {
+                idx = batch->next++;
+                if (batch->next == batch->count)
+                        list_del_init (&batch->list);
+
+                batch->active++;
+                pthread_mutex_unlock (&priv->readdirp_lock);
+                {
+                        posix_stat_batch_entry (this, batch, idx);
+                }
+                pthread_mutex_lock (&priv->readdirp_lock);
+                batch->active--;
+        }
+}
+
+
+static void *
+posix_readdirp_helper_proc (void *data)
+{
+        xlator_t                *this  = NULL;
+        struct posix_private    *priv  = NULL;
+        struct posix_stat_batch *batch = NULL;
+        int                      idx   = 0;
+
+        this = data;
+        priv = this->private;
+
+        THIS = this;
+
+        pthread_mutex_lock (&priv->readdirp_lock);
+        for (;;) {
+                while (list_empty (&priv->readdirp_batches))
+                        pthread_cond_wait (&priv->readdirp_cond,
+                                           &priv->readdirp_lock);
+
+                /* one entry at a time, so that all helpers share the
+                   batches queued */
+                batch = list_entry (priv->readdirp_batches.next,
+                                    struct posix_stat_batch, list);
+
+                idx = batch->next++;
+                if (batch->next == batch->count)
+                        list_del_init (&batch->list);
+
+                batch->active++;
+                pthread_mutex_unlock (&priv->readdirp_lock);
+                {
+                        posix_stat_batch_entry (this, batch, idx);
+                }
+                pthread_mutex_lock (&priv->readdirp_lock);
+                batch->active--;
+
+                if ((batch->next == batch->count) && !batch->active)
+                        pthread_cond_broadcast (&priv->readdirp_done);
+        }
+
+        return NULL;
+}
+
+
+static void
+posix_spawn_readdirp_helpers (xlator_t *this)
+{
+        struct posix_private *priv   = NULL;
+        pthread_t             thread;
+        int                   i      = 0;
+        int                   ret    = 0;
+
+        priv = this->private;
+
+        for (i = 0; i < priv->readdirp_threads; i++) {
+                ret = pthread_create (&thread, NULL,
+                                      posix_readdirp_helper_proc, this);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "spawning readdirp helper thread failed: %s",
+                                strerror (ret));
+                        break;
+                }
+
+                pthread_detach (thread);
+        }
+
+        priv->readdirp_threads = i;
+}
+
+
+/*
+ * stat all entries in @entries, with the help of the readdirp helper
+ * threads. entries which could not be stat'ed are dropped, returns how
+ * many are left.
+ */
+static int
+posix_stat_entries (xlator_t *this, DIR *dir, char *dir_path,
+                    gf_dirent_t *entries, int count)
+{
+        struct posix_private    *priv  = NULL;
+        struct posix_stat_batch  batch;
+        gf_dirent_t             *entry = NULL;
+        gf_dirent_t             *tmp   = NULL;
+        int                      idx   = 0;
+
+        priv = this->private;
+
+        if (!count)
+                return 0;
+
+        memset (&batch, 0, sizeof (batch));
+        INIT_LIST_HEAD (&batch.list);
+
+        batch.dirfd    = dirfd (dir);
+        batch.dir_path = dir_path;
+        batch.count    = count;
+        batch.entries  = GF_CALLOC (count, sizeof (*batch.entries)
+                                    + sizeof (*batch.ret),
+                                    gf_posix_mt_stat_batch);
+        if (!batch.entries) {
+                gf_log (this->name, GF_LOG_ERROR, "Out of memory.");
+                return -1;
+        }
+
+        batch.ret = (int *) &batch.entries[count];
+
+        list_for_each_entry (entry, &entries->list, list)
+                batch.entries[idx++] = entry;
+
+        pthread_mutex_lock (&priv->readdirp_lock);
+        {
+                if (priv->readdirp_threads && (count > 1)) {
+                        list_add_tail (&batch.list, &priv->readdirp_batches);
+                        pthread_cond_broadcast (&priv->readdirp_cond);
+                }
+
+                __posix_stat_batch_work (this, &batch);
+
+                while (batch.active)
+                        pthread_cond_wait (&priv->readdirp_done,
+                                           &priv->readdirp_lock);
+        }
+        pthread_mutex_unlock (&priv->readdirp_lock);
+
+        idx = 0;
+        list_for_each_entry_safe (entry, tmp, &entries->list, list) {
+                if (batch.ret[idx++] == -1) {
+                        list_del (&entry->list);
+                        GF_FREE (entry);
+                        count--;
+                        continue;
+                }
+
+                /* the scaled inode number, see posix_scale_ia_ino */
+                entry->d_ino = entry->d_stat.ia_ino;
+        }
+
+        GF_FREE (batch.entries);
+
+        return count;
+}
+
+
 int32_t
 posix_do_readdir (call_frame_t *frame, xlator_t *this,
                   fd_t *fd, size_t size, off_t off, int whichop)
@@ -3943,11 +5322,7 @@ posix_do_readdir (call_frame_t *frame, xlator_t *this,
         off_t                 in_case        = -1;
         int32_t               this_size      = -1;
         char                 *real_path      = NULL;
-        int                   real_path_len  = -1;
-        char                 *entry_path     = NULL;
-        int                   entry_path_len = -1;
         struct posix_private *priv           = NULL;
-        struct iatt           stbuf          = {0, };
         char                  base_path[PATH_MAX] = {0,};
 
         VALIDATE_OR_GOTO (frame, out);
@@ -3975,24 +5350,10 @@ posix_do_readdir (call_frame_t *frame, xlator_t *this,
         }
 
         real_path     = pfd->path;
-        real_path_len = strlen (real_path);
-
-        entry_path_len = real_path_len + NAME_MAX;
-        entry_path     = alloca (entry_path_len);
 
         strncpy(base_path, POSIX_BASE_PATH(this), sizeof(base_path));
         base_path[strlen(base_path)] = '/';
 
-        if (!entry_path) {
-                op_errno = errno;
-                gf_log (this->name, GF_LOG_ERROR,
-                        "Out of memory.");
-                goto out;
-        }
-
-        strncpy (entry_path, real_path, entry_path_len);
-        entry_path[real_path_len] = '/';
-
         dir = pfd->dir;
 
         if (!dir) {
@@ -4038,6 +5399,10 @@ posix_do_readdir (call_frame_t *frame, xlator_t *this,
                     && (!strcmp(entry->d_name, GF_REPLICATE_TRASH_DIR)))
                         continue;
 
+                if ((!strcmp(real_path, base_path))
+                    && (!strcmp(entry->d_name, GF_HANDLE_DIR)))
+                        continue;
+
                 this_size = dirent_size (entry);
 
                 if (this_size + filled > size) {
@@ -4045,27 +5410,6 @@ posix_do_readdir (call_frame_t *frame, xlator_t *this,
                         break;
                 }
 
-                /* Device spanning requires that we have a stat buf for the
-                 * file so we need to perform a stat on the two conditions
-                 * below.
-                 */
-                if ((whichop == GF_FOP_READDIRP) || (priv->span_devices)) {
-                        strcpy (entry_path + real_path_len + 1, entry->d_name);
-                        op_ret = posix_lstat_with_gen (this, entry_path, &stbuf);
-                        if (-1 == op_ret)
-                                continue;
-                } else
-                        stbuf.ia_ino = entry->d_ino;
-
-                /* So at this point stbuf ino is either:
-                 * a. the original inode number got from entry, in case this
-                 * was a readdir fop or if device spanning was disabled.
-                 *
-                 * b. the scaled inode number, if device spanning was enabled
-                 * or this was a readdirp fop.
-                 */
-                entry->d_ino = stbuf.ia_ino;
-
                 this_entry = gf_dirent_for_name (entry->d_name);
 
                 if (!this_entry) {
@@ -4076,7 +5420,6 @@ posix_do_readdir (call_frame_t *frame, xlator_t *this,
                 }
                 this_entry->d_off = telldir (dir);
                 this_entry->d_ino = entry->d_ino;
-                this_entry->d_stat = stbuf;
 
                 list_add_tail (&this_entry->list, &entries.list);
 
@@ -4084,6 +5427,19 @@ posix_do_readdir (call_frame_t *frame, xlator_t *this,
                 count ++;
         }
 
+        /* Device spanning requires that we have a stat buf for the
+         * file so we need to perform a stat on the two conditions
+         * below. otherwise d_ino is the one the kernel gave us.
+         */
+        if ((whichop == GF_FOP_READDIRP) || (priv->span_devices)) {
+                count = posix_stat_entries (this, dir, real_path, &entries,
+                                            count);
+                if (count == -1) {
+                        op_errno = ENOMEM;
+                        goto out;
+                }
+        }
+
         op_ret = count;
         errno = 0;
         if ((!readdir (dir) && (errno == 0)))
@@ -4121,6 +5477,11 @@ posix_priv (xlator_t *this)
         struct posix_private *priv = NULL;
         char  key_prefix[GF_DUMP_MAX_BUF_LEN];
         char  key[GF_DUMP_MAX_BUF_LEN];
+        int   i = 0;
+
+        uint64_t pending_files = 0;
+        uint64_t pending_bytes = 0;
+        uint64_t reclaimed     = 0;
 
         snprintf(key_prefix, GF_DUMP_MAX_BUF_LEN, "%s.%s", this->type, 
                        this->name);
@@ -4145,6 +5506,54 @@ posix_priv (xlator_t *this)
         gf_proc_dump_build_key(key, key_prefix, "nr_files");
         gf_proc_dump_write(key,"%ld", priv->nr_files);
 
+        gf_proc_dump_build_key(key, key_prefix, "fsync_batches");
+        gf_proc_dump_write(key,"%"PRIu64, priv->fsync_batches);
+
+        /* fsync wait time histogram, skipping empty buckets */
+        for (i = 0; i < POSIX_FSYNC_HIST_BUCKETS; i++) {
+                if (!priv->fsync_wait[i])
+                        continue;
+
+                if (i == POSIX_FSYNC_HIST_BUCKETS - 1) {
+                        gf_proc_dump_build_key(key, key_prefix,
+                                               "fsync_wait_usec.more");
+                } else {
+                        gf_proc_dump_build_key(key, key_prefix,
+                                               "fsync_wait_usec.below_%llu",
+                                               1ULL << i);
+                }
+                gf_proc_dump_write(key,"%"PRIu64, priv->fsync_wait[i]);
+        }
+
+        if (priv->background_unlink) {
+                pthread_mutex_lock (&priv->unlink_lock);
+                {
+                        pending_files = priv->unlink_pending_files;
+                        pending_bytes = priv->unlink_pending_bytes;
+                        reclaimed     = priv->unlink_reclaimed_bytes;
+                }
+                pthread_mutex_unlock (&priv->unlink_lock);
+
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "unlink_pending_files");
+                gf_proc_dump_write(key,"%"PRIu64, pending_files);
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "unlink_pending_bytes");
+                gf_proc_dump_write(key,"%"PRIu64, pending_bytes);
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "unlink_reclaimed_bytes");
+                gf_proc_dump_write(key,"%"PRIu64, reclaimed);
+        }
+
+        if (priv->aio_capable) {
+                gf_proc_dump_build_key(key, key_prefix, "aio_inflight");
+                gf_proc_dump_write(key,"%"PRIu64, priv->aio_inflight);
+                gf_proc_dump_build_key(key, key_prefix, "aio_submitted");
+                gf_proc_dump_write(key,"%"PRIu64, priv->aio_submitted);
+                gf_proc_dump_build_key(key, key_prefix, "aio_fallbacks");
+                gf_proc_dump_write(key,"%"PRIu64, priv->aio_fallbacks);
+        }
+
         return 0;
 }
 
@@ -4428,6 +5837,31 @@ init (xlator_t *this)
 				"unlinks will be performed in background");
         }
 
+        _private->unlink_chunk_size = POSIX_UNLINK_CHUNK_SIZE;
+        tmp_data = dict_get (this->options, "background-unlink-chunk-size");
+        if (tmp_data) {
+                if (gf_string2bytesize (tmp_data->data,
+                                        &_private->unlink_chunk_size) != 0) {
+			ret = -1;
+			gf_log (this->name, GF_LOG_ERROR,
+				"wrong option provided for "
+                                "'background-unlink-chunk-size'");
+			goto out;
+                }
+        }
+
+        _private->unlink_pause_msec = POSIX_UNLINK_PAUSE_MSEC;
+	dict_ret = dict_get_int32 (this->options,
+                                   "background-unlink-pause-msec",
+                                   &_private->unlink_pause_msec);
+        if ((dict_ret == 0) && (_private->unlink_pause_msec < 0)) {
+                ret = -1;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "wrong option provided for "
+                        "'background-unlink-pause-msec'");
+                goto out;
+        }
+
         tmp_data = dict_get (this->options, "o-direct");
         if (tmp_data) {
 		if (gf_string2boolean (tmp_data->data,
@@ -4483,6 +5917,106 @@ init (xlator_t *this)
 		_private->janitor_sleep_duration = janitor_sleep;
 	}
 
+        tmp_data = dict_get (this->options, "linux-aio");
+        if (tmp_data) {
+		if (gf_string2boolean (tmp_data->data,
+				       &_private->aio_configured) == -1) {
+			ret = -1;
+			gf_log (this->name, GF_LOG_ERROR,
+				"wrong option provided for 'linux-aio'");
+			goto out;
+		}
+        }
+
+        _private->aio_depth = POSIX_AIO_DEFAULT_DEPTH;
+	dict_ret = dict_get_int32 (this->options, "aio-depth",
+                                   &_private->aio_depth);
+        if ((dict_ret == 0) && (_private->aio_depth < 1)) {
+                ret = -1;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "wrong option provided for 'aio-depth'");
+                goto out;
+        }
+
+        _private->batch_fsync_mode = POSIX_BATCH_FSYNC_NONE;
+        tmp_data = dict_get (this->options, "batch-fsync-mode");
+        if (tmp_data) {
+                if (!strcmp (tmp_data->data, "none")) {
+                        _private->batch_fsync_mode = POSIX_BATCH_FSYNC_NONE;
+                } else if (!strcmp (tmp_data->data, "fsync")) {
+                        _private->batch_fsync_mode = POSIX_BATCH_FSYNC_FSYNC;
+                } else if (!strcmp (tmp_data->data, "syncfs")) {
+#ifdef HAVE_SYNCFS
+                        _private->batch_fsync_mode = POSIX_BATCH_FSYNC_SYNCFS;
+#else
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "syncfs() not available, batching fsyncs "
+                                "per fd instead");
+                        _private->batch_fsync_mode = POSIX_BATCH_FSYNC_FSYNC;
+#endif
+                } else {
+			ret = -1;
+			gf_log (this->name, GF_LOG_ERROR,
+				"wrong option provided for 'batch-fsync-mode'");
+			goto out;
+                }
+        }
+
+	dict_ret = dict_get_int32 (this->options, "batch-fsync-delay-usec",
+                                   &_private->batch_fsync_delay_usec);
+        if ((dict_ret == 0) && (_private->batch_fsync_delay_usec < 0)) {
+                ret = -1;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "wrong option provided for 'batch-fsync-delay-usec'");
+                goto out;
+        }
+
+        _private->batch_fsync_threads = POSIX_FSYNC_THREADS;
+	dict_ret = dict_get_int32 (this->options, "batch-fsync-threads",
+                                   &_private->batch_fsync_threads);
+        if ((dict_ret == 0) && (_private->batch_fsync_threads < 1)) {
+                ret = -1;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "wrong option provided for 'batch-fsync-threads'");
+                goto out;
+        }
+
+        /* off by default: the cache is not checked against the disk again,
+           so changelogs fixed with setfattr on the brick would be
+           overwritten by the next xattrop */
+        _private->xattrop_cache = 0;
+        tmp_data = dict_get (this->options, "xattrop-cache");
+        if (tmp_data) {
+		if (gf_string2boolean (tmp_data->data,
+				       &_private->xattrop_cache) == -1) {
+			ret = -1;
+			gf_log (this->name, GF_LOG_ERROR,
+				"wrong option provided for 'xattrop-cache'");
+			goto out;
+		}
+        }
+
+        tmp_data = dict_get (this->options, "handle-store");
+        if (tmp_data) {
+		if (gf_string2boolean (tmp_data->data,
+				       &_private->handle_store) == -1) {
+			ret = -1;
+			gf_log (this->name, GF_LOG_ERROR,
+				"wrong option provided for 'handle-store'");
+			goto out;
+		}
+        }
+
+        _private->readdirp_threads = POSIX_READDIRP_THREADS;
+	dict_ret = dict_get_int32 (this->options, "readdirp-threads",
+                                   &_private->readdirp_threads);
+        if ((dict_ret == 0) && (_private->readdirp_threads < 0)) {
+                ret = -1;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "wrong option provided for 'readdirp-threads'");
+                goto out;
+        }
+
         LOCK_INIT (&_private->gen_lock);
         time64 = time (NULL);
         _private->gen_seq = (time64 << 32);
@@ -4516,11 +6050,37 @@ init (xlator_t *this)
 #endif
         this->private = (void *)_private;
 
+        if (_private->handle_store) {
+                ret = posix_handle_init (this);
+                if (ret == -1)
+                        goto out;
+        }
+
         pthread_mutex_init (&_private->janitor_lock, NULL);
         pthread_cond_init (&_private->janitor_cond, NULL);
         INIT_LIST_HEAD (&_private->janitor_fds);
 
         posix_spawn_janitor_thread (this);
+
+        posix_spawn_reclaimer_thread (this);
+
+        pthread_mutex_init (&_private->readdirp_lock, NULL);
+        pthread_cond_init (&_private->readdirp_cond, NULL);
+        pthread_cond_init (&_private->readdirp_done, NULL);
+        INIT_LIST_HEAD (&_private->readdirp_batches);
+
+        posix_spawn_readdirp_helpers (this);
+
+        pthread_mutex_init (&_private->fsync_lock, NULL);
+        pthread_cond_init (&_private->fsync_cond, NULL);
+        INIT_LIST_HEAD (&_private->fsyncs);
+
+        if (_private->batch_fsync_mode != POSIX_BATCH_FSYNC_NONE)
+                posix_spawn_fsyncers (this);
+
+        /* not fatal, the data fops stay synchronous */
+        if (_private->aio_configured)
+                posix_aio_init (this);
  out:
         return ret;
 }
@@ -4529,6 +6089,7 @@ void
 fini (xlator_t *this)
 {
         struct posix_private *priv = this->private;
+        posix_aio_fini (this);
         sys_lremovexattr (priv->base_path, "trusted.glusterfs.test");
         GF_FREE (priv);
         return;
@@ -4603,7 +6164,39 @@ struct volume_options options[] = {
 	  .type = GF_OPTION_TYPE_INT },
         { .key  = {"background-unlink"},
           .type = GF_OPTION_TYPE_BOOL },
+        { .key  = {"background-unlink-chunk-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 1 * GF_UNIT_MB },
+        { .key  = {"background-unlink-pause-msec"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 60000 },
         { .key  = {"janitor-sleep-duration"},
           .type = GF_OPTION_TYPE_INT },
+        { .key  = {"batch-fsync-mode"},
+          .type = GF_OPTION_TYPE_STR,
+          .value = {"none", "fsync", "syncfs"} },
+        { .key  = {"batch-fsync-delay-usec"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 1000000 },
+        { .key  = {"batch-fsync-threads"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 64 },
+        { .key  = {"xattrop-cache"},
+          .type = GF_OPTION_TYPE_BOOL },
+        { .key  = {"readdirp-threads"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 64 },
+        { .key  = {"linux-aio"},
+          .type = GF_OPTION_TYPE_BOOL },
+        { .key  = {"handle-store"},
+          .type = GF_OPTION_TYPE_BOOL },
+        { .key  = {"aio-depth"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 65536 },
 	{ .key  = {NULL} }
 };
@@ -52,6 +52,7 @@
 #include "compat.h"
 #include "timer.h"
 #include "posix-mem-types.h"
+#include "posix-handle.h"
 
 /**
  * posix_fd - internal structure common to file and directory fd's
@@ -67,6 +68,99 @@ struct posix_fd {
 };
 
 
+/**
+ * posix_xattr_val - current value of an xattr changed by xattrop
+ */
+
+struct posix_xattr_val {
+        struct list_head  list;
+        char             *key;
+        int32_t           len;
+        char             *value;
+};
+
+
+/**
+ * posix_inode_ctx - what is kept in the inode
+ */
+
+struct posix_inode_ctx {
+        pthread_mutex_t   xattrop_lock;  /* serializes xattrops */
+        struct list_head  xattrs;        /* posix_xattr_val's of this inode,
+                                            under xattrop_lock */
+        char              handle;        /* lookup made its handle */
+};
+
+
+/* how fsyncs are grouped, see posix_fsyncer */
+typedef enum {
+        POSIX_BATCH_FSYNC_NONE = 0,
+        POSIX_BATCH_FSYNC_FSYNC,    /* one fsync per file per batch */
+        POSIX_BATCH_FSYNC_SYNCFS,   /* one syncfs per device per batch */
+} posix_batch_fsync_mode_t;
+
+/* default number of fsyncer threads */
+#define POSIX_FSYNC_THREADS 4
+
+/* fsync wait times, bucket i counts waits below 2^i microseconds */
+#define POSIX_FSYNC_HIST_BUCKETS 26
+
+/**
+ * posix_fsync_req - an fsync waiting for an fsyncer thread
+ */
+
+struct posix_fsync_req {
+        struct list_head  list;
+        call_frame_t     *frame;
+        fd_t             *fd;
+        int               _fd;
+        int32_t           datasync;
+        struct timeval    queued;
+        struct iatt       preop;
+        int32_t           op_ret;
+        int32_t           op_errno;
+};
+
+
+/* default most bytes freed at a time by the reclaimer */
+#define POSIX_UNLINK_CHUNK_SIZE (64 * GF_UNIT_MB)
+
+/* default pause of the reclaimer between two chunks */
+#define POSIX_UNLINK_PAUSE_MSEC 100
+
+/**
+ * posix_unlink_req - an unlinked file still holding its blocks, which the
+ *                    reclaimer frees a chunk at a time
+ */
+
+struct posix_unlink_req {
+        struct list_head  list;
+        int               _fd;
+        off_t             size;      /* left to truncate */
+        uint64_t          pending;   /* bytes still allocated */
+};
+
+
+/* helper threads stat'ing readdirp entries, besides the calling thread */
+#define POSIX_READDIRP_THREADS 4
+
+/**
+ * posix_stat_batch - entries of one readdir(p) reply which are stat'ed
+ *                    together by the readdirp helper threads
+ */
+
+struct posix_stat_batch {
+        struct list_head   list;     /* in readdirp_batches */
+        int                dirfd;
+        char              *dir_path;
+        gf_dirent_t      **entries;
+        int               *ret;      /* result of stat'ing each entry */
+        int                count;
+        int                next;     /* next entry to stat */
+        int                active;   /* entries being stat'ed */
+};
+
+
 struct posix_private {
 	char   *base_path;
 	int32_t base_path_length;
@@ -124,16 +218,82 @@ struct posix_private {
         pthread_t       janitor;
         gf_boolean_t    janitor_present;
         char *          trash_path;
+
+/* linux native aio for the data fops, see posix-aio.c */
+        gf_boolean_t    aio_configured;
+        gf_boolean_t    aio_capable;
+        gf_boolean_t    aio_fsync;      /* fs supports IOCB_CMD_FSYNC */
+        int32_t         aio_depth;
+        unsigned long   aio_ctx;
+        int             aio_eventfd;
+        int             aio_idx;        /* in the event pool */
+        uint64_t        aio_inflight;
+        uint64_t        aio_submitted;
+        uint64_t        aio_fallbacks;
+
+/* keep the values xattrop leaves in the inode, see do_xattrop. only safe
+   when the xattrs are never changed on the brick behind our back */
+        gf_boolean_t     xattrop_cache;
+
+/* helper threads stat'ing the entries of readdirp replies in parallel */
+        int32_t          readdirp_threads;
+        struct list_head readdirp_batches;
+        pthread_mutex_t  readdirp_lock;
+        pthread_cond_t   readdirp_cond;    /* a batch was queued */
+        pthread_cond_t   readdirp_done;    /* a batch was finished */
+
+/* group commit of fsyncs, see posix_fsyncer */
+        posix_batch_fsync_mode_t batch_fsync_mode;
+        int32_t          batch_fsync_delay_usec;
+        struct list_head fsyncs;
+        pthread_mutex_t  fsync_lock;
+        pthread_cond_t   fsync_cond;
+        int32_t          batch_fsync_threads;
+        int32_t          fsync_inline;     /* fsyncs done by their fop */
+        uint64_t         fsync_batches;
+        uint64_t         fsync_wait[POSIX_FSYNC_HIST_BUCKETS];
+
+/* large files left by background unlink, see posix_reclaimer */
+        uint64_t         unlink_chunk_size;
+        int32_t          unlink_pause_msec;
+        struct list_head unlinks;
+        pthread_mutex_t  unlink_lock;
+        pthread_cond_t   unlink_cond;
+        pthread_t        reclaimer;
+        gf_boolean_t     reclaimer_present;
+        uint64_t         unlink_pending_files;
+        uint64_t         unlink_pending_bytes;
+        uint64_t         unlink_reclaimed_bytes;
+
+/* handles of the files by generation number, see posix-handle.c */
+        gf_boolean_t     handle_store;
 };
 
 #define POSIX_BASE_PATH(this) (((struct posix_private *)this->private)->base_path)
 
 #define POSIX_BASE_PATH_LEN(this) (((struct posix_private *)this->private)->base_path_length)
 
+#define ALIGN_BUF(ptr,bound) ((void *)((unsigned long)(ptr + bound - 1) & \
+                                       (unsigned long)(~(bound - 1))))
+
 #define MAKE_REAL_PATH(var, this, path) do {                            \
-		var = alloca (strlen (path) + POSIX_BASE_PATH_LEN(this) + 2); \
+		var = alloca (strlen (path) + POSIX_BASE_PATH_LEN(this) + \
+                              POSIX_HANDLE_PATH_EXTRA);                 \
+                if (posix_handle_is_id_path (this, path)) {             \
+                        posix_handle_real_path (this, path, var);       \
+                        break;                                          \
+                }                                                       \
                 strcpy (var, POSIX_BASE_PATH(this));			\
                 strcpy (&var[POSIX_BASE_PATH_LEN(this)], path);		\
         } while (0)
 
+int
+posix_lstat_with_gen (xlator_t *this, const char *path, struct iatt *stbuf_p);
+
+int
+posix_fstat_with_gen (xlator_t *this, int fd, struct iatt *stbuf_p);
+
+int
+posix_iov_aligned_run (struct iovec *vector, int count, int align);
+
 #endif /* _POSIX_H */